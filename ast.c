@@ -0,0 +1,118 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "ast.h"
+
+#include <string.h>
+
+static bool ast_section_fits(u64 offset, u64 count, u64 elem_size, u64 align, u64 size) {
+    return offset <= size
+           && offset % align == 0
+           && count <= (size - offset) / elem_size;
+}
+
+bool ast_passage_valid(const BiblePassage *passage) {
+    return passage->book >= 0
+           && passage->book < BIBLE_BOOK_COUNT
+           && passage->ch_v.chapter > 0
+           && passage->ch_v.start_verse >= 0
+           && passage->ch_v.end_verse >= 0;
+}
+
+bool ast_open(AstView *view, const void *data, u64 size) {
+    if (!view || !data) {
+        return false;
+    }
+
+    *view = (AstView){};
+
+    if (size < sizeof(AstHeader) || (uintptr_t) data % alignof(AstHeader) != 0) {
+        return false;
+    }
+
+    const AstHeader *header = data;
+
+    bool valid = header->magic == ARTICLE_AST_MAGIC
+                 && header->version == ARTICLE_AST_VERSION
+                 && ast_section_fits(
+                     header->nodes_offset,
+                     header->node_count,
+                     sizeof(AstNode),
+                     alignof(AstNode),
+                     size
+                 )
+                 && ast_section_fits(
+                     header->passages_offset,
+                     header->passage_count,
+                     sizeof(BiblePassage),
+                     alignof(BiblePassage),
+                     size
+                 )
+                 && ast_section_fits(
+                     header->translations_offset,
+                     header->translation_count,
+                     sizeof(AstTranslation),
+                     1,
+                     size
+                 )
+                 && ast_section_fits(header->strs_offset, header->strs_size, 1, 1, size)
+                 && header->translation_count <= BIBLE_TRANSLATION_MAX;
+
+    if (!valid) {
+        return false;
+    }
+
+    const u8 *bytes = data;
+    const AstNode *nodes = (const AstNode *) (bytes + header->nodes_offset);
+    const BiblePassage *passages = (const BiblePassage *) (bytes + header->passages_offset);
+    const AstTranslation *translations = (const AstTranslation *) (bytes + header->translations_offset);
+    const char *strs = (const char *) (bytes + header->strs_offset);
+
+    // Books index the name tables directly, so a passage is checked before it's emitted
+    for (u32 passage_idx = 0; passage_idx < header->passage_count; passage_idx++) {
+        if (!ast_passage_valid(&passages[passage_idx])) {
+            return false;
+        }
+    }
+
+    for (u32 translation_idx = 0; translation_idx < header->translation_count; translation_idx++) {
+        if (!memchr(translations[translation_idx].name, '\0', BIBLE_TRANSLATION_NAME_MAX)) {
+            return false;
+        }
+    }
+
+    for (u32 node_idx = 0; node_idx < header->node_count; node_idx++) {
+        const AstNode *node = &nodes[node_idx];
+
+        // Strings are read up to their terminator, so it has to be where the length
+        // says. Nodes without one point at the empty string the pool starts with
+        if ((u64) node->str_offset + node->str_len >= header->strs_size
+            || strs[node->str_offset + node->str_len] != '\0') {
+            return false;
+        }
+
+        if ((u64) node->passage_offset + node->passage_count > header->passage_count) {
+            return false;
+        }
+
+        if (node->translation > 0 && node->translation >= header->translation_count) {
+            return false;
+        }
+
+        // Levels are emitted as the heading tag's number
+        if (node->level < 0 || node->level > ARTICLE_AST_HEADING_LEVEL_MAX) {
+            return false;
+        }
+    }
+
+    view->data = bytes;
+    view->size = size;
+    view->header = header;
+    view->nodes = nodes;
+    view->passages = passages;
+    view->translations = translations;
+    view->strs = strs;
+
+    return true;
+}
@@ -0,0 +1,75 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_AST_H
+#define ARTICLE_HTML_AST_H
+
+#include <altcore/types.h>
+
+#include "bible.h"
+
+#define ARTICLE_AST_MAGIC 0x54534141u // "AAST"
+#define ARTICLE_AST_VERSION 2u
+// <h1> to <h6>, every other node has level zero
+#define ARTICLE_AST_HEADING_LEVEL_MAX 6
+
+// Layout: header, nodes in token order, the passages of the bible nodes, the
+// translation names the nodes index, then the string pool. Every string in the
+// pool is NUL-terminated, so the emitter reads them in place
+typedef struct AST_HEADER_T {
+    u32 magic;
+    u32 version;
+    u32 node_count;
+    u32 passage_count;
+    u32 translation_count;
+    // Zero when the source had no body, the article then renders empty
+    u32 has_body;
+    u64 nodes_offset;
+    u64 passages_offset;
+    u64 translations_offset;
+    u64 strs_offset;
+    u64 strs_size;
+    // Node types and passage books are stored as enum values, so only a build
+    // with the same token types, books and struct layouts reads the nodes
+    u64 layout_version;
+    // FNV-1a of the source file, the same hash the build manifest keeps. A
+    // cached AST is stale once its source hashes differently
+    u64 source_hash;
+} AstHeader;
+
+// One tokenizer token. Headings, text runs, labels and label refs carry a
+// string, bible blocks and hovers a run of passages and a translation
+typedef struct AST_NODE_T {
+    u8 type;
+    u8 paren;
+    u16 translation;
+    i32 level;
+    u32 str_offset, str_len;
+    u32 passage_offset, passage_count;
+} AstNode;
+
+// Names in fixed slots, NUL-padded
+typedef struct AST_TRANSLATION_T {
+    char name[BIBLE_TRANSLATION_NAME_MAX];
+} AstTranslation;
+
+typedef struct AST_VIEW_T {
+    const u8 *data;
+    u64 size;
+    const AstHeader *header;
+    const AstNode *nodes;
+    const BiblePassage *passages;
+    const AstTranslation *translations;
+    const char *strs;
+} AstView;
+
+// A real book and chapter, verses from 0 for a whole chapter. Chapters and
+// verses past the end of a book are left to the lookups, which check the layout
+bool ast_passage_valid(const BiblePassage *passage);
+
+// Checks the header, that every section fits, every passage is valid and no
+// level is past <h6>. data must be 8-byte aligned and outlive the view
+bool ast_open(AstView *view, const void *data, u64 size);
+
+#endif //ARTICLE_HTML_AST_H
@@ -0,0 +1,997 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "batch.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <altcore/types.h>
+#include <altcore/arenas.h>
+#include <altcore/strings.h>
+
+#include "library.h"
+#include "bible.h"
+#include "bulk_io.h"
+#include "compress.h"
+#include "hash.h"
+#include "citation_index.h"
+#include "label_index.h"
+#include "numa.h"
+#include "search_index.h"
+#include "altcore/defer.h"
+
+// Each worker's record and search arenas start at 1 / (share * worker_count)
+// of the memory budget, within these bounds. The rest is left to the corpus
+// and the document arenas
+static const i64 kBatchArenaBudgetShare = 8;
+static const i64 kBatchArenaMinCapacity = 1024LL * 1024LL;
+static const i64 kBatchWorkerArenaMaxCapacity = 64LL * 1024LL * 1024LL;
+// A full search arena is sorted as a run of its own and a new one started
+static const i64 kBatchSearchArenaMaxCapacity = 16LL * 1024LL * 1024LL;
+// Room for an output path and its tmp file beside it, past the two paths they're made of
+static const i64 kBatchPathSlack = 1024;
+static const char *kBatchOutputExtension = LABEL_INDEX_PAGE_EXTENSION;
+
+typedef struct BATCH_JOB_T {
+    const char *const *filepaths;
+    i64 filepath_count;
+    const ArticleBatchOptions *options;
+    atomic_llong next_filepath_idx;
+    i64 worker_arena_capacity;
+    i64 search_arena_capacity;
+    // Only with async_io
+    BulkReader *reader;
+    BulkWriter *writer;
+} BatchJob;
+
+typedef struct BATCH_WORKER_T {
+    pthread_t thread;
+    BatchJob *job;
+    // Null unless workers are pinned
+    const NumaNode *node;
+    i32 cpu;
+    bool pinned;
+    // Holds the label records, citation intervals and scratch paths. A full
+    // one is kept for the records pointing into it and a new one started
+    Arena arena;
+    i64 arena_capacity;
+    Arena *full_arenas;
+    i64 full_arena_count;
+    ArticleCompressor *compressor;
+    LabelIndexRecords label_records;
+    // The run being filled, and the full runs with the arenas holding them
+    Arena search_arena;
+    i64 search_arena_capacity;
+    SearchIndexRecords search_records;
+    Arena *full_search_arenas;
+    SearchIndexRecords *full_search_runs;
+    i64 full_search_run_count;
+    CitationIndexIntervals citation_intervals;
+    i64 skipped_count;
+    i64 rendered_count;
+    i64 unchanged_count;
+    i64 failed_count;
+} BatchWorker;
+
+typedef struct BATCH_POOL_THREAD_T {
+    pthread_t thread;
+    ArticleBatchPool *pool;
+    i64 thread_idx;
+} BatchPoolThread;
+
+// The page's path under out_dir before any compression extension. Refs to the
+// article resolve to it through the label index, so it is also the index key
+static string batch_output_page_path(Arena *arena, const char *src_root, const char *src_filepath) {
+    string_view src_view = {
+        src_filepath,
+        (i64) strlen(src_filepath),
+    };
+
+    label_index_normalize_path(&src_view);
+
+    if (src_root) {
+        string_view root_view = {
+            src_root,
+            (i64) strlen(src_root),
+        };
+        label_index_normalize_path(&root_view);
+
+        while (root_view.len > 0 && root_view.data[root_view.len - 1] == '/') {
+            root_view.len--;
+        }
+
+        bool under_root = src_view.len > root_view.len
+                          && memcmp(src_view.data, root_view.data, root_view.len) == 0
+                          && (root_view.len == 0 || src_view.data[root_view.len] == '/');
+        if (under_root) {
+            str_view_advance(&src_view, root_view.len);
+        }
+    }
+
+    // An absolute path goes under out_dir too
+    label_index_page_stem(&src_view);
+
+    return str_make(arena, "%.*s%s", (i32) src_view.len, src_view.data, kBatchOutputExtension);
+}
+
+// Arena bytes batch_output_filepath may take, the page path and the full path
+static i64 batch_output_filepath_bytes(const char *out_dir, const char *src_filepath) {
+    return 2 * ((i64) strlen(out_dir) + 2 * (i64) strlen(src_filepath)) + kBatchPathSlack;
+}
+
+static string batch_output_filepath(
+    Arena *arena,
+    const char *out_dir,
+    const char *src_root,
+    const char *src_filepath,
+    ArticleCompression compression
+) {
+    string page_path = batch_output_page_path(arena, src_root, src_filepath);
+
+    return str_make(arena, "%s/%s%s", out_dir, page_path.data, html_compressor_extension(compression));
+}
+
+static atomic_llong g_batch_tmp_file_counter = 0;
+
+static bool batch_write_file(Arena *arena, string *filepath, const char *bytes, u64 len) {
+    if (!bulk_make_parent_dirs(filepath->data)) {
+        return false;
+    }
+
+    // Written beside the target and renamed over it, so readers never see a partial page
+    string tmp_filepath = str_make(
+        arena,
+        "%s.%d.%lld.tmp",
+        filepath->data,
+        (i32) getpid(),
+        (long long) atomic_fetch_add(&g_batch_tmp_file_counter, 1)
+    );
+
+    FILE *fp = fopen(tmp_filepath.data, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    bool written = fwrite(bytes, sizeof(char), len, fp) == len;
+    written = (fclose(fp) == 0) && written;
+
+    if (written) {
+        written = rename(tmp_filepath.data, filepath->data) == 0;
+    }
+
+    if (!written) {
+        remove(tmp_filepath.data);
+    }
+
+    return written;
+}
+
+// Hands the rendered bytes over to the caller, who frees them
+static char *batch_take_output(ArticleData *data, bool compressed) {
+    char *bytes = nullptr;
+
+    if (compressed) {
+        bytes = (char *) data->body_compressed;
+        data->body_compressed = nullptr;
+        data->body_compressed_len = 0;
+    } else {
+        bytes = data->body_html;
+        data->body_html = nullptr;
+    }
+
+    return bytes;
+}
+
+// Keyed on the page path, the hrefs built from the index point at the page
+static void batch_push_label_records(
+    Arena *arena,
+    const char *src_root,
+    const char *filepath,
+    const ArticleData *data,
+    LabelIndexRecords *out_records
+) {
+    string article_path = batch_output_page_path(arena, src_root, filepath);
+
+    for (size_t label_idx = 0; label_idx < data->label_count; label_idx++) {
+        string label = str_make(arena, "%s", data->labels[label_idx].name);
+        string heading_text = str_make(arena, "%s", data->labels[label_idx].heading_text);
+
+        LabelIndexRecord record = {
+            {article_path.data, article_path.len},
+            {label.data, label.len},
+            {heading_text.data, heading_text.len},
+        };
+
+        ARRAY_PUSH(out_records, &record);
+    }
+}
+
+// A worker arena's share of the memory budget
+static i64 batch_arena_capacity(i64 worker_count, i64 max_capacity) {
+    i64 capacity = (i64) article_memory_budget() / (kBatchArenaBudgetShare * worker_count);
+
+    if (capacity < kBatchArenaMinCapacity) {
+        return kBatchArenaMinCapacity;
+    }
+
+    return capacity < max_capacity ? capacity : max_capacity;
+}
+
+static void batch_worker_arena_start(BatchWorker *worker, i64 arena_capacity) {
+    worker->arena = arena_make(arena_capacity);
+    worker->arena_capacity = arena_capacity;
+}
+
+// Sets the worker's arena aside for a new one when it has less than bytes
+// left. The record arrays point at worker->arena, so they grow into the new
+// arena while their old copies and strings stay valid in the full one
+static void batch_worker_reserve(BatchWorker *worker, i64 bytes) {
+    if (worker->arena.offset + bytes <= worker->arena_capacity) {
+        return;
+    }
+
+    i64 full_count = worker->full_arena_count + 1;
+    worker->full_arenas = realloc(worker->full_arenas, full_count * sizeof(Arena));
+    assert(worker->full_arenas);
+
+    worker->full_arenas[full_count - 1] = worker->arena;
+    worker->full_arena_count = full_count;
+
+    batch_worker_arena_start(worker, bytes > worker->job->worker_arena_capacity
+                                         ? bytes
+                                         : worker->job->worker_arena_capacity);
+}
+
+// What making the article's output path, and its label and citation records,
+// may take from the worker's arena. A growing array may move to twice its size,
+// a string made from another is given twice its length
+static i64 batch_worker_article_bytes(const BatchWorker *worker, const char *filepath, const ArticleData *data) {
+    const ArticleBatchOptions *options = worker->job->options;
+    i64 bytes = 0;
+
+    if (options->out_dir) {
+        bytes += batch_output_filepath_bytes(options->out_dir, filepath);
+    }
+
+    if (options->label_index_filepath && data->label_count > 0) {
+        // The page path the records are keyed on, then the records
+        bytes += batch_output_filepath_bytes("", filepath)
+                 + 2 * (worker->label_records.len + (i64) data->label_count) * (i64) sizeof(LabelIndexRecord);
+
+        for (size_t label_idx = 0; label_idx < data->label_count; label_idx++) {
+            bytes += 2 * ((i64) strlen(data->labels[label_idx].name) + 1)
+                     + 2 * ((i64) strlen(data->labels[label_idx].heading_text) + 1);
+        }
+    }
+
+    if (options->citation_index_filepath) {
+        bytes += 2 * (worker->citation_intervals.len + (i64) data->passage_count) * (i64) sizeof(CitationIndexInterval);
+    }
+
+    return bytes;
+}
+
+static void batch_search_run_start(BatchWorker *worker, i64 arena_capacity) {
+    worker->search_arena = arena_make(arena_capacity);
+    worker->search_arena_capacity = arena_capacity;
+    worker->search_records = (SearchIndexRecords){&worker->search_arena};
+    ARRAY_MAKE(&worker->search_records);
+}
+
+// Adds the article's terms to the worker's run, first setting the run aside
+// sorted when its arena can't be sure to hold them
+static void batch_search_push_doc(BatchWorker *worker, u32 doc_idx, const ArticleData *data) {
+    i64 capacity = search_index_push_capacity(&worker->search_records, data->terms, (i64) data->term_count);
+
+    if (worker->search_arena.offset + capacity > worker->search_arena_capacity) {
+        search_index_sort_records(&worker->search_records);
+
+        i64 full_count = worker->full_search_run_count + 1;
+        worker->full_search_arenas = realloc(worker->full_search_arenas, full_count * sizeof(Arena));
+        worker->full_search_runs = realloc(worker->full_search_runs, full_count * sizeof(SearchIndexRecords));
+        assert(worker->full_search_arenas && worker->full_search_runs);
+
+        worker->full_search_arenas[full_count - 1] = worker->search_arena;
+        worker->full_search_runs[full_count - 1] = worker->search_records;
+        worker->full_search_run_count = full_count;
+
+        // An article too big for a whole arena gets one of its own size
+        SearchIndexRecords empty_records = {};
+        i64 fresh_capacity = search_index_push_capacity(&empty_records, data->terms, (i64) data->term_count);
+        if (fresh_capacity < worker->job->search_arena_capacity) {
+            fresh_capacity = worker->job->search_arena_capacity;
+        }
+
+        batch_search_run_start(worker, fresh_capacity);
+    }
+
+    search_index_push_doc(
+        &worker->search_arena,
+        doc_idx,
+        data->terms,
+        (i64) data->term_count,
+        &worker->search_records
+    );
+}
+
+// Made on the worker's own thread, so the pages a pinned worker's arenas and
+// compressor touch first come from its node, memory reused from an earlier
+// owner stays where it was. False when the compressor couldn't be made
+static bool batch_worker_setup(BatchWorker *worker) {
+    const ArticleBatchOptions *options = worker->job->options;
+
+    batch_worker_arena_start(worker, worker->job->worker_arena_capacity);
+
+    worker->label_records = (LabelIndexRecords){&worker->arena};
+    ARRAY_MAKE(&worker->label_records);
+
+    worker->citation_intervals = (CitationIndexIntervals){&worker->arena};
+    ARRAY_MAKE(&worker->citation_intervals);
+
+    if (options->search_index_filepath) {
+        batch_search_run_start(worker, worker->job->search_arena_capacity);
+    }
+
+    if (options->compression != ARTICLE_COMPRESSION_NONE) {
+        worker->compressor = article_compressor_create(options->compression, options->compression_level);
+        if (!worker->compressor) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Records the source's hash, true when it matches the previous one and the
+// previous output is still there to keep
+static bool batch_source_unchanged(BatchWorker *worker, i64 filepath_idx, const char *source, u64 source_len) {
+    const ArticleBatchOptions *options = worker->job->options;
+    u64 source_hash = hash_fnv1a(source, source_len, HASH_FNV1A_SEED);
+
+    if (options->out_source_hashes) {
+        options->out_source_hashes[filepath_idx] = source_hash;
+    }
+
+    if (!options->previous_source_hashes
+        || options->previous_source_hashes[filepath_idx] != source_hash
+        || !options->previous_output_hashes
+        || !options->previous_output_hashes[filepath_idx]
+        || !options->out_dir) {
+        return false;
+    }
+
+    const char *filepath = worker->job->filepaths[filepath_idx];
+    batch_worker_reserve(worker, batch_output_filepath_bytes(options->out_dir, filepath));
+
+    const i64 arena_start_offset = worker->arena.offset;
+
+    string out_filepath = batch_output_filepath(
+        &worker->arena,
+        options->out_dir,
+        options->src_root,
+        filepath,
+        options->compression
+    );
+    bool output_exists = access(out_filepath.data, F_OK) == 0;
+
+    worker->arena.offset = arena_start_offset;
+
+    if (output_exists && options->out_output_hashes) {
+        options->out_output_hashes[filepath_idx] = options->previous_output_hashes[filepath_idx];
+    }
+
+    return output_exists;
+}
+
+static void *batch_worker_run(void *arg) {
+    BatchWorker *worker = arg;
+    BatchJob *job = worker->job;
+
+    if (worker->node) {
+        worker->pinned = numa_bind_thread(worker->node, worker->cpu);
+
+        if (job->options->replicate_corpus) {
+            bible_set_thread_replica(worker->node->id);
+        }
+    }
+
+    // The other workers take its files, any left unclaimed count as failed
+    if (!batch_worker_setup(worker)) {
+        return nullptr;
+    }
+
+    for (;;) {
+        i64 filepath_idx = atomic_fetch_add(&job->next_filepath_idx, 1);
+        if (filepath_idx >= job->filepath_count) {
+            break;
+        }
+
+        const char *filepath = job->filepaths[filepath_idx];
+
+        ArticleParseOptions parse_options = {
+            .compressor = worker->compressor,
+            .compressed_only = worker->compressor != nullptr,
+            .collect_terms = job->options->search_index_filepath != nullptr,
+            .collect_passages = job->options->citation_index_filepath != nullptr,
+            .arena_budget = job->options->arena_budget,
+            .source_path = filepath,
+        };
+
+        ArticleData data = {};
+
+        // Sources that are hashed are read here, so the same bytes are hashed and rendered
+        bool hash_source = job->options->previous_source_hashes || job->options->out_source_hashes;
+
+        if (job->reader || hash_source) {
+            u64 source_len = 0;
+            char *source = job->reader
+                               ? bulk_reader_take(job->reader, filepath_idx, &source_len)
+                               : bulk_read_file(filepath, &source_len);
+
+            if (source && hash_source && batch_source_unchanged(worker, filepath_idx, source, source_len)) {
+                free(source);
+                worker->skipped_count++;
+                continue;
+            }
+
+            if (source) {
+                data = article_parse_bytes(source, source_len, &parse_options);
+                free(source);
+            }
+        } else {
+            data = article_parse_ex(filepath, &parse_options);
+        }
+
+        bool rendered = worker->compressor ? data.body_compressed != nullptr : data.body_html != nullptr;
+        bool unchanged = false;
+
+        if (rendered) {
+            batch_worker_reserve(worker, batch_worker_article_bytes(worker, filepath, &data));
+
+            const char *out_bytes = worker->compressor ? (char *) data.body_compressed : data.body_html;
+            u64 out_len = worker->compressor ? data.body_compressed_len : strlen(data.body_html);
+            u64 out_hash = hash_fnv1a(out_bytes, out_len, HASH_FNV1A_SEED);
+
+            if (job->options->out_output_hashes) {
+                job->options->out_output_hashes[filepath_idx] = out_hash;
+            }
+
+            if (job->options->out_dir) {
+                const i64 arena_start_offset = worker->arena.offset;
+
+                string out_filepath = batch_output_filepath(
+                    &worker->arena,
+                    job->options->out_dir,
+                    job->options->src_root,
+                    filepath,
+                    worker->compressor ? job->options->compression : ARTICLE_COMPRESSION_NONE
+                );
+
+                // Identical bytes keep the old file, so its mtime and any caches stay valid
+                unchanged = job->options->previous_output_hashes
+                            && job->options->previous_output_hashes[filepath_idx] == out_hash
+                            && access(out_filepath.data, F_OK) == 0;
+
+                if (!unchanged && job->writer) {
+                    char *out_filepath_copy = strdup(out_filepath.data);
+                    assert(out_filepath_copy);
+
+                    bulk_writer_push(
+                        job->writer,
+                        filepath_idx,
+                        out_filepath_copy,
+                        batch_take_output(&data, worker->compressor != nullptr),
+                        out_len
+                    );
+                } else if (!unchanged) {
+                    rendered = batch_write_file(&worker->arena, &out_filepath, out_bytes, out_len);
+                }
+
+                worker->arena.offset = arena_start_offset;
+            }
+        }
+
+        if (rendered && job->options->label_index_filepath) {
+            batch_push_label_records(&worker->arena, job->options->src_root, filepath, &data, &worker->label_records);
+        }
+
+        if (rendered && job->options->citation_index_filepath) {
+            citation_index_push_passages(
+                (u32) filepath_idx,
+                data.passages,
+                (i64) data.passage_count,
+                &worker->citation_intervals
+            );
+        }
+
+        if (rendered && job->options->search_index_filepath) {
+            batch_search_push_doc(worker, (u32) filepath_idx, &data);
+        }
+
+        if (unchanged) {
+            worker->unchanged_count++;
+        } else if (rendered) {
+            worker->rendered_count++;
+        } else {
+            worker->failed_count++;
+        }
+
+        article_free(&data);
+    }
+
+    // Each worker hands back sorted runs, leaving only a merge for the writer
+    if (job->options->search_index_filepath) {
+        search_index_sort_records(&worker->search_records);
+    }
+
+    return nullptr;
+}
+
+struct ARTICLE_BATCH_POOL_T {
+    pthread_mutex_t mutex;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    BatchPoolThread *threads;
+    i64 thread_count;
+    // The running batch's workers, thread i runs worker i if there is one
+    BatchWorker *workers;
+    i64 worker_count;
+    u64 generation;
+    i64 busy_count;
+    bool stopping;
+};
+
+static void *batch_pool_thread_run(void *arg) {
+    BatchPoolThread *thread = arg;
+    ArticleBatchPool *pool = thread->pool;
+    u64 seen_generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+
+        while (pool->generation == seen_generation && !pool->stopping) {
+            pthread_cond_wait(&pool->work_ready, &pool->mutex);
+        }
+
+        if (pool->stopping) {
+            pthread_mutex_unlock(&pool->mutex);
+            break;
+        }
+
+        seen_generation = pool->generation;
+        BatchWorker *worker = thread->thread_idx < pool->worker_count ? &pool->workers[thread->thread_idx] : nullptr;
+
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (worker) {
+            batch_worker_run(worker);
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busy_count == 0) {
+            pthread_cond_signal(&pool->work_done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    return nullptr;
+}
+
+// Runs the workers on the pool's threads and waits for all of them
+static void batch_pool_run(ArticleBatchPool *pool, BatchWorker *workers, i64 worker_count) {
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->workers = workers;
+    pool->worker_count = worker_count;
+    pool->busy_count = pool->thread_count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->work_ready);
+
+    while (pool->busy_count > 0) {
+        pthread_cond_wait(&pool->work_done, &pool->mutex);
+    }
+
+    pool->workers = nullptr;
+    pool->worker_count = 0;
+
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+ArticleBatchPool *article_batch_pool_create(int worker_count) {
+    i64 thread_count = worker_count > 0 ? worker_count : sysconf(_SC_NPROCESSORS_ONLN);
+    if (thread_count <= 0) {
+        thread_count = 1;
+    }
+
+    ArticleBatchPool *pool = calloc(1, sizeof(ArticleBatchPool));
+    assert(pool);
+
+    pool->threads = calloc(thread_count, sizeof(BatchPoolThread));
+    assert(pool->threads);
+    pool->thread_count = thread_count;
+
+    pthread_mutex_init(&pool->mutex, nullptr);
+    pthread_cond_init(&pool->work_ready, nullptr);
+    pthread_cond_init(&pool->work_done, nullptr);
+
+    for (i64 thread_idx = 0; thread_idx < thread_count; thread_idx++) {
+        BatchPoolThread *thread = &pool->threads[thread_idx];
+        thread->pool = pool;
+        thread->thread_idx = thread_idx;
+
+        int err = pthread_create(&thread->thread, nullptr, batch_pool_thread_run, thread);
+        assert(!err);
+    }
+
+    return pool;
+}
+
+void article_batch_pool_destroy(ArticleBatchPool *pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->work_ready);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i64 thread_idx = 0; thread_idx < pool->thread_count; thread_idx++) {
+        int err = pthread_join(pool->threads[thread_idx].thread, nullptr);
+        assert(!err);
+    }
+
+    pthread_cond_destroy(&pool->work_done);
+    pthread_cond_destroy(&pool->work_ready);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool->threads);
+    free(pool);
+}
+
+static void batch_index_failed(const char *index_filepath, ArticleBatchResult *result) {
+    fprintf(stderr, "article_html: failed to write %s\n", index_filepath);
+    result->failed_index_count++;
+}
+
+ArticleBatchResult article_batch_render(
+    const char *const *filepaths,
+    size_t filepath_count,
+    const ArticleBatchOptions *options
+) {
+    ArticleBatchResult result = {};
+
+    if (!filepaths || !options) {
+        return result;
+    }
+
+    i64 worker_count = options->pool ? options->pool->thread_count : options->worker_count;
+    if (worker_count <= 0) {
+        worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (worker_count > (i64) filepath_count) {
+        worker_count = (i64) filepath_count;
+    }
+    if (worker_count <= 0) {
+        worker_count = 1;
+    }
+
+    // Checked up front so an unavailable compression fails the batch instead of every worker
+    if (options->compression != ARTICLE_COMPRESSION_NONE) {
+        ArticleCompressor *compressor = article_compressor_create(options->compression, options->compression_level);
+
+        if (!compressor) {
+            fprintf(
+                stderr,
+                "article_html: %s compression isn't available in this build\n",
+                html_compressor_extension(options->compression)
+            );
+            result.failed_count = filepath_count;
+            return result;
+        }
+
+        article_compressor_destroy(compressor);
+    }
+
+    BatchJob job = {
+        .filepaths = filepaths,
+        .filepath_count = (i64) filepath_count,
+        .options = options,
+        .worker_arena_capacity = batch_arena_capacity(worker_count, kBatchWorkerArenaMaxCapacity),
+        .search_arena_capacity = batch_arena_capacity(worker_count, kBatchSearchArenaMaxCapacity),
+    };
+    atomic_init(&job.next_filepath_idx, 0);
+
+    bool *write_failed = nullptr;
+
+    if (options->async_io) {
+        job.reader = bulk_reader_start(filepaths, (i64) filepath_count);
+
+        if (options->out_dir) {
+            write_failed = calloc(filepath_count > 0 ? filepath_count : 1, sizeof(bool));
+            assert(write_failed);
+
+            job.writer = bulk_writer_start(write_failed);
+        }
+    }
+
+    // Pinning only pays off across nodes, on one node the scheduler is left to it
+    NumaTopology topology = {};
+    bool pin_workers = false;
+
+    if (options->pin_workers) {
+        numa_topology_detect(&topology);
+        pin_workers = topology.node_count > 1;
+    }
+
+    if (pin_workers && options->replicate_corpus) {
+        bible_require();
+        bible_replicate(&topology);
+    }
+
+    BatchWorker *workers = calloc(worker_count, sizeof(BatchWorker));
+    assert(workers);
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        BatchWorker *worker = &workers[worker_idx];
+        worker->job = &job;
+
+        // Round-robin over the nodes, then over each node's CPUs
+        if (pin_workers) {
+            worker->node = &topology.nodes[worker_idx % topology.node_count];
+            worker->cpu = numa_node_cpu(worker->node, (i32) (worker_idx / topology.node_count));
+        }
+
+        if (!options->pool) {
+            int err = pthread_create(&worker->thread, nullptr, batch_worker_run, worker);
+            assert(!err);
+        }
+    }
+
+    if (options->pool) {
+        batch_pool_run(options->pool, workers, worker_count);
+    }
+
+    i64 label_record_count = 0;
+    i64 citation_interval_count = 0;
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        BatchWorker *worker = &workers[worker_idx];
+
+        if (!options->pool) {
+            int err = pthread_join(worker->thread, nullptr);
+            assert(!err);
+        }
+
+        result.skipped_count += worker->skipped_count;
+        result.rendered_count += worker->rendered_count;
+        result.unchanged_count += worker->unchanged_count;
+        result.failed_count += worker->failed_count;
+        result.pinned_count += worker->pinned ? 1 : 0;
+        label_record_count += worker->label_records.len;
+        citation_interval_count += worker->citation_intervals.len;
+    }
+
+    // Files no worker claimed, when every worker failed its setup
+    result.failed_count += filepath_count
+                           - result.skipped_count
+                           - result.rendered_count
+                           - result.unchanged_count
+                           - result.failed_count;
+
+    bulk_writer_stop(job.writer);
+    bulk_reader_stop(job.reader);
+
+    if (write_failed) {
+        for (size_t filepath_idx = 0; filepath_idx < filepath_count; filepath_idx++) {
+            if (!write_failed[filepath_idx]) {
+                continue;
+            }
+
+            result.rendered_count--;
+            result.failed_count++;
+
+            if (options->out_output_hashes) {
+                options->out_output_hashes[filepath_idx] = 0;
+            }
+        }
+
+        free(write_failed);
+    }
+
+    if (options->label_index_filepath) {
+        Arena arena = arena_make((label_record_count + 1) * (i64) sizeof(LabelIndexRecord) * 2 + 1024);
+
+        DEFER(arena_free(&arena)) {
+            LabelIndexRecords label_records = {&arena, label_record_count + 1};
+            ARRAY_MAKE(&label_records);
+            label_records.len = 0;
+
+            for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+                ARRAY_FOR(record, &workers[worker_idx].label_records) {
+                    ARRAY_PUSH(&label_records, record);
+                }
+            }
+
+            if (!label_index_write(options->label_index_filepath, &label_records)) {
+                batch_index_failed(options->label_index_filepath, &result);
+            }
+        }
+    }
+
+    string_view *article_paths = nullptr;
+
+    if (options->search_index_filepath || options->citation_index_filepath) {
+        article_paths = calloc(filepath_count > 0 ? filepath_count : 1, sizeof(string_view));
+        assert(article_paths);
+
+        for (size_t filepath_idx = 0; filepath_idx < filepath_count; filepath_idx++) {
+            article_paths[filepath_idx] = (string_view){
+                filepaths[filepath_idx],
+                (i64) strlen(filepaths[filepath_idx]),
+            };
+        }
+    }
+
+    if (options->search_index_filepath) {
+        i64 search_run_count = 0;
+        for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+            search_run_count += workers[worker_idx].full_search_run_count + 1;
+        }
+
+        SearchIndexRecords *search_runs = calloc(search_run_count, sizeof(SearchIndexRecords));
+        assert(search_runs);
+
+        search_run_count = 0;
+        for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+            const BatchWorker *worker = &workers[worker_idx];
+
+            for (i64 run_idx = 0; run_idx < worker->full_search_run_count; run_idx++) {
+                search_runs[search_run_count++] = worker->full_search_runs[run_idx];
+            }
+            search_runs[search_run_count++] = worker->search_records;
+        }
+
+        bool written = search_index_write(
+            options->search_index_filepath,
+            article_paths,
+            (i64) filepath_count,
+            search_runs,
+            search_run_count
+        );
+        if (!written) {
+            batch_index_failed(options->search_index_filepath, &result);
+        }
+
+        free(search_runs);
+    }
+
+    if (options->citation_index_filepath) {
+        Arena arena = arena_make((citation_interval_count + 1) * (i64) sizeof(CitationIndexInterval) + 1024);
+
+        DEFER(arena_free(&arena)) {
+            CitationIndexIntervals citation_intervals = {&arena, citation_interval_count + 1};
+            ARRAY_MAKE(&citation_intervals);
+            citation_intervals.len = 0;
+
+            for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+                ARRAY_FOR(interval, &workers[worker_idx].citation_intervals) {
+                    ARRAY_PUSH(&citation_intervals, interval);
+                }
+            }
+
+            bool written = citation_index_write(
+                options->citation_index_filepath,
+                article_paths,
+                (i64) filepath_count,
+                &citation_intervals
+            );
+
+            if (!written) {
+                batch_index_failed(options->citation_index_filepath, &result);
+            }
+        }
+    }
+
+    free(article_paths);
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        article_compressor_destroy(workers[worker_idx].compressor);
+        arena_free(&workers[worker_idx].arena);
+
+        for (i64 arena_idx = 0; arena_idx < workers[worker_idx].full_arena_count; arena_idx++) {
+            arena_free(&workers[worker_idx].full_arenas[arena_idx]);
+        }
+        free(workers[worker_idx].full_arenas);
+
+        if (options->search_index_filepath) {
+            BatchWorker *worker = &workers[worker_idx];
+
+            for (i64 run_idx = 0; run_idx < worker->full_search_run_count; run_idx++) {
+                arena_free(&worker->full_search_arenas[run_idx]);
+            }
+            free(worker->full_search_arenas);
+            free(worker->full_search_runs);
+            arena_free(&worker->search_arena);
+        }
+    }
+
+    free(workers);
+
+    return result;
+}
+
+char *article_batch_output_path(const ArticleBatchOptions *options, const char *filepath) {
+    if (!options || !options->out_dir || !filepath) {
+        return nullptr;
+    }
+
+    Arena arena = arena_make(batch_output_filepath_bytes(options->out_dir, filepath));
+
+    string out_filepath = batch_output_filepath(
+        &arena,
+        options->out_dir,
+        options->src_root,
+        filepath,
+        options->compression
+    );
+    char *out_path = strdup(out_filepath.data);
+    assert(out_path);
+
+    arena_free(&arena);
+
+    return out_path;
+}
+
+bool article_batch_io_uring() {
+    return bulk_io_uring_available();
+}
+
+bool article_label_index_update(
+    const char *label_index_filepath,
+    const char *src_root,
+    const char *filepath,
+    const ArticleData *data
+) {
+    if (!label_index_filepath || !filepath || !data) {
+        return false;
+    }
+
+    // The page path, once for the lookup and once for the records
+    i64 arena_capacity = 2 * batch_output_filepath_bytes("", filepath);
+    for (size_t label_idx = 0; label_idx < data->label_count; label_idx++) {
+        arena_capacity += (i64) sizeof(LabelIndexRecord) * 2
+            + (i64) strlen(data->labels[label_idx].name)
+            + (i64) strlen(data->labels[label_idx].heading_text)
+            + 64;
+    }
+
+    Arena arena = arena_make(arena_capacity);
+
+    bool updated = false;
+
+    DEFER(arena_free(&arena)) {
+        LabelIndexRecords records = {&arena};
+        ARRAY_MAKE(&records);
+
+        batch_push_label_records(&arena, src_root, filepath, data, &records);
+
+        string page_path = batch_output_page_path(&arena, src_root, filepath);
+        string_view article_path = {
+            page_path.data,
+            page_path.len,
+        };
+
+        updated = label_index_update(label_index_filepath, &article_path, &records);
+    }
+
+    return updated;
+}
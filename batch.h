@@ -0,0 +1,100 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_BATCH_H
+#define ARTICLE_HTML_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "library.h"
+
+// Long-lived worker threads that batches can run on one at a time, so a
+// caller rendering many small batches doesn't start threads for each
+typedef struct ARTICLE_BATCH_POOL_T ArticleBatchPool;
+
+typedef struct ARTICLE_BATCH_OPTIONS_T {
+    const char* out_dir;
+    // Optional, stripped from the front of each filepath to form its path
+    // under out_dir. Otherwise the whole filepath is kept, less any leading '/'
+    const char* src_root;
+    // Optional, runs the batch on the pool's threads, at most one per filepath
+    ArticleBatchPool* pool;
+    // Optional, keyed on each article's path under out_dir. A ref names the
+    // article by its path below src_root, e.g. {{ref guide/setup.xmd#install}}
+    const char* label_index_filepath;
+    // Optional, written from the term streams gathered while rendering
+    const char* search_index_filepath;
+    // Optional, written from the Bible passages each article cites
+    const char* citation_index_filepath;
+    int worker_count;
+    // Writes .html.gz/.html.zst instead of .html, one compressor per worker
+    ArticleCompression compression;
+    int compression_level;
+    // Optional, one per filepath: an existing output whose hash matches is left untouched
+    const uint64_t* previous_output_hashes;
+    // Optional, one per filepath: receives the hash of the rendered output
+    uint64_t* out_output_hashes;
+    // Optional, one per filepath: a source whose bytes hash to this, whose
+    // previous output hash is known and whose output exists isn't rendered
+    // again. It is counted as skipped, keeps its previous output hash and
+    // adds nothing to the indexes
+    const uint64_t* previous_source_hashes;
+    // Optional, one per filepath: receives the hash of the source as read
+    uint64_t* out_source_hashes;
+    // Warns about each article whose arena peaks above this many bytes, 0 for no limit
+    size_t arena_budget;
+    // Reads sources ahead of the workers and writes outputs behind them, in
+    // io_uring batches where the kernel allows it. A failed write is only
+    // known once the batch ends, so the indexes may still list that article
+    bool async_io;
+    // Pins each worker to a CPU, spread over the NUMA nodes, and prefers its
+    // node for pages it touches first. Arena memory the allocator hands back
+    // already touched stays where it is. Does nothing on one node
+    bool pin_workers;
+    // With pin_workers, the workers of each node read their own copy of the
+    // verse corpus, kept until article_uninit
+    bool replicate_corpus;
+} ArticleBatchOptions;
+
+typedef struct ARTICLE_BATCH_RESULT_T {
+    // Sources left alone through previous_source_hashes
+    size_t skipped_count;
+    size_t rendered_count;
+    size_t unchanged_count;
+    size_t failed_count;
+    // Workers pinned to a CPU, 0 when pin_workers had nothing to do
+    size_t pinned_count;
+    // Requested indexes that couldn't be written, each is warned about on stderr
+    size_t failed_index_count;
+} ArticleBatchResult;
+
+ArticleBatchResult article_batch_render(
+    const char *const *filepaths,
+    size_t filepath_count,
+    const ArticleBatchOptions *options
+);
+
+// Where a batch with these options writes filepath's output. The caller frees it
+char *article_batch_output_path(const ArticleBatchOptions *options, const char *filepath);
+
+// worker_count <= 0 starts one thread per CPU
+ArticleBatchPool *article_batch_pool_create(int worker_count);
+
+// Joins the pool's threads, no batch may still be running on it
+void article_batch_pool_destroy(ArticleBatchPool *pool);
+
+// True when async_io batches through io_uring rather than plain POSIX I/O
+bool article_batch_io_uring();
+
+// Replaces a single article's entries in an existing label index without
+// touching any other article. src_root is the one the batch was rendered with
+bool article_label_index_update(
+    const char *label_index_filepath,
+    const char *src_root,
+    const char *filepath,
+    const ArticleData *data
+);
+
+#endif //ARTICLE_HTML_BATCH_H
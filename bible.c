@@ -8,9 +8,16 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
 
-#include "bibtool_wrapper/libs/altcore/memory.h"
+#include "bible_search.h"
+#include "escape.h"
+#include "hash.h"
+#include "trace.h"
 
 const char *kBibleSubkeyStrs[] = {
 #ifndef X
@@ -23,7 +30,72 @@ const char *kBibleSubkeyStrs[] = {
 
 static bool g_bible_initialised = false;
 
-BibleVerseToHtmlMap g_lsb_verse_map = {HASHMAP_TYPE_STR_KEY};
+// Headroom of a load arena past the file and its verses
+static const i64 kBibleLoadArenaSlack = 64 * 1024;
+// "B,1,1,x", the shortest row that holds a verse
+static const i64 kBibleCsvMinRowLen = 7;
+static const u32 kBibleVerseMissing = 0xFFFFFFFFu;
+
+typedef struct BIBLE_SLOTS_T {
+    ARRAY_FIELDS(u32)
+} BibleSlots;
+
+// Where each chapter and verse sits, shared by every translation so that an
+// extra translation only costs its text and one offset per verse
+typedef struct BIBLE_LAYOUT_T {
+    Arena arena;
+    // First chapter slot of each book, the last entry closes the final book
+    u32 book_chapter_offsets[BIBLE_BOOK_COUNT + 1];
+    // First verse slot of each chapter slot, one extra entry closes the final chapter
+    BibleSlots chapter_verse_offsets;
+    u32 verse_slot_count;
+} BibleLayout;
+
+typedef struct BIBLE_TRANSLATION_T {
+    char name[BIBLE_TRANSLATION_NAME_MAX];
+    // The text followed by the verse offsets, mapped apart from the arenas so
+    // that lookups can be kept on 2 MB pages
+    HugePagesRegion storage;
+    // Every verse's text packed back to back in verse slot order
+    char *text;
+    // Where each verse slot starts in text, one extra entry closes the final verse
+    u32 *verse_offsets;
+    u64 verse_offsets_start;
+    // Copies of storage, replicas[slot] is bound to node g_bible_replica_node_ids[slot]
+    HugePagesRegion replicas[NUMA_NODE_MAX];
+    u64 corpus_hash;
+} BibleTranslation;
+
+typedef struct BIBLE_CSV_VERSE_T {
+    BibleBook book;
+    i32 chapter;
+    i32 verse;
+    string_view text;
+} BibleCsvVerse;
+
+typedef struct BIBLE_CSV_VERSES_T {
+    ARRAY_FIELDS(BibleCsvVerse)
+} BibleCsvVerses;
+
+static BibleLayout g_bible_layout = {};
+
+// Set by bible_init_lazy, bible_require loads it on first use
+static char *g_bible_lazy_filepath = nullptr;
+static bool g_bible_huge_pages = false;
+
+// Node id each replica slot was made for, slots are handed out in the order
+// bible_replicate first meets the nodes
+static i32 g_bible_replica_node_ids[NUMA_NODE_MAX] = {};
+static i32 g_bible_replica_slot_count = 0;
+
+// Replica slot the thread reads, -1 for the original storage
+static _Thread_local i32 g_bible_thread_replica = -1;
+static pthread_mutex_t g_bible_lazy_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Released once the corpus is loaded, so bible_require only locks until then
+static atomic_bool g_bible_loaded = false;
+
+static BibleTranslation g_bible_translations[BIBLE_TRANSLATION_MAX] = {};
+static i32 g_bible_translation_count = 0;
 
 const char *kBibleBookStrs[] = {
 #ifndef X
@@ -50,119 +122,474 @@ static const char *book_num_to_str(i32 book_num) {
     return num_str;
 }
 
-void bible_init(const char *lsb_csv_filepath) {
-    Arena arena = arena_make(200 * 1024 * 1024);
+static BibleBook bible_csv_book(const string_view *book_view) {
+    char book_key[64];
+    i64 book_key_len = 0;
 
-    if (!g_bible_initialised) {
-        g_lsb_verse_map = (BibleVerseToHtmlMap){HASHMAP_TYPE_STR_KEY};
+    string_view title_view = *book_view;
 
-        char *default_val = nullptr;
-        HASHMAP_MAKE(&g_lsb_verse_map, &default_val);
+    // "1 Samuel" is FIRST_SAMUEL
+    if (title_view.len > 2 && isdigit((u8) title_view.data[0]) && title_view.data[1] == ' ') {
+        const char *num_str = book_num_to_str(title_view.data[0] - '0');
 
-        FILE *fp = fopen("./data/lsb.csv", "rb");
-        assert(fp);
+        if (num_str) {
+            book_key_len = snprintf(book_key, sizeof(book_key), "%s_", num_str);
+            str_view_advance(&title_view, 2);
+        }
+    }
 
-        fseek(fp, 0, SEEK_END);
-        long fsize = ftell(fp);
-        fseek(fp, 0, SEEK_SET);
+    if (book_key_len + title_view.len >= (i64) sizeof(book_key)) {
+        return BIBLE_BOOK_COUNT;
+    }
 
-        string csv_str = {&arena, fsize + 1};
-        ARRAY_MAKE(&csv_str);
-        memset(csv_str.data, 0, csv_str.len);
+    for (i64 c_idx = 0; c_idx < title_view.len; c_idx++) {
+        char c = title_view.data[c_idx];
+        book_key[book_key_len++] = c == ' ' ? '_' : (char) toupper((u8) c);
+    }
+    book_key[book_key_len] = '\0';
 
-        u64 bytes_read = fread(csv_str.data, 1, fsize, fp);
-        assert(bytes_read == fsize);
+    for (i32 book_idx = 0; book_idx < BIBLE_BOOK_COUNT; book_idx++) {
+        if (strcmp(kBibleBookStrs[book_idx], book_key) == 0) {
+            return book_idx;
+        }
+    }
 
-        strings lines = str_split(&arena, &csv_str, "\n");
+    return BIBLE_BOOK_COUNT;
+}
 
-        for (i64 line_idx = 1; line_idx < lines.len; line_idx++) {
-            const string *line = lines.data + line_idx;
+// Rows are "Book,Chapter,Verse,Text" after a header row, the text may hold
+// commas. The verse texts are views into the file buffer, out_verses is made
+// here once the rows are counted.
+static bool bible_read_csv(Arena *arena, const char *csv_filepath, BibleCsvVerses *out_verses, u64 *out_hash) {
+    FILE *fp = fopen(csv_filepath, "rb");
+    if (!fp) {
+        return false;
+    }
 
-            i64s comma_idxs = str_split_idxs(&arena, line, ",");
-            assert(comma_idxs.len >= 3);
+    fseek(fp, 0, SEEK_END);
+    long fsize = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
 
-            string_view b_ch_v_view = {
-                .data = line->data,
-                .len = comma_idxs.data[2],
-            };
+    TRACE_BEGIN("bible_read_csv", csv_filepath, fsize);
 
-            string b_ch_v_str = str_view_make(&arena, &b_ch_v_view);
+    string csv_str = {arena, fsize + 1};
+    ARRAY_MAKE(&csv_str);
 
-            strings b_ch_v_str_parts = str_split(&arena, &b_ch_v_str, ",");
-            assert(b_ch_v_str_parts.len == 3);
+    u64 bytes_read = fread(csv_str.data, 1, fsize, fp);
+    csv_str.data[fsize] = '\0';
 
-            const string *book_str = &b_ch_v_str_parts.data[0];
-            const string *chapter_str = &b_ch_v_str_parts.data[1];
-            const string *verse_str = &b_ch_v_str_parts.data[2];
+    int err = fclose(fp);
+    assert(!err);
 
-            string bible_key_str = str_make(&arena, "");
+    bool read = bytes_read == (u64) fsize;
 
-            bool is_numbered_book = false;
+    if (read) {
+        *out_hash = hash_fnv1a(csv_str.data, fsize, HASH_FNV1A_SEED);
 
-            if (isdigit(book_str->data[0])) {
-                char *title_start = nullptr;
-                i64 book_num = strtol(book_str->data, &title_start, 10);
-                const char *num_str = book_num_to_str((i32) book_num);
+        // Sized once, a row per line but never more than the shortest rows fit
+        i64 row_count = 1;
+        for (const char *newline = memchr(csv_str.data, '\n', fsize); newline;
+             newline = memchr(newline + 1, '\n', csv_str.data + fsize - (newline + 1))) {
+            row_count++;
+        }
 
-                if (num_str && title_start) {
-                    title_start++; // Skip the space
-                    is_numbered_book = true;
+        i64 max_row_count = fsize / kBibleCsvMinRowLen + 1;
+        out_verses->len = row_count < max_row_count ? row_count : max_row_count;
+        ARRAY_MAKE(out_verses);
+        out_verses->len = 0;
 
-                    string_view title_view = {
-                        title_start,
-                        (book_str->data + book_str->len) - title_start,
-                    };
-                    str_append(&bible_key_str, "%s_%.*s_", num_str, title_view.len, title_view.data);
-                }
+        BibleBook prior_book = BIBLE_BOOK_COUNT;
+        string_view prior_book_view = {};
+
+        const char *line_start = memchr(csv_str.data, '\n', fsize);
+        const char *csv_end = csv_str.data + fsize;
+
+        while (line_start && line_start < csv_end) {
+            line_start++;
+
+            const char *line_end = memchr(line_start, '\n', csv_end - line_start);
+            if (!line_end) {
+                line_end = csv_end;
             }
 
-            if (!is_numbered_book) {
-                str_append(&bible_key_str, "%s_", book_str->data);
+            const char *field_ends[3] = {};
+            const char *field_start = line_start;
+
+            for (i32 field_idx = 0; field_idx < 3 && field_start; field_idx++) {
+                field_ends[field_idx] = memchr(field_start, ',', line_end - field_start);
+                field_start = field_ends[field_idx] ? field_ends[field_idx] + 1 : nullptr;
             }
 
-            str_append(&bible_key_str, "%s_%s", chapter_str->data, verse_str->data);
-            str_to_upper(&bible_key_str);
-            ARRAY_FOR(c, &bible_key_str) {
-                if (*c == ' ') {
-                    *c = '_';
+            if (field_start && field_start < line_end) {
+                BibleCsvVerse verse = {
+                    .chapter = (i32) strtol(field_ends[0] + 1, nullptr, 10),
+                    .verse = (i32) strtol(field_ends[1] + 1, nullptr, 10),
+                    .text = {field_start, line_end - field_start},
+                };
+
+                string_view book_view = {line_start, field_ends[0] - line_start};
+
+                // Rows come grouped by book, so the name rarely needs matching
+                if (book_view.len != prior_book_view.len
+                    || memcmp(book_view.data, prior_book_view.data, book_view.len) != 0) {
+                    prior_book = bible_csv_book(&book_view);
+                    prior_book_view = book_view;
                 }
-            }
+                verse.book = prior_book;
 
-            i64 text_len = line->len - comma_idxs.data[2] - 1;
-            if (text_len > 0) {
-                char *text_str = alt_calloc(text_len + 1, sizeof(char));
-                assert(text_str);
-                snprintf(
-                    text_str,
-                    text_len + 1,
-                    "%.*s",
-                    (i32) text_len,
-                    line->data + (line->len - text_len)
-                );
-
-                HASHMAP_PUT(&g_lsb_verse_map, &bible_key_str.data, &text_str);
+                if (verse.book < BIBLE_BOOK_COUNT && verse.chapter > 0 && verse.verse > 0) {
+                    ARRAY_PUSH(out_verses, &verse);
+                }
             }
+
+            line_start = line_end;
         }
+    }
+
+    TRACE_END("bible_read_csv", -1);
+
+    return read;
+}
+
+// Room for the file and a verse for as many rows as it can hold
+static i64 bible_load_arena_capacity(const char *csv_filepath) {
+    struct stat st = {};
+    if (stat(csv_filepath, &st) != 0 || st.st_size <= 0) {
+        return kBibleLoadArenaSlack;
+    }
 
-        int err = fclose(fp);
-        assert(!err);
+    i64 max_row_count = st.st_size / kBibleCsvMinRowLen + 1;
+
+    return st.st_size + 1 + max_row_count * (i64) sizeof(BibleCsvVerse) + kBibleLoadArenaSlack;
+}
+
+static void bible_layout_build(const BibleCsvVerses *verses) {
+    i32 chapter_counts[BIBLE_BOOK_COUNT] = {};
+
+    ARRAY_FOR(verse, verses) {
+        if (verse->chapter > chapter_counts[verse->book]) {
+            chapter_counts[verse->book] = verse->chapter;
+        }
+    }
+
+    u32 chapter_slot_count = 0;
+    for (i32 book_idx = 0; book_idx < BIBLE_BOOK_COUNT; book_idx++) {
+        g_bible_layout.book_chapter_offsets[book_idx] = chapter_slot_count;
+        chapter_slot_count += chapter_counts[book_idx];
+    }
+    g_bible_layout.book_chapter_offsets[BIBLE_BOOK_COUNT] = chapter_slot_count;
+
+    g_bible_layout.arena = arena_make((i64) ((chapter_slot_count + 1) * sizeof(u32)) + 1024);
+
+    BibleSlots *chapter_verse_offsets = &g_bible_layout.chapter_verse_offsets;
+    *chapter_verse_offsets = (BibleSlots){&g_bible_layout.arena, chapter_slot_count + 1};
+    ARRAY_MAKE(chapter_verse_offsets);
+    memset(chapter_verse_offsets->data, 0, chapter_verse_offsets->len * sizeof(u32));
+
+    // Verse counts first, then turned into offsets in place
+    ARRAY_FOR(verse, verses) {
+        u32 chapter_slot = g_bible_layout.book_chapter_offsets[verse->book] + verse->chapter - 1;
+
+        if ((u32) verse->verse > chapter_verse_offsets->data[chapter_slot]) {
+            chapter_verse_offsets->data[chapter_slot] = verse->verse;
+        }
+    }
+
+    u32 verse_slot_count = 0;
+    for (u32 chapter_slot = 0; chapter_slot <= chapter_slot_count; chapter_slot++) {
+        u32 verse_count = chapter_verse_offsets->data[chapter_slot];
+        chapter_verse_offsets->data[chapter_slot] = verse_slot_count;
+        verse_slot_count += verse_count;
+    }
+
+    g_bible_layout.verse_slot_count = verse_slot_count;
+}
+
+static i64 bible_verse_slot(BibleBook book, i32 chapter, i32 verse) {
+    if (book < 0 || book >= BIBLE_BOOK_COUNT || chapter <= 0 || verse <= 0) {
+        return -1;
+    }
+
+    u32 chapter_slot = g_bible_layout.book_chapter_offsets[book] + (u32) chapter - 1;
+    if (chapter_slot >= g_bible_layout.book_chapter_offsets[book + 1]) {
+        return -1;
+    }
+
+    u32 verse_slot = g_bible_layout.chapter_verse_offsets.data[chapter_slot] + (u32) verse - 1;
+    if (verse_slot >= g_bible_layout.chapter_verse_offsets.data[chapter_slot + 1]) {
+        return -1;
+    }
+
+    return verse_slot;
+}
+
+// Packs the verse texts back to back in canonical order, so the verses of a
+// chapter form one contiguous span. Returns the number of verses the layout
+// has no slot for
+static i64 bible_translation_fill(BibleTranslation *translation, const BibleCsvVerses *verses) {
+    i64 text_size = 0;
+
+    ARRAY_FOR(verse, verses) {
+        text_size += verse->text.len;
+    }
+
+    u32 verse_slot_count = g_bible_layout.verse_slot_count;
+
+    i64 offsets_start = (text_size + 1 + (i64) alignof(u32) - 1) & ~((i64) alignof(u32) - 1);
+    i64 storage_size = offsets_start + (i64) ((verse_slot_count + 1) * sizeof(u32));
+
+    bool mapped = huge_pages_map(&translation->storage, storage_size, g_bible_huge_pages);
+    assert(mapped);
+
+    string text = {.len = 0, .data = (char *) translation->storage.data};
+
+    // Holds the CSV verse of each slot first, then turned into text offsets in place
+    BibleSlots verse_offsets = {
+        .len = verse_slot_count + 1,
+        .data = (u32 *) (translation->storage.data + offsets_start),
+    };
+    memset(verse_offsets.data, 0xFF, verse_offsets.len * sizeof(u32));
+
+    i64 dropped_count = 0;
+
+    for (i64 verse_idx = 0; verse_idx < verses->len; verse_idx++) {
+        const BibleCsvVerse *verse = &verses->data[verse_idx];
+
+        i64 verse_slot = bible_verse_slot(verse->book, verse->chapter, verse->verse);
+        if (verse_slot < 0) {
+            dropped_count++;
+            continue;
+        }
+
+        // A repeated verse keeps its last text
+        verse_offsets.data[verse_slot] = (u32) verse_idx;
+    }
+
+    for (u32 verse_slot = 0; verse_slot < verse_slot_count; verse_slot++) {
+        u32 verse_idx = verse_offsets.data[verse_slot];
+        verse_offsets.data[verse_slot] = (u32) text.len;
+
+        // A verse the translation lacks is an empty span
+        if (verse_idx != kBibleVerseMissing) {
+            const string_view *verse_text = &verses->data[verse_idx].text;
+
+            memcpy(text.data + text.len, verse_text->data, verse_text->len);
+            text.len += verse_text->len;
+        }
+    }
+
+    verse_offsets.data[verse_slot_count] = (u32) text.len;
+    text.data[text.len] = '\0';
+
+    translation->text = text.data;
+    translation->verse_offsets = verse_offsets.data;
+    translation->verse_offsets_start = offsets_start;
+
+    return dropped_count;
+}
+
+static void bible_translation_set_name(BibleTranslation *translation, const char *name, i64 name_len) {
+    if (name_len > BIBLE_TRANSLATION_NAME_MAX - 1) {
+        name_len = BIBLE_TRANSLATION_NAME_MAX - 1;
+    }
+
+    for (i64 c_idx = 0; c_idx < name_len; c_idx++) {
+        translation->name[c_idx] = (char) toupper((u8) name[c_idx]);
+    }
+    translation->name[name_len] = '\0';
+}
+
+void bible_init(const char *lsb_csv_filepath, bool huge_pages) {
+    if (!g_bible_initialised) {
+        TRACE_BEGIN("bible_init", lsb_csv_filepath, -1);
+
+        // Every translation loaded later follows the default one
+        g_bible_huge_pages = huge_pages;
+
+        Arena arena = arena_make(bible_load_arena_capacity(lsb_csv_filepath));
+
+        BibleCsvVerses verses = {&arena};
+
+        BibleTranslation *translation = &g_bible_translations[0];
+
+        bool read = bible_read_csv(&arena, lsb_csv_filepath, &verses, &translation->corpus_hash);
+        assert(read);
+
+        // The default translation decides which chapters and verses exist
+        bible_layout_build(&verses);
+        bible_translation_fill(translation, &verses);
+
+        // Named after the file, "./data/lsb.csv" is LSB
+        const char *name_start = strrchr(lsb_csv_filepath, '/');
+        name_start = name_start ? name_start + 1 : lsb_csv_filepath;
+
+        const char *name_end = strchr(name_start, '.');
+        i64 name_len = name_end ? name_end - name_start : (i64) strlen(name_start);
+
+        bible_translation_set_name(translation, name_start, name_len);
+
+        g_bible_translation_count = 1;
+
+        bible_search_init();
+
+        arena_free(&arena);
+
+        TRACE_END("bible_init", g_bible_layout.verse_slot_count);
 
         g_bible_initialised = true;
     }
+}
+
+void bible_init_lazy(const char *lsb_csv_filepath, bool huge_pages) {
+    pthread_mutex_lock(&g_bible_lazy_mutex);
+
+    if (!g_bible_initialised && !g_bible_lazy_filepath) {
+        g_bible_lazy_filepath = strdup(lsb_csv_filepath);
+        assert(g_bible_lazy_filepath);
+        g_bible_huge_pages = huge_pages;
+    }
+
+    pthread_mutex_unlock(&g_bible_lazy_mutex);
+}
+
+void bible_require() {
+    if (atomic_load_explicit(&g_bible_loaded, memory_order_acquire)) {
+        return;
+    }
+
+    pthread_mutex_lock(&g_bible_lazy_mutex);
+
+    if (!g_bible_initialised && g_bible_lazy_filepath) {
+        bible_init(g_bible_lazy_filepath, g_bible_huge_pages);
+    }
+
+    if (g_bible_initialised) {
+        atomic_store_explicit(&g_bible_loaded, true, memory_order_release);
+    }
+
+    pthread_mutex_unlock(&g_bible_lazy_mutex);
+}
+
+i32 bible_load_translation(const char *name, const char *csv_filepath) {
+    if (!g_bible_initialised || !name || !csv_filepath || g_bible_translation_count >= BIBLE_TRANSLATION_MAX) {
+        return -1;
+    }
+
+    string_view name_view = {name, (i64) strlen(name)};
+    if (bible_find_translation(&name_view) >= 0) {
+        return -1;
+    }
+
+    i32 translation_idx = -1;
+
+    Arena arena = arena_make(bible_load_arena_capacity(csv_filepath));
+
+    BibleCsvVerses verses = {&arena};
+
+    BibleTranslation translation = {};
+
+    if (bible_read_csv(&arena, csv_filepath, &verses, &translation.corpus_hash)) {
+        i64 dropped_count = bible_translation_fill(&translation, &verses);
+        if (dropped_count > 0) {
+            fprintf(
+                stderr,
+                "bible: %lld verses of %s aren't in the default translation and were left out\n",
+                (long long) dropped_count,
+                csv_filepath
+            );
+        }
+
+        bible_translation_set_name(&translation, name, name_view.len);
+
+        translation_idx = g_bible_translation_count++;
+        g_bible_translations[translation_idx] = translation;
+    }
 
     arena_free(&arena);
+
+    return translation_idx;
 }
 
 void bible_uninit() {
     if (g_bible_initialised) {
-        HASHMAP_FOR(key_val, &g_lsb_verse_map) {
-            alt_free(key_val->value);
+        bible_search_uninit();
+
+        for (i32 translation_idx = 0; translation_idx < g_bible_translation_count; translation_idx++) {
+            BibleTranslation *translation = &g_bible_translations[translation_idx];
+
+            for (i32 replica_idx = 0; replica_idx < NUMA_NODE_MAX; replica_idx++) {
+                huge_pages_unmap(&translation->replicas[replica_idx]);
+            }
+
+            huge_pages_unmap(&translation->storage);
+            *translation = (BibleTranslation){};
         }
+        g_bible_translation_count = 0;
+        g_bible_replica_slot_count = 0;
 
-        HASHMAP_FREE(&g_lsb_verse_map);
+        arena_free(&g_bible_layout.arena);
+        g_bible_layout = (BibleLayout){};
 
         g_bible_initialised = false;
     }
+
+    atomic_store_explicit(&g_bible_loaded, false, memory_order_release);
+
+    pthread_mutex_lock(&g_bible_lazy_mutex);
+
+    if (g_bible_lazy_filepath) {
+        free(g_bible_lazy_filepath);
+        g_bible_lazy_filepath = nullptr;
+    }
+
+    pthread_mutex_unlock(&g_bible_lazy_mutex);
+}
+
+i32 bible_find_translation(const string_view *name) {
+    if (!name || name->len <= 0 || name->len >= BIBLE_TRANSLATION_NAME_MAX) {
+        return -1;
+    }
+
+    for (i32 translation_idx = 0; translation_idx < g_bible_translation_count; translation_idx++) {
+        const char *translation_name = g_bible_translations[translation_idx].name;
+
+        if ((i64) strlen(translation_name) == name->len && strncasecmp(translation_name, name->data, name->len) == 0) {
+            return translation_idx;
+        }
+    }
+
+    return -1;
+}
+
+i32 bible_translation_count() {
+    return g_bible_translation_count;
+}
+
+const char *bible_translation_name(i32 translation_idx) {
+    if (translation_idx < 0 || translation_idx >= g_bible_translation_count) {
+        return nullptr;
+    }
+
+    return g_bible_translations[translation_idx].name;
+}
+
+i32 bible_chapter_count(BibleBook book) {
+    if (book < 0 || book >= BIBLE_BOOK_COUNT) {
+        return 0;
+    }
+
+    return (i32) (g_bible_layout.book_chapter_offsets[book + 1] - g_bible_layout.book_chapter_offsets[book]);
+}
+
+i32 bible_verse_count(BibleBook book, i32 chapter) {
+    if (chapter <= 0 || chapter > bible_chapter_count(book)) {
+        return 0;
+    }
+
+    u32 chapter_slot = g_bible_layout.book_chapter_offsets[book] + (u32) chapter - 1;
+
+    return (i32) (g_bible_layout.chapter_verse_offsets.data[chapter_slot + 1]
+                  - g_bible_layout.chapter_verse_offsets.data[chapter_slot]);
 }
 
 BiblePassages bible_parse_ref(Arena *arena, const string *ref) {
@@ -398,62 +825,184 @@ BibleSubkey bible_get_subkey(const string *subkey_str) {
     return bible_subkey;
 }
 
-char *bible_get_verse(BibleBook book, i32 chapter, i32 verse) {
-    Arena tmp = arena_make(64);
+string_view bible_get_verse(BibleBook book, i32 chapter, i32 verse) {
+    return bible_get_translation_range(0, book, chapter, verse, verse);
+}
+
+string_view bible_get_translation_verse(i32 translation_idx, BibleBook book, i32 chapter, i32 verse) {
+    return bible_get_translation_range(translation_idx, book, chapter, verse, verse);
+}
+
+string_view bible_get_range(BibleBook book, i32 chapter, i32 start_verse, i32 end_verse) {
+    return bible_get_translation_range(0, book, chapter, start_verse, end_verse);
+}
 
-    string verse_key = str_make(
-        &tmp,
-        "%s_%d_%d",
-        kBibleBookStrs[book],
-        chapter,
-        verse
-    );
+string_view bible_get_translation_range(
+    i32 translation_idx,
+    BibleBook book,
+    i32 chapter,
+    i32 start_verse,
+    i32 end_verse
+) {
+    TRACE_BEGIN("bible_get_range", nullptr, -1);
+
+    string_view verses = {};
+
+    i32 verse_count = bible_verse_count(book, chapter);
+    if (end_verse > verse_count) {
+        end_verse = verse_count;
+    }
 
-    arena_free(&tmp);
+    i64 start_verse_slot = bible_verse_slot(book, chapter, start_verse);
 
-    char* verse_str = HASHMAP_GET_VAL(&g_lsb_verse_map, &verse_key.data);
+    if (start_verse_slot >= 0 && end_verse >= start_verse
+        && translation_idx >= 0 && translation_idx < g_bible_translation_count) {
+        const BibleTranslation *translation = &g_bible_translations[translation_idx];
 
-    return verse_str;
+        const char *text = translation->text;
+        const u32 *verse_offsets = translation->verse_offsets;
+
+        // Translations loaded after bible_replicate only have the original
+        i32 replica_idx = g_bible_thread_replica;
+        if (replica_idx >= 0 && translation->replicas[replica_idx].data) {
+            text = (const char *) translation->replicas[replica_idx].data;
+            verse_offsets = (const u32 *) (translation->replicas[replica_idx].data + translation->verse_offsets_start);
+        }
+
+        u32 start_offset = verse_offsets[start_verse_slot];
+        u32 end_offset = verse_offsets[start_verse_slot + (end_verse - start_verse) + 1];
+
+        if (end_offset > start_offset) {
+            verses = (string_view){text + start_offset, end_offset - start_offset};
+        }
+    }
+
+    TRACE_END("bible_get_range", verses.len);
+
+    return verses;
 }
 
-string bible_verse_to_inline(Arena *arena, const char* verse) {
-    string inline_html = str_make(arena, "%s", verse);
+void bible_huge_pages_usage(HugePagesUsage *out_usage) {
+    *out_usage = (HugePagesUsage){};
 
-    const char *opening_div_str = "<div ";
-    char *opening_div_start = strstr(
-        inline_html.data,
-        opening_div_str
-    );
-    assert(
-        opening_div_start
-        && opening_div_start == inline_html.data
-    );
-
-    str_replace_at(
-        &inline_html,
-        0,
-        (i64) strlen(opening_div_str),
-        "<span "
-    );
+    for (i32 translation_idx = 0; translation_idx < g_bible_translation_count; translation_idx++) {
+        huge_pages_usage_add(out_usage, &g_bible_translations[translation_idx].storage);
+    }
+}
+
+static i32 bible_replica_slot(i32 node_id) {
+    for (i32 slot = 0; slot < g_bible_replica_slot_count; slot++) {
+        if (g_bible_replica_node_ids[slot] == node_id) {
+            return slot;
+        }
+    }
+
+    return -1;
+}
+
+i32 bible_replicate(const NumaTopology *topology) {
+    i32 replica_count = 0;
+
+    for (i32 node_idx = 0; node_idx < topology->node_count; node_idx++) {
+        const NumaNode *node = &topology->nodes[node_idx];
+
+        i32 slot = bible_replica_slot(node->id);
+        if (slot < 0) {
+            if (g_bible_replica_slot_count >= NUMA_NODE_MAX) {
+                continue;
+            }
+            slot = g_bible_replica_slot_count++;
+            g_bible_replica_node_ids[slot] = node->id;
+        }
+
+        for (i32 translation_idx = 0; translation_idx < g_bible_translation_count; translation_idx++) {
+            BibleTranslation *translation = &g_bible_translations[translation_idx];
+            HugePagesRegion *replica = &translation->replicas[slot];
+
+            if (!replica->data) {
+                if (!huge_pages_map(replica, translation->storage.size, g_bible_huge_pages)) {
+                    continue;
+                }
+
+                // Bound before the copy touches it, so every page comes from the node
+                if (!numa_bind_memory(replica->data, replica->size, node)) {
+                    huge_pages_unmap(replica);
+                    continue;
+                }
 
+                memcpy(replica->data, translation->storage.data, translation->storage.size);
+            }
+
+            replica_count++;
+        }
+    }
+
+    return replica_count;
+}
+
+void bible_set_thread_replica(i32 node_id) {
+    g_bible_thread_replica = node_id >= 0 ? bible_replica_slot(node_id) : -1;
+}
+
+u64 bible_corpus_version() {
+    u64 corpus_version = HASH_FNV1A_SEED;
+
+    for (i32 translation_idx = 0; translation_idx < g_bible_translation_count; translation_idx++) {
+        const BibleTranslation *translation = &g_bible_translations[translation_idx];
+
+        corpus_version = hash_fnv1a(translation->name, strlen(translation->name), corpus_version);
+        corpus_version = hash_fnv1a(&translation->corpus_hash, sizeof(translation->corpus_hash), corpus_version);
+    }
+
+    return corpus_version;
+}
+
+void bible_append_inline(string *out_html, const string_view *verses) {
+    const char *opening_div_str = "<div ";
     const char *closing_div_str = "</div>";
-    u64 closing_div_str_len = strlen(closing_div_str);
-    char *closing_div_start = strstr(
-        inline_html.data,
-        closing_div_str
-    );
-    i64 closing_div_start_idx = inline_html.len - (i64) closing_div_str_len;
-    assert(
-        closing_div_start
-        && closing_div_start == inline_html.data + closing_div_start_idx
-    );
-
-    str_replace_at(
-        &inline_html,
-        closing_div_start_idx,
-        (i64) closing_div_str_len,
-        "</span>"
-    );
-
-    return inline_html;
+    i64 opening_div_str_len = (i64) strlen(opening_div_str);
+    i64 closing_div_str_len = (i64) strlen(closing_div_str);
+
+    string_view rest = *verses;
+
+    // A verse is normally one <div ...>...</div> whose only </div> is its own.
+    // Text of a translation that doesn't wrap its verses is already inline and
+    // goes out as it is, up to the next <div
+    while (rest.len > 0) {
+        bool wrapped = rest.len >= opening_div_str_len
+                       && memcmp(rest.data, opening_div_str, opening_div_str_len) == 0;
+
+        if (!wrapped) {
+            i64 unwrapped_len = 1;
+            while (unwrapped_len + opening_div_str_len <= rest.len
+                   && memcmp(rest.data + unwrapped_len, opening_div_str, opening_div_str_len) != 0) {
+                unwrapped_len++;
+            }
+            if (unwrapped_len + opening_div_str_len > rest.len) {
+                unwrapped_len = rest.len;
+            }
+
+            html_bytes_append(out_html, rest.data, unwrapped_len);
+            str_view_advance(&rest, unwrapped_len);
+            continue;
+        }
+
+        i64 closing_div_start_idx = opening_div_str_len;
+        while (closing_div_start_idx + closing_div_str_len <= rest.len
+               && memcmp(rest.data + closing_div_start_idx, closing_div_str, closing_div_str_len) != 0) {
+            closing_div_start_idx++;
+        }
+
+        // An unclosed <div runs to the end of the text
+        bool closed = closing_div_start_idx + closing_div_str_len <= rest.len;
+        if (!closed) {
+            closing_div_start_idx = rest.len;
+        }
+
+        str_append(out_html, "<span ");
+        html_bytes_append(out_html, rest.data + opening_div_str_len, closing_div_start_idx - opening_div_str_len);
+        str_append(out_html, "</span>");
+
+        str_view_advance(&rest, closed ? closing_div_start_idx + closing_div_str_len : rest.len);
+    }
 }
@@ -10,6 +10,9 @@
 #include <altcore/arenas.h>
 #include <altcore/hashmap.h>
 
+#include "huge_pages.h"
+#include "numa.h"
+
 typedef enum BIBLE_BOOK_E : i32 {
 #ifndef X_BIBLE_BOOKS
 #define X_BIBLE_BOOKS \
@@ -104,10 +107,6 @@ typedef struct BIBLE_PASSAGES_T {
     ARRAY_FIELDS(BiblePassage);
 } BiblePassages;
 
-typedef struct BIBLE_VERSE_TO_HTML_MAP_T {
-    HASHMAP_FIELDS(const char*, char*)
-} BibleVerseToHtmlMap;
-
 typedef enum BIBLE_SUBKEY_E : i32 {
 #ifndef X_BIBLE_SUBKEYS
 #define X_BIBLE_SUBKEYS \
@@ -128,9 +127,47 @@ extern const char *kBibleSubkeyStrs[];
 
 extern const char *kBibleBookStrs[];
 
-extern BibleVerseToHtmlMap g_lsb_verse_map;
+// Translations loaded side by side, the one bible_init loads is the default
+#define BIBLE_TRANSLATION_MAX 16
+#define BIBLE_TRANSLATION_NAME_MAX 16
+
+// Loads the default translation, named after the file. With huge_pages every
+// translation's text and verse offsets are mapped on 2 MB pages when it can be
+void bible_init(const char *lsb_csv_filepath, bool huge_pages);
+
+// Only remembers the file, the first bible_require loads it
+void bible_init_lazy(const char *lsb_csv_filepath, bool huge_pages);
+
+// Loads the translation bible_init_lazy named unless it already is, safe to
+// call from any thread before using the corpus
+void bible_require();
+
+// Adds a translation on top of the default one's chapters and verses, returns
+// its index or -1
+i32 bible_load_translation(const char *name, const char *csv_filepath);
+
+// Case-insensitive, returns -1 for an unknown name
+i32 bible_find_translation(const string_view *name);
+
+i32 bible_translation_count();
+
+// Storage of the loaded translations and how much of it is on huge pages
+void bible_huge_pages_usage(HugePagesUsage *out_usage);
 
-void bible_init(const char *lsb_csv_filepath);
+// Copies every loaded translation onto each node of the topology, for threads
+// there to read through bible_set_thread_replica. Call it before the threads
+// start, returns the replicas made or already there
+i32 bible_replicate(const NumaTopology *topology);
+
+// The calling thread reads the replica made for the node with this id, or the
+// original with -1 or a node bible_replicate was not given
+void bible_set_thread_replica(i32 node_id);
+
+const char *bible_translation_name(i32 translation_idx);
+
+i32 bible_chapter_count(BibleBook book);
+
+i32 bible_verse_count(BibleBook book, i32 chapter);
 
 void bible_uninit();
 
@@ -140,8 +177,29 @@ string bible_passage_ref_to_str(Arena *arena, BiblePassage passage);
 
 BibleSubkey bible_get_subkey(const string* subkey_str);
 
-char* bible_get_verse(BibleBook book, i32 chapter, i32 verse);
+// Views into the loaded text, data is nullptr when the translation lacks the
+// verse. Without a translation index they read the default one
+string_view bible_get_verse(BibleBook book, i32 chapter, i32 verse);
+
+string_view bible_get_translation_verse(i32 translation_idx, BibleBook book, i32 chapter, i32 verse);
+
+// Verses start_verse to end_verse of a chapter as one span, since every
+// translation keeps its verses back to back in canonical order. end_verse is
+// clamped to the chapter and verses the translation lacks are simply absent
+string_view bible_get_range(BibleBook book, i32 chapter, i32 start_verse, i32 end_verse);
+
+string_view bible_get_translation_range(
+    i32 translation_idx,
+    BibleBook book,
+    i32 chapter,
+    i32 start_verse,
+    i32 end_verse
+);
+
+// Appends a span of verses inline, each verse's <div> becomes a <span>
+void bible_append_inline(string *out_html, const string_view *verses);
 
-string bible_verse_to_inline(Arena *arena, const char* verse);
+// Hash of the loaded translations, changes whenever any verse text does
+u64 bible_corpus_version();
 
 #endif //ARTICLE_HTML_BIBLE_H
@@ -0,0 +1,908 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "bible_search.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <altcore/hashmap.h>
+
+#include "index_file.h"
+#include "search_index.h"
+#include "altcore/defer.h"
+
+#define BIBLE_SEARCH_TERM_MAX_LEN 64
+#define BIBLE_SEARCH_MAX_CLAUSES 16
+#define BIBLE_SEARCH_MAX_PHRASE_TERMS 16
+
+// Covers the alignment of the build arena's handful of arrays
+static const i64 kBibleSearchBuildArenaSlack = 4096;
+static const double kBibleSearchBm25K1 = 1.2;
+static const double kBibleSearchBm25B = 0.75;
+
+typedef enum BIBLE_SEARCH_CLAUSE_TYPE_E {
+#ifndef X_BIBLE_SEARCH_CLAUSE_TYPES
+#define X_BIBLE_SEARCH_CLAUSE_TYPES \
+    X(WORD) \
+    X(PREFIX) \
+    X(PHRASE) \
+    X(COUNT)
+#endif
+
+#ifndef X
+#define X(type) \
+    BIBLE_SEARCH_CLAUSE_TYPE_##type,
+#endif
+    X_BIBLE_SEARCH_CLAUSE_TYPES
+#undef X
+} BibleSearchClauseType;
+
+typedef struct BIBLE_SEARCH_VERSE_T {
+    BibleBook book;
+    i32 chapter;
+    i32 verse;
+    u32 term_count;
+} BibleSearchVerse;
+
+typedef struct BIBLE_SEARCH_VERSES_T {
+    ARRAY_FIELDS(BibleSearchVerse)
+} BibleSearchVerses;
+
+typedef struct BIBLE_SEARCH_OCCURRENCE_T {
+    u32 verse_idx;
+    u32 position;
+} BibleSearchOccurrence;
+
+typedef struct BIBLE_SEARCH_OCCURRENCES_T {
+    ARRAY_FIELDS(BibleSearchOccurrence)
+} BibleSearchOccurrences;
+
+typedef struct BIBLE_SEARCH_MATCH_T {
+    u32 verse_idx;
+    u32 count;
+} BibleSearchMatch;
+
+typedef struct BIBLE_SEARCH_MATCHES_T {
+    ARRAY_FIELDS(BibleSearchMatch)
+} BibleSearchMatches;
+
+typedef struct BIBLE_SEARCH_TERM_T {
+    string_view text;
+    u32 occurrence_offset;
+    u32 occurrence_count;
+    u32 match_offset;
+    u32 match_count;
+} BibleSearchTerm;
+
+typedef struct BIBLE_SEARCH_TERMS_T {
+    ARRAY_FIELDS(BibleSearchTerm)
+} BibleSearchTerms;
+
+typedef struct BIBLE_SEARCH_INDEX_T {
+    Arena arena;
+    // In canonical order, so a verse_idx sorts the same way as its passage
+    BibleSearchVerses verses;
+    // Sorted by text, prefix queries walk a contiguous range
+    BibleSearchTerms terms;
+    // Grouped by term, then in (verse_idx, position) order
+    BibleSearchOccurrences occurrences;
+    // Grouped by term, one per verse the term occurs in, so word clauses need no work at query time
+    BibleSearchMatches term_matches;
+    double avg_verse_len;
+    bool built;
+} BibleSearchIndex;
+
+typedef struct BIBLE_SEARCH_SOURCE_VERSE_T {
+    BibleSearchVerse verse;
+    string_view text;
+} BibleSearchSourceVerse;
+
+typedef struct BIBLE_SEARCH_SOURCE_VERSES_T {
+    ARRAY_FIELDS(BibleSearchSourceVerse)
+} BibleSearchSourceVerses;
+
+typedef struct BIBLE_SEARCH_TOKEN_T {
+    u32 term_id;
+    u32 verse_idx;
+    u32 position;
+} BibleSearchToken;
+
+typedef struct BIBLE_SEARCH_TOKENS_T {
+    ARRAY_FIELDS(BibleSearchToken)
+} BibleSearchTokens;
+
+typedef struct BIBLE_SEARCH_TERM_TEXTS_T {
+    ARRAY_FIELDS(string_view)
+} BibleSearchTermTexts;
+
+typedef struct BIBLE_SEARCH_CHARS_T {
+    ARRAY_FIELDS(char)
+} BibleSearchChars;
+
+typedef struct BIBLE_SEARCH_TERM_IDS_MAP_T {
+    HASHMAP_FIELDS(const char*, i64)
+} BibleSearchTermIdsMap;
+
+typedef struct BIBLE_SEARCH_COUNTS_T {
+    ARRAY_FIELDS(u32)
+} BibleSearchCounts;
+
+typedef struct BIBLE_SEARCH_CLAUSE_T {
+    BibleSearchClauseType type;
+    i64 term_count;
+    const BibleSearchTerm *terms[BIBLE_SEARCH_MAX_PHRASE_TERMS];
+    // A prefix needn't be a whole word of the corpus, so it is kept as text
+    char prefix[BIBLE_SEARCH_TERM_MAX_LEN + 1];
+    i64 prefix_len;
+    BibleSearchMatches matches;
+} BibleSearchClause;
+
+static BibleSearchIndex g_bible_search_index = {};
+
+static i64 bible_search_skip_past(const char *text, i64 text_len, i64 c_idx, const char *delimiter) {
+    i64 delimiter_len = (i64) strlen(delimiter);
+
+    for (; c_idx + delimiter_len <= text_len; c_idx++) {
+        if (memcmp(text + c_idx, delimiter, delimiter_len) == 0) {
+            return c_idx + delimiter_len;
+        }
+    }
+
+    return text_len;
+}
+
+// Writes the next lower-cased term to out_term and returns its length, 0 once
+// the text is exhausted. Markup and entities separate words.
+static i64 bible_search_next_term(const char *text, i64 text_len, i64 *c_idx, char *out_term) {
+    while (*c_idx < text_len) {
+        char c = text[*c_idx];
+
+        if (c == '<') {
+            // Verse numbers sit in <sup>, they aren't words of the verse
+            if (text_len - *c_idx >= 5 && memcmp(text + *c_idx, "<sup>", 5) == 0) {
+                *c_idx = bible_search_skip_past(text, text_len, *c_idx, "</sup>");
+            } else {
+                *c_idx = bible_search_skip_past(text, text_len, *c_idx, ">");
+            }
+            continue;
+        }
+
+        if (c == '&') {
+            *c_idx = bible_search_skip_past(text, text_len, *c_idx, ";");
+            continue;
+        }
+
+        if (!search_term_char(c)) {
+            (*c_idx)++;
+            continue;
+        }
+
+        i64 term_start_c_idx = *c_idx;
+        while (*c_idx < text_len && search_term_char(text[*c_idx])) {
+            (*c_idx)++;
+        }
+
+        i64 term_len = *c_idx - term_start_c_idx;
+        if (term_len > BIBLE_SEARCH_TERM_MAX_LEN) {
+            continue;
+        }
+
+        for (i64 term_c_idx = 0; term_c_idx < term_len; term_c_idx++) {
+            char term_c = text[term_start_c_idx + term_c_idx];
+            out_term[term_c_idx] = term_c >= 'A' && term_c <= 'Z' ? (char) (term_c - 'A' + 'a') : term_c;
+        }
+        out_term[term_len] = '\0';
+
+        return term_len;
+    }
+
+    return 0;
+}
+
+static int bible_search_term_qsort_cmp(const void *a, const void *b) {
+    return index_file_str_cmp(&((const BibleSearchTerm *) a)->text, &((const BibleSearchTerm *) b)->text);
+}
+
+// Walking the layout yields the verses of the default translation in canonical
+// order. Pushes them when out_verses is set, otherwise counts their terms and
+// the bytes the terms' copies take with their terminators.
+static i64 bible_search_walk_verses(
+    BibleSearchSourceVerses *out_verses,
+    i64 *out_token_count,
+    i64 *out_term_chars_len
+) {
+    i64 source_verse_count = 0;
+    char term[BIBLE_SEARCH_TERM_MAX_LEN + 1];
+
+    for (i32 book_idx = 0; book_idx < BIBLE_BOOK_COUNT; book_idx++) {
+        i32 chapter_count = bible_chapter_count(book_idx);
+
+        for (i32 chapter = 1; chapter <= chapter_count; chapter++) {
+            i32 verse_count = bible_verse_count(book_idx, chapter);
+
+            for (i32 verse = 1; verse <= verse_count; verse++) {
+                BibleSearchSourceVerse source_verse = {
+                    .verse = {book_idx, chapter, verse},
+                    .text = bible_get_verse(book_idx, chapter, verse),
+                };
+
+                if (!source_verse.text.data) {
+                    continue;
+                }
+
+                source_verse_count++;
+
+                if (out_verses) {
+                    ARRAY_PUSH(out_verses, &source_verse);
+                    continue;
+                }
+
+                const string_view *text = &source_verse.text;
+                i64 c_idx = 0;
+                i64 term_len;
+
+                while ((term_len = bible_search_next_term(text->data, text->len, &c_idx, term)) > 0) {
+                    (*out_token_count)++;
+                    *out_term_chars_len += term_len + 1;
+                }
+            }
+        }
+    }
+
+    return source_verse_count;
+}
+
+void bible_search_init() {
+    if (g_bible_search_index.built) {
+        return;
+    }
+
+    // Tokenized once up front, so the build arena holds exactly the corpus's
+    // tokens and at most one copy of each of their texts
+    i64 token_count = 0;
+    i64 term_chars_len = 0;
+    i64 source_verse_count = bible_search_walk_verses(nullptr, &token_count, &term_chars_len);
+
+    Arena tmp = arena_make(
+        (i64) (source_verse_count * sizeof(BibleSearchSourceVerse)
+               + (token_count + 1) * (sizeof(BibleSearchToken) + sizeof(string_view) + sizeof(i64)))
+        + term_chars_len + 1
+        + kBibleSearchBuildArenaSlack
+    );
+
+    BibleSearchTermIdsMap term_ids = {HASHMAP_TYPE_STR_KEY};
+    i64 default_term_id = -1;
+    HASHMAP_MAKE(&term_ids, &default_term_id);
+
+    DEFER(arena_free(&tmp)) {
+        // Every array is made at its bound up front, pushes never move them
+        BibleSearchSourceVerses source_verses = {&tmp, source_verse_count > 0 ? source_verse_count : 1};
+        ARRAY_MAKE(&source_verses);
+        source_verses.len = 0;
+
+        bible_search_walk_verses(&source_verses, nullptr, nullptr);
+
+        BibleSearchTermTexts term_texts = {&tmp, token_count + 1};
+        ARRAY_MAKE(&term_texts);
+        term_texts.len = 0;
+
+        // The map keys point in here, so it must not move once a term is added
+        BibleSearchChars term_chars = {&tmp, term_chars_len + 1};
+        ARRAY_MAKE(&term_chars);
+        term_chars.len = 0;
+
+        BibleSearchTokens tokens = {&tmp, token_count + 1};
+        ARRAY_MAKE(&tokens);
+        tokens.len = 0;
+
+        char term[BIBLE_SEARCH_TERM_MAX_LEN + 1];
+
+        for (i64 verse_idx = 0; verse_idx < source_verses.len; verse_idx++) {
+            BibleSearchSourceVerse *source_verse = &source_verses.data[verse_idx];
+            i64 c_idx = 0;
+            u32 position = 0;
+            const string_view *text = &source_verse->text;
+            i64 term_len;
+
+            while ((term_len = bible_search_next_term(text->data, text->len, &c_idx, term)) > 0) {
+                const char *term_key = term;
+                i64 term_id = HASHMAP_GET_VAL(&term_ids, &term_key);
+
+                if (term_id < 0) {
+                    assert(term_chars.len + term_len + 1 <= term_chars_len + 1);
+
+                    term_id = term_texts.len;
+
+                    string_view term_text = {
+                        term_chars.data + term_chars.len,
+                        term_len,
+                    };
+                    memcpy(term_chars.data + term_chars.len, term, term_len + 1);
+                    term_chars.len += term_len + 1;
+
+                    ARRAY_PUSH(&term_texts, &term_text);
+
+                    // Keyed on the copy, term is overwritten by the next word
+                    term_key = term_text.data;
+                    HASHMAP_PUT(&term_ids, &term_key, &term_id);
+                }
+
+                BibleSearchToken token = {
+                    (u32) term_id,
+                    (u32) verse_idx,
+                    position++,
+                };
+                ARRAY_PUSH(&tokens, &token);
+            }
+
+            source_verse->verse.term_count = position;
+        }
+
+        u64 term_texts_size = (u64) term_chars.len;
+
+        BibleSearchIndex *index = &g_bible_search_index;
+
+        // Sized exactly, the index lives for as long as the corpus does
+        index->arena = arena_make(
+            (i64) (source_verses.len * sizeof(BibleSearchVerse)
+                   + term_texts.len * (sizeof(BibleSearchTerm) + 16)
+                   + tokens.len * (sizeof(BibleSearchOccurrence) + sizeof(BibleSearchMatch))
+                   + term_texts_size)
+            + 4096
+        );
+
+        index->verses = (BibleSearchVerses){&index->arena, source_verses.len > 0 ? source_verses.len : 1};
+        ARRAY_MAKE(&index->verses);
+        index->verses.len = source_verses.len;
+
+        for (i64 verse_idx = 0; verse_idx < source_verses.len; verse_idx++) {
+            index->verses.data[verse_idx] = source_verses.data[verse_idx].verse;
+        }
+
+        i64s occurrence_cursors = {&tmp, term_texts.len + 1};
+        ARRAY_MAKE(&occurrence_cursors);
+        memset(occurrence_cursors.data, 0, occurrence_cursors.len * sizeof(i64));
+
+        ARRAY_FOR(token, &tokens) {
+            occurrence_cursors.data[token->term_id + 1]++;
+        }
+
+        index->terms = (BibleSearchTerms){&index->arena, term_texts.len > 0 ? term_texts.len : 1};
+        ARRAY_MAKE(&index->terms);
+        index->terms.len = term_texts.len;
+
+        for (i64 term_id = 0; term_id < term_texts.len; term_id++) {
+            occurrence_cursors.data[term_id + 1] += occurrence_cursors.data[term_id];
+
+            string term_text = str_make(
+                &index->arena,
+                "%.*s",
+                (i32) term_texts.data[term_id].len,
+                term_texts.data[term_id].data
+            );
+
+            index->terms.data[term_id] = (BibleSearchTerm){
+                .text = {term_text.data, term_text.len},
+                .occurrence_offset = (u32) occurrence_cursors.data[term_id],
+                .occurrence_count = (u32) (occurrence_cursors.data[term_id + 1] - occurrence_cursors.data[term_id]),
+            };
+        }
+
+        index->occurrences = (BibleSearchOccurrences){&index->arena, tokens.len > 0 ? tokens.len : 1};
+        ARRAY_MAKE(&index->occurrences);
+        index->occurrences.len = tokens.len;
+
+        // Tokens are already in (verse_idx, position) order, so a counting sort keeps each term's run sorted
+        ARRAY_FOR(token, &tokens) {
+            i64 occurrence_idx = occurrence_cursors.data[token->term_id]++;
+
+            index->occurrences.data[occurrence_idx] = (BibleSearchOccurrence){
+                token->verse_idx,
+                token->position,
+            };
+        }
+
+        index->term_matches = (BibleSearchMatches){&index->arena, tokens.len > 0 ? tokens.len : 1};
+        ARRAY_MAKE(&index->term_matches);
+        index->term_matches.len = 0;
+
+        ARRAY_FOR(term, &index->terms) {
+            term->match_offset = (u32) index->term_matches.len;
+
+            for (u32 occurrence_idx = 0; occurrence_idx < term->occurrence_count; occurrence_idx++) {
+                u32 verse_idx = index->occurrences.data[term->occurrence_offset + occurrence_idx].verse_idx;
+
+                if (index->term_matches.len > term->match_offset
+                    && index->term_matches.data[index->term_matches.len - 1].verse_idx == verse_idx) {
+                    index->term_matches.data[index->term_matches.len - 1].count++;
+                } else {
+                    BibleSearchMatch match = {
+                        verse_idx,
+                        1,
+                    };
+                    ARRAY_PUSH(&index->term_matches, &match);
+                }
+            }
+
+            term->match_count = (u32) (index->term_matches.len - term->match_offset);
+        }
+
+        qsort(index->terms.data, index->terms.len, sizeof(BibleSearchTerm), bible_search_term_qsort_cmp);
+
+        index->avg_verse_len = source_verses.len > 0 ? (double) tokens.len / (double) source_verses.len : 0;
+        index->built = true;
+    }
+
+    HASHMAP_FREE(&term_ids);
+}
+
+void bible_search_uninit() {
+    if (g_bible_search_index.built) {
+        arena_free(&g_bible_search_index.arena);
+        g_bible_search_index = (BibleSearchIndex){};
+    }
+}
+
+static i64 bible_search_term_lower_bound(const string_view *text) {
+    const BibleSearchTerms *terms = &g_bible_search_index.terms;
+
+    i64 low_idx = 0;
+    i64 high_idx = terms->len;
+
+    while (low_idx < high_idx) {
+        i64 mid_idx = low_idx + (high_idx - low_idx) / 2;
+
+        if (index_file_str_cmp(&terms->data[mid_idx].text, text) < 0) {
+            low_idx = mid_idx + 1;
+        } else {
+            high_idx = mid_idx;
+        }
+    }
+
+    return low_idx;
+}
+
+static const BibleSearchTerm *bible_search_find_term(const char *text, i64 text_len) {
+    string_view text_view = {
+        text,
+        text_len,
+    };
+
+    i64 term_idx = bible_search_term_lower_bound(&text_view);
+
+    if (term_idx < g_bible_search_index.terms.len
+        && index_file_str_cmp(&g_bible_search_index.terms.data[term_idx].text, &text_view) == 0) {
+        return &g_bible_search_index.terms.data[term_idx];
+    }
+
+    return nullptr;
+}
+
+static bool bible_search_occurrence_before(const BibleSearchOccurrence *occurrence, u32 verse_idx, u32 position) {
+    return occurrence->verse_idx < verse_idx
+           || (occurrence->verse_idx == verse_idx && occurrence->position < position);
+}
+
+// Gallops forward from the cursor, so probing in ascending order costs
+// O(log gap) per probe rather than O(log n)
+static bool bible_search_seek_occurrence(
+    const BibleSearchTerm *term,
+    i64 *cursor,
+    u32 verse_idx,
+    u32 position
+) {
+    const BibleSearchOccurrence *occurrences = g_bible_search_index.occurrences.data + term->occurrence_offset;
+    i64 occurrence_count = term->occurrence_count;
+
+    i64 low_idx = *cursor;
+    i64 high_idx = low_idx;
+    i64 step = 1;
+
+    while (high_idx < occurrence_count
+           && bible_search_occurrence_before(&occurrences[high_idx], verse_idx, position)) {
+        low_idx = high_idx + 1;
+        high_idx += step;
+        step <<= 1;
+    }
+
+    if (high_idx > occurrence_count) {
+        high_idx = occurrence_count;
+    }
+
+    while (low_idx < high_idx) {
+        i64 mid_idx = low_idx + (high_idx - low_idx) / 2;
+
+        if (bible_search_occurrence_before(&occurrences[mid_idx], verse_idx, position)) {
+            low_idx = mid_idx + 1;
+        } else {
+            high_idx = mid_idx;
+        }
+    }
+
+    *cursor = low_idx;
+
+    return low_idx < occurrence_count
+           && occurrences[low_idx].verse_idx == verse_idx
+           && occurrences[low_idx].position == position;
+}
+
+static void bible_search_push_match(BibleSearchMatches *matches, u32 verse_idx) {
+    if (matches->len > 0 && matches->data[matches->len - 1].verse_idx == verse_idx) {
+        matches->data[matches->len - 1].count++;
+        return;
+    }
+
+    BibleSearchMatch match = {
+        verse_idx,
+        1,
+    };
+    ARRAY_PUSH(matches, &match);
+}
+
+static BibleSearchMatches bible_search_term_matches(const BibleSearchTerm *term) {
+    // A read-only view into the index, never pushed to
+    BibleSearchMatches matches = {
+        .data = g_bible_search_index.term_matches.data + term->match_offset,
+        .len = term->match_count,
+        .cap = term->match_count,
+    };
+
+    return matches;
+}
+
+static BibleSearchMatches bible_search_match_prefix(Arena *arena, const string_view *prefix) {
+    const BibleSearchTerms *terms = &g_bible_search_index.terms;
+
+    i64 first_term_idx = bible_search_term_lower_bound(prefix);
+    i64 end_term_idx = first_term_idx;
+
+    while (end_term_idx < terms->len
+           && terms->data[end_term_idx].text.len >= prefix->len
+           && memcmp(terms->data[end_term_idx].text.data, prefix->data, prefix->len) == 0) {
+        end_term_idx++;
+    }
+
+    if (end_term_idx - first_term_idx == 1) {
+        return bible_search_term_matches(&terms->data[first_term_idx]);
+    }
+
+    i64 match_capacity = 1;
+    for (i64 term_idx = first_term_idx; term_idx < end_term_idx; term_idx++) {
+        match_capacity += terms->data[term_idx].match_count;
+    }
+    if (match_capacity > g_bible_search_index.verses.len) {
+        match_capacity = g_bible_search_index.verses.len;
+    }
+
+    BibleSearchMatches matches = {arena, match_capacity > 0 ? match_capacity : 1};
+    ARRAY_MAKE(&matches);
+    matches.len = 0;
+
+    if (end_term_idx == first_term_idx) {
+        return matches;
+    }
+
+    // Several terms' runs interleave, a dense per-verse count merges them without sorting
+    BibleSearchCounts verse_counts = {arena, g_bible_search_index.verses.len};
+    ARRAY_MAKE(&verse_counts);
+    memset(verse_counts.data, 0, verse_counts.len * sizeof(u32));
+
+    for (i64 term_idx = first_term_idx; term_idx < end_term_idx; term_idx++) {
+        BibleSearchMatches term_matches = bible_search_term_matches(&terms->data[term_idx]);
+
+        ARRAY_FOR(term_match, &term_matches) {
+            verse_counts.data[term_match->verse_idx] += term_match->count;
+        }
+    }
+
+    for (i64 verse_idx = 0; verse_idx < verse_counts.len; verse_idx++) {
+        if (verse_counts.data[verse_idx] > 0) {
+            matches.data[matches.len++] = (BibleSearchMatch){
+                (u32) verse_idx,
+                (u32) verse_counts.data[verse_idx],
+            };
+        }
+    }
+
+    return matches;
+}
+
+static BibleSearchMatches bible_search_match_phrase(Arena *arena, const BibleSearchClause *clause) {
+    // Anchored on the rarest word, every other word is probed at its offset from it
+    i64 anchor_idx = 0;
+    for (i64 term_idx = 1; term_idx < clause->term_count; term_idx++) {
+        if (clause->terms[term_idx]->occurrence_count < clause->terms[anchor_idx]->occurrence_count) {
+            anchor_idx = term_idx;
+        }
+    }
+
+    const BibleSearchTerm *anchor = clause->terms[anchor_idx];
+    const BibleSearchOccurrence *occurrences = g_bible_search_index.occurrences.data + anchor->occurrence_offset;
+
+    BibleSearchMatches matches = {arena, anchor->match_count > 0 ? anchor->match_count : 1};
+    ARRAY_MAKE(&matches);
+    matches.len = 0;
+
+    // Anchor occurrences ascend, so every word's probes do too
+    i64 cursors[BIBLE_SEARCH_MAX_PHRASE_TERMS] = {};
+
+    for (u32 occurrence_idx = 0; occurrence_idx < anchor->occurrence_count; occurrence_idx++) {
+        const BibleSearchOccurrence *occurrence = &occurrences[occurrence_idx];
+        if (occurrence->position < anchor_idx) {
+            continue;
+        }
+
+        u32 phrase_position = occurrence->position - (u32) anchor_idx;
+        bool matched = true;
+
+        for (i64 term_idx = 0; term_idx < clause->term_count && matched; term_idx++) {
+            if (term_idx != anchor_idx) {
+                matched = bible_search_seek_occurrence(
+                    clause->terms[term_idx],
+                    &cursors[term_idx],
+                    occurrence->verse_idx,
+                    phrase_position + (u32) term_idx
+                );
+            }
+        }
+
+        if (matched) {
+            bible_search_push_match(&matches, occurrence->verse_idx);
+        }
+    }
+
+    return matches;
+}
+
+static i64 bible_search_seek_match(const BibleSearchMatches *matches, i64 *cursor, u32 verse_idx) {
+    i64 low_idx = *cursor;
+    i64 high_idx = low_idx;
+    i64 step = 1;
+
+    while (high_idx < matches->len && matches->data[high_idx].verse_idx < verse_idx) {
+        low_idx = high_idx + 1;
+        high_idx += step;
+        step <<= 1;
+    }
+
+    if (high_idx > matches->len) {
+        high_idx = matches->len;
+    }
+
+    while (low_idx < high_idx) {
+        i64 mid_idx = low_idx + (high_idx - low_idx) / 2;
+
+        if (matches->data[mid_idx].verse_idx < verse_idx) {
+            low_idx = mid_idx + 1;
+        } else {
+            high_idx = mid_idx;
+        }
+    }
+
+    *cursor = low_idx;
+
+    return low_idx < matches->len && matches->data[low_idx].verse_idx == verse_idx ? low_idx : -1;
+}
+
+static int bible_search_clause_qsort_cmp(const void *a, const void *b) {
+    i64 len_a = ((const BibleSearchClause *) a)->matches.len;
+    i64 len_b = ((const BibleSearchClause *) b)->matches.len;
+
+    return (len_a > len_b) - (len_a < len_b);
+}
+
+// Returns false when a word of the query isn't in the corpus, so nothing can match
+static bool bible_search_parse_clause(
+    const char *segment,
+    i64 segment_len,
+    bool quoted,
+    BibleSearchClause *out_clause
+) {
+    *out_clause = (BibleSearchClause){
+        .type = BIBLE_SEARCH_CLAUSE_TYPE_COUNT,
+    };
+
+    char term[BIBLE_SEARCH_TERM_MAX_LEN + 1];
+    i64 c_idx = 0;
+    i64 term_len = 0;
+
+    while (out_clause->term_count < BIBLE_SEARCH_MAX_PHRASE_TERMS
+           && (term_len = bible_search_next_term(segment, segment_len, &c_idx, term)) > 0) {
+        if (out_clause->term_count == 0) {
+            memcpy(out_clause->prefix, term, term_len + 1);
+            out_clause->prefix_len = term_len;
+        }
+
+        out_clause->terms[out_clause->term_count++] = bible_search_find_term(term, term_len);
+    }
+
+    if (out_clause->term_count == 0) {
+        return true;
+    }
+
+    if (!quoted && out_clause->term_count == 1 && segment[segment_len - 1] == '*') {
+        out_clause->type = BIBLE_SEARCH_CLAUSE_TYPE_PREFIX;
+        return true;
+    }
+
+    for (i64 term_idx = 0; term_idx < out_clause->term_count; term_idx++) {
+        if (!out_clause->terms[term_idx]) {
+            return false;
+        }
+    }
+
+    // A word that folds into several terms, e.g. "lord's", is matched as a phrase
+    out_clause->type = out_clause->term_count == 1
+                           ? BIBLE_SEARCH_CLAUSE_TYPE_WORD
+                           : BIBLE_SEARCH_CLAUSE_TYPE_PHRASE;
+
+    return true;
+}
+
+static void bible_search_push_hit(BibleSearchHits *hits, i32 max_hits, const BibleSearchHit *hit) {
+    if (hits->len == max_hits && hits->data[hits->len - 1].score >= hit->score) {
+        return;
+    }
+
+    if (hits->len < max_hits) {
+        hits->len++;
+    }
+
+    // Kept sorted best first, max_hits is small so insertion beats a heap
+    i64 hit_idx = hits->len - 1;
+    while (hit_idx > 0 && hits->data[hit_idx - 1].score < hit->score) {
+        hits->data[hit_idx] = hits->data[hit_idx - 1];
+        hit_idx--;
+    }
+
+    hits->data[hit_idx] = *hit;
+}
+
+BibleSearchHits bible_search(Arena *arena, const string *query, i32 max_hits) {
+    BibleSearchHits hits = {arena, max_hits > 0 ? max_hits : 1};
+    ARRAY_MAKE(&hits);
+    hits.len = 0;
+
+    const BibleSearchIndex *index = &g_bible_search_index;
+
+    if (!index->built || !query || max_hits <= 0) {
+        return hits;
+    }
+
+    BibleSearchClause clauses[BIBLE_SEARCH_MAX_CLAUSES];
+    i64 clause_count = 0;
+    i64 c_idx = 0;
+
+    while (c_idx < query->len && clause_count < BIBLE_SEARCH_MAX_CLAUSES) {
+        char c = query->data[c_idx];
+
+        if (c == ' ' || c == '\t') {
+            c_idx++;
+            continue;
+        }
+
+        bool quoted = c == '"';
+        if (quoted) {
+            c_idx++;
+        }
+
+        i64 segment_start_c_idx = c_idx;
+        while (c_idx < query->len
+               && query->data[c_idx] != '"'
+               && (quoted || (query->data[c_idx] != ' ' && query->data[c_idx] != '\t'))) {
+            c_idx++;
+        }
+
+        i64 segment_len = c_idx - segment_start_c_idx;
+
+        if (quoted && c_idx < query->len) {
+            c_idx++;
+        }
+
+        if (segment_len == 0) {
+            continue;
+        }
+
+        BibleSearchClause *clause = &clauses[clause_count];
+        if (!bible_search_parse_clause(query->data + segment_start_c_idx, segment_len, quoted, clause)) {
+            return hits;
+        }
+
+        if (clause->type != BIBLE_SEARCH_CLAUSE_TYPE_COUNT) {
+            clause_count++;
+        }
+    }
+
+    for (i64 clause_idx = 0; clause_idx < clause_count; clause_idx++) {
+        BibleSearchClause *clause = &clauses[clause_idx];
+
+        switch (clause->type) {
+            case BIBLE_SEARCH_CLAUSE_TYPE_WORD: {
+                clause->matches = bible_search_term_matches(clause->terms[0]);
+                break;
+            }
+            case BIBLE_SEARCH_CLAUSE_TYPE_PREFIX: {
+                string_view prefix = {
+                    clause->prefix,
+                    clause->prefix_len,
+                };
+                clause->matches = bible_search_match_prefix(arena, &prefix);
+                break;
+            }
+            case BIBLE_SEARCH_CLAUSE_TYPE_PHRASE: {
+                clause->matches = bible_search_match_phrase(arena, clause);
+                break;
+            }
+            default:
+                assert(0);
+                break;
+        }
+
+        if (clause->matches.len == 0) {
+            return hits;
+        }
+    }
+
+    if (clause_count == 0) {
+        return hits;
+    }
+
+    // The rarest clause drives the intersection, the rest are probed per verse
+    qsort(clauses, clause_count, sizeof(BibleSearchClause), bible_search_clause_qsort_cmp);
+
+    double verse_count = (double) index->verses.len;
+    double idfs[BIBLE_SEARCH_MAX_CLAUSES];
+    i64 match_cursors[BIBLE_SEARCH_MAX_CLAUSES] = {};
+
+    for (i64 clause_idx = 0; clause_idx < clause_count; clause_idx++) {
+        double doc_freq = (double) clauses[clause_idx].matches.len;
+        idfs[clause_idx] = log(1.0 + (verse_count - doc_freq + 0.5) / (doc_freq + 0.5));
+    }
+
+    ARRAY_FOR(driver_match, &clauses[0].matches) {
+        const BibleSearchVerse *verse = &index->verses.data[driver_match->verse_idx];
+
+        // BM25, shorter verses rank above longer ones with the same matches
+        double length_norm = kBibleSearchBm25K1 * (1.0 - kBibleSearchBm25B
+                                                   + kBibleSearchBm25B * verse->term_count / index->avg_verse_len);
+        double score = 0;
+        bool matched = true;
+
+        for (i64 clause_idx = 0; clause_idx < clause_count && matched; clause_idx++) {
+            u32 count = driver_match->count;
+
+            if (clause_idx > 0) {
+                i64 match_idx = bible_search_seek_match(
+                    &clauses[clause_idx].matches,
+                    &match_cursors[clause_idx],
+                    driver_match->verse_idx
+                );
+                matched = match_idx >= 0;
+                count = matched ? clauses[clause_idx].matches.data[match_idx].count : 0;
+            }
+
+            score += idfs[clause_idx] * count * (kBibleSearchBm25K1 + 1.0) / (count + length_norm);
+        }
+
+        if (matched) {
+            BibleSearchHit hit = {
+                .passage = {
+                    .book = verse->book,
+                    .ch_v = {
+                        .chapter = verse->chapter,
+                        .start_verse = verse->verse,
+                        .end_verse = verse->verse,
+                    },
+                },
+                .score = score,
+            };
+
+            bible_search_push_hit(&hits, max_hits, &hit);
+        }
+    }
+
+    return hits;
+}
@@ -0,0 +1,32 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_BIBLE_SEARCH_H
+#define ARTICLE_HTML_BIBLE_SEARCH_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+#include <altcore/arenas.h>
+
+#include "bible.h"
+
+typedef struct BIBLE_SEARCH_HIT_T {
+    BiblePassage passage;
+    double score;
+} BibleSearchHit;
+
+typedef struct BIBLE_SEARCH_HITS_T {
+    ARRAY_FIELDS(BibleSearchHit)
+} BibleSearchHits;
+
+// Builds the inverted index over the verses loaded by bible_init
+void bible_search_init();
+
+void bible_search_uninit();
+
+// Every query word must match. "Quoted words" match as a phrase and a
+// trailing * matches any word with that prefix. Hits are ranked best first.
+BibleSearchHits bible_search(Arena *arena, const string *query, i32 max_hits);
+
+#endif //ARTICLE_HTML_BIBLE_SEARCH_H
@@ -0,0 +1,774 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "bibliography.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <altcore/hashmap.h>
+
+#include "hash.h"
+#include "index_file.h"
+#include "trace.h"
+#include "altcore/defer.h"
+
+Bibliography g_bibliography = {};
+
+static const char *kBibliographyFieldStrs[] = {
+#ifndef X
+#define X(field, name) \
+    name,
+#endif
+    X_BIBLIOGRAPHY_FIELDS
+#undef X
+};
+
+// Entry types that hold no citation
+static const char *kBibliographySkippedTypes[] = {
+    "comment",
+    "preamble",
+};
+
+static const char *kBibliographyStringType = "string";
+
+// Macros every style defines, an @string of the same name overrides them
+static const char *kBibliographyMonthMacros[][2] = {
+    {"jan", "January"},
+    {"feb", "February"},
+    {"mar", "March"},
+    {"apr", "April"},
+    {"may", "May"},
+    {"jun", "June"},
+    {"jul", "July"},
+    {"aug", "August"},
+    {"sep", "September"},
+    {"oct", "October"},
+    {"nov", "November"},
+    {"dec", "December"},
+};
+
+// Longer bare words are never taken for a macro name
+#define BIBLIOGRAPHY_MACRO_NAME_MAX 64
+
+typedef struct BIBLIOGRAPHY_ENTRIES_T {
+    ARRAY_FIELDS(BibliographyEntry)
+} BibliographyEntries;
+
+typedef struct BIBLIOGRAPHY_SLOTS_T {
+    ARRAY_FIELDS(u32)
+} BibliographySlots;
+
+typedef struct BIBLIOGRAPHY_MACRO_VALUES_T {
+    ARRAY_FIELDS(BibliographyStr)
+} BibliographyMacroValues;
+
+// Lower-cased macro name to its index in the macro values
+typedef struct BIBLIOGRAPHY_MACROS_MAP_T {
+    HASHMAP_FIELDS(const char*, i64)
+} BibliographyMacrosMap;
+
+// Reads one .bib in a single pass, values are written straight into the pool.
+// Macros expand to more than their source takes, so a pool that runs out marks
+// the parser exhausted and the pass is retried with larger pools
+typedef struct BIBLIOGRAPHY_PARSER_T {
+    const char *bytes;
+    u64 len;
+    u64 pos;
+    string *strs;
+    // Names, NUL terminated as the map keys them, and values of the @strings
+    string *macro_strs;
+    BibliographyMacroValues *macro_values;
+    BibliographyMacrosMap *macros;
+    // Bytes each of strs and macro_strs may hold
+    i64 pool_capacity;
+    bool exhausted;
+} BibliographyParser;
+
+static string_view bibliography_str(const Bibliography *bib, BibliographyStr str) {
+    string_view view = {
+        bib->strs + str.offset,
+        str.len,
+    };
+
+    return view;
+}
+
+static bool bibliography_str_eq(const char *strs, BibliographyStr str, const string_view *view) {
+    return str.len == view->len && memcmp(strs + str.offset, view->data, view->len) == 0;
+}
+
+static bool bibliography_entry_valid(const BibliographyHeader *header, const BibliographyEntry *entry) {
+    bool valid = index_file_str_fits(header->strs_size, entry->key.offset, entry->key.len)
+                 && index_file_str_fits(header->strs_size, entry->type.offset, entry->type.len);
+
+    for (i32 field_idx = 0; valid && field_idx < BIBLIOGRAPHY_FIELD_COUNT; field_idx++) {
+        valid = index_file_str_fits(header->strs_size, entry->fields[field_idx].offset, entry->fields[field_idx].len);
+    }
+
+    return valid;
+}
+
+bool bibliography_open(Bibliography *bib, const char *cache_filepath) {
+    if (!bib || !cache_filepath) {
+        return false;
+    }
+
+    *bib = (Bibliography){};
+
+    IndexFileMapping mapping = {};
+    if (!index_file_map(cache_filepath, sizeof(BibliographyHeader), &mapping)) {
+        return false;
+    }
+
+    const BibliographyHeader *header = (const BibliographyHeader *) mapping.data;
+
+    bool valid = header->magic == BIBLIOGRAPHY_MAGIC
+                 && header->version == BIBLIOGRAPHY_VERSION
+                 && index_file_section_fits(&mapping, header->strs_offset, header->strs_size, 1, 1)
+                 && index_file_section_fits(
+                     &mapping,
+                     header->entries_offset,
+                     header->entry_count,
+                     sizeof(BibliographyEntry),
+                     alignof(BibliographyEntry)
+                 )
+                 && index_file_slots_valid(&mapping, header->slots_offset, header->slot_count, header->entry_count);
+
+    // Lookups trust the entries from here on, so every string has to lie in the pool
+    const BibliographyEntry *entries = (const BibliographyEntry *) (mapping.data + header->entries_offset);
+    const u32 *slots = (const u32 *) (mapping.data + header->slots_offset);
+
+    for (u32 entry_idx = 0; valid && entry_idx < header->entry_count; entry_idx++) {
+        valid = bibliography_entry_valid(header, &entries[entry_idx]);
+    }
+
+    if (!valid) {
+        index_file_unmap(&mapping);
+        return false;
+    }
+
+    bib->data = mapping.data;
+    bib->size = mapping.size;
+    bib->header = header;
+    bib->entries = entries;
+    bib->slots = slots;
+    bib->strs = (const char *) (bib->data + header->strs_offset);
+
+    return true;
+}
+
+void bibliography_close(Bibliography *bib) {
+    if (bib && bib->data) {
+        IndexFileMapping mapping = {bib->data, bib->size};
+        index_file_unmap(&mapping);
+        *bib = (Bibliography){};
+    }
+}
+
+bool bibliography_find(const Bibliography *bib, const string_view *key, BibliographyRecord *out_record) {
+    if (!bib || !bib->data || bib->header->slot_count == 0) {
+        return false;
+    }
+
+    u64 hash = hash_fnv1a(key->data, key->len, HASH_FNV1A_SEED);
+    IndexFileProbe probe = index_file_probe_begin(bib->slots, bib->header->slot_count, hash);
+
+    for (i64 entry_idx = index_file_probe_next(&probe); entry_idx >= 0; entry_idx = index_file_probe_next(&probe)) {
+        const BibliographyEntry *entry = &bib->entries[entry_idx];
+        if (entry->key_hash != hash || !bibliography_str_eq(bib->strs, entry->key, key)) {
+            continue;
+        }
+
+        if (out_record) {
+            out_record->key = bibliography_str(bib, entry->key);
+            out_record->type = bibliography_str(bib, entry->type);
+
+            for (i32 field_idx = 0; field_idx < BIBLIOGRAPHY_FIELD_COUNT; field_idx++) {
+                out_record->fields[field_idx] = bibliography_str(bib, entry->fields[field_idx]);
+            }
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+static void bibliography_skip_space(BibliographyParser *parser) {
+    while (parser->pos < parser->len && isspace((u8) parser->bytes[parser->pos])) {
+        parser->pos++;
+    }
+}
+
+static bool bibliography_name_char(char c) {
+    return isalnum((u8) c) || c == '_' || c == '-' || c == ':' || c == '.';
+}
+
+static string_view bibliography_read_name(BibliographyParser *parser) {
+    string_view name = {parser->bytes + parser->pos, 0};
+
+    while (parser->pos < parser->len && bibliography_name_char(parser->bytes[parser->pos])) {
+        parser->pos++;
+        name.len++;
+    }
+
+    return name;
+}
+
+// Appends bytes to one of the parser's pools, or marks the parser exhausted
+// when they don't fit
+static bool bibliography_pool_append(BibliographyParser *parser, string *pool, const char *data, i64 len) {
+    if (pool->len + len > parser->pool_capacity) {
+        parser->exhausted = true;
+        return false;
+    }
+
+    memcpy(pool->data + pool->len, data, len);
+    pool->len += len;
+
+    return true;
+}
+
+// Copies a view into the pool, lower-cased when asked
+static BibliographyStr bibliography_pool_view(BibliographyParser *parser, const string_view *view, bool lower) {
+    BibliographyStr str = {(u32) parser->strs->len, 0};
+
+    if (bibliography_pool_append(parser, parser->strs, view->data, view->len)) {
+        str.len = (u32) view->len;
+
+        for (i64 c_idx = 0; lower && c_idx < view->len; c_idx++) {
+            char *c = &parser->strs->data[str.offset + c_idx];
+            *c = (char) tolower((u8) *c);
+        }
+    }
+
+    return str;
+}
+
+// Appends one character of a value, whitespace is collapsed into single spaces
+// and dropped at the start of the value
+static void bibliography_value_char(
+    BibliographyParser *parser,
+    string *pool,
+    char c,
+    bool *inout_pending_space,
+    i64 value_start
+) {
+    if (isspace((u8) c)) {
+        *inout_pending_space = true;
+        return;
+    }
+
+    if (*inout_pending_space && pool->len > value_start) {
+        bibliography_pool_append(parser, pool, " ", 1);
+    }
+    *inout_pending_space = false;
+
+    bibliography_pool_append(parser, pool, &c, 1);
+}
+
+// Appends the text of a delimited value piece, braces dropped. Stops after the
+// piece's closing delimiter
+static void bibliography_read_piece(
+    BibliographyParser *parser,
+    string *pool,
+    char close_c,
+    bool *inout_pending_space,
+    i64 value_start
+) {
+    i64 depth = 0;
+
+    while (parser->pos < parser->len) {
+        char c = parser->bytes[parser->pos++];
+
+        if (depth == 0 && c == close_c) {
+            return;
+        }
+
+        if (c == '{') {
+            depth++;
+            continue;
+        }
+        if (c == '}') {
+            depth--;
+            continue;
+        }
+
+        bibliography_value_char(parser, pool, c, inout_pending_space, value_start);
+    }
+}
+
+// The value of a macro named by a bare word, nullptr when it names none
+static const char *bibliography_macro_value(BibliographyParser *parser, const string_view *name, i64 *out_len) {
+    if (name->len >= BIBLIOGRAPHY_MACRO_NAME_MAX) {
+        return nullptr;
+    }
+
+    char lower_name[BIBLIOGRAPHY_MACRO_NAME_MAX];
+    for (i64 c_idx = 0; c_idx < name->len; c_idx++) {
+        lower_name[c_idx] = (char) tolower((u8) name->data[c_idx]);
+    }
+    lower_name[name->len] = '\0';
+
+    const char *lower_name_ptr = lower_name;
+    i64 macro_idx = HASHMAP_GET_VAL(parser->macros, &lower_name_ptr);
+    if (macro_idx >= 0) {
+        const BibliographyStr *value = ARRAY_ELEM(parser->macro_values, &macro_idx);
+        *out_len = value->len;
+        return parser->macro_strs->data + value->offset;
+    }
+
+    for (i64 month_idx = 0; month_idx < STATIC_ARRAY_LEN(kBibliographyMonthMacros); month_idx++) {
+        if (strcmp(kBibliographyMonthMacros[month_idx][0], lower_name) == 0) {
+            *out_len = (i64) strlen(kBibliographyMonthMacros[month_idx][1]);
+            return kBibliographyMonthMacros[month_idx][1];
+        }
+    }
+
+    return nullptr;
+}
+
+// A number stands for itself, any other bare word for the macro it names.
+// Like bibtex, an undefined macro expands to nothing
+static void bibliography_read_word(
+    BibliographyParser *parser,
+    string *pool,
+    bool *inout_pending_space,
+    i64 value_start
+) {
+    string_view word = {parser->bytes + parser->pos, 0};
+    bool number = true;
+
+    while (parser->pos < parser->len) {
+        char c = parser->bytes[parser->pos];
+        if (c == ',' || c == '{' || c == '}' || c == '(' || c == ')' || c == '#' || c == '"' || isspace((u8) c)) {
+            break;
+        }
+
+        number = number && isdigit((u8) c);
+        parser->pos++;
+        word.len++;
+    }
+
+    const char *text = word.data;
+    i64 text_len = word.len;
+
+    if (!number) {
+        text = bibliography_macro_value(parser, &word, &text_len);
+    }
+
+    for (i64 c_idx = 0; text && c_idx < text_len; c_idx++) {
+        bibliography_value_char(parser, pool, text[c_idx], inout_pending_space, value_start);
+    }
+}
+
+// "{...}", "\"...\"" or a bare word, joined by '#'. A macro keeps a trailing
+// space for the piece it is joined to
+static BibliographyStr bibliography_read_value(BibliographyParser *parser, string *pool, bool keep_trailing_space) {
+    i64 value_start = pool->len;
+    bool pending_space = false;
+
+    while (parser->pos < parser->len) {
+        bibliography_skip_space(parser);
+        if (parser->pos >= parser->len) {
+            break;
+        }
+
+        char c = parser->bytes[parser->pos];
+
+        if (c == '{') {
+            parser->pos++;
+            bibliography_read_piece(parser, pool, '}', &pending_space, value_start);
+        } else if (c == '"') {
+            parser->pos++;
+            bibliography_read_piece(parser, pool, '"', &pending_space, value_start);
+        } else {
+            bibliography_read_word(parser, pool, &pending_space, value_start);
+        }
+
+        bibliography_skip_space(parser);
+        if (parser->pos >= parser->len || parser->bytes[parser->pos] != '#') {
+            break;
+        }
+        parser->pos++;
+    }
+
+    if (keep_trailing_space && pending_space && pool->len > value_start) {
+        bibliography_pool_append(parser, pool, " ", 1);
+    }
+
+    BibliographyStr str = {(u32) value_start, (u32) (pool->len - value_start)};
+
+    return str;
+}
+
+static void bibliography_skip_group(BibliographyParser *parser, char close_c) {
+    i64 depth = 0;
+
+    while (parser->pos < parser->len) {
+        char c = parser->bytes[parser->pos++];
+
+        if (c == '{') {
+            depth++;
+        } else if (c == '}' && depth > 0) {
+            depth--;
+        } else if (c == close_c && depth == 0) {
+            return;
+        }
+    }
+}
+
+// Defines the macro of an @string, values of later entries expand it
+static void bibliography_read_macro(BibliographyParser *parser, char close_c) {
+    bibliography_skip_space(parser);
+    string_view name = bibliography_read_name(parser);
+    bibliography_skip_space(parser);
+
+    if (name.len == 0 || parser->pos >= parser->len || parser->bytes[parser->pos] != '=') {
+        bibliography_skip_group(parser, close_c);
+        return;
+    }
+    parser->pos++;
+
+    string *macro_strs = parser->macro_strs;
+
+    // The map keys the NUL terminated name where it sits in the pool
+    i64 name_start = macro_strs->len;
+    if (!bibliography_pool_append(parser, macro_strs, name.data, name.len)
+        || !bibliography_pool_append(parser, macro_strs, "", 1)) {
+        return;
+    }
+
+    char *lower_name = macro_strs->data + name_start;
+    for (i64 c_idx = 0; c_idx < name.len; c_idx++) {
+        lower_name[c_idx] = (char) tolower((u8) lower_name[c_idx]);
+    }
+
+    BibliographyStr value = bibliography_read_value(parser, macro_strs, true);
+    if (parser->exhausted) {
+        return;
+    }
+
+    i64 macro_idx = parser->macro_values->len;
+    ARRAY_PUSH(parser->macro_values, &value);
+
+    const char *key = lower_name;
+    HASHMAP_PUT(parser->macros, &key, &macro_idx);
+
+    bibliography_skip_group(parser, close_c);
+}
+
+// Parses the entry after an '@', false when it holds no citation. A malformed
+// entry is abandoned where it goes wrong and the scan resumes at the next '@'
+static bool bibliography_read_entry(BibliographyParser *parser, BibliographyEntry *out_entry) {
+    string_view type = bibliography_read_name(parser);
+    bibliography_skip_space(parser);
+
+    if (type.len == 0 || parser->pos >= parser->len) {
+        return false;
+    }
+
+    char open_c = parser->bytes[parser->pos];
+    if (open_c != '{' && open_c != '(') {
+        return false;
+    }
+    char close_c = open_c == '{' ? '}' : ')';
+    parser->pos++;
+
+    if ((i64) strlen(kBibliographyStringType) == type.len
+        && strncasecmp(kBibliographyStringType, type.data, type.len) == 0) {
+        bibliography_read_macro(parser, close_c);
+        return false;
+    }
+
+    for (i64 skipped_idx = 0; skipped_idx < STATIC_ARRAY_LEN(kBibliographySkippedTypes); skipped_idx++) {
+        const char *skipped_type = kBibliographySkippedTypes[skipped_idx];
+
+        if ((i64) strlen(skipped_type) == type.len && strncasecmp(skipped_type, type.data, type.len) == 0) {
+            bibliography_skip_group(parser, close_c);
+            return false;
+        }
+    }
+
+    bibliography_skip_space(parser);
+
+    string_view key = {parser->bytes + parser->pos, 0};
+    while (parser->pos < parser->len) {
+        char c = parser->bytes[parser->pos];
+        if (c == ',' || c == close_c || isspace((u8) c)) {
+            break;
+        }
+        parser->pos++;
+        key.len++;
+    }
+
+    if (key.len == 0) {
+        return false;
+    }
+
+    *out_entry = (BibliographyEntry){
+        .key_hash = hash_fnv1a(key.data, key.len, HASH_FNV1A_SEED),
+    };
+    out_entry->key = bibliography_pool_view(parser, &key, false);
+    out_entry->type = bibliography_pool_view(parser, &type, true);
+
+    while (parser->pos < parser->len) {
+        bibliography_skip_space(parser);
+
+        if (parser->pos < parser->len && parser->bytes[parser->pos] == ',') {
+            parser->pos++;
+            bibliography_skip_space(parser);
+        }
+
+        if (parser->pos >= parser->len) {
+            break;
+        }
+
+        if (parser->bytes[parser->pos] == close_c) {
+            parser->pos++;
+            return true;
+        }
+
+        string_view field_name = bibliography_read_name(parser);
+        bibliography_skip_space(parser);
+
+        if (field_name.len == 0 || parser->pos >= parser->len || parser->bytes[parser->pos] != '=') {
+            break;
+        }
+        parser->pos++;
+
+        i64 value_start = parser->strs->len;
+        BibliographyStr value = bibliography_read_value(parser, parser->strs, false);
+
+        bool kept = false;
+
+        for (i32 field_idx = 0; field_idx < BIBLIOGRAPHY_FIELD_COUNT; field_idx++) {
+            const char *field_str = kBibliographyFieldStrs[field_idx];
+
+            if ((i64) strlen(field_str) == field_name.len
+                && strncasecmp(field_str, field_name.data, field_name.len) == 0) {
+                out_entry->fields[field_idx] = value;
+                kept = true;
+                break;
+            }
+        }
+
+        if (!kept) {
+            // Fields nothing renders give their pool bytes back
+            parser->strs->len = value_start;
+        }
+    }
+
+    // Truncated, what was read so far is still worth citing
+    return true;
+}
+
+// One pass over the .bib with pools of pool_capacity bytes, written only when
+// they held everything
+static bool bibliography_compile_pass(
+    const char *bib_bytes,
+    u64 bib_len,
+    u64 at_count,
+    i64 pool_capacity,
+    const char *cache_filepath,
+    bool *out_exhausted
+) {
+    u32 slot_count = 16;
+    while (slot_count < 2 * at_count) {
+        slot_count <<= 1;
+    }
+
+    Arena arena = arena_make(
+        2 * pool_capacity
+        + (i64) ((at_count + 1) * (sizeof(BibliographyEntry) + sizeof(BibliographyStr)) + slot_count * sizeof(u32))
+        + 1024
+    );
+
+    BibliographyMacrosMap macros = {HASHMAP_TYPE_STR_KEY};
+    i64 default_macro_idx = -1;
+    HASHMAP_MAKE(&macros, &default_macro_idx);
+
+    bool written = false;
+
+    DEFER(arena_free(&arena)) {
+        string strs = {&arena, pool_capacity};
+        ARRAY_MAKE(&strs);
+        strs.len = 0;
+
+        string macro_strs = {&arena, pool_capacity};
+        ARRAY_MAKE(&macro_strs);
+        macro_strs.len = 0;
+
+        BibliographyMacroValues macro_values = {&arena, (i64) at_count + 1};
+        ARRAY_MAKE(&macro_values);
+        macro_values.len = 0;
+
+        BibliographyEntries entries = {&arena, (i64) at_count + 1};
+        ARRAY_MAKE(&entries);
+        entries.len = 0;
+
+        BibliographySlots slots = {&arena, slot_count};
+        ARRAY_MAKE(&slots);
+        memset(slots.data, 0, slot_count * sizeof(u32));
+
+        BibliographyParser parser = {
+            .bytes = bib_bytes,
+            .len = bib_len,
+            .strs = &strs,
+            .macro_strs = &macro_strs,
+            .macro_values = &macro_values,
+            .macros = &macros,
+            .pool_capacity = pool_capacity,
+        };
+
+        while (parser.pos < parser.len && !parser.exhausted) {
+            const char *at = memchr(parser.bytes + parser.pos, '@', parser.len - parser.pos);
+            if (!at) {
+                break;
+            }
+            parser.pos = at - parser.bytes + 1;
+
+            i64 entry_strs_start = strs.len;
+            BibliographyEntry entry = {};
+
+            if (!bibliography_read_entry(&parser, &entry)) {
+                strs.len = entry_strs_start;
+                continue;
+            }
+
+            string_view key = {strs.data + entry.key.offset, entry.key.len};
+
+            u32 slot_idx = (u32) entry.key_hash & (slot_count - 1);
+            bool duplicate = false;
+
+            while (slots.data[slot_idx] != 0) {
+                const BibliographyEntry *slot_entry = &entries.data[slots.data[slot_idx] - 1];
+
+                if (slot_entry->key_hash == entry.key_hash && bibliography_str_eq(strs.data, slot_entry->key, &key)) {
+                    duplicate = true;
+                    break;
+                }
+
+                slot_idx = (slot_idx + 1) & (slot_count - 1);
+            }
+
+            if (duplicate) {
+                // Like bibtex, the first definition of a key wins
+                strs.len = entry_strs_start;
+                continue;
+            }
+
+            ARRAY_PUSH(&entries, &entry);
+            slots.data[slot_idx] = (u32) entries.len;
+        }
+
+        *out_exhausted = parser.exhausted;
+
+        if (!parser.exhausted) {
+            BibliographyHeader header = {
+                .magic = BIBLIOGRAPHY_MAGIC,
+                .version = BIBLIOGRAPHY_VERSION,
+                .entry_count = (u32) entries.len,
+                .slot_count = slot_count,
+                .source_hash = hash_fnv1a(bib_bytes, bib_len, HASH_FNV1A_SEED),
+                .source_size = bib_len,
+            };
+
+            header.entries_offset = sizeof(BibliographyHeader);
+            header.slots_offset = header.entries_offset + entries.len * sizeof(BibliographyEntry);
+            header.strs_offset = header.slots_offset + slot_count * sizeof(u32);
+            header.strs_size = strs.len;
+
+            IndexFileSection sections[] = {
+                {&header, sizeof(header)},
+                {entries.data, entries.len * sizeof(BibliographyEntry)},
+                {slots.data, slot_count * sizeof(u32)},
+                {strs.data, strs.len},
+            };
+
+            written = index_file_write(cache_filepath, sections, STATIC_ARRAY_LEN(sections));
+        }
+    }
+
+    HASHMAP_FREE(&macros);
+
+    return written;
+}
+
+bool bibliography_compile(const char *bib_bytes, u64 bib_len, const char *cache_filepath) {
+    if (!bib_bytes || !cache_filepath) {
+        return false;
+    }
+
+    TRACE_BEGIN("bibliography_compile", cache_filepath, (i64) bib_len);
+
+    // Every entry starts at an '@', so their count bounds the entry table
+    u64 at_count = 0;
+    for (u64 c_idx = 0; c_idx < bib_len; c_idx++) {
+        at_count += bib_bytes[c_idx] == '@';
+    }
+
+    // Without macros nothing is longer than the text it came from. Each
+    // expansion that overruns the pools doubles them, up to what a u32 offset reaches
+    bool written = false;
+    bool exhausted = true;
+
+    for (i64 pool_capacity = (i64) bib_len + 1; exhausted && pool_capacity <= UINT32_MAX; pool_capacity *= 2) {
+        written = bibliography_compile_pass(bib_bytes, bib_len, at_count, pool_capacity, cache_filepath, &exhausted);
+    }
+
+    TRACE_END("bibliography_compile", -1);
+
+    return written;
+}
+
+bool bibliography_load(Bibliography *bib, const char *bib_filepath, const char *cache_filepath) {
+    if (!bib || !bib_filepath || !cache_filepath) {
+        return false;
+    }
+
+    FILE *fp = fopen(bib_filepath, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    char *bib_bytes = nullptr;
+    u64 bib_len = 0;
+
+    int err = 0;
+    DEFER(err = fclose(fp), assert(!err), fp = nullptr) {
+        err = fseek(fp, 0, SEEK_END);
+        assert(!err);
+
+        long file_size = ftell(fp);
+        rewind(fp);
+
+        bib_bytes = malloc(file_size + 1);
+        assert(bib_bytes);
+
+        bib_len = fread(bib_bytes, sizeof(char), file_size, fp);
+        bib_bytes[bib_len] = '\0';
+    }
+
+    u64 bib_hash = hash_fnv1a(bib_bytes, bib_len, HASH_FNV1A_SEED);
+
+    bool loaded = bibliography_open(bib, cache_filepath)
+                  && bib->header->source_hash == bib_hash
+                  && bib->header->source_size == bib_len;
+
+    if (!loaded) {
+        bibliography_close(bib);
+
+        loaded = bibliography_compile(bib_bytes, bib_len, cache_filepath)
+                 && bibliography_open(bib, cache_filepath);
+    }
+
+    free(bib_bytes);
+
+    return loaded;
+}
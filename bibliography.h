@@ -0,0 +1,104 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_BIBLIOGRAPHY_H
+#define ARTICLE_HTML_BIBLIOGRAPHY_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+
+#define BIBLIOGRAPHY_MAGIC 0x42494241u // "ABIB"
+#define BIBLIOGRAPHY_VERSION 2u
+
+typedef enum BIBLIOGRAPHY_FIELD_E : i32 {
+#ifndef X_BIBLIOGRAPHY_FIELDS
+#define X_BIBLIOGRAPHY_FIELDS \
+    X(AUTHOR, "author") \
+    X(EDITOR, "editor") \
+    X(TITLE, "title") \
+    X(YEAR, "year") \
+    X(JOURNAL, "journal") \
+    X(BOOKTITLE, "booktitle") \
+    X(PUBLISHER, "publisher") \
+    X(VOLUME, "volume") \
+    X(PAGES, "pages") \
+    X(DOI, "doi") \
+    X(URL, "url")
+#endif
+#ifndef X
+#define X(field, name) \
+    BIBLIOGRAPHY_FIELD_##field,
+#endif
+    X_BIBLIOGRAPHY_FIELDS
+#undef X
+    BIBLIOGRAPHY_FIELD_COUNT
+} BibliographyField;
+
+// On-disk layout: header, entries in .bib order, an open addressed slot table
+// of entry_idx + 1 (0 is empty) keyed by citation key, then the string pool.
+// The cache is rebuilt whenever the hash of the .bib it came from changes
+typedef struct BIBLIOGRAPHY_HEADER_T {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 slot_count;
+    u64 source_hash;
+    u64 source_size;
+    u64 entries_offset;
+    u64 slots_offset;
+    u64 strs_offset;
+    u64 strs_size;
+} BibliographyHeader;
+
+typedef struct BIBLIOGRAPHY_STR_T {
+    u32 offset, len;
+} BibliographyStr;
+
+typedef struct BIBLIOGRAPHY_ENTRY_T {
+    u64 key_hash;
+    BibliographyStr key;
+    // Lower-cased entry type, e.g. "article"
+    BibliographyStr type;
+    BibliographyStr fields[BIBLIOGRAPHY_FIELD_COUNT];
+} BibliographyEntry;
+
+// Read-only once loaded, render threads share it without locking
+typedef struct BIBLIOGRAPHY_T {
+    const u8 *data;
+    u64 size;
+    const BibliographyHeader *header;
+    const BibliographyEntry *entries;
+    const u32 *slots;
+    const char *strs;
+} Bibliography;
+
+// Views into the mapped cache, missing fields are empty
+typedef struct BIBLIOGRAPHY_RECORD_T {
+    string_view key;
+    string_view type;
+    string_view fields[BIBLIOGRAPHY_FIELD_COUNT];
+} BibliographyRecord;
+
+extern Bibliography g_bibliography;
+
+// Maps the cache when it was compiled from a .bib with this hash and size,
+// otherwise parses the .bib, rewrites the cache and maps that
+bool bibliography_load(Bibliography *bib, const char *bib_filepath, const char *cache_filepath);
+
+bool bibliography_open(Bibliography *bib, const char *cache_filepath);
+
+void bibliography_close(Bibliography *bib);
+
+bool bibliography_find(const Bibliography *bib, const string_view *key, BibliographyRecord *out_record);
+
+// Entry types, field values and keys of a .bib, @preamble and @comment are
+// skipped. Values expand the @string macros and months they name and join
+// their '#' pieces, braces are dropped and whitespace collapsed
+bool bibliography_compile(
+    const char *bib_bytes,
+    u64 bib_len,
+    const char *cache_filepath
+);
+
+#endif //ARTICLE_HTML_BIBLIOGRAPHY_H
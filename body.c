@@ -5,9 +5,24 @@
 #include "body.h"
 
 #include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "bible.h"
+#include "bibliography.h"
+#include "escape.h"
+#include "hash.h"
+#include "label_index.h"
+#include "search_index.h"
+#include "trace.h"
 #include "altcore/defer.h"
 
+// Deeper headings are listed beside the deepest open list
+#define BODY_TOC_MAX_DEPTH 6
+// A ref to an article with a longer page path stays unresolved
+#define BODY_LABEL_REF_PAGE_PATH_MAX 4096
+
 typedef struct METABLOCK_RANGE_T {
     i64 start_c_idx, end_c_idx;
 } MetablockRange;
@@ -26,8 +41,10 @@ typedef enum ARTICLE_TOKEN_TYPE_E {
     X(UNORDERED_LIST) \
     X(ORDERED_LIST) \
     X(LABEL) \
+    X(LABEL_REF) \
     X(BIBLE_BLOCK) \
     X(BIBLE_HOVER) \
+    X(CITE) \
     X(COUNT)
 #endif
 
@@ -62,15 +79,28 @@ typedef struct LABEL_TOKEN_DATA_T {
     i64 ref_count;
 } LabelTokenData;
 
+typedef struct LABEL_REF_TOKEN_DATA_T {
+    string name;
+    i64 end_c_idx;
+} LabelRefTokenData;
+
 typedef struct BIBLE_BLOCK_TOKEN_DATA_T {
     BiblePassages passages;
+    i32 translation_idx;
 } BibleBlockTokenData;
 
 typedef struct BIBLE_HOWEVER_TOKEN_DATA_T {
     BiblePassages passages;
+    i32 translation_idx;
     i64 end_c_idx;
 } BibleHoverTokenData;
 
+typedef struct CITE_TOKEN_DATA_T {
+    // Comma separated citation keys, as written
+    string keys;
+    i64 end_c_idx;
+} CiteTokenData;
+
 typedef enum TOKEN_PAREN_E {
 #ifndef X_TOKEN_PARENS
 #define X_TOKEN_PARENS \
@@ -99,8 +129,10 @@ typedef struct ARTICLE_TOKEN_T {
         ItalicTextTokenData it_text;
         BoldTextTokenData bold_text;
         LabelTokenData label;
+        LabelRefTokenData label_ref;
         BibleBlockTokenData bible_block;
         BibleHoverTokenData bible_hover;
+        CiteTokenData cite;
     } data;
 } ArticleToken;
 
@@ -112,12 +144,32 @@ typedef struct LABELS_MAP_T {
     HASHMAP_FIELDS(const char*, bool)
 } LabelsMap;
 
+typedef struct LABEL_TARGETS_MAP_T {
+    HASHMAP_FIELDS(const char*, i64)
+} LabelTargetsMap;
+
+typedef struct LABEL_REF_PATCH_T {
+    i64 out_offset;
+    string name;
+} LabelRefPatch;
+
+typedef struct LABEL_REF_PATCHES_T {
+    ARRAY_FIELDS(LabelRefPatch)
+} LabelRefPatches;
+
+// Entries in the order the article first cites them, numbered from 1
+typedef struct CITED_RECORDS_T {
+    ARRAY_FIELDS(BibliographyRecord)
+} CitedRecords;
+
 
 typedef enum METABLOCK_KEY_E : i32 {
 #ifndef X_METABLOCK_KEYS
 #define X_METABLOCK_KEYS \
     X(LABEL) \
     X(BIBLE) \
+    X(REF) \
+    X(CITE) \
     X(COUNT)
 #endif
 #ifndef X
@@ -140,38 +192,60 @@ static const char *kMetablockKeyStrs[] = {
 static const char *kMetablockStartDelimiter = "{{";
 static const char *kMetablockEndDelimiter = "}}";
 static const char *kMetablockLabelKey = "label";
-
-static MetablockRange metablock_find_range(Arena *arena, const string_view *str_view) {
+static const char kLabelRefArticleSeparator = '#';
+static const i64 kCompressorFlushThreshold = 16 * 1024;
+static const i64 kMetablockMaxLen = 1024;
+// Id of a heading with nothing to slug
+static const char *kTocEmptySlug = "section";
+// Headroom estimates, generous next to what big.xmd needs. Text can grow six
+// times when escaped and again as terms, a growing array or string may move
+// to twice its size while the old copy stays in the arena
+static const i64 kBodyArenaReserve = 64 * 1024;
+static const i64 kBodyTextBytesPerChar = 16;
+static const i64 kBodyEmitBytesPerChar = 8;
+static const i64 kBodyEmitPassageBytes = 512;
+// The tags and separators body_reference_append puts around a record's fields,
+// and the list around the records
+static const i64 kBodyReferenceMarkupBytes = 256;
+// A string grown by doubling to n bytes has at most 2n in its last copy and
+// less than 2n in the copies it left behind
+static const i64 kBodyStringGrowthBytesPerByte = 4;
+
+// The metablock has to open at the start of the view. Nothing is copied and the
+// closing delimiter is only looked for up to the next opening delimiter, at
+// most kMetablockMaxLen bytes ahead, so a line full of braces is scanned in
+// linear time.
+static MetablockRange metablock_find_range(const string_view *str_view) {
     MetablockRange range = {-1, -1};
 
-    const i64 arena_start_offset = arena->offset;
-
-    string str = str_view_make(arena, str_view);
+    i64 start_delim_len = (i64) strlen(kMetablockStartDelimiter);
+    i64 end_delim_len = (i64) strlen(kMetablockEndDelimiter);
 
-    u64 delim_total_len = strlen(kMetablockStartDelimiter) + strlen(kMetablockEndDelimiter);
-
-    if (str.len <= delim_total_len) {
+    if (str_view->len <= start_delim_len + end_delim_len) {
         // Empty metablock
         return range;
     }
 
-    const char *metablock_start = strstr(str.data, kMetablockStartDelimiter);
-    if (!metablock_start) {
+    if (memcmp(str_view->data, kMetablockStartDelimiter, start_delim_len) != 0) {
         return range;
     }
 
-    range.start_c_idx = metablock_start - str.data;
-
-    const char *metablock_content_start = metablock_start + strlen(kMetablockStartDelimiter);
+    range.start_c_idx = 0;
 
-    const char *metablock_end = strstr(metablock_content_start, kMetablockEndDelimiter);
+    i64 scan_end_idx = str_view->len < kMetablockMaxLen ? str_view->len : kMetablockMaxLen;
 
-    if (metablock_end) {
-        range.end_c_idx = metablock_end - str.data;
+    for (i64 c_idx = start_delim_len; c_idx + end_delim_len <= scan_end_idx; c_idx++) {
+        if (memcmp(str_view->data + c_idx, kMetablockEndDelimiter, end_delim_len) == 0) {
+            range.end_c_idx = c_idx;
+            break;
+        }
+        if (c_idx + start_delim_len <= scan_end_idx
+            && memcmp(str_view->data + c_idx, kMetablockStartDelimiter, start_delim_len) == 0) {
+            // Metablocks don't nest, the opener is left as text
+            break;
+        }
     }
 
-    arena->offset = arena_start_offset;
-
     return range;
 }
 
@@ -218,6 +292,9 @@ static bool label_get_metablock(
         return false;
     }
 
+    bool new_label = true;
+    HASHMAP_PUT(in_labels_map, &terms.data[1].data, &new_label);
+
     out_label_tk->name = terms.data[1];
 
     return true;
@@ -311,12 +388,29 @@ typedef struct METABLOCK_DATA_T {
     strings val_strs;
 } MetablockData;
 
+// Keys are written in lower case and matched as a prefix of the first word
+static bool metablock_key_matches(const string_view *content_view, const char *key_str) {
+    i64 key_len = (i64) strlen(key_str);
+    if (content_view->len < key_len) {
+        return false;
+    }
+
+    for (i64 c_idx = 0; c_idx < key_len; c_idx++) {
+        if (content_view->data[c_idx] != tolower((u8) key_str[c_idx])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 static MetablockData metablock_get_data(Arena *arena, const string_view *line_view) {
     MetablockData metablock_data = {
-        METABLOCK_KEY_COUNT
+        .range = {-1, -1},
+        .key = METABLOCK_KEY_COUNT,
     };
 
-    metablock_data.range = metablock_find_range(arena, line_view);
+    metablock_data.range = metablock_find_range(line_view);
 
     if (metablock_data.range.start_c_idx >= 0 && metablock_data.range.end_c_idx >= 0) {
         string_view metablock_view = {
@@ -327,20 +421,18 @@ static MetablockData metablock_get_data(Arena *arena, const string_view *line_vi
         str_view_advance(&metablock_view, (i64) strlen(kMetablockStartDelimiter));
         str_view_strip(&metablock_view);
 
-        str_view_strip(&metablock_view);
-        string metablock_content_str = str_view_make(arena, &metablock_view);
-        metablock_data.val_strs = str_split(arena, &metablock_content_str, " ");
-        const string *key_str = &metablock_data.val_strs.data[0];
-
         for (i32 key_idx = 0; key_idx < METABLOCK_KEY_COUNT; key_idx++) {
-            string current_key_str = str_make(arena, "%s", kMetablockKeyStrs[key_idx]);
-            str_to_lower(&current_key_str);
-
-            if (strncmp(key_str->data, current_key_str.data, current_key_str.len) == 0) {
+            if (metablock_key_matches(&metablock_view, kMetablockKeyStrs[key_idx])) {
                 metablock_data.key = key_idx;
                 break;
             }
         }
+
+        // Only a recognized metablock is copied out of the line
+        if (metablock_data.key != METABLOCK_KEY_COUNT) {
+            string metablock_content_str = str_view_make(arena, &metablock_view);
+            metablock_data.val_strs = str_split(arena, &metablock_content_str, " ");
+        }
     }
 
     return metablock_data;
@@ -352,7 +444,7 @@ static string metablock_join_val_strs(Arena *arena, const strings *val_strs, i64
     string ref_str = str_make(arena, "");
 
     for (
-        i64 val_str_idx = 2;
+        i64 val_str_idx = start_idx;
         val_str_idx < val_strs->len;
         val_str_idx++
     ) {
@@ -366,504 +458,1207 @@ static string metablock_join_val_strs(Arena *arena, const strings *val_strs, i64
     return ref_str;
 }
 
-void body_to_html(
-    Arena *arena,
-    const MetadataMap *metadata,
-    const strings *file_lines,
-    i64 body_start_line_idx,
+// "{{bible <subkey> [translation] <refs>}}", returns where the refs start. A
+// first ref word naming a loaded translation overrides the article's.
+static i64 metablock_bible_refs_idx(const strings *val_strs, i32 *inout_translation_idx) {
+    if (val_strs->len >= 4) {
+        string_view name_view = {
+            val_strs->data[2].data,
+            val_strs->data[2].len,
+        };
+
+        i32 translation_idx = bible_find_translation(&name_view);
+        if (translation_idx >= 0) {
+            *inout_translation_idx = translation_idx;
+            return 3;
+        }
+    }
+
+    return 2;
+}
+
+static void label_ref_append_link(
+    ArticleTokens *tks,
+    i64 heading_tk_idx,
+    const string *name,
     string *out_html
 ) {
-    if (body_start_line_idx < 0 || body_start_line_idx >= file_lines->len) {
+    if (heading_tk_idx < 0) {
+        str_append(out_html, "<span class=\"label-ref-unresolved\">");
+        html_escape_append(out_html, name->data, name->len);
+        str_append(out_html, "</span>");
         return;
     }
 
-    ArticleTokens tks = {arena};
-    ARRAY_MAKE(&tks);
-
-    LabelsMap existing_labels = {HASHMAP_TYPE_STR_KEY};
-    bool default_label_val = false;
-    HASHMAP_MAKE(&existing_labels, &default_label_val);
-
-    i64 current_open_tk_idx = -1;
+    const ArticleToken *heading_tk = ARRAY_ELEM(tks, &heading_tk_idx);
+    assert(heading_tk->type == ARTICLE_TOKEN_TYPE_HEADING);
 
-    for (i64 line_idx = body_start_line_idx; line_idx < file_lines->len; line_idx++) {
-        const string *line = &file_lines->data[line_idx];
+    i64 label_tk_idx = heading_tk_idx + 1;
+    ArticleToken *label_tk = ARRAY_ELEM(tks, &label_tk_idx);
+    assert(label_tk->type == ARTICLE_TOKEN_TYPE_LABEL);
+    label_tk->data.label.ref_count++;
 
-        string_view line_view = {line->data, line->len};
+    const string *heading_text = &heading_tk->data.heading.text;
 
-        if (current_open_tk_idx < 0) {
-            str_view_strip(&line_view);
+    str_append(out_html, "<a class=\"label-ref\" href=\"#");
+    html_escape_append(out_html, name->data, name->len);
+    str_append(out_html, "\">");
+    html_escape_append(out_html, heading_text->data, heading_text->len);
+    str_append(out_html, "</a>");
+}
 
-            if (line_view.len > 0) {
-                switch (line_view.data[0]) {
-                    case '#': {
-                        // Heading
-                        ArticleTokenType heading_tk_type = ARTICLE_TOKEN_TYPE_HEADING;
-                        ArticleToken heading_open_tk = {
-                            TOKEN_PAREN_OPEN,
-                            heading_tk_type,
-                        };
+static void label_ref_append_external_link(const string *name, string *out_html) {
+    const char *separator = strchr(name->data, kLabelRefArticleSeparator);
+    assert(separator);
 
-                        i64 text_start_idx;
-                        for (text_start_idx = 0; text_start_idx < line_view.len; text_start_idx++) {
-                            if (line_view.data[text_start_idx] != '#') {
-                                break;
-                            }
-                        }
+    string_view article_path = {
+        name->data,
+        separator - name->data,
+    };
 
-                        if (text_start_idx >= line_view.len) {
-                            break;
-                        }
+    string_view label = {
+        separator + 1,
+        name->len - (article_path.len + 1),
+    };
 
-                        heading_open_tk.data.heading.level = (i32) text_start_idx;
+    // Refs name the article by its source path, the index by its page path
+    label_index_page_stem(&article_path);
+
+    char page_path[BODY_LABEL_REF_PAGE_PATH_MAX];
+    i32 page_path_len = snprintf(
+        page_path,
+        sizeof(page_path),
+        "%.*s%s",
+        (i32) article_path.len,
+        article_path.data,
+        LABEL_INDEX_PAGE_EXTENSION
+    );
+
+    string_view page_path_view = {
+        page_path,
+        page_path_len,
+    };
 
-                        bool label_present = false;
-                        LabelTokenData label_tk_data = {};
+    LabelIndexRecord record = {};
 
-                        if (line_view.data[text_start_idx] == kMetablockStartDelimiter[0]) {
-                            // label
-                            MetablockRange label_range = metablock_find_range(arena, &line_view);
-                            if (label_range.start_c_idx >= 0 && label_range.end_c_idx >= 0) {
-                                string_view metablock_view = {
-                                    line_view.data + label_range.start_c_idx,
-                                    label_range.end_c_idx - label_range.start_c_idx
-                                };
+    if (page_path_len < 0 || page_path_len >= (i32) sizeof(page_path)
+        || !label_index_find(&g_label_index, &page_path_view, &label, &record)) {
+        str_append(out_html, "<span class=\"label-ref-unresolved\">");
+        html_escape_append(out_html, name->data, name->len);
+        str_append(out_html, "</span>");
+        return;
+    }
 
-                                label_present = label_get_metablock(arena, &existing_labels, &metablock_view,
-                                                                    &label_tk_data);
-                                if (label_present) {
-                                    text_start_idx = (i32) (label_range.end_c_idx + strlen(kMetablockEndDelimiter));
-                                }
-                            }
-                        }
+    // The page path is relative to the site root, where the output directory is published
+    str_append(out_html, "<a class=\"label-ref\" href=\"/");
+    html_escape_append(out_html, record.article_path.data, record.article_path.len);
+    str_append(out_html, "#");
+    html_escape_append(out_html, record.label.data, record.label.len);
+    str_append(out_html, "\">");
+    html_escape_append(out_html, record.heading_text.data, record.heading_text.len);
+    str_append(out_html, "</a>");
+}
 
-                        str_view_advance(&line_view, text_start_idx);
-                        str_view_strip(&line_view);
-                        heading_open_tk.data.heading.text = str_view_make(arena, &line_view);
-                        ARRAY_PUSH(&tks, &heading_open_tk);
+static void label_refs_backpatch(
+    Arena *arena,
+    ArticleTokens *tks,
+    LabelTargetsMap *label_targets,
+    const LabelRefPatches *patches,
+    string *out_html
+) {
+    // Patch offsets are ascending, so the output is spliced in a single forward sweep
+    string patched_html = str_make(arena, "");
+    i64 copied_len = 0;
+
+    ARRAY_FOR(patch, patches) {
+        assert(patch->out_offset >= copied_len && patch->out_offset <= out_html->len);
+
+        str_append(
+            &patched_html,
+            "%.*s",
+            (i32) (patch->out_offset - copied_len),
+            out_html->data + copied_len
+        );
+        copied_len = patch->out_offset;
+
+        i64 heading_tk_idx = HASHMAP_GET_VAL(label_targets, &patch->name.data);
+        label_ref_append_link(tks, heading_tk_idx, &patch->name, &patched_html);
+    }
 
-                        if (label_present) {
-                            ArticleToken label_open_tk = {
-                                TOKEN_PAREN_OPEN,
-                                ARTICLE_TOKEN_TYPE_LABEL
-                            };
-                            label_open_tk.data.label = label_tk_data;
+    str_append(
+        &patched_html,
+        "%.*s",
+        (i32) (out_html->len - copied_len),
+        out_html->data + copied_len
+    );
 
-                            ARRAY_PUSH(&tks, &label_open_tk);
+    *out_html = patched_html;
+}
 
-                            ArticleToken label_close_tk = {
-                                TOKEN_PAREN_CLOSE,
-                                ARTICLE_TOKEN_TYPE_LABEL
-                            };
+void body_arena_charge(ArticleArenaStats *arena_stats, ArticleArenaSite site, const Arena *arena, i64 start_offset) {
+    if (!arena_stats) {
+        return;
+    }
 
-                            ARRAY_PUSH(&tks, &label_close_tk);
-                        }
+    if (arena->offset > start_offset) {
+        arena_stats->sites[site].bytes += arena->offset - start_offset;
+        arena_stats->sites[site].allocation_count++;
+    }
 
-                        ArticleToken heading_close_tk = {
-                            TOKEN_PAREN_CLOSE,
-                            heading_tk_type,
-                        };
+    if ((size_t) arena->offset > arena_stats->peak_bytes) {
+        arena_stats->peak_bytes = arena->offset;
+    }
+}
 
-                        ARRAY_PUSH(&tks, &heading_close_tk);
+static size_t body_arena_charged_bytes(const ArticleArenaStats *arena_stats) {
+    size_t charged_bytes = 0;
 
-                        break;
-                    }
-                    case '>': {
-                        // Blockquote
-                        break;
-                    }
-                    case '{': {
-                        // Metablock
-                        MetablockData metablock_data = metablock_get_data(arena, &line_view);
-
-                        switch (metablock_data.key) {
-                            case METABLOCK_KEY_BIBLE: {
-                                if (metablock_data.val_strs.len >= 3) {
-                                    const string *subkey_str = &metablock_data.val_strs.data[1];
-
-                                    switch (bible_get_subkey(subkey_str)) {
-                                        case BIBLE_SUBKEY_BLOCK: {
-                                            string verse_refs_str = metablock_join_val_strs(
-                                                arena,
-                                                &metablock_data.val_strs,
-                                                2
-                                            );
+    for (i32 site = 0; site < ARTICLE_ARENA_SITE_COUNT; site++) {
+        charged_bytes += arena_stats->sites[site].bytes;
+    }
 
-                                            BibleBlockTokenData block_data = {
-                                                .passages = bible_parse_ref(arena, &verse_refs_str),
-                                            };
+    return charged_bytes;
+}
 
-                                            ArticleToken open_tk = {
-                                                TOKEN_PAREN_OPEN,
-                                                ARTICLE_TOKEN_TYPE_BIBLE_BLOCK
-                                            };
+bool body_arena_has_room(const Arena *arena, BodyArenaLimit *arena_limit, i64 needed_bytes) {
+    if (!arena_limit) {
+        return true;
+    }
 
-                                            open_tk.data.bible_block = block_data;
+    if (!arena_limit->exhausted && arena_limit->capacity - arena->offset < needed_bytes + kBodyArenaReserve) {
+        arena_limit->exhausted = true;
+    }
 
-                                            ARRAY_PUSH(&tks, &open_tk);
+    return !arena_limit->exhausted;
+}
 
-                                            ArticleToken close_tk = {
-                                                TOKEN_PAREN_CLOSE,
-                                                ARTICLE_TOKEN_TYPE_BIBLE_BLOCK
-                                            };
+// Gives a stage's bytes that no finer-grained site claimed to the stage's own site
+static void body_arena_charge_rest(
+    ArticleArenaStats *arena_stats,
+    ArticleArenaSite site,
+    const Arena *arena,
+    i64 start_offset,
+    size_t start_charged_bytes
+) {
+    if (!arena_stats) {
+        return;
+    }
 
-                                            ARRAY_PUSH(&tks, &close_tk);
+    size_t stage_bytes = arena->offset > start_offset ? arena->offset - start_offset : 0;
+    size_t claimed_bytes = body_arena_charged_bytes(arena_stats) - start_charged_bytes;
 
-                                            break;
-                                        }
-                                        case BIBLE_SUBKEY_CITE:
-                                        case BIBLE_SUBKEY_HOVER: {
-                                            ArticleToken tk = {
-                                                TOKEN_PAREN_OPEN,
-                                                ARTICLE_TOKEN_TYPE_PARAGRAPH,
-                                            };
+    if (stage_bytes > claimed_bytes) {
+        arena_stats->sites[site].bytes += stage_bytes - claimed_bytes;
+    }
 
-                                            current_open_tk_idx = tks.len;
+    if ((size_t) arena->offset > arena_stats->peak_bytes) {
+        arena_stats->peak_bytes = arena->offset;
+    }
+}
 
-                                            ARRAY_PUSH(&tks, &tk);
+static void body_push_tk(ArticleTokens *tks, const ArticleToken *tk, ArticleArenaStats *arena_stats) {
+    const i64 arena_start_offset = tks->arena->offset;
 
-                                            line_idx--;
+    ARRAY_PUSH(tks, tk);
 
-                                            break;
-                                        }
-                                        default:
-                                            break;
-                                    }
-                                }
-                                break;
-                            }
-                            default:
-                                break;
-                        }
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_TOKENS, tks->arena, arena_start_offset);
+}
 
-                        break;
-                    }
-                    default: // Paragraph
-                    {
-                        ArticleToken p_open_tk = {
-                            TOKEN_PAREN_OPEN,
-                            ARTICLE_TOKEN_TYPE_PARAGRAPH
-                        };
+static void body_append_text_char(string *text, char c, ArticleArenaStats *arena_stats) {
+    const i64 arena_start_offset = text->arena->offset;
 
-                        current_open_tk_idx = tks.len;
+    str_append(text, "%c", c);
 
-                        ARRAY_PUSH(&tks, &p_open_tk);
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_TEXT, text->arena, arena_start_offset);
+}
 
-                        line_idx--;
+static BiblePassages body_parse_passages(Arena *arena, const string *ref, ArticleArenaStats *arena_stats) {
+    const i64 arena_start_offset = arena->offset;
 
-                        break;
-                    }
-                }
-            } else {
-                current_open_tk_idx = -1;
-            }
-        } else {
-            ArticleToken *current_open_tk = ARRAY_ELEM(&tks, &current_open_tk_idx);
+    BiblePassages passages = bible_parse_ref(arena, ref);
 
-            if (line->len > 0) {
-                switch (current_open_tk->type) {
-                    case ARTICLE_TOKEN_TYPE_PARAGRAPH: {
-                        ArticleToken reg_open_tk = {
-                            TOKEN_PAREN_OPEN,
-                            ARTICLE_TOKEN_TYPE_REGULAR_TEXT
-                        };
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_PASSAGES, arena, arena_start_offset);
 
-                        reg_open_tk.data.reg_text.start_c_idx = 0;
-                        reg_open_tk.data.reg_text.start_line_idx = line_idx;
-                        reg_open_tk.data.reg_text.text = str_make(arena, "");
+    return passages;
+}
 
-                        current_open_tk_idx = tks.len;
+static void body_push_terms(
+    Arena *arena,
+    const string *text,
+    ArticleTermField field,
+    BodyTerms *out_terms,
+    ArticleArenaStats *arena_stats
+) {
+    const i64 arena_start_offset = arena->offset;
 
-                        ARRAY_PUSH(&tks, &reg_open_tk);
+    i64 c_idx = 0;
 
-                        line_idx--;
+    while (c_idx < text->len) {
+        while (c_idx < text->len && !search_term_char(text->data[c_idx])) {
+            c_idx++;
+        }
 
-                        break;
-                    }
-                    case ARTICLE_TOKEN_TYPE_REGULAR_TEXT: {
-                        i64 start_char_idx = current_open_tk->data.reg_text.start_line_idx == line_idx
-                                                 ? current_open_tk->data.reg_text.start_c_idx
-                                                 : 0;
+        i64 term_start_c_idx = c_idx;
+        while (c_idx < text->len && search_term_char(text->data[c_idx])) {
+            c_idx++;
+        }
 
-                        for (i64 c_idx = start_char_idx; c_idx < line->len; c_idx++) {
-                            char c = line->data[c_idx];
+        i64 term_len = c_idx - term_start_c_idx;
+        if (term_len == 0 || term_len > SEARCH_TERM_MAX_LEN) {
+            continue;
+        }
 
-                            bool new_tk = false;
+        BodyTerm term = {
+            .text = str_make(arena, "%.*s", (i32) term_len, text->data + term_start_c_idx),
+            .field = field,
+        };
 
-                            ArticleToken open_tk = {
-                                TOKEN_PAREN_OPEN,
-                            };
+        for (i64 term_c_idx = 0; term_c_idx < term.text.len; term_c_idx++) {
+            char c = term.text.data[term_c_idx];
+            if (c >= 'A' && c <= 'Z') {
+                term.text.data[term_c_idx] = (char) (c - 'A' + 'a');
+            }
+        }
 
-                            switch (c) {
-                                case '*': {
-                                    bool is_italic = true;
-                                    if (c_idx < line->len - 1 && line->data[c_idx + 1] == '*') {
-                                        is_italic = false;
-                                    }
+        ARRAY_PUSH(out_terms, &term);
+    }
 
-                                    TextTokenData text_tk_data = {
-                                        .start_line_idx = line_idx,
-                                        .start_c_idx = is_italic ? c_idx + 1 : c_idx + 2,
-                                        .text = str_make(arena, "")
-                                    };
-
-                                    if (is_italic) {
-                                        open_tk.type = ARTICLE_TOKEN_TYPE_ITALIC_TEXT;
-                                        open_tk.data.it_text = text_tk_data;
-                                    } else {
-                                        open_tk.type = ARTICLE_TOKEN_TYPE_BOLD_TEXT;
-                                        open_tk.data.bold_text = text_tk_data;
-                                    }
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_TERMS, arena, arena_start_offset);
+}
 
-                                    new_tk = true;
+static void body_text_stats_append(BodyTextStats *text_stats, char c) {
+    bool continuation = ((u8) c & 0xC0) == 0x80;
 
-                                    break;
-                                }
-                                case '{': {
-                                    string_view metablock_view = {
-                                        line->data + c_idx,
-                                        line->len - c_idx,
-                                    };
+    if (!continuation) {
+        if (text_stats->excerpt_char_count >= text_stats->excerpt_char_limit) {
+            text_stats->excerpt_full = true;
+            return;
+        }
+        text_stats->excerpt_char_count++;
+    }
 
-                                    MetablockData metablock_data = metablock_get_data(arena, &metablock_view);
+    if (text_stats->excerpt.len < text_stats->excerpt_capacity) {
+        text_stats->excerpt.data[text_stats->excerpt.len++] = c;
+    }
+}
 
-                                    switch (metablock_data.key) {
-                                        case METABLOCK_KEY_BIBLE: {
-                                            if (metablock_data.val_strs.len >= 3) {
-                                                const string *subkey_str = &metablock_data.val_strs.data[1];
+// Counts the words of a text run and extends the excerpt, no allocation
+static void body_text_stats_add(BodyTextStats *text_stats, const string *text) {
+    for (i64 c_idx = 0; c_idx < text->len; c_idx++) {
+        char c = text->data[c_idx];
 
-                                                switch (bible_get_subkey(subkey_str)) {
-                                                    case BIBLE_SUBKEY_HOVER: {
-                                                        open_tk.type = ARTICLE_TOKEN_TYPE_BIBLE_HOVER;
+        if (isspace((u8) c)) {
+            text_stats->in_word = false;
+            text_stats->pending_space = true;
+            continue;
+        }
 
-                                                        string verse_ref_str = metablock_join_val_strs(
-                                                            arena,
-                                                            &metablock_data.val_strs,
-                                                            2
-                                                        );
-
-                                                        open_tk.data.bible_hover.passages = bible_parse_ref(
-                                                            arena,
-                                                            &verse_ref_str
-                                                        );
-                                                        open_tk.data.bible_hover.end_c_idx = c_idx
-                                                            + metablock_data.range.end_c_idx
-                                                            + (i64) strlen(kMetablockEndDelimiter);
-
-                                                        new_tk = true;
-
-                                                        break;
-                                                    }
-                                                    default:
-                                                        break;
-                                                }
-                                            }
+        if (!text_stats->in_word) {
+            text_stats->word_count++;
+            text_stats->in_word = true;
+        }
 
-                                            break;
-                                        }
-                                        default:
-                                            break;
-                                    }
+        // A space with no room left for a character after it is dropped
+        if (!text_stats->excerpt_full && text_stats->pending_space && text_stats->excerpt.len > 0) {
+            if (text_stats->excerpt_char_count + 1 >= text_stats->excerpt_char_limit) {
+                text_stats->excerpt_full = true;
+            } else {
+                body_text_stats_append(text_stats, ' ');
+            }
+        }
 
-                                    break;
-                                }
-                                default: {
-                                    str_append(&current_open_tk->data.reg_text.text, "%c", c);
-                                    break;
-                                }
-                            }
+        if (!text_stats->excerpt_full) {
+            body_text_stats_append(text_stats, c);
+        }
 
-                            if (new_tk) {
-                                ArticleToken reg_close_tk = {
-                                    TOKEN_PAREN_CLOSE,
-                                    ARTICLE_TOKEN_TYPE_REGULAR_TEXT
-                                };
+        text_stats->pending_space = false;
+    }
+}
 
-                                ARRAY_PUSH(&tks, &reg_close_tk);
+static void body_text_stats_break(BodyTextStats *text_stats) {
+    text_stats->in_word = false;
+    text_stats->pending_space = true;
+}
 
-                                current_open_tk_idx = tks.len;
-                                ARRAY_PUSH(&tks, &open_tk);
-                                line_idx--;
+// "[1, 2]" linking into the references, keys missing from the bibliography are
+// shown as written
+static void body_cite_append(
+    Arena *arena,
+    const string *keys,
+    LabelTargetsMap *cite_numbers,
+    CitedRecords *cited_records,
+    string *out_html
+) {
+    str_append(out_html, "<span class=\"cite\">[");
 
-                                break;
-                            }
+    string_view keys_view = {keys->data, keys->len};
+    bool first_key = true;
 
-                            if (c_idx == line->len - 1) {
-                                // Replace new line with a space
-                                str_append(&current_open_tk->data.reg_text.text, " ");
-                            }
-                        }
+    while (keys_view.len > 0) {
+        const char *comma = memchr(keys_view.data, ',', keys_view.len);
+        i64 key_len = comma ? comma - keys_view.data : keys_view.len;
 
-                        break;
-                    }
-                    case ARTICLE_TOKEN_TYPE_ITALIC_TEXT: {
-                        i64 start_c_idx = current_open_tk->data.it_text.start_line_idx == line_idx
-                                              ? current_open_tk->data.it_text.start_c_idx
-                                              : 0;
+        string_view key = {keys_view.data, key_len};
+        str_view_strip(&key);
 
-                        bool end_of_tk = false;
-                        i64 c_idx;
-                        for (c_idx = start_c_idx; c_idx < line->len; c_idx++) {
-                            char c = line->data[c_idx];
+        str_view_advance(&keys_view, comma ? key_len + 1 : key_len);
 
-                            if (c == '*') {
-                                end_of_tk = true;
-                                break;
-                            }
+        if (key.len == 0) {
+            continue;
+        }
 
-                            str_append(&current_open_tk->data.it_text.text, "%c", c);
+        string key_str = str_view_make(arena, &key);
+        i64 cite_number = HASHMAP_GET_VAL(cite_numbers, &key_str.data);
 
-                            if (c_idx == line->len - 1) {
-                                // Replace new line with a space
-                                str_append(&current_open_tk->data.reg_text.text, " ");
-                            }
-                        }
+        if (cite_number == 0) {
+            BibliographyRecord record = {};
 
-                        if (end_of_tk) {
-                            ArticleToken it_close_tk = {
-                                TOKEN_PAREN_CLOSE,
-                                ARTICLE_TOKEN_TYPE_ITALIC_TEXT
-                            };
+            if (bibliography_find(&g_bibliography, &key, &record)) {
+                ARRAY_PUSH(cited_records, &record);
+                cite_number = cited_records->len;
+                HASHMAP_PUT(cite_numbers, &key_str.data, &cite_number);
+            }
+        }
 
-                            ARRAY_PUSH(&tks, &it_close_tk);
+        if (!first_key) {
+            str_append(out_html, ", ");
+        }
+        first_key = false;
 
-                            ArticleToken reg_open_tk = {
-                                TOKEN_PAREN_OPEN,
-                                ARTICLE_TOKEN_TYPE_REGULAR_TEXT
-                            };
+        if (cite_number > 0) {
+            str_append(out_html, "<a href=\"#ref-");
+            html_escape_append(out_html, key.data, key.len);
+            str_append(out_html, "\">%lld</a>", (long long) cite_number);
+        } else {
+            str_append(out_html, "<span class=\"cite-unresolved\">");
+            html_escape_append(out_html, key.data, key.len);
+            str_append(out_html, "</span>");
+        }
+    }
 
-                            reg_open_tk.data.reg_text.start_c_idx = c_idx + 1;
-                            reg_open_tk.data.reg_text.start_line_idx = line_idx;
-                            reg_open_tk.data.reg_text.text = str_make(arena, "");
+    str_append(out_html, "]</span>");
+}
 
-                            current_open_tk_idx = tks.len;
+// "Author. <i>Title</i>. Venue, volume, pages, year. link"
+static void body_reference_append(const BibliographyRecord *record, string *out_html) {
+    const string_view *fields = record->fields;
 
-                            ARRAY_PUSH(&tks, &reg_open_tk);
+    str_append(out_html, "<li id=\"ref-");
+    html_escape_append(out_html, record->key.data, record->key.len);
+    str_append(out_html, "\">");
 
-                            line_idx--;
-                        }
+    bool separate = false;
 
-                        break;
-                    }
-                    case ARTICLE_TOKEN_TYPE_BOLD_TEXT: {
-                        i64 start_c_idx = current_open_tk->data.bold_text.start_line_idx == line_idx
-                                              ? current_open_tk->data.bold_text.start_c_idx
-                                              : 0;
-
-                        bool end_of_tk = false;
-                        i64 c_idx;
-                        for (c_idx = start_c_idx; c_idx < line->len; c_idx++) {
-                            if (c_idx < line->len - 1) {
-                                char first_c = line->data[c_idx];
-                                char second_c = line->data[c_idx + 1];
-
-                                if (first_c == '*' && second_c == '*') {
-                                    end_of_tk = true;
-                                    break;
-                                }
-                            }
+    if (fields[BIBLIOGRAPHY_FIELD_AUTHOR].len > 0) {
+        html_escape_append(out_html, fields[BIBLIOGRAPHY_FIELD_AUTHOR].data, fields[BIBLIOGRAPHY_FIELD_AUTHOR].len);
+        str_append(out_html, ".");
+        separate = true;
+    } else if (fields[BIBLIOGRAPHY_FIELD_EDITOR].len > 0) {
+        html_escape_append(out_html, fields[BIBLIOGRAPHY_FIELD_EDITOR].data, fields[BIBLIOGRAPHY_FIELD_EDITOR].len);
+        str_append(out_html, " (ed.).");
+        separate = true;
+    }
 
-                            str_append(&current_open_tk->data.bold_text.text, "%c", line->data[c_idx]);
+    if (fields[BIBLIOGRAPHY_FIELD_TITLE].len > 0) {
+        str_append(out_html, "%s<i>", separate ? " " : "");
+        html_escape_append(out_html, fields[BIBLIOGRAPHY_FIELD_TITLE].data, fields[BIBLIOGRAPHY_FIELD_TITLE].len);
+        str_append(out_html, "</i>.");
+        separate = true;
+    }
 
-                            if (c_idx == line->len - 1) {
-                                // Replace new line with a space
-                                str_append(&current_open_tk->data.reg_text.text, " ");
-                            }
-                        }
+    // The venue sentence lists whichever of these the entry has
+    static const BibliographyField kVenueFields[] = {
+        BIBLIOGRAPHY_FIELD_JOURNAL,
+        BIBLIOGRAPHY_FIELD_BOOKTITLE,
+        BIBLIOGRAPHY_FIELD_PUBLISHER,
+        BIBLIOGRAPHY_FIELD_VOLUME,
+        BIBLIOGRAPHY_FIELD_PAGES,
+        BIBLIOGRAPHY_FIELD_YEAR,
+    };
 
-                        if (end_of_tk) {
-                            ArticleToken bold_close_tk = {
-                                TOKEN_PAREN_CLOSE,
-                                ARTICLE_TOKEN_TYPE_BOLD_TEXT
-                            };
+    bool venue_open = false;
 
-                            ARRAY_PUSH(&tks, &bold_close_tk);
+    for (i64 venue_idx = 0; venue_idx < STATIC_ARRAY_LEN(kVenueFields); venue_idx++) {
+        const string_view *field = &fields[kVenueFields[venue_idx]];
+        if (field->len == 0) {
+            continue;
+        }
 
-                            ArticleToken reg_open_tk = {
-                                TOKEN_PAREN_OPEN,
-                                ARTICLE_TOKEN_TYPE_REGULAR_TEXT
-                            };
+        str_append(out_html, "%s", venue_open ? ", " : separate ? " " : "");
+        html_escape_append(out_html, field->data, field->len);
+        venue_open = true;
+    }
 
-                            reg_open_tk.data.reg_text.start_c_idx = c_idx + 2;
-                            reg_open_tk.data.reg_text.start_line_idx = line_idx;
-                            reg_open_tk.data.reg_text.text = str_make(arena, "");
+    if (venue_open) {
+        str_append(out_html, ".");
+        separate = true;
+    }
 
-                            current_open_tk_idx = tks.len;
+    const string_view *doi = &fields[BIBLIOGRAPHY_FIELD_DOI];
+    const string_view *url = &fields[BIBLIOGRAPHY_FIELD_URL];
+
+    if (doi->len > 0) {
+        str_append(out_html, "%s<a href=\"https://doi.org/", separate ? " " : "");
+        html_escape_append(out_html, doi->data, doi->len);
+        str_append(out_html, "\">doi:");
+        html_escape_append(out_html, doi->data, doi->len);
+        str_append(out_html, "</a>");
+    } else if (url->len > 0) {
+        str_append(out_html, "%s<a href=\"", separate ? " " : "");
+        html_escape_append(out_html, url->data, url->len);
+        str_append(out_html, "\">");
+        html_escape_append(out_html, url->data, url->len);
+        str_append(out_html, "</a>");
+    }
 
-                            ARRAY_PUSH(&tks, &reg_open_tk);
+    str_append(out_html, "</li>");
+}
 
-                            line_idx--;
-                        }
+// Bytes body_reference_append may add for the record, every field escaped at
+// the worst rate and the doi or url twice, once in the href and once as text
+static i64 body_reference_bytes(const BibliographyRecord *record) {
+    i64 text_len = record->key.len
+                   + record->fields[BIBLIOGRAPHY_FIELD_DOI].len
+                   + record->fields[BIBLIOGRAPHY_FIELD_URL].len;
 
-                        break;
-                    }
-                    case ARTICLE_TOKEN_TYPE_BIBLE_HOVER: {
-                        ArticleToken hover_close_tk = {
-                            TOKEN_PAREN_CLOSE,
-                            ARTICLE_TOKEN_TYPE_BIBLE_HOVER,
-                        };
+    for (i64 field_idx = 0; field_idx < BIBLIOGRAPHY_FIELD_COUNT; field_idx++) {
+        text_len += record->fields[field_idx].len;
+    }
 
-                        ARRAY_PUSH(&tks, &hover_close_tk);
+    return kBodyReferenceMarkupBytes + HTML_ESCAPE_MAX_BYTES_PER_CHAR * text_len;
+}
 
-                        ArticleToken reg_open_tk = {
-                            TOKEN_PAREN_OPEN,
-                            ARTICLE_TOKEN_TYPE_REGULAR_TEXT
-                        };
+// Nests a heading's list item under the closest shallower heading
+static void body_toc_append(string *toc_html, i32 *open_levels, i32 *open_count, const BodyTocEntry *entry) {
+    if (*open_count == 0) {
+        str_append(toc_html, "<ul class=\"toc\">");
+        open_levels[(*open_count)++] = entry->level;
+    } else if (entry->level > open_levels[*open_count - 1] && *open_count < BODY_TOC_MAX_DEPTH) {
+        str_append(toc_html, "<ul>");
+        open_levels[(*open_count)++] = entry->level;
+    } else {
+        str_append(toc_html, "</li>");
+
+        while (*open_count > 1 && open_levels[*open_count - 1] > entry->level) {
+            str_append(toc_html, "</ul></li>");
+            (*open_count)--;
+        }
+    }
 
-                        reg_open_tk.data.reg_text.start_line_idx = line_idx;
-                        reg_open_tk.data.reg_text.start_c_idx = current_open_tk->data.bible_hover.end_c_idx;
-                        reg_open_tk.data.reg_text.text = str_make(arena, "");
+    str_append(toc_html, "<li><a href=\"#");
+    html_escape_append(toc_html, entry->id.data, entry->id.len);
+    str_append(toc_html, "\">");
+    html_escape_append(toc_html, entry->text.data, entry->text.len);
+    str_append(toc_html, "</a>");
+}
 
-                        current_open_tk_idx = tks.len;
-                        ARRAY_PUSH(&tks, &reg_open_tk);
+static void body_toc_finish(string *toc_html, i32 open_count) {
+    if (open_count == 0) {
+        return;
+    }
 
-                        line_idx--;
+    str_append(toc_html, "</li>");
 
-                        break;
-                    }
-                    default: {
-                        current_open_tk_idx = -1;
-                        break;
-                    }
-                }
-            } else {
-                switch (current_open_tk->type) {
-                    case ARTICLE_TOKEN_TYPE_BOLD_TEXT:
-                    case ARTICLE_TOKEN_TYPE_ITALIC_TEXT:
-                    case ARTICLE_TOKEN_TYPE_REGULAR_TEXT: {
-                        // Within a paragraph
+    for (i32 level_idx = 1; level_idx < open_count; level_idx++) {
+        str_append(toc_html, "</ul></li>");
+    }
 
-                        ArticleToken close_tk = {
-                            TOKEN_PAREN_CLOSE,
-                            current_open_tk->type
-                        };
+    str_append(toc_html, "</ul>");
+}
 
-                        ARRAY_PUSH(&tks, &close_tk);
+static void body_push_passages(
+    const BiblePassages *passages,
+    BiblePassages *out_passages,
+    ArticleArenaStats *arena_stats
+) {
+    const i64 arena_start_offset = out_passages->arena->offset;
 
-                        i64 parent_open_tk_idx = find_parent_open_tk_idx(&tks, current_open_tk_idx);
-                        assert(parent_open_tk_idx >= 0);
+    ARRAY_FOR(passage, passages) {
+        if (passage->book < BIBLE_BOOK_COUNT && passage->ch_v.chapter > 0) {
+            ARRAY_PUSH(out_passages, passage);
+        }
+    }
 
-                        ArticleToken *parent_open_tk = ARRAY_ELEM(&tks, &parent_open_tk_idx);
-                        assert(parent_open_tk->type == ARTICLE_TOKEN_TYPE_PARAGRAPH);
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_PASSAGES, out_passages->arena, arena_start_offset);
+}
 
-                        ArticleToken paragraph_close_tk = {
+static void body_flush_output(
+    const BodyOutputs *outputs,
+    const LabelRefPatches *label_ref_patches,
+    const string *out_html,
+    i64 *flushed_len
+) {
+    if (!outputs || !(outputs->compressor || outputs->sink)) {
+        return;
+    }
+
+    // Output past the first pending forward reference may still be spliced
+    i64 final_len = label_ref_patches->len > 0
+                        ? label_ref_patches->data[0].out_offset
+                        : out_html->len;
+
+    if (final_len > *flushed_len) {
+        if (outputs->compressor) {
+            html_compressor_feed(outputs->compressor, out_html->data + *flushed_len, final_len - *flushed_len);
+        }
+        if (outputs->sink) {
+            outputs->sink(outputs->sink_ctx, out_html->data + *flushed_len, (size_t) (final_len - *flushed_len));
+        }
+        *flushed_len = final_len;
+    }
+}
+
+// Tokenizer state carried from one line to the next
+typedef struct BODY_TOKENIZER_T {
+    Arena *arena;
+    ArticleArenaStats *arena_stats;
+    i32 article_translation_idx;
+    ArticleTokens tks;
+    LabelsMap existing_labels;
+    i64 current_open_tk_idx;
+} BodyTokenizer;
+
+static void body_tokenizer_begin(
+    BodyTokenizer *tokenizer,
+    Arena *arena,
+    const Metadata *metadata,
+    const ArticleTokens *tks,
+    ArticleArenaStats *arena_stats
+) {
+    *tokenizer = (BodyTokenizer){
+        .arena = arena,
+        .arena_stats = arena_stats,
+        .tks = *tks,
+        .existing_labels = {HASHMAP_TYPE_STR_KEY},
+        .current_open_tk_idx = -1,
+    };
+
+    // "translation = <name>" in the metadata, unknown names fall back to the default
+    tokenizer->article_translation_idx = bible_find_translation(&metadata->values[METADATA_KEY_TRANSLATION]);
+    if (tokenizer->article_translation_idx < 0) {
+        tokenizer->article_translation_idx = 0;
+    }
+
+    bool default_label_val = false;
+    HASHMAP_MAKE(&tokenizer->existing_labels, &default_label_val);
+}
+
+static bool body_tokenizer_has_room(const BodyTokenizer *tokenizer, BodyArenaLimit *arena_limit, const string *line) {
+    // The token array may move once more, the line's text is copied and split into terms
+    i64 line_bytes = 2 * (tokenizer->tks.len + line->len + 1) * (i64) sizeof(ArticleToken)
+                     + (line->len + 1) * kBodyTextBytesPerChar;
+
+    return body_arena_has_room(tokenizer->arena, arena_limit, line_bytes);
+}
+
+// True when the line has to be tokenized again, it opened a block its text goes into
+static bool body_tokenize_line(BodyTokenizer *tokenizer, const string *line, i64 line_idx) {
+    Arena *arena = tokenizer->arena;
+    ArticleArenaStats *arena_stats = tokenizer->arena_stats;
+    i32 article_translation_idx = tokenizer->article_translation_idx;
+    ArticleTokens tks = tokenizer->tks;
+    LabelsMap existing_labels = tokenizer->existing_labels;
+    i64 current_open_tk_idx = tokenizer->current_open_tk_idx;
+
+    bool repeat_line = false;
+
+    string_view line_view = {line->data, line->len};
+
+    if (current_open_tk_idx < 0) {
+        str_view_strip(&line_view);
+
+        if (line_view.len > 0) {
+            switch (line_view.data[0]) {
+                case '#': {
+                    // Heading
+                    ArticleTokenType heading_tk_type = ARTICLE_TOKEN_TYPE_HEADING;
+                    ArticleToken heading_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        heading_tk_type,
+                    };
+
+                    i64 text_start_idx;
+                    for (text_start_idx = 0; text_start_idx < line_view.len; text_start_idx++) {
+                        if (line_view.data[text_start_idx] != '#') {
+                            break;
+                        }
+                    }
+
+                    if (text_start_idx >= line_view.len) {
+                        break;
+                    }
+
+                    // HTML stops at <h6>, deeper headings are kept at that level
+                    heading_open_tk.data.heading.level = (i32) (text_start_idx < ARTICLE_AST_HEADING_LEVEL_MAX
+                                                                    ? text_start_idx
+                                                                    : ARTICLE_AST_HEADING_LEVEL_MAX);
+
+                    bool label_present = false;
+                    LabelTokenData label_tk_data = {};
+
+                    i64 label_start_idx = text_start_idx;
+                    while (label_start_idx < line_view.len && line_view.data[label_start_idx] == ' ') {
+                        label_start_idx++;
+                    }
+
+                    if (label_start_idx < line_view.len
+                        && line_view.data[label_start_idx] == kMetablockStartDelimiter[0]) {
+                        // label
+                        string_view label_view = {
+                            line_view.data + label_start_idx,
+                            line_view.len - label_start_idx,
+                        };
+
+                        MetablockRange label_range = metablock_find_range(&label_view);
+                        if (label_range.start_c_idx >= 0 && label_range.end_c_idx >= 0) {
+                            label_range.start_c_idx += label_start_idx;
+                            label_range.end_c_idx += label_start_idx;
+
+                            string_view metablock_view = {
+                                line_view.data + label_range.start_c_idx,
+                                label_range.end_c_idx - label_range.start_c_idx
+                            };
+
+                            label_present = label_get_metablock(arena, &existing_labels, &metablock_view,
+                                                                &label_tk_data);
+                            if (label_present) {
+                                text_start_idx = (i32) (label_range.end_c_idx + strlen(kMetablockEndDelimiter));
+                            }
+                        }
+                    }
+
+                    str_view_advance(&line_view, text_start_idx);
+                    str_view_strip(&line_view);
+                    heading_open_tk.data.heading.text = str_view_make(arena, &line_view);
+                    body_push_tk(&tks, &heading_open_tk, arena_stats);
+
+                    if (label_present) {
+                        ArticleToken label_open_tk = {
+                            TOKEN_PAREN_OPEN,
+                            ARTICLE_TOKEN_TYPE_LABEL
+                        };
+                        label_open_tk.data.label = label_tk_data;
+
+                        body_push_tk(&tks, &label_open_tk, arena_stats);
+
+                        ArticleToken label_close_tk = {
                             TOKEN_PAREN_CLOSE,
-                            ARTICLE_TOKEN_TYPE_PARAGRAPH,
+                            ARTICLE_TOKEN_TYPE_LABEL
                         };
 
-                        ARRAY_PUSH(&tks, &paragraph_close_tk);
+                        body_push_tk(&tks, &label_close_tk, arena_stats);
+                    }
 
-                        current_open_tk_idx = -1;
+                    ArticleToken heading_close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        heading_tk_type,
+                    };
 
-                        break;
+                    body_push_tk(&tks, &heading_close_tk, arena_stats);
+
+                    break;
+                }
+                case '>': {
+                    // Blockquote
+                    break;
+                }
+                case '{': {
+                    // Metablock
+                    MetablockData metablock_data = metablock_get_data(arena, &line_view);
+
+                    switch (metablock_data.key) {
+                        case METABLOCK_KEY_BIBLE: {
+                            if (metablock_data.val_strs.len >= 3) {
+                                const string *subkey_str = &metablock_data.val_strs.data[1];
+
+                                switch (bible_get_subkey(subkey_str)) {
+                                    case BIBLE_SUBKEY_BLOCK: {
+                                        i32 translation_idx = article_translation_idx;
+
+                                        string verse_refs_str = metablock_join_val_strs(
+                                            arena,
+                                            &metablock_data.val_strs,
+                                            metablock_bible_refs_idx(&metablock_data.val_strs, &translation_idx)
+                                        );
+
+                                        BibleBlockTokenData block_data = {
+                                            .passages = body_parse_passages(arena, &verse_refs_str, arena_stats),
+                                            .translation_idx = translation_idx,
+                                        };
+
+                                        ArticleToken open_tk = {
+                                            TOKEN_PAREN_OPEN,
+                                            ARTICLE_TOKEN_TYPE_BIBLE_BLOCK
+                                        };
+
+                                        open_tk.data.bible_block = block_data;
+
+                                        body_push_tk(&tks, &open_tk, arena_stats);
+
+                                        ArticleToken close_tk = {
+                                            TOKEN_PAREN_CLOSE,
+                                            ARTICLE_TOKEN_TYPE_BIBLE_BLOCK
+                                        };
+
+                                        body_push_tk(&tks, &close_tk, arena_stats);
+
+                                        break;
+                                    }
+                                    case BIBLE_SUBKEY_CITE:
+                                    case BIBLE_SUBKEY_HOVER: {
+                                        ArticleToken tk = {
+                                            TOKEN_PAREN_OPEN,
+                                            ARTICLE_TOKEN_TYPE_PARAGRAPH,
+                                        };
+
+                                        current_open_tk_idx = tks.len;
+
+                                        body_push_tk(&tks, &tk, arena_stats);
+
+                                        repeat_line = true;
+
+                                        break;
+                                    }
+                                    default:
+                                        break;
+                                }
+                            }
+                            break;
+                        }
+                        default:
+                            break;
                     }
-                    default:
-                        break;
+
+                    break;
+                }
+                default: // Paragraph
+                {
+                    ArticleToken p_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        ARTICLE_TOKEN_TYPE_PARAGRAPH
+                    };
+
+                    current_open_tk_idx = tks.len;
+
+                    body_push_tk(&tks, &p_open_tk, arena_stats);
+
+                    repeat_line = true;
+
+                    break;
+                }
+            }
+        } else {
+            current_open_tk_idx = -1;
+        }
+    } else {
+        ArticleToken *current_open_tk = ARRAY_ELEM(&tks, &current_open_tk_idx);
+
+        if (line->len > 0) {
+            switch (current_open_tk->type) {
+                case ARTICLE_TOKEN_TYPE_PARAGRAPH: {
+                    ArticleToken reg_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                    };
+
+                    reg_open_tk.data.reg_text.start_c_idx = 0;
+                    reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                    reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                    current_open_tk_idx = tks.len;
+
+                    body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                    repeat_line = true;
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_REGULAR_TEXT: {
+                    i64 start_char_idx = current_open_tk->data.reg_text.start_line_idx == line_idx
+                                             ? current_open_tk->data.reg_text.start_c_idx
+                                             : 0;
+
+                    for (i64 c_idx = start_char_idx; c_idx < line->len; c_idx++) {
+                        char c = line->data[c_idx];
+
+                        bool new_tk = false;
+
+                        ArticleToken open_tk = {
+                            TOKEN_PAREN_OPEN,
+                        };
+
+                        switch (c) {
+                            case '*': {
+                                bool is_italic = true;
+                                if (c_idx < line->len - 1 && line->data[c_idx + 1] == '*') {
+                                    is_italic = false;
+                                }
+
+                                TextTokenData text_tk_data = {
+                                    .start_line_idx = line_idx,
+                                    .start_c_idx = is_italic ? c_idx + 1 : c_idx + 2,
+                                    .text = str_make(arena, "")
+                                };
+
+                                if (is_italic) {
+                                    open_tk.type = ARTICLE_TOKEN_TYPE_ITALIC_TEXT;
+                                    open_tk.data.it_text = text_tk_data;
+                                } else {
+                                    open_tk.type = ARTICLE_TOKEN_TYPE_BOLD_TEXT;
+                                    open_tk.data.bold_text = text_tk_data;
+                                }
+
+                                new_tk = true;
+
+                                break;
+                            }
+                            case '{': {
+                                string_view metablock_view = {
+                                    line->data + c_idx,
+                                    line->len - c_idx,
+                                };
+
+                                MetablockData metablock_data = metablock_get_data(arena, &metablock_view);
+
+                                switch (metablock_data.key) {
+                                    case METABLOCK_KEY_BIBLE: {
+                                        if (metablock_data.val_strs.len >= 3) {
+                                            const string *subkey_str = &metablock_data.val_strs.data[1];
+
+                                            switch (bible_get_subkey(subkey_str)) {
+                                                case BIBLE_SUBKEY_HOVER: {
+                                                    open_tk.type = ARTICLE_TOKEN_TYPE_BIBLE_HOVER;
+
+                                                    i32 translation_idx = article_translation_idx;
+
+                                                    string verse_ref_str = metablock_join_val_strs(
+                                                        arena,
+                                                        &metablock_data.val_strs,
+                                                        metablock_bible_refs_idx(
+                                                            &metablock_data.val_strs,
+                                                            &translation_idx
+                                                        )
+                                                    );
+
+                                                    open_tk.data.bible_hover.translation_idx = translation_idx;
+
+                                                    open_tk.data.bible_hover.passages = body_parse_passages(
+                                                        arena,
+                                                        &verse_ref_str,
+                                                        arena_stats
+                                                    );
+                                                    open_tk.data.bible_hover.end_c_idx = c_idx
+                                                        + metablock_data.range.end_c_idx
+                                                        + (i64) strlen(kMetablockEndDelimiter);
+
+                                                    new_tk = true;
+
+                                                    break;
+                                                }
+                                                default:
+                                                    break;
+                                            }
+                                        }
+
+                                        break;
+                                    }
+                                    case METABLOCK_KEY_REF: {
+                                        if (metablock_data.val_strs.len >= 2) {
+                                            open_tk.type = ARTICLE_TOKEN_TYPE_LABEL_REF;
+                                            open_tk.data.label_ref.name = metablock_data.val_strs.data[1];
+                                            open_tk.data.label_ref.end_c_idx = c_idx
+                                                + metablock_data.range.end_c_idx
+                                                + (i64) strlen(kMetablockEndDelimiter);
+
+                                            new_tk = true;
+                                        }
+
+                                        break;
+                                    }
+                                    case METABLOCK_KEY_CITE: {
+                                        if (metablock_data.val_strs.len >= 2) {
+                                            open_tk.type = ARTICLE_TOKEN_TYPE_CITE;
+                                            open_tk.data.cite.keys = metablock_join_val_strs(
+                                                arena,
+                                                &metablock_data.val_strs,
+                                                1
+                                            );
+                                            open_tk.data.cite.end_c_idx = c_idx
+                                                + metablock_data.range.end_c_idx
+                                                + (i64) strlen(kMetablockEndDelimiter);
+
+                                            new_tk = true;
+                                        }
+
+                                        break;
+                                    }
+                                    default:
+                                        break;
+                                }
+
+                                if (!new_tk) {
+                                    body_append_text_char(&current_open_tk->data.reg_text.text, c, arena_stats);
+                                }
+
+                                break;
+                            }
+                            default: {
+                                body_append_text_char(&current_open_tk->data.reg_text.text, c, arena_stats);
+                                break;
+                            }
+                        }
+
+                        if (new_tk) {
+                            ArticleToken reg_close_tk = {
+                                TOKEN_PAREN_CLOSE,
+                                ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                            };
+
+                            body_push_tk(&tks, &reg_close_tk, arena_stats);
+
+                            current_open_tk_idx = tks.len;
+                            body_push_tk(&tks, &open_tk, arena_stats);
+                            repeat_line = true;
+
+                            break;
+                        }
+
+                        if (c_idx == line->len - 1) {
+                            // Replace new line with a space
+                            body_append_text_char(&current_open_tk->data.reg_text.text, ' ', arena_stats);
+                        }
+                    }
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_ITALIC_TEXT: {
+                    i64 start_c_idx = current_open_tk->data.it_text.start_line_idx == line_idx
+                                          ? current_open_tk->data.it_text.start_c_idx
+                                          : 0;
+
+                    bool end_of_tk = false;
+                    i64 c_idx;
+                    for (c_idx = start_c_idx; c_idx < line->len; c_idx++) {
+                        char c = line->data[c_idx];
+
+                        if (c == '*') {
+                            end_of_tk = true;
+                            break;
+                        }
+
+                        body_append_text_char(&current_open_tk->data.it_text.text, c, arena_stats);
+
+                        if (c_idx == line->len - 1) {
+                            // Replace new line with a space
+                            body_append_text_char(&current_open_tk->data.reg_text.text, ' ', arena_stats);
+                        }
+                    }
+
+                    if (end_of_tk) {
+                        ArticleToken it_close_tk = {
+                            TOKEN_PAREN_CLOSE,
+                            ARTICLE_TOKEN_TYPE_ITALIC_TEXT
+                        };
+
+                        body_push_tk(&tks, &it_close_tk, arena_stats);
+
+                        ArticleToken reg_open_tk = {
+                            TOKEN_PAREN_OPEN,
+                            ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                        };
+
+                        reg_open_tk.data.reg_text.start_c_idx = c_idx + 1;
+                        reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                        reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                        current_open_tk_idx = tks.len;
+
+                        body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                        repeat_line = true;
+                    }
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_BOLD_TEXT: {
+                    i64 start_c_idx = current_open_tk->data.bold_text.start_line_idx == line_idx
+                                          ? current_open_tk->data.bold_text.start_c_idx
+                                          : 0;
+
+                    bool end_of_tk = false;
+                    i64 c_idx;
+                    for (c_idx = start_c_idx; c_idx < line->len; c_idx++) {
+                        if (c_idx < line->len - 1) {
+                            char first_c = line->data[c_idx];
+                            char second_c = line->data[c_idx + 1];
+
+                            if (first_c == '*' && second_c == '*') {
+                                end_of_tk = true;
+                                break;
+                            }
+                        }
+
+                        body_append_text_char(&current_open_tk->data.bold_text.text, line->data[c_idx], arena_stats);
+
+                        if (c_idx == line->len - 1) {
+                            // Replace new line with a space
+                            body_append_text_char(&current_open_tk->data.reg_text.text, ' ', arena_stats);
+                        }
+                    }
+
+                    if (end_of_tk) {
+                        ArticleToken bold_close_tk = {
+                            TOKEN_PAREN_CLOSE,
+                            ARTICLE_TOKEN_TYPE_BOLD_TEXT
+                        };
+
+                        body_push_tk(&tks, &bold_close_tk, arena_stats);
+
+                        ArticleToken reg_open_tk = {
+                            TOKEN_PAREN_OPEN,
+                            ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                        };
+
+                        reg_open_tk.data.reg_text.start_c_idx = c_idx + 2;
+                        reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                        reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                        current_open_tk_idx = tks.len;
+
+                        body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                        repeat_line = true;
+                    }
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_BIBLE_HOVER: {
+                    ArticleToken hover_close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        ARTICLE_TOKEN_TYPE_BIBLE_HOVER,
+                    };
+
+                    body_push_tk(&tks, &hover_close_tk, arena_stats);
+
+                    ArticleToken reg_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                    };
+
+                    reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                    reg_open_tk.data.reg_text.start_c_idx = current_open_tk->data.bible_hover.end_c_idx;
+                    reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                    current_open_tk_idx = tks.len;
+                    body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                    repeat_line = true;
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_LABEL_REF: {
+                    ArticleToken ref_close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        ARTICLE_TOKEN_TYPE_LABEL_REF,
+                    };
+
+                    body_push_tk(&tks, &ref_close_tk, arena_stats);
+
+                    ArticleToken reg_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                    };
+
+                    reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                    reg_open_tk.data.reg_text.start_c_idx = current_open_tk->data.label_ref.end_c_idx;
+                    reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                    current_open_tk_idx = tks.len;
+                    body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                    repeat_line = true;
+
+                    break;
+                }
+                case ARTICLE_TOKEN_TYPE_CITE: {
+                    ArticleToken cite_close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        ARTICLE_TOKEN_TYPE_CITE,
+                    };
+
+                    body_push_tk(&tks, &cite_close_tk, arena_stats);
+
+                    ArticleToken reg_open_tk = {
+                        TOKEN_PAREN_OPEN,
+                        ARTICLE_TOKEN_TYPE_REGULAR_TEXT
+                    };
+
+                    reg_open_tk.data.reg_text.start_line_idx = line_idx;
+                    reg_open_tk.data.reg_text.start_c_idx = current_open_tk->data.cite.end_c_idx;
+                    reg_open_tk.data.reg_text.text = str_make(arena, "");
+
+                    current_open_tk_idx = tks.len;
+                    body_push_tk(&tks, &reg_open_tk, arena_stats);
+
+                    repeat_line = true;
+
+                    break;
+                }
+                default: {
+                    current_open_tk_idx = -1;
+                    break;
                 }
             }
+        } else {
+            switch (current_open_tk->type) {
+                case ARTICLE_TOKEN_TYPE_BOLD_TEXT:
+                case ARTICLE_TOKEN_TYPE_ITALIC_TEXT:
+                case ARTICLE_TOKEN_TYPE_REGULAR_TEXT: {
+                    // Within a paragraph
+
+                    ArticleToken close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        current_open_tk->type
+                    };
+
+                    body_push_tk(&tks, &close_tk, arena_stats);
+
+                    i64 parent_open_tk_idx = find_parent_open_tk_idx(&tks, current_open_tk_idx);
+                    assert(parent_open_tk_idx >= 0);
+
+                    ArticleToken *parent_open_tk = ARRAY_ELEM(&tks, &parent_open_tk_idx);
+                    assert(parent_open_tk->type == ARTICLE_TOKEN_TYPE_PARAGRAPH);
+
+                    ArticleToken paragraph_close_tk = {
+                        TOKEN_PAREN_CLOSE,
+                        ARTICLE_TOKEN_TYPE_PARAGRAPH,
+                    };
+
+                    body_push_tk(&tks, &paragraph_close_tk, arena_stats);
+
+                    current_open_tk_idx = -1;
+
+                    break;
+                }
+                default:
+                    break;
+            }
         }
     }
 
+    tokenizer->tks = tks;
+    tokenizer->existing_labels = existing_labels;
+    tokenizer->current_open_tk_idx = current_open_tk_idx;
+
+    return repeat_line;
+}
+
+// Closes whatever the last line left open
+static void body_tokenizer_finish(BodyTokenizer *tokenizer, ArticleTokens *out_tks) {
+    ArticleArenaStats *arena_stats = tokenizer->arena_stats;
+    ArticleTokens tks = tokenizer->tks;
+    i64 current_open_tk_idx = tokenizer->current_open_tk_idx;
+
     while (current_open_tk_idx >= 0) {
         ArticleToken *current_open_tk = ARRAY_ELEM(&tks, &current_open_tk_idx);
         assert(current_open_tk->paren == TOKEN_PAREN_OPEN);
@@ -873,22 +1668,319 @@ void body_to_html(
             current_open_tk->type
         };
 
-        ARRAY_PUSH(&tks, &close_tk);
+        body_push_tk(&tks, &close_tk, arena_stats);
         current_open_tk_idx = find_parent_open_tk_idx(&tks, current_open_tk_idx);
     }
 
-    i64 current_tk_idx = 0;
+    HASHMAP_FREE(&tokenizer->existing_labels);
+
+    tokenizer->tks = tks;
+    tokenizer->current_open_tk_idx = -1;
+
+    *out_tks = tks;
+}
+
+static void body_tokenize(
+    Arena *arena,
+    const Metadata *metadata,
+    const strings *file_lines,
+    i64 body_start_line_idx,
+    ArticleTokens *out_tks,
+    ArticleArenaStats *arena_stats,
+    BodyArenaLimit *arena_limit
+) {
+    const i64 tokenize_start_offset = arena->offset;
+    const size_t tokenize_start_charged_bytes = arena_stats ? body_arena_charged_bytes(arena_stats) : 0;
+
+    BodyTokenizer tokenizer = {};
+    body_tokenizer_begin(&tokenizer, arena, metadata, out_tks, arena_stats);
+
+    TRACE_BEGIN("tokenize", nullptr, file_lines->len - body_start_line_idx);
+
+    for (i64 line_idx = body_start_line_idx; line_idx < file_lines->len; line_idx++) {
+        const string *line = &file_lines->data[line_idx];
+
+        if (!body_tokenizer_has_room(&tokenizer, arena_limit, line)) {
+            break;
+        }
+
+        while (body_tokenize_line(&tokenizer, line, line_idx)) {}
+    }
+
+    body_tokenizer_finish(&tokenizer, out_tks);
+
+    TRACE_END("tokenize", out_tks->len);
+
+    // Token text, labels and metablock scratch are what the tokenizer has left
+    body_arena_charge_rest(
+        arena_stats,
+        ARTICLE_ARENA_SITE_TEXT,
+        arena,
+        tokenize_start_offset,
+        tokenize_start_charged_bytes
+    );
+}
+
+static const string *body_tk_str(const ArticleToken *tk) {
+    if (tk->paren != TOKEN_PAREN_OPEN) {
+        return nullptr;
+    }
+
+    switch (tk->type) {
+        case ARTICLE_TOKEN_TYPE_HEADING:
+            return &tk->data.heading.text;
+        case ARTICLE_TOKEN_TYPE_REGULAR_TEXT:
+            return &tk->data.reg_text.text;
+        case ARTICLE_TOKEN_TYPE_ITALIC_TEXT:
+            return &tk->data.it_text.text;
+        case ARTICLE_TOKEN_TYPE_BOLD_TEXT:
+            return &tk->data.bold_text.text;
+        case ARTICLE_TOKEN_TYPE_LABEL:
+            return &tk->data.label.name;
+        case ARTICLE_TOKEN_TYPE_LABEL_REF:
+            return &tk->data.label_ref.name;
+        case ARTICLE_TOKEN_TYPE_CITE:
+            return &tk->data.cite.keys;
+        default:
+            return nullptr;
+    }
+}
+
+static const BiblePassages *body_tk_passages(const ArticleToken *tk, i32 *out_translation_idx) {
+    if (tk->paren != TOKEN_PAREN_OPEN) {
+        return nullptr;
+    }
+
+    switch (tk->type) {
+        case ARTICLE_TOKEN_TYPE_BIBLE_BLOCK:
+            *out_translation_idx = tk->data.bible_block.translation_idx;
+            return &tk->data.bible_block.passages;
+        case ARTICLE_TOKEN_TYPE_BIBLE_HOVER:
+            *out_translation_idx = tk->data.bible_hover.translation_idx;
+            return &tk->data.bible_hover.passages;
+        default:
+            return nullptr;
+    }
+}
+
+// Upper bound on what emitting a token adds to the arena, bible passages
+// expand to their verse text
+static i64 body_tk_emit_bytes(const ArticleToken *tk) {
+    i64 emit_bytes = 0;
+
+    const string *str = body_tk_str(tk);
+    if (str) {
+        emit_bytes += str->len * kBodyEmitBytesPerChar;
+    }
+
+    i32 translation_idx = 0;
+    const BiblePassages *passages = body_tk_passages(tk, &translation_idx);
+    if (passages) {
+        ARRAY_FOR(passage, passages) {
+            i32 start_verse = passage->ch_v.start_verse > 0 ? passage->ch_v.start_verse : 1;
+            i32 end_verse = passage->ch_v.end_verse > start_verse ? passage->ch_v.end_verse : start_verse;
+
+            string_view verses = bible_get_translation_range(
+                translation_idx,
+                passage->book,
+                passage->ch_v.chapter,
+                start_verse,
+                end_verse
+            );
+
+            emit_bytes += verses.len + kBodyEmitPassageBytes;
+        }
+    }
+
+    return emit_bytes;
+}
+
+// Emitter state carried from one run of tokens to the next
+typedef struct BODY_EMITTER_T {
+    Arena *arena;
+    string *out_html;
+    const BodyOutputs *outputs;
+    i64 start_offset;
+    size_t start_charged_bytes;
+    LabelTargetsMap emitted_labels;
+    LabelRefPatches label_ref_patches;
+    // Output handed to the compressor and sink so far
+    i64 flushed_len;
+    i32 toc_open_levels[BODY_TOC_MAX_DEPTH];
+    i32 toc_open_count;
+    // Number of each cited key, 0 until its first citation
+    LabelTargetsMap cite_numbers;
+    CitedRecords cited_records;
+    // Heading ids taken so far, explicit labels and generated slugs alike. A
+    // slug maps to the last numeric suffix handed out for it
+    LabelTargetsMap toc_ids;
+    const char *out_html_data;
+    i64 current_tk_idx;
+} BodyEmitter;
+
+static void body_emitter_begin(BodyEmitter *emitter, Arena *arena, string *out_html, const BodyOutputs *outputs) {
+    ArticleArenaStats *arena_stats = outputs ? outputs->arena_stats : nullptr;
+
+    *emitter = (BodyEmitter){
+        .arena = arena,
+        .out_html = out_html,
+        .outputs = outputs,
+        .start_offset = arena->offset,
+        .start_charged_bytes = arena_stats ? body_arena_charged_bytes(arena_stats) : 0,
+        .emitted_labels = {HASHMAP_TYPE_STR_KEY},
+        .label_ref_patches = {arena},
+        .cite_numbers = {HASHMAP_TYPE_STR_KEY},
+        .cited_records = {arena},
+        .toc_ids = {HASHMAP_TYPE_STR_KEY},
+        .out_html_data = out_html->data,
+    };
+
+    i64 default_heading_tk_idx = -1;
+    HASHMAP_MAKE(&emitter->emitted_labels, &default_heading_tk_idx);
+
+    ARRAY_MAKE(&emitter->label_ref_patches);
+
+    i64 default_cite_number = 0;
+    HASHMAP_MAKE(&emitter->cite_numbers, &default_cite_number);
+
+    ARRAY_MAKE(&emitter->cited_records);
+
+    i64 default_toc_id_count = 0;
+    HASHMAP_MAKE(&emitter->toc_ids, &default_toc_id_count);
+}
+
+// Emits the tokens from where the last run stopped up to the end of in_tks,
+// every block they open has to close within them
+static void body_emitter_run(BodyEmitter *emitter, const ArticleTokens *in_tks) {
+    Arena *arena = emitter->arena;
+    string *out_html = emitter->out_html;
+    const BodyOutputs *outputs = emitter->outputs;
+
+    ArticleArenaStats *arena_stats = outputs ? outputs->arena_stats : nullptr;
+
+    // Shares the token storage, label refs count their uses in place
+    ArticleTokens tks = *in_tks;
+
+    LabelTargetsMap emitted_labels = emitter->emitted_labels;
+    LabelRefPatches label_ref_patches = emitter->label_ref_patches;
+    i64 flushed_len = emitter->flushed_len;
+
+    BodyTerms *out_terms = outputs ? outputs->terms : nullptr;
+    BiblePassages *out_passages = outputs ? outputs->passages : nullptr;
+    BodyTextStats *text_stats = outputs ? outputs->text_stats : nullptr;
+
+    BodyToc *out_toc = outputs && outputs->toc_html ? outputs->toc : nullptr;
+    i32 *toc_open_levels = emitter->toc_open_levels;
+    i32 toc_open_count = emitter->toc_open_count;
+
+    LabelTargetsMap cite_numbers = emitter->cite_numbers;
+    CitedRecords cited_records = emitter->cited_records;
+    LabelTargetsMap toc_ids = emitter->toc_ids;
+
+    const char *out_html_data = emitter->out_html_data;
+
+    BodyArenaLimit *arena_limit = outputs ? outputs->arena_limit : nullptr;
+
+    i64 current_tk_idx = emitter->current_tk_idx;
+
+    // Labels further on in this run keep their ids, generated slugs step around them
+    if (out_toc) {
+        for (i64 tk_idx = current_tk_idx; tk_idx >= 0 && tk_idx < tks.len; tk_idx++) {
+            const ArticleToken *tk = ARRAY_ELEM(&tks, &tk_idx);
+            if (tk->type == ARTICLE_TOKEN_TYPE_LABEL && tk->paren == TOKEN_PAREN_OPEN) {
+                if (HASHMAP_GET_VAL(&toc_ids, &tk->data.label.name.data) == 0) {
+                    i64 label_id_count = 1;
+                    HASHMAP_PUT(&toc_ids, &tk->data.label.name.data, &label_id_count);
+                }
+            }
+        }
+    }
 
     while (current_tk_idx >= 0 && current_tk_idx < tks.len) {
         ArticleToken *current_tk = ARRAY_ELEM(&tks, &current_tk_idx);
 
+        // The output may move while it grows, its copies take up to four times what it will hold
+        i64 emit_bytes = kBodyStringGrowthBytesPerByte * (out_html->len + body_tk_emit_bytes(current_tk));
+        if (!body_arena_has_room(arena, arena_limit, emit_bytes)) {
+            break;
+        }
+
         switch (current_tk->type) {
             case ARTICLE_TOKEN_TYPE_HEADING: {
                 assert(current_tk->paren == TOKEN_PAREN_OPEN);
 
                 i32 heading_level = current_tk->data.heading.level;
-                str_append(out_html, "<h%d>", heading_level);
-                str_append(out_html, "%s", current_tk->data.heading.text.data);
+
+                if (text_stats) {
+                    body_text_stats_break(text_stats);
+                }
+
+                i64 label_tk_idx = current_tk_idx + 1;
+                const ArticleToken *label_tk = ARRAY_ELEM(&tks, &label_tk_idx);
+
+                const string *heading_text = &current_tk->data.heading.text;
+                string heading_id = {};
+
+                if (label_tk->type == ARTICLE_TOKEN_TYPE_LABEL && label_tk->paren == TOKEN_PAREN_OPEN) {
+                    const string *label_name = &label_tk->data.label.name;
+
+                    str_append(out_html, "<h%d id=\"", heading_level);
+                    html_escape_append(out_html, label_name->data, label_name->len);
+                    str_append(out_html, "\">");
+                    HASHMAP_PUT(&emitted_labels, &label_tk->data.label.name.data, &current_tk_idx);
+
+                    heading_id = *label_name;
+                } else if (out_toc) {
+                    str_append(out_html, "<h%d id=\"", heading_level);
+
+                    i64 slug_start_idx = out_html->len;
+                    i64 slug_len = html_slug_append(out_html, heading_text->data, heading_text->len);
+                    if (slug_len == 0) {
+                        str_append(out_html, "%s", kTocEmptySlug);
+                        slug_len = out_html->len - slug_start_idx;
+                    }
+
+                    string slug = str_make(arena, "%.*s", (i32) slug_len, out_html->data + slug_start_idx);
+
+                    i64 slug_count = HASHMAP_GET_VAL(&toc_ids, &slug.data);
+                    heading_id = slug;
+
+                    if (slug_count == 0) {
+                        slug_count = 1;
+                    } else {
+                        // A suffixed slug can itself be a label or another heading's slug
+                        do {
+                            slug_count++;
+                            heading_id = str_make(arena, "%s-%lld", slug.data, (long long) slug_count);
+                        } while (HASHMAP_GET_VAL(&toc_ids, &heading_id.data) > 0);
+
+                        i64 heading_id_count = 1;
+                        HASHMAP_PUT(&toc_ids, &heading_id.data, &heading_id_count);
+                        str_append(out_html, "%s", heading_id.data + slug.len);
+                    }
+
+                    HASHMAP_PUT(&toc_ids, &slug.data, &slug_count);
+
+                    str_append(out_html, "\">");
+                } else {
+                    str_append(out_html, "<h%d>", heading_level);
+                }
+
+                if (out_toc) {
+                    BodyTocEntry toc_entry = {
+                        .level = heading_level,
+                        .text = *heading_text,
+                        .id = heading_id,
+                    };
+
+                    ARRAY_PUSH(out_toc, &toc_entry);
+                    body_toc_append(outputs->toc_html, toc_open_levels, &toc_open_count, &toc_entry);
+                }
+
+                html_escape_append(out_html, heading_text->data, heading_text->len);
+                if (out_terms) {
+                    body_push_terms(arena, heading_text, ARTICLE_TERM_FIELD_HEADING, out_terms, arena_stats);
+                }
                 str_append(out_html, "</h%d>", heading_level);
 
                 current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
@@ -897,6 +1989,10 @@ void body_to_html(
                 break;
             }
             case ARTICLE_TOKEN_TYPE_PARAGRAPH: {
+                if (text_stats) {
+                    body_text_stats_break(text_stats);
+                }
+
                 switch (current_tk->paren) {
                     case TOKEN_PAREN_OPEN: {
                         str_append(out_html, "<p>");
@@ -914,21 +2010,79 @@ void body_to_html(
             }
             case ARTICLE_TOKEN_TYPE_REGULAR_TEXT: {
                 assert(current_tk->paren == TOKEN_PAREN_OPEN);
-                str_append(out_html, "%s", current_tk->data.reg_text.text.data);
+                const string *text = &current_tk->data.reg_text.text;
+                html_escape_append(out_html, text->data, text->len);
+                if (out_terms) {
+                    body_push_terms(arena, text, ARTICLE_TERM_FIELD_TEXT, out_terms, arena_stats);
+                }
+                if (text_stats) {
+                    body_text_stats_add(text_stats, text);
+                }
                 current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
                 assert(current_tk_idx >= 0);
                 break;
             }
             case ARTICLE_TOKEN_TYPE_ITALIC_TEXT: {
                 assert(current_tk->paren == TOKEN_PAREN_OPEN);
-                str_append(out_html, "<i>%s</i>", current_tk->data.it_text.text.data);
+                const string *text = &current_tk->data.it_text.text;
+                str_append(out_html, "<i>");
+                html_escape_append(out_html, text->data, text->len);
+                if (out_terms) {
+                    body_push_terms(arena, text, ARTICLE_TERM_FIELD_TEXT, out_terms, arena_stats);
+                }
+                if (text_stats) {
+                    body_text_stats_add(text_stats, text);
+                }
+                str_append(out_html, "</i>");
                 current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
                 assert(current_tk_idx >= 0);
                 break;
             }
             case ARTICLE_TOKEN_TYPE_BOLD_TEXT: {
                 assert(current_tk->paren == TOKEN_PAREN_OPEN);
-                str_append(out_html, "<b>%s</b>", current_tk->data.bold_text.text.data);
+                const string *text = &current_tk->data.bold_text.text;
+                str_append(out_html, "<b>");
+                html_escape_append(out_html, text->data, text->len);
+                if (out_terms) {
+                    body_push_terms(arena, text, ARTICLE_TERM_FIELD_TEXT, out_terms, arena_stats);
+                }
+                if (text_stats) {
+                    body_text_stats_add(text_stats, text);
+                }
+                str_append(out_html, "</b>");
+                current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
+                assert(current_tk_idx >= 0);
+                break;
+            }
+            case ARTICLE_TOKEN_TYPE_LABEL_REF: {
+                assert(current_tk->paren == TOKEN_PAREN_OPEN);
+
+                const string *label_name = &current_tk->data.label_ref.name;
+                i64 heading_tk_idx = HASHMAP_GET_VAL(&emitted_labels, &label_name->data);
+
+                if (strchr(label_name->data, kLabelRefArticleSeparator)) {
+                    // Labels in other articles come from the site-wide index
+                    label_ref_append_external_link(label_name, out_html);
+                } else if (heading_tk_idx >= 0) {
+                    label_ref_append_link(&tks, heading_tk_idx, label_name, out_html);
+                } else {
+                    // Forward reference, filled in once the rest of the body has been emitted
+                    LabelRefPatch patch = {
+                        .out_offset = out_html->len,
+                        .name = *label_name,
+                    };
+                    ARRAY_PUSH(&label_ref_patches, &patch);
+                }
+
+                current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
+                assert(current_tk_idx >= 0);
+                break;
+            }
+            case ARTICLE_TOKEN_TYPE_CITE: {
+                assert(current_tk->paren == TOKEN_PAREN_OPEN);
+
+                body_cite_append(arena, &current_tk->data.cite.keys, &cite_numbers, &cited_records, out_html);
+
                 current_tk_idx = find_closing_tk_idx(&tks, current_tk_idx);
                 assert(current_tk_idx >= 0);
                 break;
@@ -939,6 +2093,10 @@ void body_to_html(
                 str_append(out_html, "<div class=\"bible-block\">");
                 const BiblePassages *passages = &current_tk->data.bible_block.passages;
 
+                if (out_passages) {
+                    body_push_passages(passages, out_passages, arena_stats);
+                }
+
                 ARRAY_FOR(passage, passages) {
                     if (passage->book < BIBLE_BOOK_COUNT &&
                         passage->ch_v.chapter > 0 &&
@@ -949,21 +2107,15 @@ void body_to_html(
                             end_verse = start_verse;
                         }
 
-                        Arena tmp = arena_make(32 * (end_verse - start_verse + 1));
-
-                        for (i32 current_verse = start_verse; current_verse <= end_verse; current_verse++) {
-                            char *verse_val = bible_get_verse(
-                                passage->book,
-                                passage->ch_v.chapter,
-                                current_verse
-                            );
-
-                            if (verse_val) {
-                                str_append(out_html, "%s", verse_val);
-                            }
-                        }
+                        string_view verses = bible_get_translation_range(
+                            current_tk->data.bible_block.translation_idx,
+                            passage->book,
+                            passage->ch_v.chapter,
+                            start_verse,
+                            end_verse
+                        );
 
-                        arena_free(&tmp);
+                        html_bytes_append(out_html, verses.data, verses.len);
 
                         str_append(out_html, "<p class=\"bible-block-verse-ref\">");
                         string ref_str = bible_passage_ref_to_str(arena, *passage);
@@ -984,6 +2136,10 @@ void body_to_html(
                 str_append(out_html, "<span class=\"bible-hover\">");
 
                 const BiblePassages *passages = &current_tk->data.bible_hover.passages;
+
+                if (out_passages) {
+                    body_push_passages(passages, out_passages, arena_stats);
+                }
                 for (i32 passage_idx = 0; passage_idx < passages->len; passage_idx++) {
                     BiblePassage *passage = &passages->data[passage_idx];
 
@@ -997,39 +2153,23 @@ void body_to_html(
 
                         str_append(out_html, "<span class=\"bible-hover-body hidden\">");
 
-                        if (passage->ch_v.start_verse > 0) {
-                            i32 start_verse = passage->ch_v.start_verse;
-                            i32 end_verse = passage->ch_v.end_verse;
-                            if (end_verse < start_verse) {
-                                end_verse = start_verse;
-                            }
-
-                            Arena tmp = arena_make(512 + 32 * (end_verse - start_verse + 1));
-                            DEFER(arena_free(&tmp)) {
-                                for (i32 current_verse = start_verse; current_verse <= end_verse; current_verse++) {
-                                    char *verse_val = bible_get_verse(
-                                        passage->book,
-                                        passage->ch_v.chapter,
-                                        current_verse
-                                    );
-
-                                    if (verse_val) {
-                                        string inline_verse_str = bible_verse_to_inline(&tmp, verse_val);
-                                        str_append(out_html, "%s", inline_verse_str.data);
-                                    }
-                                }
-                            }
-                        } else {
-                            char *verse_val = bible_get_verse(passage->book, passage->ch_v.chapter, 1);
-                            if (verse_val) {
-                                Arena tmp = arena_make(512);
-                                DEFER(arena_free(&tmp)) {
-                                    string inline_verse_str = bible_verse_to_inline(&tmp, verse_val);
-                                    str_append(out_html, "%s", inline_verse_str.data);
-                                }
-                            }
+                        // A whole chapter only previews its first verse
+                        i32 start_verse = passage->ch_v.start_verse > 0 ? passage->ch_v.start_verse : 1;
+                        i32 end_verse = passage->ch_v.start_verse > 0 ? passage->ch_v.end_verse : 1;
+                        if (end_verse < start_verse) {
+                            end_verse = start_verse;
                         }
 
+                        string_view verses = bible_get_translation_range(
+                            current_tk->data.bible_hover.translation_idx,
+                            passage->book,
+                            passage->ch_v.chapter,
+                            start_verse,
+                            end_verse
+                        );
+
+                        bible_append_inline(out_html, &verses);
+
                         str_append(out_html, "</span>");
                     }
                 }
@@ -1045,7 +2185,557 @@ void body_to_html(
         }
 
         current_tk_idx++;
+
+        if (arena_stats && out_html->data != out_html_data) {
+            arena_stats->sites[ARTICLE_ARENA_SITE_OUTPUT].allocation_count++;
+            out_html_data = out_html->data;
+        }
+
+        if (out_html->len - flushed_len >= kCompressorFlushThreshold) {
+            body_flush_output(outputs, &label_ref_patches, out_html, &flushed_len);
+        }
+    }
+
+    emitter->emitted_labels = emitted_labels;
+    emitter->label_ref_patches = label_ref_patches;
+    emitter->flushed_len = flushed_len;
+    emitter->toc_open_count = toc_open_count;
+    emitter->cite_numbers = cite_numbers;
+    emitter->cited_records = cited_records;
+    emitter->toc_ids = toc_ids;
+    emitter->out_html_data = out_html_data;
+    emitter->current_tk_idx = current_tk_idx;
+}
+
+// Hands what is final so far to the compressor and sink
+static void body_emitter_flush(BodyEmitter *emitter) {
+    body_flush_output(emitter->outputs, &emitter->label_ref_patches, emitter->out_html, &emitter->flushed_len);
+}
+
+static void body_emitter_free(BodyEmitter *emitter) {
+    HASHMAP_FREE(&emitter->cite_numbers);
+    HASHMAP_FREE(&emitter->toc_ids);
+    HASHMAP_FREE(&emitter->emitted_labels);
+}
+
+// Backpatches the forward label refs, appends the references and gathers the
+// labels, then frees the emitter. False when the arena has no room to finish
+static bool body_emitter_finish(BodyEmitter *emitter, const ArticleTokens *in_tks) {
+    Arena *arena = emitter->arena;
+    string *out_html = emitter->out_html;
+    const BodyOutputs *outputs = emitter->outputs;
+
+    ArticleArenaStats *arena_stats = outputs ? outputs->arena_stats : nullptr;
+    BodyArenaLimit *arena_limit = outputs ? outputs->arena_limit : nullptr;
+
+    ArticleTokens tks = *in_tks;
+
+    // Backpatching copies the output, the references are appended to it
+    i64 references_bytes = emitter->cited_records.len > 0 ? kBodyReferenceMarkupBytes : 0;
+    ARRAY_FOR(record, &emitter->cited_records) {
+        references_bytes += body_reference_bytes(record);
+    }
+
+    i64 finish_bytes = kBodyStringGrowthBytesPerByte * (out_html->len + references_bytes);
+    if (emitter->label_ref_patches.len > 0) {
+        finish_bytes += kBodyStringGrowthBytesPerByte * out_html->len;
+    }
+
+    if (!body_arena_has_room(arena, arena_limit, finish_bytes)) {
+        body_emitter_free(emitter);
+        return false;
+    }
+
+    if (emitter->label_ref_patches.len > 0) {
+        label_refs_backpatch(arena, &tks, &emitter->emitted_labels, &emitter->label_ref_patches, out_html);
+        emitter->label_ref_patches.len = 0;
+    }
+
+    if (emitter->cited_records.len > 0) {
+        str_append(out_html, "<section class=\"references\"><h2>References</h2><ol>");
+
+        ARRAY_FOR(record, &emitter->cited_records) {
+            body_reference_append(record, out_html);
+        }
+
+        str_append(out_html, "</ol></section>");
+    }
+
+    body_emitter_flush(emitter);
+
+    if (outputs && outputs->toc_html) {
+        body_toc_finish(outputs->toc_html, emitter->toc_open_count);
+    }
+
+    body_arena_charge_rest(
+        arena_stats,
+        ARTICLE_ARENA_SITE_OUTPUT,
+        arena,
+        emitter->start_offset,
+        emitter->start_charged_bytes
+    );
+
+    BodyLabels *out_labels = outputs ? outputs->labels : nullptr;
+
+    if (out_labels) {
+        HASHMAP_FOR(key_val, &emitter->emitted_labels) {
+            const ArticleToken *heading_tk = ARRAY_ELEM(&tks, &key_val->value);
+            i64 label_tk_idx = key_val->value + 1;
+            const ArticleToken *label_tk = ARRAY_ELEM(&tks, &label_tk_idx);
+
+            BodyLabel body_label = {
+                .name = label_tk->data.label.name,
+                .heading_text = heading_tk->data.heading.text,
+            };
+
+            ARRAY_PUSH(out_labels, &body_label);
+        }
+    }
+
+    body_emitter_free(emitter);
+
+    return true;
+}
+
+// Walks the tokens once, writing the HTML and gathering the optional outputs
+static void body_emit(Arena *arena, const ArticleTokens *in_tks, string *out_html, const BodyOutputs *outputs) {
+    BodyEmitter emitter = {};
+    body_emitter_begin(&emitter, arena, out_html, outputs);
+
+    TRACE_BEGIN("emit", nullptr, in_tks->len);
+
+    body_emitter_run(&emitter, in_tks);
+
+    if (!body_emitter_finish(&emitter, in_tks)) {
+        TRACE_END("emit", -1);
+        return;
+    }
+
+    // What went out to the compressor or sink when they took it, else the html
+    TRACE_END("emit", outputs && (outputs->compressor || outputs->sink) ? emitter.flushed_len : out_html->len);
+}
+
+void body_to_html(
+    Arena *arena,
+    const Metadata *metadata,
+    const strings *file_lines,
+    i64 body_start_line_idx,
+    string *out_html,
+    const BodyOutputs *outputs
+) {
+    if (body_start_line_idx < 0 || body_start_line_idx >= file_lines->len) {
+        return;
+    }
+
+    ArticleTokens tks = {arena};
+    ARRAY_MAKE(&tks);
+
+    body_tokenize(
+        arena,
+        metadata,
+        file_lines,
+        body_start_line_idx,
+        &tks,
+        outputs ? outputs->arena_stats : nullptr,
+        outputs ? outputs->arena_limit : nullptr
+    );
+
+    if (outputs && outputs->arena_limit && outputs->arena_limit->exhausted) {
+        return;
+    }
+
+    body_emit(arena, &tks, out_html, outputs);
+}
+
+struct BODY_STREAM_T {
+    Arena *arena;
+    BodyOutputs outputs;
+    BodyTokenizer tokenizer;
+    BodyEmitter emitter;
+    i64 line_idx;
+};
+
+BodyStream *body_stream_begin(Arena *arena, const Metadata *metadata, string *out_html, const BodyOutputs *outputs) {
+    BodyStream *stream = calloc(1, sizeof(BodyStream));
+    assert(stream);
+
+    stream->arena = arena;
+    stream->outputs = outputs ? *outputs : (BodyOutputs){};
+
+    ArticleTokens tks = {arena};
+    ARRAY_MAKE(&tks);
+
+    body_tokenizer_begin(&stream->tokenizer, arena, metadata, &tks, stream->outputs.arena_stats);
+    body_emitter_begin(&stream->emitter, arena, out_html, &stream->outputs);
+
+    return stream;
+}
+
+bool body_stream_line(BodyStream *stream, const string *line) {
+    Arena *arena = stream->arena;
+    ArticleArenaStats *arena_stats = stream->outputs.arena_stats;
+    BodyArenaLimit *arena_limit = stream->outputs.arena_limit;
+
+    if (!body_tokenizer_has_room(&stream->tokenizer, arena_limit, line)) {
+        return false;
+    }
+
+    // Charged a line at a time, the tokenizer and emitter take turns in the arena
+    i64 stage_start_offset = arena->offset;
+    size_t stage_start_charged_bytes = arena_stats ? body_arena_charged_bytes(arena_stats) : 0;
+
+    while (body_tokenize_line(&stream->tokenizer, line, stream->line_idx)) {}
+    stream->line_idx++;
+
+    body_arena_charge_rest(arena_stats, ARTICLE_ARENA_SITE_TEXT, arena, stage_start_offset, stage_start_charged_bytes);
+
+    // Nothing is open between blocks, every token so far has its closing one
+    if (stream->tokenizer.current_open_tk_idx < 0) {
+        stage_start_offset = arena->offset;
+        stage_start_charged_bytes = arena_stats ? body_arena_charged_bytes(arena_stats) : 0;
+
+        body_emitter_run(&stream->emitter, &stream->tokenizer.tks);
+        body_emitter_flush(&stream->emitter);
+
+        body_arena_charge_rest(
+            arena_stats,
+            ARTICLE_ARENA_SITE_OUTPUT,
+            arena,
+            stage_start_offset,
+            stage_start_charged_bytes
+        );
+    }
+
+    return !arena_limit || !arena_limit->exhausted;
+}
+
+bool body_stream_finish(BodyStream *stream) {
+    BodyArenaLimit *arena_limit = stream->outputs.arena_limit;
+    if (arena_limit && arena_limit->exhausted) {
+        body_stream_free(stream);
+        return false;
+    }
+
+    ArticleTokens tks = {};
+    body_tokenizer_finish(&stream->tokenizer, &tks);
+
+    body_emitter_run(&stream->emitter, &tks);
+    bool finished = body_emitter_finish(&stream->emitter, &tks);
+
+    free(stream);
+
+    return finished;
+}
+
+void body_stream_free(BodyStream *stream) {
+    if (stream) {
+        HASHMAP_FREE(&stream->tokenizer.existing_labels);
+        body_emitter_free(&stream->emitter);
+        free(stream);
+    }
+}
+
+typedef struct BODY_AST_OPEN_TYPES_T {
+    ARRAY_FIELDS(u8)
+} BodyAstOpenTypes;
+
+static u64 body_ast_align(u64 offset) {
+    return (offset + 7) & ~(u64) 7;
+}
+
+// Changes whenever a token type or book is added, removed or reordered, or a
+// stored struct changes size
+static u64 body_ast_layout_version() {
+    static const char kTokenTypeNames[] =
+#define X(type) #type ","
+        X_ARTICLE_TOKEN_TYPES
+#undef X
+        ;
+    static const char kBookNames[] =
+#define X(book) #book ","
+        X_BIBLE_BOOKS
+#undef X
+        ;
+
+    const u64 struct_sizes[] = {
+        sizeof(AstHeader),
+        sizeof(AstNode),
+        sizeof(BiblePassage),
+        sizeof(AstTranslation),
+    };
+
+    u64 layout_version = hash_fnv1a(kTokenTypeNames, sizeof(kTokenTypeNames), HASH_FNV1A_SEED);
+    layout_version = hash_fnv1a(kBookNames, sizeof(kBookNames), layout_version);
+    layout_version = hash_fnv1a(struct_sizes, sizeof(struct_sizes), layout_version);
+
+    return layout_version;
+}
+
+void *body_to_ast(
+    Arena *arena,
+    const Metadata *metadata,
+    const strings *file_lines,
+    i64 body_start_line_idx,
+    u64 source_hash,
+    BodyArenaLimit *arena_limit,
+    u64 *out_size
+) {
+    ArticleTokens tks = {arena};
+    ARRAY_MAKE(&tks);
+
+    if (body_start_line_idx >= 0 && body_start_line_idx < file_lines->len) {
+        body_tokenize(arena, metadata, file_lines, body_start_line_idx, &tks, nullptr, arena_limit);
+    }
+
+    if (arena_limit && arena_limit->exhausted) {
+        return nullptr;
+    }
+
+    TRACE_BEGIN("ast_write", nullptr, tks.len);
+
+    // The pool starts with the empty string the nodes without one point at
+    u64 strs_size = 1;
+    u64 passage_count = 0;
+
+    ARRAY_FOR(tk, &tks) {
+        const string *str = body_tk_str(tk);
+        if (str) {
+            strs_size += str->len + 1;
+        }
+
+        // Only the passages ast_open accepts are kept, the emitter skips the others anyway
+        i32 translation_idx = 0;
+        const BiblePassages *passages = body_tk_passages(tk, &translation_idx);
+        if (passages) {
+            ARRAY_FOR(passage, passages) {
+                passage_count += ast_passage_valid(passage);
+            }
+        }
+    }
+
+    assert(strs_size <= UINT32_MAX && passage_count <= UINT32_MAX);
+
+    i32 translation_count = bible_translation_count();
+
+    AstHeader header = {
+        .magic = ARTICLE_AST_MAGIC,
+        .version = ARTICLE_AST_VERSION,
+        .node_count = (u32) tks.len,
+        .passage_count = (u32) passage_count,
+        .translation_count = (u32) translation_count,
+        .has_body = body_start_line_idx >= 0,
+        .layout_version = body_ast_layout_version(),
+        .source_hash = source_hash,
+    };
+
+    header.nodes_offset = body_ast_align(sizeof(AstHeader));
+    header.passages_offset = body_ast_align(header.nodes_offset + tks.len * sizeof(AstNode));
+    header.translations_offset = body_ast_align(header.passages_offset + passage_count * sizeof(BiblePassage));
+    header.strs_offset = body_ast_align(header.translations_offset + translation_count * sizeof(AstTranslation));
+    header.strs_size = strs_size;
+
+    u64 size = header.strs_offset + strs_size;
+
+    u8 *data = calloc(size, 1);
+    assert(data);
+
+    memcpy(data, &header, sizeof(header));
+
+    AstNode *nodes = (AstNode *) (data + header.nodes_offset);
+    BiblePassage *passages = (BiblePassage *) (data + header.passages_offset);
+    AstTranslation *translations = (AstTranslation *) (data + header.translations_offset);
+    char *strs = (char *) (data + header.strs_offset);
+
+    for (i32 translation_idx = 0; translation_idx < translation_count; translation_idx++) {
+        strncpy(
+            translations[translation_idx].name,
+            bible_translation_name(translation_idx),
+            BIBLE_TRANSLATION_NAME_MAX - 1
+        );
+    }
+
+    u64 strs_len = 1;
+    u64 passages_len = 0;
+
+    for (i64 tk_idx = 0; tk_idx < tks.len; tk_idx++) {
+        const ArticleToken *tk = &tks.data[tk_idx];
+        AstNode *node = &nodes[tk_idx];
+
+        node->type = (u8) tk->type;
+        node->paren = (u8) tk->paren;
+
+        if (tk->type == ARTICLE_TOKEN_TYPE_HEADING && tk->paren == TOKEN_PAREN_OPEN) {
+            node->level = tk->data.heading.level;
+        }
+
+        const string *str = body_tk_str(tk);
+        if (str) {
+            memcpy(strs + strs_len, str->data, str->len);
+
+            node->str_offset = (u32) strs_len;
+            node->str_len = (u32) str->len;
+
+            strs_len += str->len + 1;
+        }
+
+        i32 translation_idx = 0;
+        const BiblePassages *tk_passages = body_tk_passages(tk, &translation_idx);
+        if (tk_passages) {
+            node->translation = (u16) translation_idx;
+            node->passage_offset = (u32) passages_len;
+
+            ARRAY_FOR(passage, tk_passages) {
+                if (ast_passage_valid(passage)) {
+                    passages[passages_len++] = *passage;
+                }
+            }
+
+            node->passage_count = (u32) (passages_len - node->passage_offset);
+        }
+    }
+
+    TRACE_END("ast_write", (i64) size);
+
+    *out_size = size;
+
+    return data;
+}
+
+bool body_ast_to_html(Arena *arena, const AstView *ast, string *out_html, const BodyOutputs *outputs) {
+    const AstHeader *header = ast->header;
+
+    if (header->layout_version != body_ast_layout_version()) {
+        return false;
+    }
+
+    ArticleArenaStats *arena_stats = outputs ? outputs->arena_stats : nullptr;
+
+    const i64 arena_start_offset = arena->offset;
+
+    // The tokens, and before them the stack of open node types
+    if (!body_arena_has_room(
+        arena,
+        outputs ? outputs->arena_limit : nullptr,
+        (i64) header->node_count * (i64) (sizeof(ArticleToken) + sizeof(u8))
+    )) {
+        return true;
+    }
+
+    // The emitter asserts on unbalanced tokens, so a corrupt file is turned away
+    // here. Every close has to match the type of the innermost open, and every
+    // heading has a level ast_open has already capped
+    BodyAstOpenTypes open_types = {arena, header->node_count > 0 ? header->node_count : 1};
+    ARRAY_MAKE(&open_types);
+    open_types.len = 0;
+
+    bool nested = true;
+
+    for (u32 node_idx = 0; nested && node_idx < header->node_count; node_idx++) {
+        const AstNode *node = &ast->nodes[node_idx];
+
+        if (node->type >= ARTICLE_TOKEN_TYPE_COUNT) {
+            nested = false;
+        } else if (node->type == ARTICLE_TOKEN_TYPE_HEADING && node->paren == TOKEN_PAREN_OPEN && node->level < 1) {
+            nested = false;
+        } else if (node->paren == TOKEN_PAREN_OPEN) {
+            ARRAY_PUSH(&open_types, &node->type);
+        } else if (node->paren == TOKEN_PAREN_CLOSE
+                   && open_types.len > 0
+                   && open_types.data[open_types.len - 1] == node->type) {
+            open_types.len--;
+        } else {
+            nested = false;
+        }
+    }
+
+    nested = nested && open_types.len == 0;
+
+    arena->offset = arena_start_offset;
+
+    if (!nested) {
+        return false;
+    }
+
+    // Translations are matched by name, one no longer loaded falls back to the default
+    i32 translation_idxs[BIBLE_TRANSLATION_MAX] = {};
+
+    for (u32 translation_idx = 0; translation_idx < header->translation_count; translation_idx++) {
+        const char *name = ast->translations[translation_idx].name;
+        string_view name_view = {name, (i64) strlen(name)};
+
+        i32 found_idx = bible_find_translation(&name_view);
+        translation_idxs[translation_idx] = found_idx >= 0 ? found_idx : 0;
+    }
+
+    TRACE_BEGIN("ast_read", nullptr, header->node_count);
+
+    // One pass over the nodes, strings and passages stay in the mapping
+    ArticleTokens tks = {arena, header->node_count};
+    ARRAY_MAKE(&tks);
+
+    for (u32 node_idx = 0; node_idx < header->node_count; node_idx++) {
+        const AstNode *node = &ast->nodes[node_idx];
+        ArticleToken *tk = &tks.data[node_idx];
+
+        *tk = (ArticleToken){
+            .paren = node->paren,
+            .type = node->type,
+        };
+
+        if (node->paren != TOKEN_PAREN_OPEN) {
+            continue;
+        }
+
+        string str = {
+            .len = node->str_len,
+            .data = (char *) ast->strs + node->str_offset,
+        };
+
+        BiblePassages passages = {
+            .len = node->passage_count,
+            .data = (BiblePassage *) ast->passages + node->passage_offset,
+        };
+
+        switch (tk->type) {
+            case ARTICLE_TOKEN_TYPE_HEADING:
+                tk->data.heading = (HeadingTokenData){node->level, str};
+                break;
+            case ARTICLE_TOKEN_TYPE_REGULAR_TEXT:
+                tk->data.reg_text.text = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_ITALIC_TEXT:
+                tk->data.it_text.text = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_BOLD_TEXT:
+                tk->data.bold_text.text = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_LABEL:
+                tk->data.label.name = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_LABEL_REF:
+                tk->data.label_ref.name = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_CITE:
+                tk->data.cite.keys = str;
+                break;
+            case ARTICLE_TOKEN_TYPE_BIBLE_BLOCK:
+                tk->data.bible_block.passages = passages;
+                tk->data.bible_block.translation_idx = translation_idxs[node->translation];
+                break;
+            case ARTICLE_TOKEN_TYPE_BIBLE_HOVER:
+                tk->data.bible_hover.passages = passages;
+                tk->data.bible_hover.translation_idx = translation_idxs[node->translation];
+                break;
+            default:
+                break;
+        }
     }
 
-    HASHMAP_FREE(&existing_labels);
+    TRACE_END("ast_read", -1);
+
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_TOKENS, arena, arena_start_offset);
+
+    body_emit(arena, &tks, out_html, outputs);
+
+    return true;
 }
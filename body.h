@@ -6,14 +6,133 @@
 #define ARTICLE_HTML_BODY_H
 
 #include <altcore/strings.h>
+#include "ast.h"
+#include "bible.h"
+#include "compress.h"
 #include "metadata.h"
 
+typedef struct BODY_LABEL_T {
+    string name;
+    string heading_text;
+} BodyLabel;
+
+typedef struct BODY_LABELS_T {
+    ARRAY_FIELDS(BodyLabel)
+} BodyLabels;
+
+typedef struct BODY_TERM_T {
+    string text;
+    ArticleTermField field;
+} BodyTerm;
+
+typedef struct BODY_TERMS_T {
+    ARRAY_FIELDS(BodyTerm)
+} BodyTerms;
+
+typedef struct BODY_TOC_ENTRY_T {
+    i32 level;
+    string text;
+    // The heading's label, or a slug of its text when it has none
+    string id;
+} BodyTocEntry;
+
+typedef struct BODY_TOC_T {
+    ARRAY_FIELDS(BodyTocEntry)
+} BodyToc;
+
+// Gathered from the text runs as they are emitted, a paragraph or heading ends
+// a word. The excerpt is pre-sized by the caller and never grown
+typedef struct BODY_TEXT_STATS_T {
+    i64 word_count;
+    string excerpt;
+    // Bytes the excerpt data can hold, 4 per character covers any UTF-8
+    i64 excerpt_capacity;
+    // UTF-8 characters, 0 for no excerpt
+    i64 excerpt_char_limit;
+    i64 excerpt_char_count;
+    bool excerpt_full;
+    bool in_word;
+    // Whitespace since the last character, collapsed into one space
+    bool pending_space;
+} BodyTextStats;
+
+// Bytes the document arena was made with. The body stages check their headroom
+// before each line and token and stop, setting exhausted, rather than overrun it
+typedef struct BODY_ARENA_LIMIT_T {
+    i64 capacity;
+    bool exhausted;
+} BodyArenaLimit;
+
+// Optional outputs gathered while the body is emitted, null members are skipped
+typedef struct BODY_OUTPUTS_T {
+    BodyLabels *labels;
+    HtmlCompressor *compressor;
+    BodyTerms *terms;
+    // Every passage of the bible blocks and hovers, in order
+    BiblePassages *passages;
+    // Optional, accumulates the arena bytes of each accounting site
+    ArticleArenaStats *arena_stats;
+    BodyTextStats *text_stats;
+    // Headings in order, unlabeled ones get a slugged id in the body. Needs toc_html
+    BodyToc *toc;
+    // Nested lists linking the headings, <ul class="toc"> outermost
+    string *toc_html;
+    // Unchecked when null, the arena is then assumed to have room
+    BodyArenaLimit *arena_limit;
+    // Optional, handed the final output as the compressor is while the body is emitted
+    ArticleHtmlSink sink;
+    void *sink_ctx;
+} BodyOutputs;
+
+// Tokenizes and emits a body as its lines arrive. A block is emitted once the
+// line that closes it is in, the compressor and sink see it then
+typedef struct BODY_STREAM_T BodyStream;
+
+// Charges the bytes allocated since start_offset to a site and raises the peak
+void body_arena_charge(ArticleArenaStats *arena_stats, ArticleArenaSite site, const Arena *arena, i64 start_offset);
+
+// Sets exhausted when fewer than needed_bytes and a reserve are left, so a
+// stage can stop before an allocation fails. Always true without a limit
+bool body_arena_has_room(const Arena *arena, BodyArenaLimit *arena_limit, i64 needed_bytes);
+
 void body_to_html(
     Arena *arena,
-    const MetadataMap *metadata,
+    const Metadata *metadata,
     const strings *file_lines,
     i64 body_start_line_idx,
-    string *out_html
+    string *out_html,
+    const BodyOutputs *outputs
 );
 
+// The metadata and outputs have to outlive the stream
+BodyStream *body_stream_begin(Arena *arena, const Metadata *metadata, string *out_html, const BodyOutputs *outputs);
+
+// The line has to stay put until the stream is finished. False once the arena
+// limit has run out, later lines are dropped
+bool body_stream_line(BodyStream *stream, const string *line);
+
+// Closes and emits what the last line left open, backpatches and frees the
+// stream. False when the arena limit ran out, the outputs are incomplete then
+bool body_stream_finish(BodyStream *stream);
+
+// Frees a stream without finishing it
+void body_stream_free(BodyStream *stream);
+
+// Tokenizes the body into a malloc'd AST the caller frees, see ast.h for the layout.
+// Null when the arena limit ran out
+void *body_to_ast(
+    Arena *arena,
+    const Metadata *metadata,
+    const strings *file_lines,
+    i64 body_start_line_idx,
+    u64 source_hash,
+    BodyArenaLimit *arena_limit,
+    u64 *out_size
+);
+
+// Emits an AST without tokenizing again, false when it was written by a build
+// with another layout or its tokens don't nest.
+// Nothing is emitted when the arena limit runs out
+bool body_ast_to_html(Arena *arena, const AstView *ast, string *out_html, const BodyOutputs *outputs);
+
 #endif //ARTICLE_HTML_BODY_H
@@ -0,0 +1,362 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "build.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <altcore/types.h>
+#include <altcore/arenas.h>
+#include <altcore/strings.h>
+#include <altcore/hashmap.h>
+
+#include "bible.h"
+#include "bibliography.h"
+#include "hash.h"
+#include "altcore/defer.h"
+
+#define BUILD_MANIFEST_MAGIC 0x464E4D41u // "AMNF"
+#define BUILD_MANIFEST_VERSION 1u
+
+// On-disk layout: header, entries, then the NUL-terminated source paths
+typedef struct BUILD_MANIFEST_HEADER_T {
+    u32 magic;
+    u32 version;
+    u64 corpus_version;
+    u64 entry_count;
+    u64 strs_size;
+} BuildManifestHeader;
+
+typedef struct BUILD_MANIFEST_ENTRY_T {
+    u64 content_hash;
+    u64 output_hash;
+    i64 size;
+    i64 mtime_ns;
+    u32 path_offset;
+    u32 path_len;
+} BuildManifestEntry;
+
+typedef struct BUILD_MANIFEST_ENTRIES_T {
+    ARRAY_FIELDS(BuildManifestEntry)
+} BuildManifestEntries;
+
+typedef struct BUILD_MANIFEST_MAP_T {
+    HASHMAP_FIELDS(const char*, i64)
+} BuildManifestMap;
+
+typedef struct BUILD_MANIFEST_T {
+    u8 *file_data;
+    const BuildManifestHeader *header;
+    const BuildManifestEntry *entries;
+    const char *strs;
+    BuildManifestMap path_to_entry_idx;
+} BuildManifest;
+
+// The bible translations, and the bibliography's source when one is loaded
+static u64 build_corpus_version() {
+    bible_require();
+
+    u64 corpus_version = bible_corpus_version();
+
+    if (g_bibliography.data) {
+        u64 source_hash = g_bibliography.header->source_hash;
+        corpus_version = hash_fnv1a(&source_hash, sizeof(source_hash), corpus_version);
+    }
+
+    return corpus_version;
+}
+
+static bool build_manifest_load(BuildManifest *manifest, const char *filepath) {
+    *manifest = (BuildManifest){
+        .path_to_entry_idx = {HASHMAP_TYPE_STR_KEY},
+    };
+
+    i64 default_entry_idx = -1;
+    HASHMAP_MAKE(&manifest->path_to_entry_idx, &default_entry_idx);
+
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return false;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    rewind(fp);
+
+    bool loaded = false;
+
+    if (file_size >= (long) sizeof(BuildManifestHeader)) {
+        manifest->file_data = malloc(file_size);
+        assert(manifest->file_data);
+
+        loaded = fread(manifest->file_data, 1, file_size, fp) == (u64) file_size;
+    }
+
+    fclose(fp);
+
+    if (!loaded) {
+        return false;
+    }
+
+    const BuildManifestHeader *header = (const BuildManifestHeader *) manifest->file_data;
+
+    // Bounded first, so a corrupt count can't overflow the offsets
+    u64 max_entry_count = ((u64) file_size - sizeof(BuildManifestHeader)) / sizeof(BuildManifestEntry);
+    u64 strs_offset = sizeof(BuildManifestHeader) + header->entry_count * sizeof(BuildManifestEntry);
+
+    if (header->magic != BUILD_MANIFEST_MAGIC
+        || header->version != BUILD_MANIFEST_VERSION
+        || header->entry_count > max_entry_count
+        || strs_offset + header->strs_size != (u64) file_size) {
+        free(manifest->file_data);
+        manifest->file_data = nullptr;
+        return false;
+    }
+
+    const BuildManifestEntry *entries =
+        (const BuildManifestEntry *) (manifest->file_data + sizeof(BuildManifestHeader));
+    const char *strs = (const char *) (manifest->file_data + strs_offset);
+
+    // Each path must be NUL-terminated inside the strings, or the manifest is
+    // dropped and the build renders everything
+    for (i64 entry_idx = 0; entry_idx < (i64) header->entry_count; entry_idx++) {
+        const BuildManifestEntry *entry = &entries[entry_idx];
+
+        if ((u64) entry->path_offset + entry->path_len >= header->strs_size
+            || strs[entry->path_offset + entry->path_len] != '\0') {
+            free(manifest->file_data);
+            manifest->file_data = nullptr;
+            return false;
+        }
+    }
+
+    manifest->header = header;
+    manifest->entries = entries;
+    manifest->strs = strs;
+
+    for (i64 entry_idx = 0; entry_idx < (i64) header->entry_count; entry_idx++) {
+        const char *path = manifest->strs + manifest->entries[entry_idx].path_offset;
+        HASHMAP_PUT(&manifest->path_to_entry_idx, &path, &entry_idx);
+    }
+
+    return true;
+}
+
+static void build_manifest_free(BuildManifest *manifest) {
+    HASHMAP_FREE(&manifest->path_to_entry_idx);
+    free(manifest->file_data);
+    *manifest = (BuildManifest){};
+}
+
+static bool build_manifest_write(
+    Arena *arena,
+    const char *filepath,
+    const char *const *filepaths,
+    const BuildManifestEntries *entries
+) {
+    u64 strs_size = 0;
+    u64 entry_count = 0;
+
+    ARRAY_FOR(entry, entries) {
+        if (entry->output_hash) {
+            strs_size += entry->path_len + 1;
+            entry_count++;
+        }
+    }
+
+    BuildManifestHeader header = {
+        .magic = BUILD_MANIFEST_MAGIC,
+        .version = BUILD_MANIFEST_VERSION,
+        .corpus_version = build_corpus_version(),
+        .entry_count = entry_count,
+        .strs_size = strs_size,
+    };
+
+    string tmp_filepath = str_make(arena, "%s.tmp", filepath);
+
+    FILE *fp = fopen(tmp_filepath.data, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    // Entries without an output hash failed to render and are retried next build
+    u32 path_offset = 0;
+    for (i64 entry_idx = 0; entry_idx < entries->len && written; entry_idx++) {
+        BuildManifestEntry entry = entries->data[entry_idx];
+        if (!entry.output_hash) {
+            continue;
+        }
+
+        entry.path_offset = path_offset;
+        path_offset += entry.path_len + 1;
+
+        written = fwrite(&entry, sizeof(entry), 1, fp) == 1;
+    }
+
+    for (i64 entry_idx = 0; entry_idx < entries->len && written; entry_idx++) {
+        const BuildManifestEntry *entry = &entries->data[entry_idx];
+        if (!entry->output_hash) {
+            continue;
+        }
+
+        written = fwrite(filepaths[entry_idx], 1, entry->path_len + 1, fp) == entry->path_len + 1;
+    }
+
+    written = (fclose(fp) == 0) && written;
+
+    if (written) {
+        written = rename(tmp_filepath.data, filepath) == 0;
+    } else {
+        remove(tmp_filepath.data);
+    }
+
+    return written;
+}
+
+ArticleBuildResult article_build(
+    const char *const *filepaths,
+    size_t filepath_count,
+    const ArticleBuildOptions *options
+) {
+    ArticleBuildResult result = {};
+
+    if (!filepaths || !options || !options->out_dir || !options->manifest_filepath) {
+        return result;
+    }
+
+    BuildManifest manifest = {};
+    bool manifest_loaded = build_manifest_load(&manifest, options->manifest_filepath);
+
+    // Sources can only be skipped when they'd be rendered against the same corpus
+    bool corpus_unchanged = manifest_loaded && manifest.header->corpus_version == build_corpus_version();
+
+    Arena arena = arena_make(
+        1024 + (i64) filepath_count * (i64) (sizeof(BuildManifestEntry) + 3 * sizeof(u64) + 2 * sizeof(i64)) * 2
+    );
+
+    DEFER(arena_free(&arena), build_manifest_free(&manifest)) {
+        BuildManifestEntries entries = {&arena, (i64) filepath_count > 0 ? (i64) filepath_count : 1};
+        ARRAY_MAKE(&entries);
+        entries.len = (i64) filepath_count;
+
+        i64s dirty_idxs = {&arena, entries.len};
+        ARRAY_MAKE(&dirty_idxs);
+        dirty_idxs.len = 0;
+
+        ArticleBatchOptions batch_options = {
+            .out_dir = options->out_dir,
+            .worker_count = options->worker_count,
+            .arena_budget = options->arena_budget,
+            .async_io = options->async_io,
+        };
+
+        for (i64 path_idx = 0; path_idx < (i64) filepath_count; path_idx++) {
+            const char *filepath = filepaths[path_idx];
+            BuildManifestEntry *entry = &entries.data[path_idx];
+            *entry = (BuildManifestEntry){
+                .path_len = (u32) strlen(filepath),
+            };
+
+            struct stat st = {};
+            if (stat(filepath, &st) != 0) {
+                result.failed_count++;
+                continue;
+            }
+
+            entry->size = st.st_size;
+            entry->mtime_ns = (i64) st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+            i64 prior_entry_idx = HASHMAP_GET_VAL(&manifest.path_to_entry_idx, &filepath);
+            const BuildManifestEntry *prior_entry = prior_entry_idx >= 0
+                                                        ? &manifest.entries[prior_entry_idx]
+                                                        : nullptr;
+
+            if (corpus_unchanged
+                && prior_entry
+                && prior_entry->size == entry->size
+                && prior_entry->mtime_ns == entry->mtime_ns) {
+                // Unchanged by size and mtime, the source isn't even opened, as
+                // long as its output hasn't been deleted since
+                char *out_path = article_batch_output_path(&batch_options, filepath);
+                bool output_exists = out_path && access(out_path, F_OK) == 0;
+                free(out_path);
+
+                if (output_exists) {
+                    entry->content_hash = prior_entry->content_hash;
+                    entry->output_hash = prior_entry->output_hash;
+                    result.skipped_count++;
+                    continue;
+                }
+            }
+
+            ARRAY_PUSH(&dirty_idxs, &path_idx);
+        }
+
+        if (dirty_idxs.len > 0) {
+            const char **dirty_filepaths = calloc(dirty_idxs.len, sizeof(char *));
+            u64 *previous_source_hashes = calloc(dirty_idxs.len, sizeof(u64));
+            u64 *previous_output_hashes = calloc(dirty_idxs.len, sizeof(u64));
+            u64 *source_hashes = calloc(dirty_idxs.len, sizeof(u64));
+            u64 *output_hashes = calloc(dirty_idxs.len, sizeof(u64));
+            assert(dirty_filepaths && previous_source_hashes && previous_output_hashes);
+            assert(source_hashes && output_hashes);
+
+            for (i64 dirty_idx = 0; dirty_idx < dirty_idxs.len; dirty_idx++) {
+                const char *filepath = filepaths[dirty_idxs.data[dirty_idx]];
+                dirty_filepaths[dirty_idx] = filepath;
+
+                i64 prior_entry_idx = HASHMAP_GET_VAL(&manifest.path_to_entry_idx, &filepath);
+                if (prior_entry_idx >= 0) {
+                    previous_output_hashes[dirty_idx] = manifest.entries[prior_entry_idx].output_hash;
+
+                    // Touched but not edited, the batch hashes the source as it reads it and skips it
+                    if (corpus_unchanged) {
+                        previous_source_hashes[dirty_idx] = manifest.entries[prior_entry_idx].content_hash;
+                    }
+                }
+            }
+
+            batch_options.previous_output_hashes = previous_output_hashes;
+            batch_options.out_output_hashes = output_hashes;
+            batch_options.previous_source_hashes = previous_source_hashes;
+            batch_options.out_source_hashes = source_hashes;
+
+            ArticleBatchResult batch_result = article_batch_render(
+                dirty_filepaths,
+                dirty_idxs.len,
+                &batch_options
+            );
+
+            result.skipped_count += batch_result.skipped_count;
+            result.rendered_count += batch_result.rendered_count + batch_result.unchanged_count;
+            result.unchanged_count += batch_result.unchanged_count;
+            result.failed_count += batch_result.failed_count;
+
+            for (i64 dirty_idx = 0; dirty_idx < dirty_idxs.len; dirty_idx++) {
+                BuildManifestEntry *entry = &entries.data[dirty_idxs.data[dirty_idx]];
+                entry->content_hash = source_hashes[dirty_idx];
+                entry->output_hash = output_hashes[dirty_idx];
+            }
+
+            free(output_hashes);
+            free(source_hashes);
+            free(previous_output_hashes);
+            free(previous_source_hashes);
+            free(dirty_filepaths);
+        }
+
+        if (!build_manifest_write(&arena, options->manifest_filepath, filepaths, &entries)) {
+            fprintf(stderr, "article_html: failed to write %s\n", options->manifest_filepath);
+            result.manifest_failed = true;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,38 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_BUILD_H
+#define ARTICLE_HTML_BUILD_H
+
+#include "batch.h"
+
+typedef struct ARTICLE_BUILD_OPTIONS_T {
+    const char* out_dir;
+    const char* manifest_filepath;
+    int worker_count;
+    // Passed on to article_batch_render
+    size_t arena_budget;
+    bool async_io;
+} ArticleBuildOptions;
+
+typedef struct ARTICLE_BUILD_RESULT_T {
+    // Sources skipped without re-rendering
+    size_t skipped_count;
+    // Sources re-rendered, of which unchanged_count produced identical output
+    size_t rendered_count;
+    size_t unchanged_count;
+    size_t failed_count;
+    // Warned about on stderr, the previous manifest is left in place
+    bool manifest_failed;
+} ArticleBuildResult;
+
+// Renders only the sources that changed since the manifest was last
+// written, then rewrites the manifest. The library must already be initialised
+ArticleBuildResult article_build(
+    const char *const *filepaths,
+    size_t filepath_count,
+    const ArticleBuildOptions *options
+);
+
+#endif //ARTICLE_HTML_BUILD_H
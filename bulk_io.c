@@ -0,0 +1,996 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "bulk_io.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef ARTICLE_HTML_IO_URING
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "trace.h"
+
+// Files read but not yet taken by a worker, bounds the memory held ahead of them
+static const i64 kBulkReadAheadFiles = 4 * BULK_IO_WINDOW;
+
+// Rendered pages waiting to be written, pushes block beyond either limit
+static const i64 kBulkWriteQueueCapacity = 4 * BULK_IO_WINDOW;
+static const u64 kBulkWriteQueueMaxBytes = 256ULL * 1024ULL * 1024ULL;
+
+#ifdef ARTICLE_HTML_IO_URING
+
+// A single read or write submission is capped here, the rest is finished with pread/pwrite
+static const u64 kBulkMaxSubmitLen = 1ULL << 30;
+
+// Opcodes are a u8, so a probe this long covers every one the kernel knows
+static const u32 kBulkUringProbeOpCount = 256;
+
+// Every read and write goes through these, a ring lacking any of them isn't used
+static const u8 kBulkUringRequiredOps[] = {
+    IORING_OP_OPENAT,
+    IORING_OP_STATX,
+    IORING_OP_READ,
+    IORING_OP_WRITE,
+    IORING_OP_CLOSE,
+};
+
+// The submission and completion rings shared with the kernel, driven with
+// raw syscalls so there's no dependency on liburing
+typedef struct BULK_URING_T {
+    i32 fd;
+    u32 *sq_head;
+    u32 *sq_tail;
+    u32 *sq_array;
+    u32 sq_mask;
+    u32 sq_entries;
+    struct io_uring_sqe *sqes;
+    u32 *cq_head;
+    u32 *cq_tail;
+    u32 cq_mask;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    u64 sq_ring_size;
+    void *cq_ring;
+    u64 cq_ring_size;
+    u64 sqes_size;
+    // Filled since the last bulk_uring_run, published to the kernel there
+    u32 sq_local_tail;
+    u32 queued_count;
+    // Only from 5.11, renames fall back to rename(2) before that
+    bool renameat_supported;
+} BulkUring;
+
+#else
+
+typedef struct BULK_URING_T {
+    i32 fd;
+} BulkUring;
+
+#endif
+
+typedef struct BULK_READ_SLOT_T {
+    char *bytes;
+    u64 len;
+    bool read;
+} BulkReadSlot;
+
+struct BULK_READER_T {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t slot_read;
+    pthread_cond_t slot_taken;
+    const char *const *filepaths;
+    i64 filepath_count;
+    BulkReadSlot *slots;
+    i64 taken_count;
+    bool stopping;
+    bool use_uring;
+    BulkUring ring;
+};
+
+typedef struct BULK_WRITE_T {
+    i64 tag;
+    char *filepath;
+    char *bytes;
+    u64 len;
+} BulkWrite;
+
+struct BULK_WRITER_T {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    BulkWrite *queue;
+    i64 head;
+    i64 len;
+    u64 queued_bytes;
+    bool closed;
+    bool *out_write_failed;
+    bool use_uring;
+    BulkUring ring;
+};
+
+static atomic_llong g_bulk_tmp_file_counter = 0;
+
+static pthread_once_t g_bulk_uring_probe_once = PTHREAD_ONCE_INIT;
+static bool g_bulk_uring_available = false;
+
+#ifdef ARTICLE_HTML_IO_URING
+
+static void bulk_uring_free(BulkUring *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    if (ring->fd >= 0) {
+        close(ring->fd);
+    }
+
+    *ring = (BulkUring){.fd = -1};
+}
+
+// Kernels from 5.1 to 5.5 set up a ring but answer openat, statx, read and close
+// with -EINVAL, and IORING_REGISTER_PROBE itself only arrived with 5.6
+static bool bulk_uring_probe_ops(BulkUring *ring) {
+    u64 probe_size = sizeof(struct io_uring_probe) + kBulkUringProbeOpCount * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    assert(probe);
+
+    bool supported = syscall(
+        __NR_io_uring_register,
+        ring->fd,
+        IORING_REGISTER_PROBE,
+        probe,
+        kBulkUringProbeOpCount
+    ) == 0;
+
+    for (u64 op_idx = 0; supported && op_idx < sizeof(kBulkUringRequiredOps); op_idx++) {
+        u8 op = kBulkUringRequiredOps[op_idx];
+
+        supported = op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED) != 0;
+    }
+
+    ring->renameat_supported = supported
+                               && IORING_OP_RENAMEAT < probe->ops_len
+                               && (probe->ops[IORING_OP_RENAMEAT].flags & IO_URING_OP_SUPPORTED) != 0;
+
+    free(probe);
+
+    return supported;
+}
+
+static bool bulk_uring_init(BulkUring *ring, u32 entries) {
+    *ring = (BulkUring){.fd = -1};
+
+    struct io_uring_params params = {};
+    ring->fd = (i32) syscall(__NR_io_uring_setup, entries, &params);
+    if (ring->fd < 0) {
+        // Old kernels and seccomp sandboxes refuse it, the POSIX path takes over
+        ring->fd = -1;
+        return false;
+    }
+
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(
+        nullptr,
+        ring->sq_ring_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_SQ_RING
+    );
+    ring->cq_ring = single_mmap
+                        ? ring->sq_ring
+                        : mmap(
+                            nullptr,
+                            ring->cq_ring_size,
+                            PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE,
+                            ring->fd,
+                            IORING_OFF_CQ_RING
+                        );
+    ring->sqes = mmap(
+        nullptr,
+        ring->sqes_size,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE,
+        ring->fd,
+        IORING_OFF_SQES
+    );
+
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        bulk_uring_free(ring);
+        return false;
+    }
+
+    u8 *sq_ring = ring->sq_ring;
+    ring->sq_head = (u32 *) (sq_ring + params.sq_off.head);
+    ring->sq_tail = (u32 *) (sq_ring + params.sq_off.tail);
+    ring->sq_array = (u32 *) (sq_ring + params.sq_off.array);
+    ring->sq_mask = *(u32 *) (sq_ring + params.sq_off.ring_mask);
+    ring->sq_entries = params.sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    u8 *cq_ring = ring->cq_ring;
+    ring->cq_head = (u32 *) (cq_ring + params.cq_off.head);
+    ring->cq_tail = (u32 *) (cq_ring + params.cq_off.tail);
+    ring->cq_mask = *(u32 *) (cq_ring + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq_ring + params.cq_off.cqes);
+
+    if (!bulk_uring_probe_ops(ring)) {
+        bulk_uring_free(ring);
+        return false;
+    }
+
+    return true;
+}
+
+// user_data is the index the result lands at in bulk_uring_run
+static struct io_uring_sqe *bulk_uring_sqe(BulkUring *ring, u8 opcode, i32 fd, u64 user_data) {
+    assert(ring->queued_count < ring->sq_entries);
+
+    u32 sqe_idx = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[sqe_idx];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+
+    ring->sq_array[sqe_idx] = sqe_idx;
+    ring->sq_local_tail++;
+    ring->queued_count++;
+
+    return sqe;
+}
+
+// Submits everything queued with one io_uring_enter and waits for all of it,
+// storing each completion's result at out_results[user_data]. The first
+// result_count results start out as -ECANCELED, which an entry keeps when it
+// never completes. False when io_uring_enter fails other than transiently,
+// the ring isn't used after that.
+static bool bulk_uring_run(BulkUring *ring, i32 *out_results, i64 result_count) {
+    for (i64 result_idx = 0; result_idx < result_count; result_idx++) {
+        out_results[result_idx] = -ECANCELED;
+    }
+
+    u32 pending_count = ring->queued_count;
+    u32 unsubmitted_count = ring->queued_count;
+    ring->queued_count = 0;
+
+    bool failed = false;
+
+    __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+
+    while (pending_count > 0) {
+        i64 submitted_count = syscall(
+            __NR_io_uring_enter,
+            ring->fd,
+            unsubmitted_count,
+            1,
+            IORING_ENTER_GETEVENTS,
+            nullptr,
+            0
+        );
+
+        if (submitted_count < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            if (failed) {
+                // Not even waiting works, whatever is still in flight is abandoned
+                return false;
+            }
+
+            // Entries the kernel never took won't complete, only those in flight are waited for
+            failed = true;
+            pending_count -= unsubmitted_count;
+            unsubmitted_count = 0;
+        } else if (submitted_count > 0) {
+            unsubmitted_count -= (u32) submitted_count;
+        }
+
+        u32 head = *ring->cq_head;
+        u32 tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; head++) {
+            const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+            out_results[cqe->user_data] = cqe->res;
+            pending_count--;
+        }
+
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return !failed;
+}
+
+#else
+
+static void bulk_uring_free(BulkUring *ring) {
+    (void) ring;
+}
+
+static bool bulk_uring_init(BulkUring *ring, u32 entries) {
+    (void) entries;
+    *ring = (BulkUring){.fd = -1};
+
+    return false;
+}
+
+#endif
+
+static void bulk_uring_probe() {
+    BulkUring ring = {};
+    g_bulk_uring_available = bulk_uring_init(&ring, 2);
+    bulk_uring_free(&ring);
+}
+
+bool bulk_io_uring_available() {
+    pthread_once(&g_bulk_uring_probe_once, bulk_uring_probe);
+
+    return g_bulk_uring_available;
+}
+
+bool bulk_make_parent_dirs(char *filepath) {
+    for (char *c = filepath + 1; *c; c++) {
+        if (*c != '/') {
+            continue;
+        }
+
+        *c = '\0';
+        int err = mkdir(filepath, 0755);
+        *c = '/';
+
+        if (err && errno != EEXIST) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static bool bulk_read_rest(i32 fd, char *buffer, u64 len, u64 offset) {
+    while (len > 0) {
+        ssize_t read_len = pread(fd, buffer, len, (off_t) offset);
+        if (read_len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_len <= 0) {
+            return false;
+        }
+
+        buffer += read_len;
+        offset += read_len;
+        len -= read_len;
+    }
+
+    return true;
+}
+
+static bool bulk_write_rest(i32 fd, const char *buffer, u64 len, u64 offset) {
+    while (len > 0) {
+        ssize_t written_len = pwrite(fd, buffer, len, (off_t) offset);
+        if (written_len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written_len <= 0) {
+            return false;
+        }
+
+        buffer += written_len;
+        offset += written_len;
+        len -= written_len;
+    }
+
+    return true;
+}
+
+char *bulk_read_file(const char *filepath, u64 *out_len) {
+    i32 fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    char *bytes = nullptr;
+
+    struct stat st = {};
+    if (fstat(fd, &st) == 0) {
+        bytes = malloc(st.st_size + 1);
+        assert(bytes);
+
+        if (bulk_read_rest(fd, bytes, st.st_size, 0)) {
+            bytes[st.st_size] = '\0';
+            *out_len = st.st_size;
+        } else {
+            free(bytes);
+            bytes = nullptr;
+        }
+    }
+
+    close(fd);
+
+    return bytes;
+}
+
+static bool bulk_write_file(const char *filepath, const char *tmp_filepath, const char *bytes, u64 len) {
+    i32 fd = open(tmp_filepath, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        return false;
+    }
+
+    bool written = bulk_write_rest(fd, bytes, len, 0);
+    written = (close(fd) == 0) && written;
+
+    if (written) {
+        written = rename(tmp_filepath, filepath) == 0;
+    }
+
+    if (!written) {
+        remove(tmp_filepath);
+    }
+
+    return written;
+}
+
+#ifdef ARTICLE_HTML_IO_URING
+
+// False when the ring broke, with every file it opened closed again and nothing read
+static bool bulk_reader_read_window_uring(
+    BulkUring *ring,
+    const char *const *filepaths,
+    i64 window_len,
+    BulkReadSlot *out_slots
+) {
+    struct statx statxs[BULK_IO_WINDOW];
+    i32 fds[BULK_IO_WINDOW];
+    i32 results[2 * BULK_IO_WINDOW];
+
+    // The open and the size lookup don't depend on each other, so both go in the first round
+    for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+        const char *filepath = filepaths[file_idx];
+
+        struct io_uring_sqe *open_sqe = bulk_uring_sqe(ring, IORING_OP_OPENAT, AT_FDCWD, 2 * file_idx);
+        open_sqe->addr = (u64) (uintptr_t) filepath;
+        open_sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+        struct io_uring_sqe *statx_sqe = bulk_uring_sqe(ring, IORING_OP_STATX, AT_FDCWD, 2 * file_idx + 1);
+        statx_sqe->addr = (u64) (uintptr_t) filepath;
+        statx_sqe->len = STATX_SIZE;
+        statx_sqe->off = (u64) (uintptr_t) &statxs[file_idx];
+    }
+
+    bool ring_ok = bulk_uring_run(ring, results, 2 * window_len);
+
+    for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+        fds[file_idx] = results[2 * file_idx];
+
+        if (!ring_ok || fds[file_idx] < 0 || results[2 * file_idx + 1] < 0) {
+            continue;
+        }
+
+        u64 len = statxs[file_idx].stx_size;
+        out_slots[file_idx].bytes = malloc(len + 1);
+        out_slots[file_idx].len = len;
+        assert(out_slots[file_idx].bytes);
+
+        struct io_uring_sqe *read_sqe = bulk_uring_sqe(ring, IORING_OP_READ, fds[file_idx], file_idx);
+        read_sqe->addr = (u64) (uintptr_t) out_slots[file_idx].bytes;
+        read_sqe->len = (u32) (len < kBulkMaxSubmitLen ? len : kBulkMaxSubmitLen);
+        read_sqe->off = 0;
+    }
+
+    ring_ok = ring_ok && bulk_uring_run(ring, results, window_len);
+
+    for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+        BulkReadSlot *slot = &out_slots[file_idx];
+        if (!slot->bytes) {
+            continue;
+        }
+
+        // A short read, e.g. a file truncated since the statx, is finished synchronously
+        i32 read_len = results[file_idx];
+        bool complete = ring_ok
+                        && read_len >= 0
+                        && bulk_read_rest(fds[file_idx], slot->bytes + read_len, slot->len - read_len, read_len);
+
+        if (complete) {
+            slot->bytes[slot->len] = '\0';
+        } else {
+            free(slot->bytes);
+            slot->bytes = nullptr;
+            slot->len = 0;
+        }
+    }
+
+    if (!ring_ok) {
+        for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+            if (fds[file_idx] >= 0) {
+                close(fds[file_idx]);
+            }
+        }
+
+        return false;
+    }
+
+    for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+        if (fds[file_idx] >= 0) {
+            bulk_uring_sqe(ring, IORING_OP_CLOSE, fds[file_idx], file_idx);
+        }
+    }
+
+    if (!bulk_uring_run(ring, results, window_len)) {
+        // The bytes are read, only the descriptors the ring didn't get to are left
+        for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+            if (fds[file_idx] >= 0 && results[file_idx] == -ECANCELED) {
+                close(fds[file_idx]);
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif
+
+static void bulk_reader_read_window(BulkReader *reader, i64 first_idx, i64 window_len, BulkReadSlot *out_slots) {
+#ifdef ARTICLE_HTML_IO_URING
+    if (reader->use_uring) {
+        if (bulk_reader_read_window_uring(&reader->ring, reader->filepaths + first_idx, window_len, out_slots)) {
+            return;
+        }
+
+        // This window and the rest are read with POSIX I/O
+        bulk_uring_free(&reader->ring);
+        reader->use_uring = false;
+    }
+#endif
+
+    for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+        BulkReadSlot *slot = &out_slots[file_idx];
+        slot->bytes = bulk_read_file(reader->filepaths[first_idx + file_idx], &slot->len);
+    }
+}
+
+static void *bulk_reader_run(void *arg) {
+    BulkReader *reader = arg;
+
+    for (i64 first_idx = 0; first_idx < reader->filepath_count; first_idx += BULK_IO_WINDOW) {
+        pthread_mutex_lock(&reader->mutex);
+
+        while (!reader->stopping && first_idx - reader->taken_count >= kBulkReadAheadFiles) {
+            pthread_cond_wait(&reader->slot_taken, &reader->mutex);
+        }
+
+        bool stopping = reader->stopping;
+
+        pthread_mutex_unlock(&reader->mutex);
+
+        if (stopping) {
+            break;
+        }
+
+        i64 window_len = reader->filepath_count - first_idx;
+        if (window_len > BULK_IO_WINDOW) {
+            window_len = BULK_IO_WINDOW;
+        }
+
+        BulkReadSlot window_slots[BULK_IO_WINDOW] = {};
+
+        TRACE_BEGIN("bulk_read", reader->filepaths[first_idx], window_len);
+        bulk_reader_read_window(reader, first_idx, window_len, window_slots);
+        TRACE_END("bulk_read", -1);
+
+        pthread_mutex_lock(&reader->mutex);
+
+        for (i64 file_idx = 0; file_idx < window_len; file_idx++) {
+            reader->slots[first_idx + file_idx] = window_slots[file_idx];
+            reader->slots[first_idx + file_idx].read = true;
+        }
+
+        pthread_cond_broadcast(&reader->slot_read);
+        pthread_mutex_unlock(&reader->mutex);
+    }
+
+    return nullptr;
+}
+
+BulkReader *bulk_reader_start(const char *const *filepaths, i64 filepath_count) {
+    BulkReader *reader = calloc(1, sizeof(BulkReader));
+    assert(reader);
+
+    reader->filepaths = filepaths;
+    reader->filepath_count = filepath_count;
+    reader->slots = calloc(filepath_count > 0 ? filepath_count : 1, sizeof(BulkReadSlot));
+    assert(reader->slots);
+
+    reader->use_uring = bulk_uring_init(&reader->ring, 2 * BULK_IO_WINDOW);
+
+    pthread_mutex_init(&reader->mutex, nullptr);
+    pthread_cond_init(&reader->slot_read, nullptr);
+    pthread_cond_init(&reader->slot_taken, nullptr);
+
+    int err = pthread_create(&reader->thread, nullptr, bulk_reader_run, reader);
+    assert(!err);
+
+    return reader;
+}
+
+char *bulk_reader_take(BulkReader *reader, i64 filepath_idx, u64 *out_len) {
+    assert(filepath_idx >= 0 && filepath_idx < reader->filepath_count);
+
+    pthread_mutex_lock(&reader->mutex);
+
+    while (!reader->slots[filepath_idx].read && !reader->stopping) {
+        pthread_cond_wait(&reader->slot_read, &reader->mutex);
+    }
+
+    BulkReadSlot *slot = &reader->slots[filepath_idx];
+    char *bytes = slot->bytes;
+    *out_len = slot->len;
+
+    slot->bytes = nullptr;
+    slot->len = 0;
+
+    reader->taken_count++;
+    pthread_cond_signal(&reader->slot_taken);
+
+    pthread_mutex_unlock(&reader->mutex);
+
+    return bytes;
+}
+
+void bulk_reader_stop(BulkReader *reader) {
+    if (!reader) {
+        return;
+    }
+
+    pthread_mutex_lock(&reader->mutex);
+    reader->stopping = true;
+    pthread_cond_broadcast(&reader->slot_taken);
+    pthread_cond_broadcast(&reader->slot_read);
+    pthread_mutex_unlock(&reader->mutex);
+
+    int err = pthread_join(reader->thread, nullptr);
+    assert(!err);
+
+    // Anything read ahead but never taken
+    for (i64 filepath_idx = 0; filepath_idx < reader->filepath_count; filepath_idx++) {
+        free(reader->slots[filepath_idx].bytes);
+    }
+
+    bulk_uring_free(&reader->ring);
+    pthread_cond_destroy(&reader->slot_taken);
+    pthread_cond_destroy(&reader->slot_read);
+    pthread_mutex_destroy(&reader->mutex);
+    free(reader->slots);
+    free(reader);
+}
+
+#ifdef ARTICLE_HTML_IO_URING
+
+// False when the ring broke, with every descriptor it opened closed again and
+// the window left for the POSIX path to write over
+static bool bulk_writer_write_window_uring(
+    BulkUring *ring,
+    const BulkWrite *writes,
+    char *const *tmp_filepaths,
+    i64 window_len,
+    bool *out_written
+) {
+    i32 fds[BULK_IO_WINDOW];
+    i32 results[BULK_IO_WINDOW];
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        if (out_written[write_idx]) {
+            struct io_uring_sqe *open_sqe = bulk_uring_sqe(ring, IORING_OP_OPENAT, AT_FDCWD, write_idx);
+            open_sqe->addr = (u64) (uintptr_t) tmp_filepaths[write_idx];
+            open_sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+            open_sqe->len = 0666;
+        }
+    }
+
+    bool ring_ok = bulk_uring_run(ring, results, window_len);
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        fds[write_idx] = results[write_idx];
+        out_written[write_idx] = out_written[write_idx] && fds[write_idx] >= 0;
+
+        if (ring_ok && out_written[write_idx]) {
+            u64 len = writes[write_idx].len;
+
+            struct io_uring_sqe *write_sqe = bulk_uring_sqe(ring, IORING_OP_WRITE, fds[write_idx], write_idx);
+            write_sqe->addr = (u64) (uintptr_t) writes[write_idx].bytes;
+            write_sqe->len = (u32) (len < kBulkMaxSubmitLen ? len : kBulkMaxSubmitLen);
+            write_sqe->off = 0;
+        }
+    }
+
+    ring_ok = ring_ok && bulk_uring_run(ring, results, window_len);
+
+    if (!ring_ok) {
+        for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+            if (fds[write_idx] >= 0) {
+                close(fds[write_idx]);
+            }
+        }
+
+        return false;
+    }
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        if (fds[write_idx] < 0) {
+            continue;
+        }
+
+        i32 written_len = results[write_idx];
+        out_written[write_idx] = written_len >= 0
+                                 && bulk_write_rest(
+                                     fds[write_idx],
+                                     writes[write_idx].bytes + written_len,
+                                     writes[write_idx].len - written_len,
+                                     written_len
+                                 );
+
+        bulk_uring_sqe(ring, IORING_OP_CLOSE, fds[write_idx], write_idx);
+    }
+
+    if (!bulk_uring_run(ring, results, window_len)) {
+        for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+            if (fds[write_idx] >= 0 && results[write_idx] == -ECANCELED) {
+                close(fds[write_idx]);
+            }
+        }
+
+        return false;
+    }
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        if (fds[write_idx] < 0) {
+            continue;
+        }
+
+        out_written[write_idx] = out_written[write_idx] && results[write_idx] == 0;
+
+        if (out_written[write_idx] && ring->renameat_supported) {
+            struct io_uring_sqe *rename_sqe = bulk_uring_sqe(ring, IORING_OP_RENAMEAT, AT_FDCWD, write_idx);
+            rename_sqe->addr = (u64) (uintptr_t) tmp_filepaths[write_idx];
+            rename_sqe->len = (u32) AT_FDCWD;
+            rename_sqe->addr2 = (u64) (uintptr_t) writes[write_idx].filepath;
+        }
+    }
+
+    if (ring->renameat_supported) {
+        ring_ok = bulk_uring_run(ring, results, window_len);
+    }
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        if (fds[write_idx] < 0) {
+            continue;
+        }
+
+        // Renames the ring didn't take are done here, as they are on kernels before 5.11
+        if (out_written[write_idx] && (!ring->renameat_supported || results[write_idx] == -ECANCELED)) {
+            results[write_idx] = rename(tmp_filepaths[write_idx], writes[write_idx].filepath) == 0 ? 0 : -errno;
+        }
+
+        out_written[write_idx] = out_written[write_idx] && results[write_idx] == 0;
+
+        if (!out_written[write_idx]) {
+            remove(tmp_filepaths[write_idx]);
+        }
+    }
+
+    return ring_ok;
+}
+
+#endif
+
+static void bulk_writer_write_window(BulkWriter *writer, BulkWrite *writes, i64 window_len, bool *out_written) {
+    char *tmp_filepaths[BULK_IO_WINDOW] = {};
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        const char *filepath = writes[write_idx].filepath;
+        u64 tmp_filepath_len = strlen(filepath) + 64;
+
+        // Written beside the target and renamed over it, so readers never see a partial page
+        tmp_filepaths[write_idx] = malloc(tmp_filepath_len);
+        assert(tmp_filepaths[write_idx]);
+
+        snprintf(
+            tmp_filepaths[write_idx],
+            tmp_filepath_len,
+            "%s.%d.w%lld.tmp",
+            filepath,
+            (i32) getpid(),
+            (long long) atomic_fetch_add(&g_bulk_tmp_file_counter, 1)
+        );
+
+        out_written[write_idx] = bulk_make_parent_dirs(writes[write_idx].filepath);
+    }
+
+    bool window_written = false;
+
+#ifdef ARTICLE_HTML_IO_URING
+    if (writer->use_uring) {
+        bool made_dirs[BULK_IO_WINDOW];
+        memcpy(made_dirs, out_written, window_len * sizeof(bool));
+
+        window_written = bulk_writer_write_window_uring(
+            &writer->ring,
+            writes,
+            tmp_filepaths,
+            window_len,
+            out_written
+        );
+
+        if (!window_written) {
+            // This window and the rest are written with POSIX I/O
+            bulk_uring_free(&writer->ring);
+            writer->use_uring = false;
+
+            memcpy(out_written, made_dirs, window_len * sizeof(bool));
+        }
+    }
+#else
+    (void) writer;
+#endif
+
+    for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+        if (!window_written) {
+            out_written[write_idx] = out_written[write_idx]
+                                     && bulk_write_file(
+                                         writes[write_idx].filepath,
+                                         tmp_filepaths[write_idx],
+                                         writes[write_idx].bytes,
+                                         writes[write_idx].len
+                                     );
+        }
+
+        free(tmp_filepaths[write_idx]);
+    }
+}
+
+static void *bulk_writer_run(void *arg) {
+    BulkWriter *writer = arg;
+
+    for (;;) {
+        BulkWrite writes[BULK_IO_WINDOW];
+        i64 window_len = 0;
+
+        pthread_mutex_lock(&writer->mutex);
+
+        while (writer->len == 0 && !writer->closed) {
+            pthread_cond_wait(&writer->not_empty, &writer->mutex);
+        }
+
+        // Whatever has queued up by now goes out in one window
+        while (writer->len > 0 && window_len < BULK_IO_WINDOW) {
+            writes[window_len++] = writer->queue[writer->head];
+            writer->head = (writer->head + 1) % kBulkWriteQueueCapacity;
+            writer->len--;
+        }
+
+        pthread_mutex_unlock(&writer->mutex);
+
+        if (window_len == 0) {
+            break;
+        }
+
+        bool written[BULK_IO_WINDOW] = {};
+        u64 window_bytes = 0;
+
+        TRACE_BEGIN("bulk_write", writes[0].filepath, window_len);
+        bulk_writer_write_window(writer, writes, window_len, written);
+        TRACE_END("bulk_write", -1);
+
+        for (i64 write_idx = 0; write_idx < window_len; write_idx++) {
+            if (!written[write_idx] && writer->out_write_failed) {
+                writer->out_write_failed[writes[write_idx].tag] = true;
+            }
+
+            window_bytes += writes[write_idx].len;
+
+            free(writes[write_idx].filepath);
+            free(writes[write_idx].bytes);
+        }
+
+        // Only released once written, so the byte limit covers pages still in flight
+        pthread_mutex_lock(&writer->mutex);
+        writer->queued_bytes -= window_bytes;
+        pthread_cond_broadcast(&writer->not_full);
+        pthread_mutex_unlock(&writer->mutex);
+    }
+
+    return nullptr;
+}
+
+BulkWriter *bulk_writer_start(bool *out_write_failed) {
+    BulkWriter *writer = calloc(1, sizeof(BulkWriter));
+    assert(writer);
+
+    writer->queue = calloc(kBulkWriteQueueCapacity, sizeof(BulkWrite));
+    assert(writer->queue);
+
+    writer->out_write_failed = out_write_failed;
+    writer->use_uring = bulk_uring_init(&writer->ring, BULK_IO_WINDOW);
+
+    pthread_mutex_init(&writer->mutex, nullptr);
+    pthread_cond_init(&writer->not_empty, nullptr);
+    pthread_cond_init(&writer->not_full, nullptr);
+
+    int err = pthread_create(&writer->thread, nullptr, bulk_writer_run, writer);
+    assert(!err);
+
+    return writer;
+}
+
+void bulk_writer_push(BulkWriter *writer, i64 tag, char *filepath, char *bytes, u64 len) {
+    pthread_mutex_lock(&writer->mutex);
+
+    assert(!writer->closed);
+
+    // A single page larger than the limit still goes through once the queue drains
+    while (writer->len == kBulkWriteQueueCapacity
+           || (writer->queued_bytes > 0 && writer->queued_bytes + len > kBulkWriteQueueMaxBytes)) {
+        pthread_cond_wait(&writer->not_full, &writer->mutex);
+    }
+
+    writer->queue[(writer->head + writer->len) % kBulkWriteQueueCapacity] = (BulkWrite){
+        tag,
+        filepath,
+        bytes,
+        len,
+    };
+    writer->len++;
+    writer->queued_bytes += len;
+
+    pthread_cond_signal(&writer->not_empty);
+    pthread_mutex_unlock(&writer->mutex);
+}
+
+void bulk_writer_stop(BulkWriter *writer) {
+    if (!writer) {
+        return;
+    }
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->closed = true;
+    pthread_cond_broadcast(&writer->not_empty);
+    pthread_mutex_unlock(&writer->mutex);
+
+    int err = pthread_join(writer->thread, nullptr);
+    assert(!err);
+
+    bulk_uring_free(&writer->ring);
+    pthread_cond_destroy(&writer->not_full);
+    pthread_cond_destroy(&writer->not_empty);
+    pthread_mutex_destroy(&writer->mutex);
+    free(writer->queue);
+    free(writer);
+}
@@ -0,0 +1,49 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_BULK_IO_H
+#define ARTICLE_HTML_BULK_IO_H
+
+#include <altcore/types.h>
+
+// Submitted to the kernel together, so one io_uring_enter covers this many files
+#define BULK_IO_WINDOW 32
+
+// Reads sources ahead of the render workers and writes outputs behind them.
+// Both run on their own thread, batching through io_uring when built with
+// ARTICLE_HTML_IO_URING and the kernel allows it, otherwise with plain POSIX I/O
+typedef struct BULK_READER_T BulkReader;
+typedef struct BULK_WRITER_T BulkWriter;
+
+// True when the kernel accepted an io_uring, checked once per process
+bool bulk_io_uring_available();
+
+// Creates each missing directory above filepath
+bool bulk_make_parent_dirs(char *filepath);
+
+// Reads the whole file with plain POSIX I/O. The caller owns the NUL-terminated
+// bytes, nullptr when the file couldn't be read
+char *bulk_read_file(const char *filepath, u64 *out_len);
+
+// filepaths must outlive the reader
+BulkReader *bulk_reader_start(const char *const *filepaths, i64 filepath_count);
+
+// Blocks until the file is read. The caller owns the NUL-terminated bytes and
+// frees them, nullptr when the file couldn't be read. Each index is taken once
+char *bulk_reader_take(BulkReader *reader, i64 filepath_idx, u64 *out_len);
+
+void bulk_reader_stop(BulkReader *reader);
+
+// out_write_failed is indexed by the tag of each push and set when that write fails
+BulkWriter *bulk_writer_start(bool *out_write_failed);
+
+// Takes ownership of the malloc'd filepath and bytes. The file is written
+// beside its target and renamed over it, so readers never see a partial page.
+// Blocks while too many bytes are already queued
+void bulk_writer_push(BulkWriter *writer, i64 tag, char *filepath, char *bytes, u64 len);
+
+// Returns once every queued write is done
+void bulk_writer_stop(BulkWriter *writer);
+
+#endif //ARTICLE_HTML_BULK_IO_H
@@ -0,0 +1,327 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "citation_index.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "index_file.h"
+#include "altcore/defer.h"
+
+static const u32 kCitationChapterLastVerse = 0xFF;
+
+typedef struct CITATION_INDEX_ARTICLES_T {
+    ARRAY_FIELDS(CitationIndexArticle)
+} CitationIndexArticles;
+
+static bool citation_passage_keys(
+    i32 book,
+    i32 chapter,
+    i32 start_verse,
+    i32 end_verse,
+    u32 *out_start_key,
+    u32 *out_end_key
+) {
+    if (book < 0 || book >= BIBLE_BOOK_COUNT || chapter <= 0 || chapter > 0xFF || start_verse > 0xFF) {
+        return false;
+    }
+
+    u32 chapter_key = (u32) book << 16 | (u32) chapter << 8;
+
+    if (start_verse <= 0) {
+        *out_start_key = chapter_key;
+        *out_end_key = chapter_key | kCitationChapterLastVerse;
+    } else {
+        if (end_verse < start_verse) {
+            end_verse = start_verse;
+        }
+        if (end_verse > (i32) kCitationChapterLastVerse) {
+            end_verse = (i32) kCitationChapterLastVerse;
+        }
+
+        *out_start_key = chapter_key | (u32) start_verse;
+        *out_end_key = chapter_key | (u32) end_verse;
+    }
+
+    return true;
+}
+
+static int citation_interval_qsort_cmp(const void *a, const void *b) {
+    const CitationIndexInterval *interval_a = a;
+    const CitationIndexInterval *interval_b = b;
+
+    if (interval_a->start_key != interval_b->start_key) {
+        return interval_a->start_key < interval_b->start_key ? -1 : 1;
+    }
+    if (interval_a->end_key != interval_b->end_key) {
+        return interval_a->end_key < interval_b->end_key ? -1 : 1;
+    }
+
+    return (interval_a->article_idx > interval_b->article_idx) - (interval_a->article_idx < interval_b->article_idx);
+}
+
+static int citation_article_idx_qsort_cmp(const void *a, const void *b) {
+    u32 idx_a = *(const u32 *) a;
+    u32 idx_b = *(const u32 *) b;
+
+    return (idx_a > idx_b) - (idx_a < idx_b);
+}
+
+bool citation_index_open(CitationIndex *index, const char *filepath) {
+    if (!index || !filepath) {
+        return false;
+    }
+
+    *index = (CitationIndex){};
+
+    IndexFileMapping mapping = {};
+    if (!index_file_map(filepath, sizeof(CitationIndexHeader), &mapping)) {
+        return false;
+    }
+
+    const CitationIndexHeader *header = (const CitationIndexHeader *) mapping.data;
+
+    bool valid = header->magic == CITATION_INDEX_MAGIC
+                 && header->version == CITATION_INDEX_VERSION
+                 && index_file_section_fits(
+                     &mapping,
+                     header->articles_offset,
+                     header->article_count,
+                     sizeof(CitationIndexArticle),
+                     alignof(CitationIndexArticle)
+                 )
+                 && index_file_section_fits(
+                     &mapping,
+                     header->intervals_offset,
+                     header->interval_count,
+                     sizeof(CitationIndexInterval),
+                     alignof(CitationIndexInterval)
+                 )
+                 && index_file_section_fits(&mapping, header->strs_offset, header->strs_size, 1, 1);
+
+    // Paths are handed out as views into the pool, so each has to lie inside it
+    const u8 *bytes = mapping.data;
+    const CitationIndexArticle *articles = (const CitationIndexArticle *) (bytes + header->articles_offset);
+    const CitationIndexInterval *intervals = (const CitationIndexInterval *) (bytes + header->intervals_offset);
+
+    for (u32 article_idx = 0; valid && article_idx < header->article_count; article_idx++) {
+        const CitationIndexArticle *article = &articles[article_idx];
+
+        valid = index_file_str_fits(header->strs_size, article->path_offset, article->path_len);
+    }
+
+    for (u32 interval_idx = 0; valid && interval_idx < header->interval_count; interval_idx++) {
+        valid = intervals[interval_idx].article_idx < header->article_count;
+    }
+
+    if (!valid) {
+        index_file_unmap(&mapping);
+        return false;
+    }
+
+    index->data = mapping.data;
+    index->size = mapping.size;
+    index->header = header;
+    index->articles = articles;
+    index->intervals = intervals;
+    index->strs = (const char *) (index->data + header->strs_offset);
+
+    return true;
+}
+
+void citation_index_close(CitationIndex *index) {
+    if (index && index->data) {
+        IndexFileMapping mapping = {index->data, index->size};
+        index_file_unmap(&mapping);
+        *index = (CitationIndex){};
+    }
+}
+
+CitationIndexArticleIdxs citation_index_find(Arena *arena, const CitationIndex *index, const BiblePassage *passage) {
+    CitationIndexArticleIdxs article_idxs = {arena};
+    ARRAY_MAKE(&article_idxs);
+
+    u32 query_start_key = 0;
+    u32 query_end_key = 0;
+
+    if (!index || !index->data || !passage
+        || !citation_passage_keys(
+            passage->book,
+            passage->ch_v.chapter,
+            passage->ch_v.start_verse,
+            passage->ch_v.end_verse,
+            &query_start_key,
+            &query_end_key
+        )) {
+        return article_idxs;
+    }
+
+    // Only intervals starting within max_interval_span before the query can reach it
+    u32 span = index->header->max_interval_span;
+    u32 window_start_key = query_start_key > span ? query_start_key - span : 0;
+
+    i64 low_idx = 0;
+    i64 high_idx = index->header->interval_count;
+
+    while (low_idx < high_idx) {
+        i64 mid_idx = low_idx + (high_idx - low_idx) / 2;
+
+        if (index->intervals[mid_idx].start_key < window_start_key) {
+            low_idx = mid_idx + 1;
+        } else {
+            high_idx = mid_idx;
+        }
+    }
+
+    for (i64 interval_idx = low_idx; interval_idx < index->header->interval_count; interval_idx++) {
+        const CitationIndexInterval *interval = &index->intervals[interval_idx];
+        if (interval->start_key > query_end_key) {
+            break;
+        }
+
+        if (interval->end_key >= query_start_key) {
+            ARRAY_PUSH(&article_idxs, &interval->article_idx);
+        }
+    }
+
+    if (article_idxs.len > 1) {
+        qsort(article_idxs.data, article_idxs.len, sizeof(u32), citation_article_idx_qsort_cmp);
+
+        i64 unique_len = 1;
+        for (i64 idx = 1; idx < article_idxs.len; idx++) {
+            if (article_idxs.data[idx] != article_idxs.data[unique_len - 1]) {
+                article_idxs.data[unique_len++] = article_idxs.data[idx];
+            }
+        }
+        article_idxs.len = unique_len;
+    }
+
+    return article_idxs;
+}
+
+string_view citation_index_article_path(const CitationIndex *index, u32 article_idx) {
+    string_view path = {};
+
+    if (index && index->data && article_idx < index->header->article_count) {
+        path.data = index->strs + index->articles[article_idx].path_offset;
+        path.len = index->articles[article_idx].path_len;
+    }
+
+    return path;
+}
+
+void citation_index_push_passages(
+    u32 article_idx,
+    const ArticlePassage *passages,
+    i64 passage_count,
+    CitationIndexIntervals *out_intervals
+) {
+    for (i64 passage_idx = 0; passage_idx < passage_count; passage_idx++) {
+        const ArticlePassage *passage = &passages[passage_idx];
+
+        CitationIndexInterval interval = {
+            .article_idx = article_idx,
+        };
+
+        if (citation_passage_keys(
+            passage->book,
+            passage->chapter,
+            passage->start_verse,
+            passage->end_verse,
+            &interval.start_key,
+            &interval.end_key
+        )) {
+            ARRAY_PUSH(out_intervals, &interval);
+        }
+    }
+}
+
+bool citation_index_write(
+    const char *filepath,
+    const string_view *article_paths,
+    i64 article_count,
+    CitationIndexIntervals *intervals
+) {
+    if (!filepath || !intervals || (article_count > 0 && !article_paths)) {
+        return false;
+    }
+
+    qsort(intervals->data, intervals->len, sizeof(CitationIndexInterval), citation_interval_qsort_cmp);
+
+    // An article citing the same passage twice is stored once
+    i64 unique_len = 0;
+    u32 max_interval_span = 0;
+
+    for (i64 interval_idx = 0; interval_idx < intervals->len; interval_idx++) {
+        const CitationIndexInterval *interval = &intervals->data[interval_idx];
+
+        if (unique_len > 0 && citation_interval_qsort_cmp(interval, &intervals->data[unique_len - 1]) == 0) {
+            continue;
+        }
+
+        if (interval->end_key - interval->start_key > max_interval_span) {
+            max_interval_span = interval->end_key - interval->start_key;
+        }
+
+        intervals->data[unique_len++] = *interval;
+    }
+    intervals->len = unique_len;
+
+    u64 strs_size = 0;
+    for (i64 article_idx = 0; article_idx < article_count; article_idx++) {
+        strs_size += article_paths[article_idx].len;
+    }
+
+    Arena arena = arena_make((i64) (strs_size + 1 + article_count * sizeof(CitationIndexArticle)) + 1024);
+
+    bool written = false;
+
+    DEFER(arena_free(&arena)) {
+        string strs = {&arena, (i64) strs_size + 1};
+        ARRAY_MAKE(&strs);
+        strs.len = 0;
+
+        CitationIndexArticles articles = {&arena, article_count > 0 ? article_count : 1};
+        ARRAY_MAKE(&articles);
+        articles.len = 0;
+
+        for (i64 article_idx = 0; article_idx < article_count; article_idx++) {
+            CitationIndexArticle article = {
+                .path_offset = (u32) strs.len,
+                .path_len = (u32) article_paths[article_idx].len,
+            };
+
+            memcpy(strs.data + strs.len, article_paths[article_idx].data, article_paths[article_idx].len);
+            strs.len += article_paths[article_idx].len;
+
+            ARRAY_PUSH(&articles, &article);
+        }
+
+        CitationIndexHeader header = {
+            .magic = CITATION_INDEX_MAGIC,
+            .version = CITATION_INDEX_VERSION,
+            .article_count = (u32) articles.len,
+            .interval_count = (u32) intervals->len,
+            .max_interval_span = max_interval_span,
+        };
+
+        header.articles_offset = sizeof(CitationIndexHeader);
+        header.intervals_offset = header.articles_offset + articles.len * sizeof(CitationIndexArticle);
+        header.strs_offset = header.intervals_offset + intervals->len * sizeof(CitationIndexInterval);
+        header.strs_size = strs.len;
+
+        IndexFileSection sections[] = {
+            {&header, sizeof(header)},
+            {articles.data, articles.len * sizeof(CitationIndexArticle)},
+            {intervals->data, intervals->len * sizeof(CitationIndexInterval)},
+            {strs.data, strs.len},
+        };
+
+        written = index_file_write(filepath, sections, STATIC_ARRAY_LEN(sections));
+    }
+
+    return written;
+}
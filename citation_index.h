@@ -0,0 +1,87 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_CITATION_INDEX_H
+#define ARTICLE_HTML_CITATION_INDEX_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+#include <altcore/arenas.h>
+
+#include "bible.h"
+#include "library.h"
+
+#define CITATION_INDEX_MAGIC 0x58494341u // "ACIX"
+#define CITATION_INDEX_VERSION 1u
+
+// On-disk layout: header, article table, intervals sorted by (start_key,
+// end_key, article_idx), then the string pool. A verse is keyed
+// book << 16 | chapter << 8 | verse, so a cited range is a single interval and
+// a whole chapter spans verses 0-255.
+typedef struct CITATION_INDEX_HEADER_T {
+    u32 magic;
+    u32 version;
+    u32 article_count;
+    u32 interval_count;
+    // Widest interval, bounds how far before a query a covering interval can start
+    u32 max_interval_span;
+    u32 reserved;
+    u64 articles_offset;
+    u64 intervals_offset;
+    u64 strs_offset;
+    u64 strs_size;
+} CitationIndexHeader;
+
+typedef struct CITATION_INDEX_ARTICLE_T {
+    u32 path_offset, path_len;
+} CitationIndexArticle;
+
+typedef struct CITATION_INDEX_INTERVAL_T {
+    u32 start_key;
+    u32 end_key;
+    u32 article_idx;
+} CitationIndexInterval;
+
+typedef struct CITATION_INDEX_INTERVALS_T {
+    ARRAY_FIELDS(CitationIndexInterval)
+} CitationIndexIntervals;
+
+typedef struct CITATION_INDEX_ARTICLE_IDXS_T {
+    ARRAY_FIELDS(u32)
+} CitationIndexArticleIdxs;
+
+typedef struct CITATION_INDEX_T {
+    const u8 *data;
+    u64 size;
+    const CitationIndexHeader *header;
+    const CitationIndexArticle *articles;
+    const CitationIndexInterval *intervals;
+    const char *strs;
+} CitationIndex;
+
+bool citation_index_open(CitationIndex *index, const char *filepath);
+
+void citation_index_close(CitationIndex *index);
+
+// Articles citing any verse of the passage, ascending and without duplicates
+CitationIndexArticleIdxs citation_index_find(Arena *arena, const CitationIndex *index, const BiblePassage *passage);
+
+string_view citation_index_article_path(const CitationIndex *index, u32 article_idx);
+
+void citation_index_push_passages(
+    u32 article_idx,
+    const ArticlePassage *passages,
+    i64 passage_count,
+    CitationIndexIntervals *out_intervals
+);
+
+// article_paths is indexed by article_idx, the intervals are sorted in place
+bool citation_index_write(
+    const char *filepath,
+    const string_view *article_paths,
+    i64 article_count,
+    CitationIndexIntervals *intervals
+);
+
+#endif //ARTICLE_HTML_CITATION_INDEX_H
@@ -0,0 +1,1441 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include "library.h"
+#include "daemon.h"
+#include "watch.h"
+#include "batch.h"
+#include "build.h"
+#include "search_index.h"
+#include "bible_search.h"
+#include "citation_index.h"
+#include "numa.h"
+#include "escape.h"
+
+static const i64 kCliBibleSearchArenaCapacity = 16LL * 1024LL * 1024LL;
+static const i32 kCliBibleSearchMaxHits = 10;
+
+static const char *kCliBudgetFlag = "--budget=";
+static const char *kCliRoundsFlag = "--rounds=";
+static const char *kCliBibFlag = "--bib=";
+static const char *kCliRootFlag = "--root=";
+static const char *kCliClientsFlag = "--clients=";
+
+static const int kCliIoBenchRounds = 5;
+static const long kCliAstBenchRounds = 200;
+static const long kCliPageBenchLookups = 4L * 1024L * 1024L;
+static const long kCliPageBenchRenderRounds = 64;
+static const int kCliScalingBenchRounds = 20;
+static const size_t kCliPushBenchChunkBytes = 16 * 1024;
+static const int kCliPushBenchRounds = 50;
+static const long kCliEscapeBenchTextBytes = 64L * 1024L;
+static const long kCliEscapeBenchRounds = 2000;
+
+// Bytes between characters that need an entity: clean prose, markup-heavy text and worst case
+static const long kCliEscapeBenchSpacings[] = {0, 64, 8, 1};
+
+// Unclosed metablock openers and stray braces, the worst case for metablock detection
+static const char *kCliBraceBenchPattern = "a {b {{c ";
+static const char *kCliBraceBenchMetadata = "---\ntitle = Braces\n---\n\n";
+static const long kCliBraceBenchMinLineBytes = 4096;
+
+// Any command writes its render spans as Chrome trace-event JSON to this path
+static const char *kCliTraceFileEnv = "ARTICLE_HTML_TRACE_FILE";
+
+// Representative of what authors look up: common and rare words, phrases and prefixes
+static const char *kCliBibleBenchQueries[] = {
+    "\"be still\"",
+    "love",
+    "the",
+    "faith hope",
+    "shepherd",
+    "\"in the beginning\"",
+    "righteous*",
+    "light darkness",
+    "\"the lord is my shepherd\"",
+    "bless*",
+    "grace peace",
+    "\"fear not\"",
+    "jerusalem",
+    "mercy",
+    "\"kingdom of heaven\"",
+    "water* life",
+};
+
+static void cli_usage(const char *program) {
+    fprintf(
+        stderr,
+        "usage:\n"
+        "  %s daemon <socket> [workers] [--root=<dir>]\n"
+        "  %s request <socket> <article> [--inline]\n"
+        "  %s bench <socket> <article> [requests] [--inline] [--clients=<n>]\n"
+        "  %s watch <src_dir> <out_dir> [workers]\n"
+        "  %s build <out_dir> <manifest> <article>... [--bib=<bib_file>]\n"
+        "  %s search <search_index> <term>\n"
+        "  %s bible-search <query>\n"
+        "  %s bible-bench [rounds]\n"
+        "  %s citations <citation_index> <passage>\n"
+        "  %s arena-stats <article>... [--budget=<bytes>]\n"
+        "  %s brace-bench [max_line_bytes]\n"
+        "  %s io-bench <out_dir> <article>... [--rounds=<n>]\n"
+        "  %s ast <article> <ast_file>\n"
+        "  %s ast-bench <article> [rounds]\n"
+        "  %s bibliography <bib_file> <key>...\n"
+        "  %s page-bench [lookups] [article...]\n"
+        "  %s scaling-bench <article>... [--rounds=<n>]\n"
+        "  %s push-bench <article> [chunk_bytes]\n"
+        "  %s escape-bench [rounds]\n",
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program,
+        program
+    );
+}
+
+static void cli_handle_stop_signal(int signal) {
+    (void) signal;
+    article_daemon_stop();
+    article_watch_stop();
+}
+
+static void cli_install_stop_handler() {
+    struct sigaction stop_action = {
+        .sa_handler = cli_handle_stop_signal,
+    };
+    sigaction(SIGINT, &stop_action, nullptr);
+    sigaction(SIGTERM, &stop_action, nullptr);
+}
+
+static char *cli_read_file(const char *filepath, size_t *out_len) {
+    FILE *fp = fopen(filepath, "rb");
+    if (!fp) {
+        return nullptr;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long file_size = ftell(fp);
+    rewind(fp);
+
+    char *bytes = malloc(file_size + 1);
+    if (bytes) {
+        *out_len = fread(bytes, sizeof(char), file_size, fp);
+        bytes[*out_len] = '\0';
+    }
+
+    fclose(fp);
+
+    return bytes;
+}
+
+static bool cli_has_flag(int argc, char **argv, const char *flag) {
+    for (int arg_idx = 1; arg_idx < argc; arg_idx++) {
+        if (strcmp(argv[arg_idx], flag) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static int cli_double_cmp(const void *a, const void *b) {
+    double lhs = *(const double *) a;
+    double rhs = *(const double *) b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static double cli_now_us() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (double) ts.tv_sec * 1e6 + (double) ts.tv_nsec / 1e3;
+}
+
+// The value of a --flag=<value> argument, nullptr when it isn't given
+static const char *cli_flag_value(int argc, char **argv, const char *flag) {
+    for (int arg_idx = 1; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], flag, strlen(flag)) == 0) {
+            return argv[arg_idx] + strlen(flag);
+        }
+    }
+
+    return nullptr;
+}
+
+static int cli_daemon(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    // Paths are served from the working directory unless told otherwise
+    const char *render_root = cli_flag_value(argc, argv, kCliRootFlag);
+
+    ArticleDaemonOptions options = {
+        .socket_path = argv[2],
+        .worker_count = argc > 3 && argv[3][0] != '-' ? atoi(argv[3]) : 0,
+        .render_root = render_root ? render_root : ".",
+    };
+
+    cli_install_stop_handler();
+
+    article_init();
+
+    int err = article_daemon_run(&options);
+    if (err) {
+        fprintf(stderr, "failed to listen on %s\n", options.socket_path);
+    }
+
+    article_uninit();
+
+    return err ? 1 : 0;
+}
+
+// One bench client, on its own connection, sending its share of the requests
+typedef struct CLI_REQUEST_CLIENT_T {
+    pthread_t thread;
+    const char *socket_path;
+    ArticleDaemonRequest request;
+    const char *payload;
+    size_t payload_len;
+    bool print_body;
+    double *latencies_us;
+    long request_count;
+    bool failed;
+} CliRequestClient;
+
+static void *cli_request_client_run(void *arg) {
+    CliRequestClient *client = arg;
+
+    int fd = article_daemon_connect(client->socket_path);
+    if (fd < 0) {
+        fprintf(stderr, "failed to connect to %s\n", client->socket_path);
+        client->failed = true;
+        return nullptr;
+    }
+
+    for (long request_idx = 0; request_idx < client->request_count; request_idx++) {
+        ArticleDaemonStatus status = ARTICLE_DAEMON_STATUS_OK;
+        char *body = nullptr;
+
+        double start_us = cli_now_us();
+        bool replied = article_daemon_request(
+            fd,
+            client->request,
+            client->payload,
+            client->payload_len,
+            &status,
+            &body,
+            nullptr
+        );
+        client->latencies_us[request_idx] = cli_now_us() - start_us;
+
+        if (!replied || status != ARTICLE_DAEMON_STATUS_OK) {
+            fprintf(stderr, "request failed (status %d)\n", replied ? (int) status : -1);
+            free(body);
+            client->failed = true;
+            break;
+        }
+
+        if (client->print_body) {
+            printf("%s\n", body);
+        }
+
+        free(body);
+    }
+
+    close(fd);
+
+    return nullptr;
+}
+
+static int cli_request(int argc, char **argv, bool bench) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    const char *socket_path = argv[2];
+    const char *article_path = argv[3];
+    bool send_inline = cli_has_flag(argc, argv, "--inline");
+    long request_count = bench && argc > 4 && argv[4][0] != '-' ? atol(argv[4]) : 1;
+    if (request_count <= 0) {
+        request_count = 1;
+    }
+
+    // Concurrent connections, each kept open across its requests
+    const char *clients_value = bench ? cli_flag_value(argc, argv, kCliClientsFlag) : nullptr;
+    long client_count = clients_value ? atol(clients_value) : 1;
+    if (client_count <= 0) {
+        client_count = 1;
+    }
+    if (client_count > request_count) {
+        client_count = request_count;
+    }
+
+    ArticleDaemonRequest request = ARTICLE_DAEMON_REQUEST_RENDER_PATH;
+    const char *payload = article_path;
+    size_t payload_len = strlen(article_path);
+    char *file_bytes = nullptr;
+
+    if (send_inline) {
+        file_bytes = cli_read_file(article_path, &payload_len);
+        if (!file_bytes) {
+            fprintf(stderr, "failed to read %s\n", article_path);
+            return 1;
+        }
+
+        request = ARTICLE_DAEMON_REQUEST_RENDER_BYTES;
+        payload = file_bytes;
+    }
+
+    double *latencies_us = calloc(request_count, sizeof(double));
+    CliRequestClient *clients = calloc(client_count, sizeof(CliRequestClient));
+    long assigned_count = 0;
+
+    double start_us = cli_now_us();
+
+    for (long client_idx = 0; client_idx < client_count; client_idx++) {
+        CliRequestClient *client = &clients[client_idx];
+        long share = request_count / client_count + (client_idx < request_count % client_count ? 1 : 0);
+
+        *client = (CliRequestClient){
+            .socket_path = socket_path,
+            .request = request,
+            .payload = payload,
+            .payload_len = payload_len,
+            .print_body = !bench,
+            .latencies_us = latencies_us + assigned_count,
+            .request_count = share,
+        };
+        assigned_count += share;
+
+        pthread_create(&client->thread, nullptr, cli_request_client_run, client);
+    }
+
+    int exit_code = 0;
+
+    for (long client_idx = 0; client_idx < client_count; client_idx++) {
+        pthread_join(clients[client_idx].thread, nullptr);
+
+        if (clients[client_idx].failed) {
+            exit_code = 1;
+        }
+    }
+
+    double elapsed_us = cli_now_us() - start_us;
+
+    if (bench && exit_code == 0) {
+        qsort(latencies_us, request_count, sizeof(double), cli_double_cmp);
+
+        double total_us = 0;
+        for (long request_idx = 0; request_idx < request_count; request_idx++) {
+            total_us += latencies_us[request_idx];
+        }
+
+        printf(
+            "requests %ld clients %ld %.0f/s mean %.1fus p50 %.1fus p99 %.1fus max %.1fus\n",
+            request_count,
+            client_count,
+            (double) request_count * 1e6 / elapsed_us,
+            total_us / (double) request_count,
+            latencies_us[request_count / 2],
+            latencies_us[(request_count * 99) / 100],
+            latencies_us[request_count - 1]
+        );
+    }
+
+    free(clients);
+    free(latencies_us);
+    free(file_bytes);
+
+    return exit_code;
+}
+
+static int cli_watch(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    ArticleWatchOptions options = {
+        .src_dir = argv[2],
+        .out_dir = argv[3],
+        .worker_count = argc > 4 ? atoi(argv[4]) : 0,
+    };
+
+    cli_install_stop_handler();
+
+    article_init();
+
+    int err = article_watch_run(&options);
+    if (err) {
+        fprintf(stderr, "failed to watch %s\n", options.src_dir);
+    }
+
+    article_uninit();
+
+    return err ? 1 : 0;
+}
+
+static int cli_build(int argc, char **argv) {
+    if (argc < 5) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    ArticleBuildOptions options = {
+        .out_dir = argv[2],
+        .manifest_filepath = argv[3],
+    };
+
+    const char **filepaths = calloc(argc, sizeof(char *));
+    int filepath_count = 0;
+    const char *bib_filepath = nullptr;
+
+    for (int arg_idx = 4; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], kCliBibFlag, strlen(kCliBibFlag)) == 0) {
+            bib_filepath = argv[arg_idx] + strlen(kCliBibFlag);
+        } else {
+            filepaths[filepath_count++] = argv[arg_idx];
+        }
+    }
+
+    article_init();
+
+    if (bib_filepath && !article_load_bibliography(bib_filepath, nullptr)) {
+        fprintf(stderr, "failed to load %s\n", bib_filepath);
+        article_uninit();
+        free(filepaths);
+        return 1;
+    }
+
+    ArticleBuildResult result = article_build(filepaths, filepath_count, &options);
+
+    article_uninit();
+
+    free(filepaths);
+
+    printf(
+        "skipped %zu rendered %zu unchanged %zu failed %zu\n",
+        result.skipped_count,
+        result.rendered_count,
+        result.unchanged_count,
+        result.failed_count
+    );
+
+    return result.failed_count > 0 || result.manifest_failed ? 1 : 0;
+}
+
+static int cli_search(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    SearchIndex index = {};
+    if (!search_index_open(&index, argv[2])) {
+        fprintf(stderr, "failed to open %s\n", argv[2]);
+        return 1;
+    }
+
+    string_view term = {
+        argv[3],
+        (i64) strlen(argv[3]),
+    };
+
+    SearchPostingsIter postings = {};
+    if (search_index_find(&index, &term, &postings)) {
+        SearchPosting posting = {};
+        while (search_postings_next(&postings, &posting)) {
+            string_view doc_path = search_index_doc_path(&index, posting.doc_idx);
+            printf(
+                "%.*s heading %u text %u\n",
+                (int) doc_path.len,
+                doc_path.data,
+                posting.heading_count,
+                posting.text_count
+            );
+        }
+    }
+
+    search_index_close(&index);
+
+    return 0;
+}
+
+static int cli_bible_search(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    article_init();
+
+    Arena arena = arena_make(kCliBibleSearchArenaCapacity);
+
+    string query = str_make(&arena, "%s", argv[2]);
+    BibleSearchHits hits = bible_search(&arena, &query, kCliBibleSearchMaxHits);
+
+    ARRAY_FOR(hit, &hits) {
+        string ref_str = bible_passage_ref_to_str(&arena, hit->passage);
+        printf("%.3f %s\n", hit->score, ref_str.data);
+    }
+
+    arena_free(&arena);
+
+    article_uninit();
+
+    return 0;
+}
+
+static int cli_bible_bench(int argc, char **argv) {
+    long round_count = argc > 2 ? atol(argv[2]) : 1000;
+    if (round_count <= 0) {
+        round_count = 1;
+    }
+
+    article_init();
+
+    i64 query_count = STATIC_ARRAY_LEN(kCliBibleBenchQueries);
+    Arena arena = arena_make(kCliBibleSearchArenaCapacity);
+
+    strings queries = {&arena, query_count};
+    ARRAY_MAKE(&queries);
+
+    for (i64 query_idx = 0; query_idx < query_count; query_idx++) {
+        queries.data[query_idx] = str_make(&arena, "%s", kCliBibleBenchQueries[query_idx]);
+    }
+
+    const i64 arena_start_offset = arena.offset;
+
+    double *latencies_us = calloc(round_count * query_count, sizeof(double));
+    i64 hit_count = 0;
+
+    for (long round_idx = 0; round_idx < round_count; round_idx++) {
+        for (i64 query_idx = 0; query_idx < query_count; query_idx++) {
+            double start_us = cli_now_us();
+            BibleSearchHits hits = bible_search(&arena, &queries.data[query_idx], kCliBibleSearchMaxHits);
+            latencies_us[round_idx * query_count + query_idx] = cli_now_us() - start_us;
+
+            hit_count += hits.len;
+            arena.offset = arena_start_offset;
+        }
+    }
+
+    long sample_count = round_count * query_count;
+    qsort(latencies_us, sample_count, sizeof(double), cli_double_cmp);
+
+    double total_us = 0;
+    for (long sample_idx = 0; sample_idx < sample_count; sample_idx++) {
+        total_us += latencies_us[sample_idx];
+    }
+
+    printf(
+        "queries %ld hits %lld mean %.1fus p50 %.1fus p99 %.1fus max %.1fus\n",
+        sample_count,
+        (long long) hit_count,
+        total_us / (double) sample_count,
+        latencies_us[sample_count / 2],
+        latencies_us[(sample_count * 99) / 100],
+        latencies_us[sample_count - 1]
+    );
+
+    free(latencies_us);
+    arena_free(&arena);
+
+    article_uninit();
+
+    return 0;
+}
+
+static int cli_citations(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    article_init();
+
+    CitationIndex index = {};
+    if (!citation_index_open(&index, argv[2])) {
+        fprintf(stderr, "failed to open %s\n", argv[2]);
+        article_uninit();
+        return 1;
+    }
+
+    Arena arena = arena_make(kCliBibleSearchArenaCapacity);
+
+    string ref = str_make(&arena, "%s", argv[3]);
+    BiblePassages passages = bible_parse_ref(&arena, &ref);
+
+    ARRAY_FOR(passage, &passages) {
+        CitationIndexArticleIdxs article_idxs = citation_index_find(&arena, &index, passage);
+
+        ARRAY_FOR(article_idx, &article_idxs) {
+            string_view article_path = citation_index_article_path(&index, *article_idx);
+            printf("%.*s\n", (int) article_path.len, article_path.data);
+        }
+    }
+
+    arena_free(&arena);
+    citation_index_close(&index);
+
+    article_uninit();
+
+    return 0;
+}
+
+static int cli_arena_stats(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    ArticleParseOptions options = {
+        .collect_arena_stats = true,
+    };
+
+    for (int arg_idx = 2; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], kCliBudgetFlag, strlen(kCliBudgetFlag)) == 0) {
+            options.arena_budget = strtoull(argv[arg_idx] + strlen(kCliBudgetFlag), nullptr, 10);
+        }
+    }
+
+    article_init();
+
+    bool over_budget = false;
+
+    for (int arg_idx = 2; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], kCliBudgetFlag, strlen(kCliBudgetFlag)) == 0) {
+            continue;
+        }
+
+        ArticleData data = article_parse_ex(argv[arg_idx], &options);
+        const ArticleArenaStats *stats = &data.arena_stats;
+
+        printf(
+            "%s peak %zu of %zu bytes%s\n",
+            argv[arg_idx],
+            stats->peak_bytes,
+            stats->capacity_bytes,
+            stats->over_budget ? " over budget" : ""
+        );
+
+        for (i32 site = 0; site < ARTICLE_ARENA_SITE_COUNT; site++) {
+            printf(
+                "  %-9s %12zu bytes %8zu allocations\n",
+                article_arena_site_name(site),
+                stats->sites[site].bytes,
+                stats->sites[site].allocation_count
+            );
+        }
+
+        over_budget = over_budget || stats->over_budget;
+
+        article_free(&data);
+    }
+
+    article_uninit();
+
+    return over_budget ? 1 : 0;
+}
+
+static int cli_brace_bench(int argc, char **argv) {
+    long max_line_bytes = argc > 2 ? atol(argv[2]) : 256 * 1024;
+    if (max_line_bytes < kCliBraceBenchMinLineBytes) {
+        max_line_bytes = kCliBraceBenchMinLineBytes;
+    }
+
+    article_init();
+
+    u64 metadata_len = strlen(kCliBraceBenchMetadata);
+    u64 pattern_len = strlen(kCliBraceBenchPattern);
+
+    char *bytes = malloc(metadata_len + max_line_bytes + pattern_len + 2);
+
+    for (long line_bytes = kCliBraceBenchMinLineBytes; line_bytes <= max_line_bytes; line_bytes *= 2) {
+        memcpy(bytes, kCliBraceBenchMetadata, metadata_len);
+
+        u64 len = metadata_len;
+        while (len - metadata_len < (u64) line_bytes) {
+            memcpy(bytes + len, kCliBraceBenchPattern, pattern_len);
+            len += pattern_len;
+        }
+        bytes[len++] = '\n';
+
+        double start_us = cli_now_us();
+        ArticleData data = article_parse_bytes(bytes, len, nullptr);
+        double elapsed_us = cli_now_us() - start_us;
+
+        article_free(&data);
+
+        printf(
+            "line %ld bytes %.2fms %.1fns/byte\n",
+            line_bytes,
+            elapsed_us / 1e3,
+            elapsed_us * 1e3 / (double) line_bytes
+        );
+    }
+
+    free(bytes);
+
+    article_uninit();
+
+    return 0;
+}
+
+// Evicts the files from the page cache so the next read goes to disk. Only
+// clean pages are dropped, so sources written moments ago may stay cached
+static void cli_drop_page_cache(char **filepaths, int filepath_count) {
+    for (int filepath_idx = 0; filepath_idx < filepath_count; filepath_idx++) {
+        int fd = open(filepaths[filepath_idx], O_RDONLY);
+        if (fd < 0) {
+            continue;
+        }
+
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+static int cli_io_bench(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    int rounds = kCliIoBenchRounds;
+
+    char **filepaths = calloc(argc, sizeof(char *));
+    int filepath_count = 0;
+
+    for (int arg_idx = 3; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], kCliRoundsFlag, strlen(kCliRoundsFlag)) == 0) {
+            rounds = atoi(argv[arg_idx] + strlen(kCliRoundsFlag));
+        } else {
+            filepaths[filepath_count++] = argv[arg_idx];
+        }
+    }
+
+    if (rounds <= 0) {
+        rounds = 1;
+    }
+
+    article_init();
+
+    const char *mode_names[2] = {
+        "current",
+        article_batch_io_uring() ? "io_uring" : "async_posix",
+    };
+    double elapsed_us[2] = {};
+    size_t failed_count = 0;
+
+    // The modes alternate so drift in the machine's load hits both alike
+    for (int round = 0; round < rounds; round++) {
+        for (int mode = 0; mode < 2; mode++) {
+            cli_drop_page_cache(filepaths, filepath_count);
+
+            ArticleBatchOptions options = {
+                .out_dir = argv[2],
+                .async_io = mode == 1,
+            };
+
+            double start_us = cli_now_us();
+            ArticleBatchResult result = article_batch_render(
+                (const char *const *) filepaths,
+                filepath_count,
+                &options
+            );
+            elapsed_us[mode] += cli_now_us() - start_us;
+
+            failed_count += result.failed_count;
+        }
+    }
+
+    article_uninit();
+
+    for (int mode = 0; mode < 2; mode++) {
+        double round_ms = elapsed_us[mode] / 1e3 / rounds;
+
+        printf(
+            "%-11s %d articles %.2fms per round %.0f articles/s\n",
+            mode_names[mode],
+            filepath_count,
+            round_ms,
+            round_ms > 0 ? filepath_count * 1e3 / round_ms : 0
+        );
+    }
+
+    free(filepaths);
+
+    return failed_count > 0 ? 1 : 0;
+}
+
+static int cli_ast(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    article_init();
+
+    bool written = article_ast_write(argv[2], argv[3]);
+    if (!written) {
+        fprintf(stderr, "failed to write %s\n", argv[3]);
+    }
+
+    article_uninit();
+
+    return written ? 0 : 1;
+}
+
+static int cli_ast_bench(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    long round_count = argc > 3 ? atol(argv[3]) : kCliAstBenchRounds;
+    if (round_count <= 0) {
+        round_count = 1;
+    }
+
+    article_init();
+
+    size_t ast_size = 0;
+    void *ast = article_ast_make(argv[2], &ast_size);
+    if (!ast) {
+        fprintf(stderr, "failed to read %s\n", argv[2]);
+        article_uninit();
+        return 1;
+    }
+
+    ArticleParseOptions options = {.source_path = argv[2]};
+
+    ArticleData parsed = article_parse_ex(argv[2], &options);
+    ArticleData loaded = article_parse_ast(ast, ast_size, &options);
+
+    bool same = parsed.body_html && loaded.body_html
+                    ? strcmp(parsed.body_html, loaded.body_html) == 0
+                    : parsed.body_html == loaded.body_html;
+
+    article_free(&parsed);
+    article_free(&loaded);
+
+    if (!same) {
+        fprintf(stderr, "%s renders differently from its AST\n", argv[2]);
+        free(ast);
+        article_uninit();
+        return 1;
+    }
+
+    double parse_us = 0;
+    double ast_us = 0;
+
+    // Alternating keeps drift in the machine's load from favouring one side
+    for (long round_idx = 0; round_idx < round_count; round_idx++) {
+        double start_us = cli_now_us();
+        ArticleData data = article_parse_ex(argv[2], &options);
+        parse_us += cli_now_us() - start_us;
+        article_free(&data);
+
+        start_us = cli_now_us();
+        data = article_parse_ast(ast, ast_size, &options);
+        ast_us += cli_now_us() - start_us;
+        article_free(&data);
+    }
+
+    printf(
+        "ast %zu bytes parse %.1fus ast %.1fus speedup %.2fx\n",
+        ast_size,
+        parse_us / (double) round_count,
+        ast_us / (double) round_count,
+        ast_us > 0 ? parse_us / ast_us : 0
+    );
+
+    free(ast);
+    article_uninit();
+
+    return 0;
+}
+
+static int cli_bibliography(int argc, char **argv) {
+    if (argc < 4) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    article_init();
+
+    if (!article_load_bibliography(argv[2], nullptr)) {
+        fprintf(stderr, "failed to load %s\n", argv[2]);
+        article_uninit();
+        return 1;
+    }
+
+    // Renders the keys through the same path an article's citations take
+    size_t source_size = strlen("---\n---\n\nSee {{cite }}\n") + 1;
+    for (int arg_idx = 3; arg_idx < argc; arg_idx++) {
+        source_size += strlen(argv[arg_idx]) + 1;
+    }
+
+    char *source = malloc(source_size);
+    int source_len = snprintf(source, source_size, "---\n---\n\nSee {{cite ");
+    for (int arg_idx = 3; arg_idx < argc; arg_idx++) {
+        source_len += snprintf(
+            source + source_len,
+            source_size - source_len,
+            "%s%s",
+            arg_idx > 3 ? "," : "",
+            argv[arg_idx]
+        );
+    }
+    snprintf(source + source_len, source_size - source_len, "}}\n");
+
+    ArticleData data = article_parse_bytes(source, strlen(source), nullptr);
+    printf("%s\n", data.body_html ? data.body_html : "");
+
+    article_free(&data);
+    free(source);
+
+    article_uninit();
+
+    return 0;
+}
+
+// Counts this thread's user-space dTLB load misses from now on, -1 where perf
+// events are off limits
+static int cli_dtlb_counter_start() {
+    struct perf_event_attr attr = {
+        .type = PERF_TYPE_HW_CACHE,
+        .size = sizeof(struct perf_event_attr),
+        .config = PERF_COUNT_HW_CACHE_DTLB
+                  | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        .disabled = 1,
+        .exclude_kernel = 1,
+        .exclude_hv = 1,
+    };
+
+    int counter_fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counter_fd >= 0) {
+        ioctl(counter_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter_fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    return counter_fd;
+}
+
+// The misses since the counter started, -1 without a counter
+static long long cli_dtlb_counter_stop(int counter_fd) {
+    if (counter_fd < 0) {
+        return -1;
+    }
+
+    ioctl(counter_fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    long long miss_count = -1;
+    if (read(counter_fd, &miss_count, sizeof(miss_count)) != sizeof(miss_count)) {
+        miss_count = -1;
+    }
+
+    close(counter_fd);
+
+    return miss_count;
+}
+
+static void cli_dtlb_misses_print(long long miss_count) {
+    if (miss_count >= 0) {
+        printf(" dTLB misses %lld\n", miss_count);
+    } else {
+        printf(" dTLB misses unavailable\n");
+    }
+}
+
+static void cli_dtlb_misses_change_print(const char *what, const long long miss_counts[2]) {
+    if (miss_counts[0] > 0 && miss_counts[1] >= 0) {
+        printf(
+            "%s dTLB misses %+.1f%% on huge pages\n",
+            what,
+            100.0 * (double) (miss_counts[1] - miss_counts[0]) / (double) miss_counts[0]
+        );
+    }
+}
+
+// Random single-verse lookups with the corpus on regular pages, then on huge
+// pages. Given articles, renders them as well, their document arenas advised
+// onto huge pages in the second run
+static int cli_page_bench(int argc, char **argv) {
+    long lookup_count = argc > 2 ? atol(argv[2]) : kCliPageBenchLookups;
+    if (lookup_count <= 0) {
+        lookup_count = 1;
+    }
+
+    BiblePassage *lookups = calloc(lookup_count, sizeof(BiblePassage));
+    if (!lookups) {
+        return 1;
+    }
+
+    long long lookup_dtlb_misses[2] = {-1, -1};
+    long long render_dtlb_misses[2] = {-1, -1};
+
+    for (int huge_pages = 0; huge_pages <= 1; huge_pages++) {
+        ArticleConfig config = {
+            .huge_pages = huge_pages,
+        };
+        article_init_ex(&config);
+
+        // The same verses in the same order for both runs, xorshift from a fixed seed
+        if (!huge_pages) {
+            u64 random = 0x9E3779B97F4A7C15ULL;
+
+            for (long lookup_idx = 0; lookup_idx < lookup_count; lookup_idx++) {
+                BiblePassage *lookup = &lookups[lookup_idx];
+
+                do {
+                    random ^= random << 13;
+                    random ^= random >> 7;
+                    random ^= random << 17;
+
+                    lookup->book = (BibleBook) (random % BIBLE_BOOK_COUNT);
+                } while (bible_chapter_count(lookup->book) == 0);
+
+                lookup->ch_v.chapter = 1 + (i32) ((random >> 8) % bible_chapter_count(lookup->book));
+
+                i32 verse_count = bible_verse_count(lookup->book, lookup->ch_v.chapter);
+                lookup->ch_v.start_verse = verse_count > 0 ? 1 + (i32) ((random >> 32) % verse_count) : 1;
+            }
+        }
+
+        int counter_fd = cli_dtlb_counter_start();
+
+        double start_us = cli_now_us();
+        u64 checksum = 0;
+
+        for (long lookup_idx = 0; lookup_idx < lookup_count; lookup_idx++) {
+            const BiblePassage *lookup = &lookups[lookup_idx];
+
+            string_view verse = bible_get_verse(lookup->book, lookup->ch_v.chapter, lookup->ch_v.start_verse);
+            checksum += verse.len > 0 ? (u64) verse.len + (u8) verse.data[verse.len - 1] : 0;
+        }
+
+        double elapsed_us = cli_now_us() - start_us;
+
+        lookup_dtlb_misses[huge_pages] = cli_dtlb_counter_stop(counter_fd);
+
+        ArticleHugePagesReport report = article_huge_pages_report();
+
+        printf(
+            "%-7s lookups %ld %.1fns/lookup checksum %llu corpus %zu bytes, %zu on huge pages (%d of %d hugetlb)",
+            huge_pages ? "huge" : "regular",
+            lookup_count,
+            elapsed_us * 1e3 / (double) lookup_count,
+            (unsigned long long) checksum,
+            report.corpus_bytes,
+            report.corpus_huge_bytes,
+            report.hugetlb_count,
+            report.translation_count
+        );
+        cli_dtlb_misses_print(lookup_dtlb_misses[huge_pages]);
+
+        if (argc > 3) {
+            long render_count = 0;
+            size_t html_bytes = 0;
+
+            counter_fd = cli_dtlb_counter_start();
+            start_us = cli_now_us();
+
+            for (long round_idx = 0; round_idx < kCliPageBenchRenderRounds; round_idx++) {
+                for (int arg_idx = 3; arg_idx < argc; arg_idx++) {
+                    ArticleData data = article_parse(argv[arg_idx]);
+                    html_bytes += data.body_html ? strlen(data.body_html) : 0;
+                    render_count++;
+                    article_free(&data);
+                }
+            }
+
+            elapsed_us = cli_now_us() - start_us;
+
+            render_dtlb_misses[huge_pages] = cli_dtlb_counter_stop(counter_fd);
+
+            printf(
+                "%-7s renders %ld %.1fus/render html %zu bytes",
+                huge_pages ? "huge" : "regular",
+                render_count,
+                elapsed_us / (double) render_count,
+                html_bytes
+            );
+            cli_dtlb_misses_print(render_dtlb_misses[huge_pages]);
+        }
+
+        article_uninit();
+    }
+
+    cli_dtlb_misses_change_print("lookup", lookup_dtlb_misses);
+    cli_dtlb_misses_change_print("render", render_dtlb_misses);
+
+    free(lookups);
+
+    return 0;
+}
+
+// Renders the articles rounds times over with 1, 2, 4... workers up to one per
+// CPU, unpinned and pinned with a per-node corpus. Which of the two goes first
+// alternates with each worker count, so neither always gets the warm caches
+static int cli_scaling_bench(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    int rounds = kCliScalingBenchRounds;
+
+    char **articles = calloc(argc, sizeof(char *));
+    int article_count = 0;
+
+    for (int arg_idx = 2; arg_idx < argc; arg_idx++) {
+        if (strncmp(argv[arg_idx], kCliRoundsFlag, strlen(kCliRoundsFlag)) == 0) {
+            rounds = atoi(argv[arg_idx] + strlen(kCliRoundsFlag));
+        } else {
+            articles[article_count++] = argv[arg_idx];
+        }
+    }
+
+    if (rounds <= 0) {
+        rounds = 1;
+    }
+
+    // One batch holds every round, so the workers stay busy for the whole run
+    size_t filepath_count = (size_t) article_count * rounds;
+    const char **filepaths = calloc(filepath_count > 0 ? filepath_count : 1, sizeof(char *));
+    for (size_t filepath_idx = 0; filepath_idx < filepath_count; filepath_idx++) {
+        filepaths[filepath_idx] = articles[filepath_idx % article_count];
+    }
+
+    article_init();
+
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpu_count <= 0) {
+        cpu_count = 1;
+    }
+
+    NumaTopology topology = {};
+    numa_topology_detect(&topology);
+    printf("%d NUMA node(s), %ld CPUs\n", topology.node_count, cpu_count);
+
+    size_t failed_count = 0;
+    long worker_count = 1;
+    int pinned_first = 0;
+
+    for (;;) {
+        double articles_per_s[2] = {};
+        size_t pinned_count = 0;
+
+        for (int run_idx = 0; run_idx < 2; run_idx++) {
+            int pinned = run_idx ^ pinned_first;
+            ArticleBatchOptions options = {
+                .worker_count = (int) worker_count,
+                .pin_workers = pinned,
+                .replicate_corpus = pinned,
+            };
+
+            double start_us = cli_now_us();
+            ArticleBatchResult result = article_batch_render(filepaths, filepath_count, &options);
+            double elapsed_us = cli_now_us() - start_us;
+
+            articles_per_s[pinned] = elapsed_us > 0 ? (double) filepath_count * 1e6 / elapsed_us : 0;
+            failed_count += result.failed_count;
+
+            if (pinned) {
+                pinned_count = result.pinned_count;
+            }
+        }
+
+        printf(
+            "workers %-3ld unpinned %.0f articles/s pinned %.0f articles/s (%+.1f%%, %zu pinned)\n",
+            worker_count,
+            articles_per_s[0],
+            articles_per_s[1],
+            articles_per_s[0] > 0 ? 100.0 * (articles_per_s[1] - articles_per_s[0]) / articles_per_s[0] : 0,
+            pinned_count
+        );
+
+        if (worker_count >= cpu_count) {
+            break;
+        }
+        pinned_first ^= 1;
+        worker_count = worker_count * 2 < cpu_count ? worker_count * 2 : cpu_count;
+    }
+
+    article_uninit();
+
+    free(filepaths);
+    free(articles);
+
+    return failed_count > 0 ? 1 : 0;
+}
+
+typedef struct CLI_PUSH_SINK_T {
+    size_t fed_len;
+    size_t html_len;
+    // Bytes fed when the first HTML came out, 0 until then
+    size_t first_html_fed_len;
+} CliPushSink;
+
+static void cli_push_sink(void *ctx, const char *html, size_t len) {
+    CliPushSink *sink = ctx;
+
+    if (sink->html_len == 0) {
+        sink->first_html_fed_len = sink->fed_len;
+    }
+    sink->html_len += len;
+}
+
+// Pushes an article a chunk at a time as if it came off the network, and
+// compares how long the push parser takes once the last byte is in with
+// parsing the whole buffer then
+static int cli_push_bench(int argc, char **argv) {
+    if (argc < 3) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    long chunk_len = argc > 3 ? atol(argv[3]) : (long) kCliPushBenchChunkBytes;
+    if (chunk_len <= 0) {
+        chunk_len = 1;
+    }
+
+    size_t len = 0;
+    char *bytes = cli_read_file(argv[2], &len);
+    if (!bytes) {
+        fprintf(stderr, "failed to read %s\n", argv[2]);
+        return 1;
+    }
+
+    article_init();
+
+    ArticleParseOptions options = {.source_path = argv[2]};
+
+    double feed_us = 0;
+    double finish_us = 0;
+    double parse_us = 0;
+    CliPushSink sink = {};
+    bool sink_matches = true;
+
+    for (int round_idx = 0; round_idx < kCliPushBenchRounds; round_idx++) {
+        sink = (CliPushSink){};
+
+        // A stream's length isn't always known up front, the arena then grows as it fills
+        ArticleParser *parser = article_parser_create(&options, 0, cli_push_sink, &sink);
+
+        for (size_t offset = 0; offset < len; offset += chunk_len) {
+            size_t feed_len = len - offset < (size_t) chunk_len ? len - offset : (size_t) chunk_len;
+            sink.fed_len = offset + feed_len;
+
+            double start_us = cli_now_us();
+            article_parser_feed(parser, bytes + offset, feed_len);
+            feed_us += cli_now_us() - start_us;
+        }
+
+        double start_us = cli_now_us();
+        ArticleData pushed = article_parser_finish(parser);
+        finish_us += cli_now_us() - start_us;
+
+        size_t body_len = pushed.body_html ? strlen(pushed.body_html) : 0;
+        sink_matches = sink_matches && body_len == sink.html_len;
+        article_free(&pushed);
+
+        start_us = cli_now_us();
+        ArticleData parsed = article_parse_bytes(bytes, len, &options);
+        parse_us += cli_now_us() - start_us;
+        article_free(&parsed);
+    }
+
+    printf(
+        "%zu bytes in %ld byte chunks, first html after %zu bytes\n"
+        "feed %.1fus, after the last byte finish %.1fus vs parse_bytes %.1fus (%.1fx sooner)\n",
+        len,
+        chunk_len,
+        sink.first_html_fed_len,
+        feed_us / kCliPushBenchRounds,
+        finish_us / kCliPushBenchRounds,
+        parse_us / kCliPushBenchRounds,
+        finish_us > 0 ? parse_us / finish_us : 0
+    );
+
+    article_uninit();
+    free(bytes);
+
+    if (!sink_matches) {
+        fprintf(stderr, "%s: the sink saw other html than the body\n", argv[2]);
+        return 1;
+    }
+
+    return 0;
+}
+
+static int cli_escape_bench(int argc, char **argv) {
+    long rounds = argc > 2 ? atol(argv[2]) : kCliEscapeBenchRounds;
+    if (rounds <= 0) {
+        rounds = kCliEscapeBenchRounds;
+    }
+
+    char *text = malloc(kCliEscapeBenchTextBytes);
+    const char *prose = "In the beginning was the Word, and the Word was with God. ";
+    const i64 prose_len = (i64) strlen(prose);
+
+    // Room for the worst case, every byte a six byte entity, so no round grows the string
+    Arena arena = arena_make(kCliEscapeBenchTextBytes * 16);
+
+    for (i64 spacing_idx = 0; spacing_idx < STATIC_ARRAY_LEN(kCliEscapeBenchSpacings); spacing_idx++) {
+        const long spacing = kCliEscapeBenchSpacings[spacing_idx];
+
+        for (long c_idx = 0; c_idx < kCliEscapeBenchTextBytes; c_idx++) {
+            bool hit = spacing > 0 && c_idx % spacing == spacing - 1;
+            text[c_idx] = hit ? "<>&\"'"[c_idx / spacing % 5] : prose[c_idx % prose_len];
+        }
+
+        arena.offset = 0;
+        string out_html = str_make(&arena, "%*s", (i32) (kCliEscapeBenchTextBytes * 6), "");
+
+        i64 escaped_len = 0;
+        double start_us = cli_now_us();
+        for (long round_idx = 0; round_idx < rounds; round_idx++) {
+            out_html.len = 0;
+            html_escape_append(&out_html, text, kCliEscapeBenchTextBytes);
+            escaped_len = out_html.len;
+        }
+        double elapsed_us = cli_now_us() - start_us;
+
+        double text_bytes = (double) kCliEscapeBenchTextBytes * (double) rounds;
+        printf(
+            "%s %ld bytes -> %lld bytes %.3fns/byte %.2fGB/s\n",
+            spacing ? "entity every" : "no entities",
+            spacing,
+            (long long) escaped_len,
+            elapsed_us * 1e3 / text_bytes,
+            text_bytes / (elapsed_us * 1e3)
+        );
+    }
+
+    arena_free(&arena);
+    free(text);
+
+    return 0;
+}
+
+static int cli_run(int argc, char **argv) {
+    const char *command = argv[1];
+
+    if (strcmp(command, "daemon") == 0) {
+        return cli_daemon(argc, argv);
+    }
+    if (strcmp(command, "request") == 0) {
+        return cli_request(argc, argv, false);
+    }
+    if (strcmp(command, "bench") == 0) {
+        return cli_request(argc, argv, true);
+    }
+    if (strcmp(command, "watch") == 0) {
+        return cli_watch(argc, argv);
+    }
+    if (strcmp(command, "build") == 0) {
+        return cli_build(argc, argv);
+    }
+    if (strcmp(command, "search") == 0) {
+        return cli_search(argc, argv);
+    }
+    if (strcmp(command, "bible-search") == 0) {
+        return cli_bible_search(argc, argv);
+    }
+    if (strcmp(command, "bible-bench") == 0) {
+        return cli_bible_bench(argc, argv);
+    }
+    if (strcmp(command, "citations") == 0) {
+        return cli_citations(argc, argv);
+    }
+    if (strcmp(command, "arena-stats") == 0) {
+        return cli_arena_stats(argc, argv);
+    }
+    if (strcmp(command, "brace-bench") == 0) {
+        return cli_brace_bench(argc, argv);
+    }
+    if (strcmp(command, "io-bench") == 0) {
+        return cli_io_bench(argc, argv);
+    }
+    if (strcmp(command, "ast") == 0) {
+        return cli_ast(argc, argv);
+    }
+    if (strcmp(command, "ast-bench") == 0) {
+        return cli_ast_bench(argc, argv);
+    }
+    if (strcmp(command, "bibliography") == 0) {
+        return cli_bibliography(argc, argv);
+    }
+    if (strcmp(command, "page-bench") == 0) {
+        return cli_page_bench(argc, argv);
+    }
+    if (strcmp(command, "scaling-bench") == 0) {
+        return cli_scaling_bench(argc, argv);
+    }
+    if (strcmp(command, "push-bench") == 0) {
+        return cli_push_bench(argc, argv);
+    }
+    if (strcmp(command, "escape-bench") == 0) {
+        return cli_escape_bench(argc, argv);
+    }
+
+    cli_usage(argv[0]);
+
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cli_usage(argv[0]);
+        return 1;
+    }
+
+    const char *trace_filepath = getenv(kCliTraceFileEnv);
+    if (trace_filepath && !article_trace_start()) {
+        fprintf(stderr, "%s is set but tracing isn't compiled in\n", kCliTraceFileEnv);
+        trace_filepath = nullptr;
+    }
+
+    int exit_code = cli_run(argc, argv);
+
+    if (trace_filepath && !article_trace_stop(trace_filepath)) {
+        fprintf(stderr, "failed to write trace %s\n", trace_filepath);
+    }
+
+    return exit_code;
+}
@@ -0,0 +1,217 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "compress.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const u64 kCompressorInitialCapacity = 64 * 1024;
+static const i32 kGzipWindowBits = 15 + 16; // +16 selects the gzip wrapper
+
+static void html_compressor_reserve(HtmlCompressor *compressor, u64 extra_len) {
+    if (compressor->out_len + extra_len <= compressor->out_cap) {
+        return;
+    }
+
+    u64 new_cap = compressor->out_cap ? compressor->out_cap : kCompressorInitialCapacity;
+    while (new_cap < compressor->out_len + extra_len) {
+        new_cap *= 2;
+    }
+
+    u8 *new_data = realloc(compressor->out_data, new_cap);
+    assert(new_data);
+
+    compressor->out_data = new_data;
+    compressor->out_cap = new_cap;
+}
+
+static void html_compressor_gzip(HtmlCompressor *compressor, const char *bytes, i64 len, i32 flush) {
+    z_stream *stream = &compressor->gzip_stream;
+
+    stream->next_in = (Bytef *) bytes;
+    stream->avail_in = (uInt) len;
+
+    i32 status = Z_OK;
+    do {
+        html_compressor_reserve(compressor, deflateBound(stream, stream->avail_in) + 64);
+
+        stream->next_out = compressor->out_data + compressor->out_len;
+        stream->avail_out = (uInt) (compressor->out_cap - compressor->out_len);
+
+        status = deflate(stream, flush);
+        assert(status != Z_STREAM_ERROR);
+
+        compressor->out_len = compressor->out_cap - stream->avail_out;
+    } while (stream->avail_in > 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+}
+
+#ifdef ARTICLE_HTML_ZSTD
+static void html_compressor_zstd(HtmlCompressor *compressor, const char *bytes, i64 len, ZSTD_EndDirective end) {
+    ZSTD_inBuffer in = {bytes, (size_t) len, 0};
+
+    size_t remaining = 0;
+    do {
+        html_compressor_reserve(compressor, ZSTD_CStreamOutSize());
+
+        ZSTD_outBuffer out = {
+            compressor->out_data + compressor->out_len,
+            compressor->out_cap - compressor->out_len,
+            0
+        };
+
+        remaining = ZSTD_compressStream2(compressor->zstd_ctx, &out, &in, end);
+        assert(!ZSTD_isError(remaining));
+
+        compressor->out_len += out.pos;
+    } while (in.pos < in.size || (end == ZSTD_e_end && remaining > 0));
+}
+#endif
+
+bool html_compressor_init(HtmlCompressor *compressor, ArticleCompression compression, i32 level) {
+    if (!compressor) {
+        return false;
+    }
+
+    *compressor = (HtmlCompressor){
+        .compression = compression,
+        .level = level,
+    };
+
+    switch (compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            i32 gzip_level = level > 0 ? level : Z_DEFAULT_COMPRESSION;
+            return deflateInit2(
+                &compressor->gzip_stream,
+                gzip_level,
+                Z_DEFLATED,
+                kGzipWindowBits,
+                8,
+                Z_DEFAULT_STRATEGY
+            ) == Z_OK;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            compressor->zstd_ctx = ZSTD_createCCtx();
+            if (!compressor->zstd_ctx) {
+                return false;
+            }
+            if (level > 0) {
+                ZSTD_CCtx_setParameter(compressor->zstd_ctx, ZSTD_c_compressionLevel, level);
+            }
+            return true;
+#else
+            return false;
+#endif
+        }
+        default:
+            return false;
+    }
+}
+
+void html_compressor_free(HtmlCompressor *compressor) {
+    if (!compressor) {
+        return;
+    }
+
+    switch (compressor->compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            deflateEnd(&compressor->gzip_stream);
+            break;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            ZSTD_freeCCtx(compressor->zstd_ctx);
+#endif
+            break;
+        }
+        default:
+            break;
+    }
+
+    free(compressor->out_data);
+
+    *compressor = (HtmlCompressor){};
+}
+
+void html_compressor_begin(HtmlCompressor *compressor) {
+    compressor->out_len = 0;
+
+    switch (compressor->compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            i32 status = deflateReset(&compressor->gzip_stream);
+            assert(status == Z_OK);
+            break;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            ZSTD_CCtx_reset(compressor->zstd_ctx, ZSTD_reset_session_only);
+#endif
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void html_compressor_feed(HtmlCompressor *compressor, const char *bytes, i64 len) {
+    if (len <= 0) {
+        return;
+    }
+
+    switch (compressor->compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            html_compressor_gzip(compressor, bytes, len, Z_NO_FLUSH);
+            break;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            html_compressor_zstd(compressor, bytes, len, ZSTD_e_continue);
+#endif
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void html_compressor_finish(HtmlCompressor *compressor) {
+    switch (compressor->compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            html_compressor_gzip(compressor, nullptr, 0, Z_FINISH);
+            break;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            html_compressor_zstd(compressor, nullptr, 0, ZSTD_e_end);
+#endif
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+u8 *html_compressor_take(HtmlCompressor *compressor, u64 *out_len) {
+    u8 *out_data = compressor->out_data;
+    *out_len = compressor->out_len;
+
+    compressor->out_data = nullptr;
+    compressor->out_len = 0;
+    compressor->out_cap = 0;
+
+    return out_data;
+}
+
+const char *html_compressor_extension(ArticleCompression compression) {
+    switch (compression) {
+        case ARTICLE_COMPRESSION_GZIP:
+            return ".gz";
+        case ARTICLE_COMPRESSION_ZSTD:
+            return ".zst";
+        default:
+            return "";
+    }
+}
@@ -0,0 +1,47 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_COMPRESS_H
+#define ARTICLE_HTML_COMPRESS_H
+
+#include <zlib.h>
+#include <altcore/types.h>
+
+#ifdef ARTICLE_HTML_ZSTD
+#include <zstd.h>
+#endif
+
+#include "library.h"
+
+// Streaming compressor whose context and output buffer are reused across
+// documents, so a worker pays for setup once
+typedef struct HTML_COMPRESSOR_T {
+    ArticleCompression compression;
+    i32 level;
+    z_stream gzip_stream;
+#ifdef ARTICLE_HTML_ZSTD
+    ZSTD_CCtx *zstd_ctx;
+#endif
+    u8 *out_data;
+    u64 out_len;
+    u64 out_cap;
+} HtmlCompressor;
+
+bool html_compressor_init(HtmlCompressor *compressor, ArticleCompression compression, i32 level);
+
+void html_compressor_free(HtmlCompressor *compressor);
+
+void html_compressor_begin(HtmlCompressor *compressor);
+
+void html_compressor_feed(HtmlCompressor *compressor, const char *bytes, i64 len);
+
+void html_compressor_finish(HtmlCompressor *compressor);
+
+// Hands the finished output over to the caller to free(), the next document
+// grows a new buffer
+u8 *html_compressor_take(HtmlCompressor *compressor, u64 *out_len);
+
+const char *html_compressor_extension(ArticleCompression compression);
+
+#endif //ARTICLE_HTML_COMPRESS_H
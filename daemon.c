@@ -0,0 +1,685 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "daemon.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <altcore/types.h>
+
+#include "library.h"
+
+#define DAEMON_FRAME_MAGIC 0x4C544841u // "AHTL"
+
+static const i32 kDaemonListenBacklog = 128;
+static const i32 kDaemonPollIntervalMs = 100;
+static const i64 kDaemonConnQueueCapacity = 1024;
+static const u64 kDaemonDefaultMaxRequestLen = 16LL * 1024LL * 1024LL;
+// A reply announcing more than this is refused by the client before it allocates
+static const u64 kDaemonMaxReplyLen = 1024LL * 1024LL * 1024LL;
+// A client that stalls mid-frame is dropped after this long, so it can't hold a worker
+static const i32 kDaemonIoTimeoutMs = 5000;
+// A kept-alive connection with no request for this long is closed
+static const i64 kDaemonIdleTimeoutMs = 60000;
+
+// Every request and reply is a header followed by len payload bytes
+typedef struct DAEMON_FRAME_HEADER_T {
+    u32 magic;
+    u32 code; // ArticleDaemonRequest or ArticleDaemonStatus
+    u64 len;
+} DaemonFrameHeader;
+
+// Connections with a request waiting go to the workers, one request at a
+// time. A worker parks the connection again after replying and the accept
+// loop polls it alongside the listening socket, so an idle client holds no
+// worker
+typedef struct DAEMON_CONN_QUEUE_T {
+    pthread_mutex_t mutex;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    i32 *fds;
+    i64 head;
+    i64 len;
+    bool closed;
+    // Handed back by the workers, the accept loop takes them on a wake
+    i32 *parked_fds;
+    i64 parked_len;
+    i64 parked_cap;
+    i32 wake_fds[2];
+    // One per worker, -1 while it waits, shut down on stop so a read returns
+    i32 *active_fds;
+} DaemonConnQueue;
+
+typedef struct DAEMON_IDLE_CONN_T {
+    i32 fd;
+    i64 deadline_ms;
+} DaemonIdleConn;
+
+typedef struct DAEMON_WORKER_T {
+    pthread_t thread;
+    i64 worker_idx;
+    DaemonConnQueue *queue;
+    u64 max_request_len;
+    // Resolved, RENDER_PATH is refused without one
+    const char *render_root;
+    char *request_buffer;
+    u64 request_buffer_cap;
+} DaemonWorker;
+
+static volatile sig_atomic_t g_daemon_stopping = 0;
+
+static bool daemon_read_full(i32 fd, void *buffer, u64 len) {
+    u8 *cursor = buffer;
+
+    while (len > 0) {
+        ssize_t read_len = read(fd, cursor, len);
+        if (read_len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read_len <= 0) {
+            return false;
+        }
+
+        cursor += read_len;
+        len -= read_len;
+    }
+
+    return true;
+}
+
+static bool daemon_write_full(i32 fd, const void *buffer, u64 len) {
+    const u8 *cursor = buffer;
+
+    while (len > 0) {
+        ssize_t written_len = send(fd, cursor, len, MSG_NOSIGNAL);
+        if (written_len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written_len <= 0) {
+            return false;
+        }
+
+        cursor += written_len;
+        len -= written_len;
+    }
+
+    return true;
+}
+
+static bool daemon_write_frame(i32 fd, u32 code, const char *payload, u64 payload_len) {
+    DaemonFrameHeader header = {
+        DAEMON_FRAME_MAGIC,
+        code,
+        payload_len,
+    };
+
+    return daemon_write_full(fd, &header, sizeof(header))
+           && daemon_write_full(fd, payload, payload_len);
+}
+
+static i64 daemon_now_ms() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (i64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void daemon_queue_push(DaemonConnQueue *queue, i32 fd) {
+    pthread_mutex_lock(&queue->mutex);
+
+    while (queue->len == kDaemonConnQueueCapacity && !queue->closed) {
+        pthread_cond_wait(&queue->not_full, &queue->mutex);
+    }
+
+    if (queue->closed) {
+        close(fd);
+    } else {
+        queue->fds[(queue->head + queue->len) % kDaemonConnQueueCapacity] = fd;
+        queue->len++;
+        pthread_cond_signal(&queue->not_empty);
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static i32 daemon_queue_pop(DaemonConnQueue *queue, i64 worker_idx) {
+    i32 fd = -1;
+
+    pthread_mutex_lock(&queue->mutex);
+
+    while (queue->len == 0 && !queue->closed) {
+        pthread_cond_wait(&queue->not_empty, &queue->mutex);
+    }
+
+    if (queue->len > 0) {
+        fd = queue->fds[queue->head];
+        queue->head = (queue->head + 1) % kDaemonConnQueueCapacity;
+        queue->len--;
+        queue->active_fds[worker_idx] = fd;
+        pthread_cond_signal(&queue->not_full);
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    return fd;
+}
+
+// Parks the connection for its next request, or closes it once the client
+// has gone or the daemon is stopping
+static void daemon_queue_release(DaemonConnQueue *queue, i64 worker_idx, i32 fd, bool keep_alive) {
+    pthread_mutex_lock(&queue->mutex);
+
+    queue->active_fds[worker_idx] = -1;
+    keep_alive = keep_alive && !queue->closed;
+
+    if (keep_alive) {
+        if (queue->parked_len == queue->parked_cap) {
+            i64 parked_cap = queue->parked_cap ? queue->parked_cap * 2 : 64;
+            i32 *parked_fds = realloc(queue->parked_fds, parked_cap * sizeof(i32));
+            assert(parked_fds);
+
+            queue->parked_fds = parked_fds;
+            queue->parked_cap = parked_cap;
+        }
+
+        queue->parked_fds[queue->parked_len++] = fd;
+    } else {
+        close(fd);
+    }
+
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (keep_alive) {
+        // A full pipe already holds a wake, so a failed write loses nothing
+        u8 wake = 1;
+        ssize_t written_len = write(queue->wake_fds[1], &wake, sizeof(wake));
+        (void) written_len;
+    }
+}
+
+// Moves the parked connections into the accept loop's idle set
+static void daemon_queue_take_parked(
+    DaemonConnQueue *queue,
+    DaemonIdleConn **idle_conns,
+    i64 *idle_len,
+    i64 *idle_cap
+) {
+    u8 wakes[64];
+    while (read(queue->wake_fds[0], wakes, sizeof(wakes)) > 0) {
+    }
+
+    i64 deadline_ms = daemon_now_ms() + kDaemonIdleTimeoutMs;
+
+    pthread_mutex_lock(&queue->mutex);
+
+    for (i64 parked_idx = 0; parked_idx < queue->parked_len; parked_idx++) {
+        if (*idle_len == *idle_cap) {
+            *idle_cap = *idle_cap ? *idle_cap * 2 : 64;
+            *idle_conns = realloc(*idle_conns, *idle_cap * sizeof(DaemonIdleConn));
+            assert(*idle_conns);
+        }
+
+        (*idle_conns)[(*idle_len)++] = (DaemonIdleConn){queue->parked_fds[parked_idx], deadline_ms};
+    }
+    queue->parked_len = 0;
+
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Stops the workers taking new connections. Those mid-request are shut down
+// for reading, so a worker waiting on a stalled client returns at once, and
+// the queued ones are served what they already sent
+static void daemon_queue_close(DaemonConnQueue *queue, i64 worker_count) {
+    pthread_mutex_lock(&queue->mutex);
+
+    queue->closed = true;
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        if (queue->active_fds[worker_idx] >= 0) {
+            shutdown(queue->active_fds[worker_idx], SHUT_RD);
+        }
+    }
+    for (i64 queued_idx = 0; queued_idx < queue->len; queued_idx++) {
+        shutdown(queue->fds[(queue->head + queued_idx) % kDaemonConnQueueCapacity], SHUT_RD);
+    }
+    for (i64 parked_idx = 0; parked_idx < queue->parked_len; parked_idx++) {
+        close(queue->parked_fds[parked_idx]);
+    }
+    queue->parked_len = 0;
+
+    pthread_cond_broadcast(&queue->not_empty);
+    pthread_cond_broadcast(&queue->not_full);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+static bool daemon_path_under_root(const char *root, const char *path) {
+    u64 root_len = strlen(root);
+
+    return strncmp(path, root, root_len) == 0 && (path[root_len] == '/' || root[root_len - 1] == '/');
+}
+
+// Reads the request's file when it is a regular file under render_root, or
+// returns nullptr. The path is only resolved to find the file, it is the opened
+// file's own path that has to be under the root, so a symlink swapped in after
+// the resolve can't lead outside it. Both results are malloc'd
+static char *daemon_read_render_path(
+    const DaemonWorker *worker,
+    const char *request_path,
+    char **out_render_path,
+    u64 *out_len
+) {
+    if (!worker->render_root) {
+        return nullptr;
+    }
+
+    char *resolved_path = realpath(request_path, nullptr);
+    if (!resolved_path) {
+        return nullptr;
+    }
+
+    i32 file_fd = -1;
+    if (daemon_path_under_root(worker->render_root, resolved_path)) {
+        file_fd = open(resolved_path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    }
+
+    char fd_link_path[64];
+    char opened_path[PATH_MAX];
+    ssize_t opened_path_len = -1;
+
+    if (file_fd >= 0) {
+        snprintf(fd_link_path, sizeof(fd_link_path), "/proc/self/fd/%d", file_fd);
+        opened_path_len = readlink(fd_link_path, opened_path, sizeof(opened_path) - 1);
+    }
+
+    struct stat st = {};
+    bool valid = opened_path_len > 0
+                 && fstat(file_fd, &st) == 0
+                 && S_ISREG(st.st_mode)
+                 && (u64) st.st_size <= worker->max_request_len;
+
+    if (valid) {
+        opened_path[opened_path_len] = '\0';
+        valid = daemon_path_under_root(worker->render_root, opened_path);
+    }
+
+    char *bytes = nullptr;
+
+    if (valid) {
+        bytes = malloc((u64) st.st_size + 1);
+        assert(bytes);
+
+        if (daemon_read_full(file_fd, bytes, (u64) st.st_size)) {
+            bytes[st.st_size] = '\0';
+            *out_len = (u64) st.st_size;
+        } else {
+            free(bytes);
+            bytes = nullptr;
+        }
+    }
+
+    if (file_fd >= 0) {
+        close(file_fd);
+    }
+
+    if (!bytes) {
+        free(resolved_path);
+        return nullptr;
+    }
+
+    *out_render_path = resolved_path;
+
+    return bytes;
+}
+
+static bool daemon_serve_request(DaemonWorker *worker, i32 fd) {
+    DaemonFrameHeader header = {};
+    if (!daemon_read_full(fd, &header, sizeof(header))) {
+        // Client closed the connection
+        return false;
+    }
+
+    if (header.magic != DAEMON_FRAME_MAGIC || header.len > worker->max_request_len) {
+        daemon_write_frame(fd, ARTICLE_DAEMON_STATUS_BAD_REQUEST, nullptr, 0);
+        return false;
+    }
+
+    if (header.len + 1 > worker->request_buffer_cap) {
+        char *request_buffer = realloc(worker->request_buffer, header.len + 1);
+        assert(request_buffer);
+        worker->request_buffer = request_buffer;
+        worker->request_buffer_cap = header.len + 1;
+    }
+
+    if (!daemon_read_full(fd, worker->request_buffer, header.len)) {
+        return false;
+    }
+    worker->request_buffer[header.len] = '\0';
+
+    ArticleParseOptions parse_options = {};
+    ArticleData data = {};
+
+    switch (header.code) {
+        case ARTICLE_DAEMON_REQUEST_RENDER_PATH: {
+            char *render_path = nullptr;
+            u64 file_len = 0;
+            char *file_bytes = daemon_read_render_path(worker, worker->request_buffer, &render_path, &file_len);
+            if (!file_bytes) {
+                return daemon_write_frame(fd, ARTICLE_DAEMON_STATUS_BAD_REQUEST, nullptr, 0);
+            }
+
+            parse_options.source_path = render_path;
+            data = article_parse_bytes(file_bytes, file_len, &parse_options);
+            free(file_bytes);
+            free(render_path);
+            break;
+        }
+        case ARTICLE_DAEMON_REQUEST_RENDER_BYTES: {
+            data = article_parse_bytes(worker->request_buffer, header.len, &parse_options);
+            break;
+        }
+        default: {
+            return daemon_write_frame(fd, ARTICLE_DAEMON_STATUS_BAD_REQUEST, nullptr, 0);
+        }
+    }
+
+    bool replied = false;
+
+    if (data.body_html) {
+        replied = daemon_write_frame(fd, ARTICLE_DAEMON_STATUS_OK, data.body_html, strlen(data.body_html));
+    } else {
+        replied = daemon_write_frame(fd, ARTICLE_DAEMON_STATUS_RENDER_FAILED, nullptr, 0);
+    }
+
+    article_free(&data);
+
+    return replied;
+}
+
+static void *daemon_worker_run(void *arg) {
+    DaemonWorker *worker = arg;
+
+    for (;;) {
+        i32 fd = daemon_queue_pop(worker->queue, worker->worker_idx);
+        if (fd < 0) {
+            break;
+        }
+
+        // Connections are persistent, a client may send any number of requests
+        bool keep_alive = daemon_serve_request(worker, fd);
+        daemon_queue_release(worker->queue, worker->worker_idx, fd, keep_alive);
+    }
+
+    free(worker->request_buffer);
+    worker->request_buffer = nullptr;
+
+    return nullptr;
+}
+
+// Bounds each read and write, so a stalled client can hold a worker for at most this long
+static void daemon_set_io_timeout(i32 fd) {
+    struct timeval timeout = {
+        .tv_sec = kDaemonIoTimeoutMs / 1000,
+        .tv_usec = (kDaemonIoTimeoutMs % 1000) * 1000,
+    };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+}
+
+int article_daemon_run(const ArticleDaemonOptions *options) {
+    if (!options || !options->socket_path) {
+        return -1;
+    }
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+
+    if (strlen(options->socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, options->socket_path);
+
+    char *render_root = nullptr;
+    if (options->render_root) {
+        render_root = realpath(options->render_root, nullptr);
+        if (!render_root) {
+            return -1;
+        }
+    }
+
+    i32 listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        free(render_root);
+        return -1;
+    }
+
+    unlink(options->socket_path);
+
+    // Linux creates the socket file with the socket's mode, so only this user
+    // can connect from the moment it appears
+    if (fchmod(listen_fd, 0600) != 0
+        || bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) != 0
+        || listen(listen_fd, kDaemonListenBacklog) != 0) {
+        close(listen_fd);
+        free(render_root);
+        return -1;
+    }
+
+    i64 worker_count = options->worker_count;
+    if (worker_count <= 0) {
+        worker_count = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (worker_count <= 0) {
+        worker_count = 1;
+    }
+
+    DaemonConnQueue queue = {
+        .fds = calloc(kDaemonConnQueueCapacity, sizeof(i32)),
+        .active_fds = calloc(worker_count, sizeof(i32)),
+    };
+    assert(queue.fds && queue.active_fds);
+    pthread_mutex_init(&queue.mutex, nullptr);
+    pthread_cond_init(&queue.not_empty, nullptr);
+    pthread_cond_init(&queue.not_full, nullptr);
+
+    int err = pipe(queue.wake_fds);
+    assert(!err);
+    fcntl(queue.wake_fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(queue.wake_fds[1], F_SETFL, O_NONBLOCK);
+
+    DaemonWorker *workers = calloc(worker_count, sizeof(DaemonWorker));
+    assert(workers);
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        DaemonWorker *worker = &workers[worker_idx];
+        worker->worker_idx = worker_idx;
+        worker->queue = &queue;
+        worker->render_root = render_root;
+        worker->max_request_len = options->max_request_len > 0
+                                      ? options->max_request_len
+                                      : kDaemonDefaultMaxRequestLen;
+        queue.active_fds[worker_idx] = -1;
+
+        err = pthread_create(&worker->thread, nullptr, daemon_worker_run, worker);
+        assert(!err);
+    }
+
+    // Kept-alive connections waiting for their next request
+    DaemonIdleConn *idle_conns = nullptr;
+    i64 idle_len = 0;
+    i64 idle_cap = 0;
+
+    struct pollfd *polls = nullptr;
+    i64 polls_cap = 0;
+
+    g_daemon_stopping = 0;
+
+    while (!g_daemon_stopping) {
+        if (polls_cap < idle_len + 2) {
+            polls_cap = (idle_len + 2) * 2;
+            polls = realloc(polls, polls_cap * sizeof(struct pollfd));
+            assert(polls);
+        }
+
+        polls[0] = (struct pollfd){.fd = listen_fd, .events = POLLIN};
+        polls[1] = (struct pollfd){.fd = queue.wake_fds[0], .events = POLLIN};
+        for (i64 idle_idx = 0; idle_idx < idle_len; idle_idx++) {
+            polls[idle_idx + 2] = (struct pollfd){.fd = idle_conns[idle_idx].fd, .events = POLLIN};
+        }
+
+        i32 ready = poll(polls, idle_len + 2, kDaemonPollIntervalMs);
+        if (ready < 0) {
+            continue;
+        }
+
+        // A readable connection has its next request, or has hung up and is
+        // closed by the worker that finds it so
+        i64 now_ms = daemon_now_ms();
+        i64 kept_len = 0;
+
+        for (i64 idle_idx = 0; idle_idx < idle_len; idle_idx++) {
+            DaemonIdleConn conn = idle_conns[idle_idx];
+
+            if (polls[idle_idx + 2].revents) {
+                daemon_queue_push(&queue, conn.fd);
+            } else if (now_ms >= conn.deadline_ms) {
+                close(conn.fd);
+            } else {
+                idle_conns[kept_len++] = conn;
+            }
+        }
+        idle_len = kept_len;
+
+        if (polls[1].revents) {
+            daemon_queue_take_parked(&queue, &idle_conns, &idle_len, &idle_cap);
+        }
+
+        if (polls[0].revents) {
+            i32 conn_fd = accept(listen_fd, nullptr, nullptr);
+            if (conn_fd >= 0) {
+                daemon_set_io_timeout(conn_fd);
+                daemon_queue_push(&queue, conn_fd);
+            }
+        }
+    }
+
+    close(listen_fd);
+    unlink(options->socket_path);
+
+    for (i64 idle_idx = 0; idle_idx < idle_len; idle_idx++) {
+        close(idle_conns[idle_idx].fd);
+    }
+    free(idle_conns);
+    free(polls);
+
+    // Requests already accepted are answered before the workers exit
+    daemon_queue_close(&queue, worker_count);
+
+    for (i64 worker_idx = 0; worker_idx < worker_count; worker_idx++) {
+        err = pthread_join(workers[worker_idx].thread, nullptr);
+        assert(!err);
+    }
+
+    free(workers);
+    free(render_root);
+
+    close(queue.wake_fds[0]);
+    close(queue.wake_fds[1]);
+    pthread_cond_destroy(&queue.not_full);
+    pthread_cond_destroy(&queue.not_empty);
+    pthread_mutex_destroy(&queue.mutex);
+    free(queue.parked_fds);
+    free(queue.active_fds);
+    free(queue.fds);
+
+    return 0;
+}
+
+void article_daemon_stop() {
+    g_daemon_stopping = 1;
+}
+
+int article_daemon_connect(const char *socket_path) {
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+
+    if (!socket_path || strlen(socket_path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    i32 fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool article_daemon_request(
+    int fd,
+    ArticleDaemonRequest request,
+    const char *payload,
+    size_t payload_len,
+    ArticleDaemonStatus *out_status,
+    char **out_body,
+    size_t *out_body_len
+) {
+    if (!daemon_write_frame(fd, request, payload, payload_len)) {
+        return false;
+    }
+
+    DaemonFrameHeader header = {};
+    if (!daemon_read_full(fd, &header, sizeof(header))
+        || header.magic != DAEMON_FRAME_MAGIC
+        || header.len > kDaemonMaxReplyLen) {
+        return false;
+    }
+
+    char *body = malloc(header.len + 1);
+    assert(body);
+
+    if (!daemon_read_full(fd, body, header.len)) {
+        free(body);
+        return false;
+    }
+    body[header.len] = '\0';
+
+    if (out_status) {
+        *out_status = header.code;
+    }
+
+    if (out_body) {
+        *out_body = body;
+    } else {
+        free(body);
+    }
+
+    if (out_body_len) {
+        *out_body_len = header.len;
+    }
+
+    return true;
+}
@@ -0,0 +1,55 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_DAEMON_H
+#define ARTICLE_HTML_DAEMON_H
+
+#include <stddef.h>
+
+typedef enum ARTICLE_DAEMON_REQUEST_E {
+    ARTICLE_DAEMON_REQUEST_RENDER_PATH = 1,
+    ARTICLE_DAEMON_REQUEST_RENDER_BYTES = 2,
+} ArticleDaemonRequest;
+
+typedef enum ARTICLE_DAEMON_STATUS_E {
+    ARTICLE_DAEMON_STATUS_OK = 0,
+    ARTICLE_DAEMON_STATUS_RENDER_FAILED = 1,
+    ARTICLE_DAEMON_STATUS_BAD_REQUEST = 2,
+} ArticleDaemonStatus;
+
+typedef struct ARTICLE_DAEMON_OPTIONS_T {
+    // Created readable and writable by this user only
+    const char* socket_path;
+    int worker_count;
+    size_t max_request_len;
+    // RENDER_PATH only renders regular files under this directory, no larger
+    // than max_request_len, and is refused when it's nullptr
+    const char* render_root;
+} ArticleDaemonOptions;
+
+// Serves render requests until article_daemon_stop, the library must
+// already be initialised. A worker serves one request at a time, a client
+// that keeps its connection open between requests doesn't hold one.
+// Returns 0 on a clean shutdown
+int article_daemon_run(const ArticleDaemonOptions *options);
+
+// Async-signal-safe
+void article_daemon_stop();
+
+int article_daemon_connect(const char *socket_path);
+
+// Sends one framed request and waits for the reply. out_body is malloc'd
+// and holds the HTML on success. A reply announcing more than 1 GB is
+// refused unread, the connection is out of step then and has to be closed
+bool article_daemon_request(
+    int fd,
+    ArticleDaemonRequest request,
+    const char *payload,
+    size_t payload_len,
+    ArticleDaemonStatus *out_status,
+    char **out_body,
+    size_t *out_body_len
+);
+
+#endif //ARTICLE_HTML_DAEMON_H
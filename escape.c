@@ -0,0 +1,239 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "escape.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// A NUL has no place in html and is dropped
+static const char *kHtmlEscapeEntities[256] = {
+    ['\0'] = "",
+    ['<'] = "&lt;",
+    ['>'] = "&gt;",
+    ['&'] = "&amp;",
+    ['"'] = "&quot;",
+    ['\''] = "&#39;",
+};
+
+static const u8 kHtmlEscapeEntityLens[256] = {
+    ['<'] = 4,
+    ['>'] = 4,
+    ['&'] = 5,
+    ['"'] = 6,
+    ['\''] = 5,
+};
+
+#define HTML_ESCAPE_STAGE_BYTES 4096
+
+static i64 html_escape_find_scalar(const char *text, i64 start_idx, i64 text_len) {
+    for (i64 c_idx = start_idx; c_idx < text_len; c_idx++) {
+        if (kHtmlEscapeEntities[(u8) text[c_idx]]) {
+            return c_idx;
+        }
+    }
+
+    return text_len;
+}
+
+// Index of the next byte needing an entity, or text_len if the rest is clean
+static i64 html_escape_find(const char *text, i64 start_idx, i64 text_len) {
+    i64 c_idx = start_idx;
+
+#if defined(__AVX2__)
+    const __m256i lt_32 = _mm256_set1_epi8('<');
+    const __m256i gt_32 = _mm256_set1_epi8('>');
+    const __m256i amp_32 = _mm256_set1_epi8('&');
+    const __m256i quot_32 = _mm256_set1_epi8('"');
+    const __m256i apos_32 = _mm256_set1_epi8('\'');
+    const __m256i nul_32 = _mm256_setzero_si256();
+
+    for (; c_idx + 32 <= text_len; c_idx += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (text + c_idx));
+
+        __m256i hits = _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(chunk, lt_32), _mm256_cmpeq_epi8(chunk, gt_32)),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi8(chunk, amp_32),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quot_32), _mm256_cmpeq_epi8(chunk, apos_32))
+            )
+        );
+        hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(chunk, nul_32));
+
+        u32 hit_mask = (u32) _mm256_movemask_epi8(hits);
+        if (hit_mask) {
+            return c_idx + __builtin_ctz(hit_mask);
+        }
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i quot = _mm_set1_epi8('"');
+    const __m128i apos = _mm_set1_epi8('\'');
+    const __m128i nul = _mm_setzero_si128();
+
+    for (; c_idx + 16 <= text_len; c_idx += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (text + c_idx));
+
+        __m128i hits = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, lt), _mm_cmpeq_epi8(chunk, gt)),
+            _mm_or_si128(
+                _mm_cmpeq_epi8(chunk, amp),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quot), _mm_cmpeq_epi8(chunk, apos))
+            )
+        );
+        hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, nul));
+
+        i32 hit_mask = _mm_movemask_epi8(hits);
+        if (hit_mask) {
+            return c_idx + __builtin_ctz((u32) hit_mask);
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const uint8x16_t lt = vdupq_n_u8('<');
+    const uint8x16_t gt = vdupq_n_u8('>');
+    const uint8x16_t amp = vdupq_n_u8('&');
+    const uint8x16_t quot = vdupq_n_u8('"');
+    const uint8x16_t apos = vdupq_n_u8('\'');
+
+    for (; c_idx + 16 <= text_len; c_idx += 16) {
+        uint8x16_t chunk = vld1q_u8((const u8 *) (text + c_idx));
+
+        uint8x16_t hits = vorrq_u8(
+            vorrq_u8(vceqq_u8(chunk, lt), vceqq_u8(chunk, gt)),
+            vorrq_u8(vceqq_u8(chunk, amp), vorrq_u8(vceqq_u8(chunk, quot), vceqq_u8(chunk, apos)))
+        );
+        hits = vorrq_u8(hits, vceqzq_u8(chunk));
+
+        if (vmaxvq_u8(hits)) {
+            return html_escape_find_scalar(text, c_idx, c_idx + 16);
+        }
+    }
+#endif
+
+    return html_escape_find_scalar(text, c_idx, text_len);
+}
+
+void html_bytes_append(string *out_html, const char *bytes, i64 len) {
+    // %.*s stops at a NUL, so the bytes go in NUL-free pieces with each NUL as a %c
+    while (len > 0) {
+        const char *nul = memchr(bytes, '\0', len);
+        i64 piece_len = nul ? nul - bytes : len;
+
+        if (piece_len > 0) {
+            str_append(out_html, "%.*s", (i32) piece_len, bytes);
+        }
+        if (!nul) {
+            break;
+        }
+
+        str_append(out_html, "%c", '\0');
+        bytes += piece_len + 1;
+        len -= piece_len + 1;
+    }
+}
+
+// Escaped text is staged here and appended a chunk at a time, a short run or
+// an entity costs a memcpy instead of a str_append
+typedef struct HTML_ESCAPE_STAGE_T {
+    string *out_html;
+    i64 len;
+    char data[HTML_ESCAPE_STAGE_BYTES];
+} HtmlEscapeStage;
+
+static void html_escape_stage_flush(HtmlEscapeStage *stage) {
+    html_bytes_append(stage->out_html, stage->data, stage->len);
+    stage->len = 0;
+}
+
+static void html_escape_stage_push(HtmlEscapeStage *stage, const char *bytes, i64 len) {
+    if (stage->len + len > HTML_ESCAPE_STAGE_BYTES) {
+        html_escape_stage_flush(stage);
+    }
+
+    // A run the stage can't hold goes straight through
+    if (len > HTML_ESCAPE_STAGE_BYTES) {
+        html_bytes_append(stage->out_html, bytes, len);
+        return;
+    }
+
+    memcpy(stage->data + stage->len, bytes, len);
+    stage->len += len;
+}
+
+void html_escape_append(string *out_html, const char *text, i64 text_len) {
+    HtmlEscapeStage stage;
+    stage.out_html = out_html;
+    stage.len = 0;
+
+    i64 clean_start_idx = 0;
+
+    while (clean_start_idx < text_len) {
+        i64 hit_idx = html_escape_find(text, clean_start_idx, text_len);
+
+        if (hit_idx > clean_start_idx) {
+            html_escape_stage_push(&stage, text + clean_start_idx, hit_idx - clean_start_idx);
+        }
+
+        if (hit_idx >= text_len) {
+            break;
+        }
+
+        const char *entity = kHtmlEscapeEntities[(u8) text[hit_idx]];
+        html_escape_stage_push(&stage, entity, kHtmlEscapeEntityLens[(u8) text[hit_idx]]);
+        clean_start_idx = hit_idx + 1;
+    }
+
+    html_escape_stage_flush(&stage);
+}
+
+i64 html_slug_append(string *out_html, const char *text, i64 text_len) {
+    if (text_len <= 0) {
+        return 0;
+    }
+
+    const i64 slug_start_idx = out_html->len;
+
+    html_bytes_append(out_html, text, text_len);
+
+    // The slug never outgrows what it has read, so it is written over the text
+    char *slug = out_html->data + slug_start_idx;
+    i64 slug_len = 0;
+    bool pending_dash = false;
+
+    for (i64 c_idx = 0; c_idx < text_len; c_idx++) {
+        u8 c = (u8) slug[c_idx];
+        u8 lower = c | 0x20;
+
+        bool letter = (u8) (lower - 'a') < 26;
+        bool keep = letter || (u8) (c - '0') < 10 || c >= 0x80;
+
+        if (!keep) {
+            pending_dash = true;
+            continue;
+        }
+
+        if (pending_dash && slug_len > 0) {
+            slug[slug_len++] = '-';
+        }
+        pending_dash = false;
+
+        slug[slug_len++] = (char) (letter ? lower : c);
+    }
+
+    out_html->len = slug_start_idx + slug_len;
+    out_html->data[out_html->len] = '\0';
+
+    return slug_len;
+}
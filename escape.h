@@ -0,0 +1,25 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_ESCAPE_H
+#define ARTICLE_HTML_ESCAPE_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+
+// Appends len bytes as they are, an embedded NUL included
+void html_bytes_append(string *out_html, const char *bytes, i64 len);
+
+// The most bytes html_escape_append writes for one byte of text, for &quot;
+#define HTML_ESCAPE_MAX_BYTES_PER_CHAR 6
+
+// Appends text to out_html with <, >, &, " and ' replaced by entities and NULs dropped
+void html_escape_append(string *out_html, const char *text, i64 text_len);
+
+// Appends text as an id: ASCII letters lower-cased, digits and UTF-8 kept, any
+// other run becomes one '-' and none are left at either end. The text is
+// appended once and slugged in place, returns the slug's length
+i64 html_slug_append(string *out_html, const char *text, i64 text_len);
+
+#endif //ARTICLE_HTML_ESCAPE_H
@@ -0,0 +1,23 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_HASH_H
+#define ARTICLE_HTML_HASH_H
+
+#include <altcore/types.h>
+
+#define HASH_FNV1A_SEED 14695981039346656037ULL
+
+static inline u64 hash_fnv1a(const void *bytes, u64 len, u64 seed) {
+    const u8 *cursor = bytes;
+    u64 hash = seed;
+
+    for (u64 byte_idx = 0; byte_idx < len; byte_idx++) {
+        hash = (hash ^ cursor[byte_idx]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+#endif //ARTICLE_HTML_HASH_H
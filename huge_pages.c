@@ -0,0 +1,181 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "huge_pages.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+const char *kHugePagesBackingStrs[] = {
+#ifndef X
+#define X(backing) \
+    #backing,
+#endif
+    X_HUGE_PAGES_BACKINGS
+#undef X
+};
+
+static u64 huge_pages_round_up(u64 size) {
+    return (size + HUGE_PAGES_SIZE - 1) & ~(HUGE_PAGES_SIZE - 1);
+}
+
+bool huge_pages_map(HugePagesRegion *region, u64 size, bool huge) {
+    *region = (HugePagesRegion){};
+
+    if (size == 0) {
+        return false;
+    }
+
+    if (huge) {
+        u64 huge_size = huge_pages_round_up(size);
+
+#ifdef MAP_HUGETLB
+        // Fails unless the administrator set aside enough pages in nr_hugepages
+        void *mapping = mmap(
+            nullptr,
+            huge_size,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+            -1,
+            0
+        );
+
+        if (mapping != MAP_FAILED) {
+            *region = (HugePagesRegion){mapping, huge_size, HUGE_PAGES_BACKING_HUGETLB};
+            return true;
+        }
+#endif
+
+#ifdef MADV_HUGEPAGE
+        // Over-mapped by a page so the start can be moved to a 2 MB boundary,
+        // the kernel only folds aligned ranges into huge pages
+        u8 *unaligned = mmap(
+            nullptr,
+            huge_size + HUGE_PAGES_SIZE,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS,
+            -1,
+            0
+        );
+
+        if (unaligned != MAP_FAILED) {
+            u8 *aligned = (u8 *) (((uintptr_t) unaligned + HUGE_PAGES_SIZE - 1) & ~(uintptr_t) (HUGE_PAGES_SIZE - 1));
+
+            u64 head_size = aligned - unaligned;
+            u64 tail_size = HUGE_PAGES_SIZE - head_size;
+
+            if (head_size > 0) {
+                munmap(unaligned, head_size);
+            }
+            if (tail_size > 0) {
+                munmap(aligned + huge_size, tail_size);
+            }
+
+            bool advised = madvise(aligned, huge_size, MADV_HUGEPAGE) == 0;
+
+            *region = (HugePagesRegion){
+                aligned,
+                huge_size,
+                advised ? HUGE_PAGES_BACKING_TRANSPARENT : HUGE_PAGES_BACKING_REGULAR,
+            };
+            return true;
+        }
+#endif
+    }
+
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    *region = (HugePagesRegion){mapping, size, HUGE_PAGES_BACKING_REGULAR};
+
+    return true;
+}
+
+void huge_pages_unmap(HugePagesRegion *region) {
+    if (region->data) {
+        int err = munmap(region->data, region->size);
+        assert(!err);
+    }
+
+    *region = (HugePagesRegion){};
+}
+
+bool huge_pages_advise(void *data, u64 size) {
+#ifdef MADV_HUGEPAGE
+    uintptr_t start = ((uintptr_t) data + HUGE_PAGES_SIZE - 1) & ~(uintptr_t) (HUGE_PAGES_SIZE - 1);
+    uintptr_t end = ((uintptr_t) data + size) & ~(uintptr_t) (HUGE_PAGES_SIZE - 1);
+
+    if (end <= start) {
+        return false;
+    }
+
+    return madvise((void *) start, end - start, MADV_HUGEPAGE) == 0;
+#else
+    (void) data;
+    (void) size;
+
+    return false;
+#endif
+}
+
+// Sums AnonHugePages over the mappings the region overlaps
+static u64 huge_pages_transparent_bytes(const HugePagesRegion *region) {
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    uintptr_t region_start = (uintptr_t) region->data;
+    uintptr_t region_end = region_start + region->size;
+
+    u64 huge_bytes = 0;
+    bool in_region = false;
+
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        uintptr_t vma_start = 0;
+        uintptr_t vma_end = 0;
+
+        // Mapping headers start with "start-end", the fields under them with a name
+        if (sscanf(line, "%" SCNxPTR "-%" SCNxPTR " ", &vma_start, &vma_end) == 2) {
+            in_region = vma_start < region_end && vma_end > region_start;
+            continue;
+        }
+
+        unsigned long long huge_kb = 0;
+        if (in_region && sscanf(line, "AnonHugePages: %llu kB", &huge_kb) == 1) {
+            huge_bytes += huge_kb * 1024ULL;
+        }
+    }
+
+    fclose(fp);
+
+    return huge_bytes;
+}
+
+void huge_pages_usage_add(HugePagesUsage *usage, const HugePagesRegion *region) {
+    if (!region->data) {
+        return;
+    }
+
+    usage->bytes += region->size;
+    usage->region_count++;
+
+    switch (region->backing) {
+        case HUGE_PAGES_BACKING_HUGETLB:
+            usage->huge_bytes += region->size;
+            usage->hugetlb_count++;
+            break;
+        case HUGE_PAGES_BACKING_TRANSPARENT:
+            usage->huge_bytes += huge_pages_transparent_bytes(region);
+            break;
+        default:
+            break;
+    }
+}
@@ -0,0 +1,60 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_HUGE_PAGES_H
+#define ARTICLE_HTML_HUGE_PAGES_H
+
+#include <altcore/types.h>
+
+#define HUGE_PAGES_SIZE (2ULL * 1024ULL * 1024ULL)
+
+typedef enum HUGE_PAGES_BACKING_E : i32 {
+#ifndef X_HUGE_PAGES_BACKINGS
+#define X_HUGE_PAGES_BACKINGS \
+    X(REGULAR) \
+    X(HUGETLB) \
+    X(TRANSPARENT) \
+    X(COUNT)
+#endif
+#ifndef X
+#define X(backing) \
+    HUGE_PAGES_BACKING_##backing,
+#endif
+    X_HUGE_PAGES_BACKINGS
+#undef X
+} HugePagesBacking;
+
+extern const char *kHugePagesBackingStrs[];
+
+// An anonymous zeroed mapping. HUGETLB pages were reserved by the mmap, while
+// TRANSPARENT ones are only advised and the kernel may still use 4 KB pages
+typedef struct HUGE_PAGES_REGION_T {
+    u8 *data;
+    u64 size;
+    HugePagesBacking backing;
+} HugePagesRegion;
+
+// How much of a set of regions sits on 2 MB pages
+typedef struct HUGE_PAGES_USAGE_T {
+    u64 bytes;
+    u64 huge_bytes;
+    i32 region_count;
+    i32 hugetlb_count;
+} HugePagesUsage;
+
+// Maps at least size bytes. With huge set it tries MAP_HUGETLB, then a 2 MB
+// aligned mapping with madvise(MADV_HUGEPAGE), regular pages otherwise
+bool huge_pages_map(HugePagesRegion *region, u64 size, bool huge);
+
+void huge_pages_unmap(HugePagesRegion *region);
+
+// Advises the whole 2 MB pages inside memory mapped elsewhere, e.g. an arena,
+// with madvise(MADV_HUGEPAGE). False when none fit or the kernel refuses
+bool huge_pages_advise(void *data, u64 size);
+
+// Adds the region's bytes and those on huge pages right now, the transparent
+// ones are read from /proc/self/smaps
+void huge_pages_usage_add(HugePagesUsage *usage, const HugePagesRegion *region);
+
+#endif //ARTICLE_HTML_HUGE_PAGES_H
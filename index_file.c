@@ -0,0 +1,151 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "index_file.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <altcore/arenas.h>
+#include <altcore/strings.h>
+
+#include "altcore/defer.h"
+
+bool index_file_map(const char *filepath, u64 header_size, IndexFileMapping *out_mapping) {
+    *out_mapping = (IndexFileMapping){};
+
+    if (!filepath) {
+        return false;
+    }
+
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) header_size) {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    out_mapping->data = mapping;
+    out_mapping->size = (u64) st.st_size;
+
+    return true;
+}
+
+void index_file_unmap(IndexFileMapping *mapping) {
+    if (mapping && mapping->data) {
+        munmap((void *) mapping->data, mapping->size);
+        *mapping = (IndexFileMapping){};
+    }
+}
+
+bool index_file_section_fits(const IndexFileMapping *mapping, u64 offset, u64 count, u64 elem_size, u64 elem_align) {
+    return offset <= mapping->size
+           && (elem_size == 0 || count <= (mapping->size - offset) / elem_size)
+           && offset % elem_align == 0;
+}
+
+bool index_file_str_fits(u64 pool_size, u32 offset, u32 len) {
+    return (u64) offset + len <= pool_size;
+}
+
+i32 index_file_str_cmp(const string_view *a, const string_view *b) {
+    i64 min_len = a->len < b->len ? a->len : b->len;
+
+    i32 cmp = memcmp(a->data, b->data, min_len);
+    if (cmp == 0) {
+        cmp = (a->len > b->len) - (a->len < b->len);
+    }
+
+    return cmp;
+}
+
+bool index_file_slots_valid(const IndexFileMapping *mapping, u64 offset, u32 slot_count, u32 entry_count) {
+    if (!index_file_section_fits(mapping, offset, slot_count, sizeof(u32), alignof(u32))
+        || slot_count <= entry_count
+        || (slot_count & (slot_count - 1)) != 0) {
+        return false;
+    }
+
+    // Lookups trust the slots from here on
+    const u32 *slots = (const u32 *) (mapping->data + offset);
+
+    for (u32 slot_idx = 0; slot_idx < slot_count; slot_idx++) {
+        if (slots[slot_idx] > entry_count) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+IndexFileProbe index_file_probe_begin(const u32 *slots, u32 slot_count, u64 hash) {
+    return (IndexFileProbe){
+        .slots = slots,
+        .slot_mask = slot_count - 1,
+        .slot_idx = (u32) hash & (slot_count - 1),
+        .slot_count = slot_count,
+    };
+}
+
+i64 index_file_probe_next(IndexFileProbe *probe) {
+    if (probe->probe_count >= probe->slot_count) {
+        return -1;
+    }
+
+    u32 slot = probe->slots[probe->slot_idx];
+
+    probe->probe_count++;
+    probe->slot_idx = (probe->slot_idx + 1) & probe->slot_mask;
+
+    return slot == 0 ? -1 : (i64) slot - 1;
+}
+
+bool index_file_write(const char *filepath, const IndexFileSection *sections, i64 section_count) {
+    if (!filepath) {
+        return false;
+    }
+
+    // Room for the ".tmp" copy of the path however the string grows
+    Arena arena = arena_make(2 * (i64) strlen(filepath) + 64);
+
+    bool written = false;
+
+    DEFER(arena_free(&arena)) {
+        string tmp_filepath = str_make(&arena, "%s.tmp", filepath);
+
+        FILE *fp = fopen(tmp_filepath.data, "wb");
+        if (fp) {
+            written = true;
+            for (i64 section_idx = 0; written && section_idx < section_count; section_idx++) {
+                const IndexFileSection *section = &sections[section_idx];
+
+                written = section->size == 0 || fwrite(section->data, 1, section->size, fp) == section->size;
+            }
+
+            written = (fclose(fp) == 0) && written;
+
+            if (written) {
+                written = rename(tmp_filepath.data, filepath) == 0;
+            } else {
+                remove(tmp_filepath.data);
+            }
+        }
+    }
+
+    return written;
+}
@@ -0,0 +1,65 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_INDEX_FILE_H
+#define ARTICLE_HTML_INDEX_FILE_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+
+// The label, search and citation indexes are a fixed header followed by
+// sections at offsets the header records. They are mapped read-only and
+// replaced whole, so a reader never sees a partially written index.
+
+typedef struct INDEX_FILE_MAPPING_T {
+    const u8 *data;
+    u64 size;
+} IndexFileMapping;
+
+typedef struct INDEX_FILE_SECTION_T {
+    const void *data;
+    u64 size;
+} IndexFileSection;
+
+// Maps the whole file, fails unless it holds at least header_size bytes
+bool index_file_map(const char *filepath, u64 header_size, IndexFileMapping *out_mapping);
+
+void index_file_unmap(IndexFileMapping *mapping);
+
+// Whether count elements of elem_size starting at offset lie in the mapping
+// and are aligned for elem_align. Header fields are untrusted, so this can't overflow.
+bool index_file_section_fits(const IndexFileMapping *mapping, u64 offset, u64 count, u64 elem_size, u64 elem_align);
+
+// Whether a string of the pool lies within its pool_size bytes
+bool index_file_str_fits(u64 pool_size, u32 offset, u32 len);
+
+// Byte order, a string sorts before the longer strings it prefixes. Labels,
+// paths and terms are sorted and searched by it
+i32 index_file_str_cmp(const string_view *a, const string_view *b);
+
+// The label index and bibliography find entries through an open addressed table
+// of entry_idx + 1 per slot, 0 for empty, probed linearly
+typedef struct INDEX_FILE_PROBE_T {
+    const u32 *slots;
+    u32 slot_mask;
+    u32 slot_idx;
+    u32 probe_count;
+    u32 slot_count;
+} IndexFileProbe;
+
+// Whether slot_count slots at offset lie in the mapping, are a power of two
+// more than entry_count, and each is empty or names one of the entries
+bool index_file_slots_valid(const IndexFileMapping *mapping, u64 offset, u32 slot_count, u32 entry_count);
+
+IndexFileProbe index_file_probe_begin(const u32 *slots, u32 slot_count, u64 hash);
+
+// The index of the next entry in hash's probe sequence, or -1 once an empty
+// slot is hit. At most one lap, a table without an empty slot still ends
+i64 index_file_probe_next(IndexFileProbe *probe);
+
+// Writes the sections back to back to "<filepath>.tmp", then renames it over
+// filepath. Readers holding the old mapping keep a valid view across the rename.
+bool index_file_write(const char *filepath, const IndexFileSection *sections, i64 section_count);
+
+#endif //ARTICLE_HTML_INDEX_FILE_H
@@ -0,0 +1,338 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "label_index.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash.h"
+#include "index_file.h"
+#include "altcore/defer.h"
+
+LabelIndex g_label_index = {};
+
+static const char kLabelIndexKeySeparator = '#';
+
+typedef struct LABEL_INDEX_SLOTS_T {
+    ARRAY_FIELDS(u32)
+} LabelIndexSlots;
+
+typedef struct LABEL_INDEX_ENTRIES_T {
+    ARRAY_FIELDS(LabelIndexEntry)
+} LabelIndexEntries;
+
+static u64 label_index_hash(const string_view *article_path, const string_view *label) {
+    // FNV-1a over "<article_path>#<label>"
+    u64 hash = hash_fnv1a(article_path->data, article_path->len, HASH_FNV1A_SEED);
+    hash = hash_fnv1a(&kLabelIndexKeySeparator, 1, hash);
+    hash = hash_fnv1a(label->data, label->len, hash);
+
+    return hash;
+}
+
+static int label_index_record_cmp(const void *a, const void *b) {
+    const LabelIndexRecord *record_a = a;
+    const LabelIndexRecord *record_b = b;
+
+    i32 cmp = index_file_str_cmp(&record_a->article_path, &record_b->article_path);
+    if (cmp == 0) {
+        cmp = index_file_str_cmp(&record_a->label, &record_b->label);
+    }
+
+    return cmp;
+}
+
+void label_index_normalize_path(string_view *article_path) {
+    for (;;) {
+        if (article_path->len >= 2 && article_path->data[0] == '.' && article_path->data[1] == '/') {
+            str_view_advance(article_path, 2);
+        } else if (article_path->len >= 1 && article_path->data[0] == '/') {
+            str_view_advance(article_path, 1);
+        } else {
+            break;
+        }
+    }
+}
+
+void label_index_page_stem(string_view *article_path) {
+    label_index_normalize_path(article_path);
+
+    for (i64 c_idx = article_path->len - 1; c_idx >= 0; c_idx--) {
+        char c = article_path->data[c_idx];
+        if (c == '/') {
+            break;
+        }
+        if (c == '.') {
+            article_path->len = c_idx;
+            break;
+        }
+    }
+}
+
+static string_view label_index_str(const LabelIndex *index, u32 offset, u32 len) {
+    string_view view = {
+        index->strs + offset,
+        len,
+    };
+
+    return view;
+}
+
+bool label_index_open(LabelIndex *index, const char *filepath) {
+    if (!index || !filepath) {
+        return false;
+    }
+
+    *index = (LabelIndex){};
+
+    IndexFileMapping mapping = {};
+    if (!index_file_map(filepath, sizeof(LabelIndexHeader), &mapping)) {
+        return false;
+    }
+
+    const LabelIndexHeader *header = (const LabelIndexHeader *) mapping.data;
+
+    bool valid = header->magic == LABEL_INDEX_MAGIC
+                 && header->version == LABEL_INDEX_VERSION
+                 && index_file_section_fits(&mapping, header->strs_offset, header->strs_size, 1, 1)
+                 && index_file_section_fits(
+                     &mapping,
+                     header->entries_offset,
+                     header->entry_count,
+                     sizeof(LabelIndexEntry),
+                     alignof(LabelIndexEntry)
+                 )
+                 && index_file_slots_valid(&mapping, header->slots_offset, header->slot_count, header->entry_count);
+
+    // Lookups trust the entries from here on, so every string has to lie in the pool
+    const LabelIndexEntry *entries = (const LabelIndexEntry *) (mapping.data + header->entries_offset);
+    const u32 *slots = (const u32 *) (mapping.data + header->slots_offset);
+
+    for (u32 entry_idx = 0; valid && entry_idx < header->entry_count; entry_idx++) {
+        const LabelIndexEntry *entry = &entries[entry_idx];
+
+        valid = index_file_str_fits(header->strs_size, entry->path_offset, entry->path_len)
+                && index_file_str_fits(header->strs_size, entry->label_offset, entry->label_len)
+                && index_file_str_fits(header->strs_size, entry->heading_offset, entry->heading_len);
+    }
+
+    if (!valid) {
+        index_file_unmap(&mapping);
+        return false;
+    }
+
+    index->data = mapping.data;
+    index->size = mapping.size;
+    index->header = header;
+    index->entries = entries;
+    index->slots = slots;
+    index->strs = (const char *) (index->data + header->strs_offset);
+
+    return true;
+}
+
+void label_index_close(LabelIndex *index) {
+    if (index && index->data) {
+        IndexFileMapping mapping = {index->data, index->size};
+        index_file_unmap(&mapping);
+        *index = (LabelIndex){};
+    }
+}
+
+bool label_index_find(
+    const LabelIndex *index,
+    const string_view *article_path,
+    const string_view *label,
+    LabelIndexRecord *out_record
+) {
+    if (!index || !index->data || index->header->slot_count == 0) {
+        return false;
+    }
+
+    string_view path = *article_path;
+    label_index_normalize_path(&path);
+
+    u64 hash = label_index_hash(&path, label);
+    IndexFileProbe probe = index_file_probe_begin(index->slots, index->header->slot_count, hash);
+
+    for (i64 entry_idx = index_file_probe_next(&probe); entry_idx >= 0; entry_idx = index_file_probe_next(&probe)) {
+        const LabelIndexEntry *entry = &index->entries[entry_idx];
+        if (entry->key_hash != hash) {
+            continue;
+        }
+
+        string_view entry_path = label_index_str(index, entry->path_offset, entry->path_len);
+        string_view entry_label = label_index_str(index, entry->label_offset, entry->label_len);
+
+        if (index_file_str_cmp(&entry_path, &path) == 0 && index_file_str_cmp(&entry_label, label) == 0) {
+            if (out_record) {
+                out_record->article_path = entry_path;
+                out_record->label = entry_label;
+                out_record->heading_text = label_index_str(index, entry->heading_offset, entry->heading_len);
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool label_index_write(const char *filepath, LabelIndexRecords *records) {
+    if (!filepath || !records) {
+        return false;
+    }
+
+    qsort(records->data, records->len, sizeof(LabelIndexRecord), label_index_record_cmp);
+
+    u64 strs_size = 0;
+    ARRAY_FOR(record, records) {
+        strs_size += record->article_path.len + record->label.len + record->heading_text.len;
+    }
+
+    u32 slot_count = 16;
+    while (slot_count < 2 * records->len) {
+        slot_count <<= 1;
+    }
+
+    Arena arena = arena_make(
+        (i64) (strs_size + 1 + slot_count * sizeof(u32) + records->len * sizeof(LabelIndexEntry)) + 1024
+    );
+
+    bool written = false;
+
+    DEFER(arena_free(&arena)) {
+        string strs = {&arena, (i64) strs_size + 1};
+        ARRAY_MAKE(&strs);
+        strs.len = 0;
+
+        LabelIndexEntries entries = {&arena, records->len > 0 ? records->len : 1};
+        ARRAY_MAKE(&entries);
+        entries.len = 0;
+
+        LabelIndexSlots slots = {&arena, slot_count};
+        ARRAY_MAKE(&slots);
+        memset(slots.data, 0, slot_count * sizeof(u32));
+
+        u32 path_offset = 0;
+        const LabelIndexRecord *prior_record = nullptr;
+
+        for (i64 record_idx = 0; record_idx < records->len; record_idx++) {
+            const LabelIndexRecord *record = &records->data[record_idx];
+
+            if (record_idx + 1 < records->len
+                && label_index_record_cmp(record, &records->data[record_idx + 1]) == 0) {
+                // Duplicate key, only one entry is kept
+                continue;
+            }
+
+            // Records are sorted by path, so each article path is pooled once
+            if (!prior_record || index_file_str_cmp(&prior_record->article_path, &record->article_path) != 0) {
+                path_offset = (u32) strs.len;
+                memcpy(strs.data + strs.len, record->article_path.data, record->article_path.len);
+                strs.len += record->article_path.len;
+            }
+
+            LabelIndexEntry entry = {
+                .key_hash = label_index_hash(&record->article_path, &record->label),
+                .path_offset = path_offset,
+                .path_len = (u32) record->article_path.len,
+            };
+
+            entry.label_offset = (u32) strs.len;
+            entry.label_len = (u32) record->label.len;
+            memcpy(strs.data + strs.len, record->label.data, record->label.len);
+            strs.len += record->label.len;
+
+            entry.heading_offset = (u32) strs.len;
+            entry.heading_len = (u32) record->heading_text.len;
+            memcpy(strs.data + strs.len, record->heading_text.data, record->heading_text.len);
+            strs.len += record->heading_text.len;
+
+            ARRAY_PUSH(&entries, &entry);
+            prior_record = record;
+
+            u32 slot_idx = (u32) entry.key_hash & (slot_count - 1);
+            while (slots.data[slot_idx] != 0) {
+                slot_idx = (slot_idx + 1) & (slot_count - 1);
+            }
+            slots.data[slot_idx] = (u32) entries.len;
+        }
+
+        LabelIndexHeader header = {
+            .magic = LABEL_INDEX_MAGIC,
+            .version = LABEL_INDEX_VERSION,
+            .entry_count = (u32) entries.len,
+            .slot_count = slot_count,
+        };
+
+        header.entries_offset = sizeof(LabelIndexHeader);
+        header.slots_offset = header.entries_offset + entries.len * sizeof(LabelIndexEntry);
+        header.strs_offset = header.slots_offset + slot_count * sizeof(u32);
+        header.strs_size = strs.len;
+
+        IndexFileSection sections[] = {
+            {&header, sizeof(header)},
+            {entries.data, entries.len * sizeof(LabelIndexEntry)},
+            {slots.data, slot_count * sizeof(u32)},
+            {strs.data, strs.len},
+        };
+
+        written = index_file_write(filepath, sections, STATIC_ARRAY_LEN(sections));
+    }
+
+    return written;
+}
+
+bool label_index_update(
+    const char *filepath,
+    const string_view *article_path,
+    const LabelIndexRecords *article_records
+) {
+    if (!filepath || !article_path || !article_records) {
+        return false;
+    }
+
+    string_view path = *article_path;
+    label_index_normalize_path(&path);
+
+    LabelIndex index = {};
+    bool index_exists = label_index_open(&index, filepath);
+
+    i64 entry_count = index_exists ? index.header->entry_count : 0;
+
+    Arena arena = arena_make((entry_count + article_records->len + 1) * (i64) sizeof(LabelIndexRecord) * 2 + 1024);
+
+    bool updated = false;
+
+    DEFER(arena_free(&arena), label_index_close(&index)) {
+        LabelIndexRecords records = {&arena, entry_count + article_records->len + 1};
+        ARRAY_MAKE(&records);
+        records.len = 0;
+
+        // Every other article's entries are carried over from the mapping as-is
+        for (i64 entry_idx = 0; entry_idx < entry_count; entry_idx++) {
+            const LabelIndexEntry *entry = &index.entries[entry_idx];
+
+            LabelIndexRecord record = {
+                label_index_str(&index, entry->path_offset, entry->path_len),
+                label_index_str(&index, entry->label_offset, entry->label_len),
+                label_index_str(&index, entry->heading_offset, entry->heading_len),
+            };
+
+            if (index_file_str_cmp(&record.article_path, &path) != 0) {
+                ARRAY_PUSH(&records, &record);
+            }
+        }
+
+        ARRAY_FOR(record, article_records) {
+            ARRAY_PUSH(&records, record);
+        }
+
+        updated = label_index_write(filepath, &records);
+    }
+
+    return updated;
+}
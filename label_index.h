@@ -0,0 +1,88 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_LABEL_INDEX_H
+#define ARTICLE_HTML_LABEL_INDEX_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+
+#define LABEL_INDEX_MAGIC 0x58494C41u // "ALIX"
+#define LABEL_INDEX_VERSION 2u
+
+// Rendered pages are published under this extension
+#define LABEL_INDEX_PAGE_EXTENSION ".html"
+
+// On-disk layout: header, entries sorted by (article path, label), an open
+// addressed slot table of entry_idx + 1 (0 is empty), then the string pool.
+typedef struct LABEL_INDEX_HEADER_T {
+    u32 magic;
+    u32 version;
+    u32 entry_count;
+    u32 slot_count;
+    u64 entries_offset;
+    u64 slots_offset;
+    u64 strs_offset;
+    u64 strs_size;
+} LabelIndexHeader;
+
+typedef struct LABEL_INDEX_ENTRY_T {
+    u64 key_hash;
+    u32 path_offset, path_len;
+    u32 label_offset, label_len;
+    u32 heading_offset, heading_len;
+} LabelIndexEntry;
+
+typedef struct LABEL_INDEX_T {
+    const u8 *data;
+    u64 size;
+    const LabelIndexHeader *header;
+    const LabelIndexEntry *entries;
+    const u32 *slots;
+    const char *strs;
+} LabelIndex;
+
+typedef struct LABEL_INDEX_RECORD_T {
+    string_view article_path;
+    string_view label;
+    string_view heading_text;
+} LabelIndexRecord;
+
+typedef struct LABEL_INDEX_RECORDS_T {
+    ARRAY_FIELDS(LabelIndexRecord)
+} LabelIndexRecords;
+
+extern LabelIndex g_label_index;
+
+// Checks every entry's strings and every slot against the file before mapping it
+bool label_index_open(LabelIndex *index, const char *filepath);
+
+void label_index_close(LabelIndex *index);
+
+bool label_index_find(
+    const LabelIndex *index,
+    const string_view *article_path,
+    const string_view *label,
+    LabelIndexRecord *out_record
+);
+
+// Drops any leading "./" and '/', the same way batch output paths do. The
+// index is keyed and searched on the normalized path
+void label_index_normalize_path(string_view *article_path);
+
+// Cuts a source path below the source root down to the stem of its page under
+// the output directory, normalized and without the extension. Articles are
+// indexed under the stem followed by LABEL_INDEX_PAGE_EXTENSION
+void label_index_page_stem(string_view *article_path);
+
+// Records are expected to hold normalized paths
+bool label_index_write(const char *filepath, LabelIndexRecords *records);
+
+bool label_index_update(
+    const char *filepath,
+    const string_view *article_path,
+    const LabelIndexRecords *article_records
+);
+
+#endif //ARTICLE_HTML_LABEL_INDEX_H
@@ -1,55 +1,556 @@
 #include "library.h"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <altcore/types.h>
 #include <altcore/memory.h>
 #include <altcore/arenas.h>
 #include <altcore/strings.h>
 #include <altcore/hashmap.h>
 
+#include "ast.h"
 #include "bible.h"
+#include "bibliography.h"
 #include "body.h"
+#include "compress.h"
+#include "hash.h"
+#include "huge_pages.h"
+#include "label_index.h"
 #include "metadata.h"
+#include "trace.h"
 #include "altcore/defer.h"
 
 static bool g_initialized = false;
-static i64 kMallocInitialCapacity = 1024LL * 1024LL * 1024LL;
+static i64 g_memory_budget = 0;
+static bool g_huge_pages = false;
+static i64 g_document_arena_limit = 0;
+
+static const i64 kArticleDefaultMemoryBudget = 1024LL * 1024LL * 1024LL;
+static const char *kArticleDefaultCorpusFilepath = "./data/lsb.csv";
+static const size_t kArticleWordsPerMinute = 200;
+// A document's first arena, big.xmd peaks at 40 bytes per source byte
+static const i64 kArticleArenaMinCapacity = 1024LL * 1024LL;
+static const i64 kArticleArenaBytesPerSourceByte = 48;
+// A document that runs out is parsed again in an arena this many times larger
+static const i64 kArticleArenaGrowth = 4;
+// Each line is split into a string of its own, which may also be copied once
+static const i64 kArticleArenaBytesPerLine = 2 * (i64) sizeof(string) + 16;
+
+static const char *kArticleArenaSiteStrs[] = {
+    "source",
+    "lines",
+    "metadata",
+    "tokens",
+    "text",
+    "passages",
+    "terms",
+    "output",
+};
 
 void article_init() {
+    ArticleConfig config = {};
+
+    article_init_ex(&config);
+}
+
+void article_init_ex(const ArticleConfig *config) {
     if (!g_initialized) {
-        alt_init(kMallocInitialCapacity);
+        ArticleConfig defaults = config ? *config : (ArticleConfig){};
+
+        i64 memory_budget = defaults.memory_budget > 0 ? (i64) defaults.memory_budget : kArticleDefaultMemoryBudget;
+        g_memory_budget = memory_budget;
+        g_huge_pages = defaults.huge_pages;
+        g_document_arena_limit = defaults.document_arena_limit > 0
+                                     ? (i64) defaults.document_arena_limit
+                                     : memory_budget / 2;
+
+        alt_init(memory_budget);
 
-        bible_init("./data/lsb.csv");
+        metadata_init();
+
+        const char *corpus_filepath = defaults.corpus_filepath
+                                          ? defaults.corpus_filepath
+                                          : kArticleDefaultCorpusFilepath;
+
+        if (defaults.corpus_loading == ARTICLE_CORPUS_LOADING_LAZY) {
+            bible_init_lazy(corpus_filepath, defaults.huge_pages);
+        } else {
+            bible_init(corpus_filepath, defaults.huge_pages);
+        }
 
         g_initialized = true;
     }
 }
 
+size_t article_memory_budget() {
+    return (size_t) g_memory_budget;
+}
+
+ArticleHugePagesReport article_huge_pages_report() {
+    HugePagesUsage usage = {};
+    bible_huge_pages_usage(&usage);
+
+    return (ArticleHugePagesReport){
+        .corpus_bytes = usage.bytes,
+        .corpus_huge_bytes = usage.huge_bytes,
+        .translation_count = usage.region_count,
+        .hugetlb_count = usage.hugetlb_count,
+    };
+}
+
 void article_uninit() {
     if (g_initialized) {
+        label_index_close(&g_label_index);
+        bibliography_close(&g_bibliography);
+
         bible_uninit();
 
         alt_uninit();
 
+        g_memory_budget = 0;
+        g_huge_pages = false;
         g_initialized = false;
     }
 }
 
 ArticleData article_parse(const char *filepath) {
+    ArticleParseOptions options = {};
+
+    return article_parse_ex(filepath, &options);
+}
+
+// Where the body comes from, the source lines or an AST tokenized earlier
+typedef struct ARTICLE_BODY_SOURCE_T {
+    const Metadata *metadata;
+    const strings *file_lines;
+    i64 start_body_line_idx;
+    const AstView *ast;
+} ArticleBodySource;
+
+// Room for a document of source_len bytes, its lines, tokens and output
+static i64 article_arena_capacity(i64 source_len) {
+    i64 capacity = kArticleArenaMinCapacity;
+
+    if (source_len > (g_document_arena_limit - capacity) / kArticleArenaBytesPerSourceByte) {
+        return g_document_arena_limit;
+    }
+
+    capacity += source_len * kArticleArenaBytesPerSourceByte;
+
+    return capacity < g_document_arena_limit ? capacity : g_document_arena_limit;
+}
+
+// A document arena, advised onto 2 MB pages with ArticleConfig.huge_pages.
+// The arena's memory belongs to altcore, a probe allocation finds its start
+static Arena article_arena_make(i64 capacity) {
+    Arena arena = arena_make(capacity);
+
+    if (g_huge_pages && capacity >= (i64) HUGE_PAGES_SIZE) {
+        const i64 arena_start_offset = arena.offset;
+
+        string probe = {&arena, 1};
+        ARRAY_MAKE(&probe);
+        huge_pages_advise(probe.data, (u64) (capacity - arena_start_offset));
+
+        arena.offset = arena_start_offset;
+    }
+
+    return arena;
+}
+
+// The capacity to parse again with after a document ran out of room, false
+// once it is at the limit
+static bool article_arena_grow(const char *filepath, i64 *arena_capacity) {
+    if (*arena_capacity >= g_document_arena_limit) {
+        fprintf(
+            stderr,
+            "article_html: %s needs more than the %lld byte document arena limit\n",
+            filepath ? filepath : "<bytes>",
+            (long long) g_document_arena_limit
+        );
+        return false;
+    }
+
+    *arena_capacity = *arena_capacity > g_document_arena_limit / kArticleArenaGrowth
+                          ? g_document_arena_limit
+                          : *arena_capacity * kArticleArenaGrowth;
+
+    return true;
+}
+
+static ArticleArenaStats *article_arena_stats_begin(
+    const Arena *tmp,
+    const BodyArenaLimit *arena_limit,
+    const ArticleParseOptions *options,
+    ArticleData *data
+) {
+    if (!options || !(options->collect_arena_stats || options->arena_budget > 0)) {
+        return nullptr;
+    }
+
+    ArticleArenaStats *arena_stats = &data->arena_stats;
+
+    // The document arena is fresh, all it holds so far is the source
+    arena_stats->sites[ARTICLE_ARENA_SITE_SOURCE] = (ArticleArenaSiteStats){(size_t) tmp->offset, 1};
+    arena_stats->peak_bytes = tmp->offset;
+    arena_stats->capacity_bytes = arena_limit->capacity;
+
+    return arena_stats;
+}
+
+static void article_check_budget(
+    const char *filepath,
+    const ArticleParseOptions *options,
+    ArticleArenaStats *arena_stats
+) {
+    if (arena_stats && options->arena_budget > 0 && arena_stats->peak_bytes > options->arena_budget) {
+        arena_stats->over_budget = true;
+
+        fprintf(
+            stderr,
+            "article_html: %s peaked at %zu arena bytes, over the %zu byte budget\n",
+            filepath ? filepath : "<bytes>",
+            arena_stats->peak_bytes,
+            options->arena_budget
+        );
+    }
+}
+
+// What the body is emitted into, all of it in the document arena until it is
+// copied out. The outputs point at the other members, so it stays put
+typedef struct ARTICLE_BODY_OUTPUTS_T {
+    string body_html;
+    BodyLabels labels;
+    BodyTerms terms;
+    BiblePassages passages;
+    BodyTextStats text_stats;
+    BodyToc toc;
+    string toc_html;
+    BodyOutputs outputs;
+} ArticleBodyOutputs;
+
+static void article_body_outputs_begin(
+    Arena *tmp,
+    const ArticleParseOptions *options,
+    BodyArenaLimit *arena_limit,
+    ArticleArenaStats *arena_stats,
+    ArticleBodyOutputs *body
+) {
+    i64 stage_start_offset = tmp->offset;
+
+    body->body_html = str_make(tmp, "");
+
+    body->labels = (BodyLabels){tmp};
+    ARRAY_MAKE(&body->labels);
+
+    body->terms = (BodyTerms){tmp};
+    ARRAY_MAKE(&body->terms);
+
+    body->passages = (BiblePassages){tmp};
+    ARRAY_MAKE(&body->passages);
+
+    body->text_stats = (BodyTextStats){
+        .excerpt = {tmp},
+        .excerpt_char_limit = options ? (i64) options->excerpt_chars : 0,
+    };
+
+    BodyTextStats *text_stats = &body->text_stats;
+
+    if (text_stats->excerpt_char_limit > 0) {
+        text_stats->excerpt_capacity = text_stats->excerpt_char_limit * 4;
+        text_stats->excerpt.len = text_stats->excerpt_capacity;
+        ARRAY_MAKE(&text_stats->excerpt);
+        text_stats->excerpt.len = 0;
+    }
+
+    body->toc = (BodyToc){tmp};
+    ARRAY_MAKE(&body->toc);
+
+    body->toc_html = str_make(tmp, "");
+
+    body->outputs = (BodyOutputs){
+        .labels = &body->labels,
+        .compressor = options ? options->compressor : nullptr,
+        .terms = options && options->collect_terms ? &body->terms : nullptr,
+        .passages = options && options->collect_passages ? &body->passages : nullptr,
+        .arena_stats = arena_stats,
+        .text_stats = &body->text_stats,
+        .toc = &body->toc,
+        .toc_html = options && options->collect_toc ? &body->toc_html : nullptr,
+        .arena_limit = arena_limit,
+    };
+
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_OUTPUT, tmp, stage_start_offset);
+
+    if (body->outputs.compressor) {
+        html_compressor_begin(body->outputs.compressor);
+    }
+}
+
+// Finishes the compressor and takes its output, then copies the HTML, labels,
+// terms and passages out of the document arena, unless the body was left incomplete
+static void article_body_outputs_end(
+    ArticleBodyOutputs *body,
+    const ArticleParseOptions *options,
+    bool complete,
+    ArticleData *data
+) {
+    if (body->outputs.compressor) {
+        html_compressor_finish(body->outputs.compressor);
+    }
+
+    if (!complete) {
+        return;
+    }
+
+    const string body_html = body->body_html;
+    const BodyLabels body_labels = body->labels;
+    const BodyTerms body_terms = body->terms;
+    const BiblePassages body_passages = body->passages;
+    const BodyTextStats text_stats = body->text_stats;
+    const BodyToc body_toc = body->toc;
+    const string toc_html = body->toc_html;
+    const BodyOutputs body_outputs = body->outputs;
+
+    if (body_outputs.compressor) {
+        u64 compressed_len = 0;
+        data->body_compressed = html_compressor_take(body_outputs.compressor, &compressed_len);
+        data->body_compressed_len = compressed_len;
+    }
+
+    if (!body_outputs.compressor || !options->compressed_only) {
+        data->body_html = calloc(body_html.len + 1, sizeof(char));
+        assert(data->body_html);
+        memcpy(data->body_html, body_html.data, body_html.len);
+    }
+
+    if (body_labels.len > 0) {
+        data->labels = calloc(body_labels.len, sizeof(ArticleLabel));
+        assert(data->labels);
+        data->label_count = body_labels.len;
+
+        for (i64 label_idx = 0; label_idx < body_labels.len; label_idx++) {
+            const BodyLabel *body_label = &body_labels.data[label_idx];
+            ArticleLabel *label = &data->labels[label_idx];
+
+            label->name = strdup(body_label->name.data);
+            assert(label->name);
+            label->heading_text = strdup(body_label->heading_text.data);
+            assert(label->heading_text);
+        }
+    }
+
+    if (body_terms.len > 0) {
+        u64 terms_size = body_terms.len * sizeof(ArticleTerm);
+        ARRAY_FOR(body_term, &body_terms) {
+            terms_size += body_term->text.len + 1;
+        }
+
+        data->terms = malloc(terms_size);
+        assert(data->terms);
+        data->term_count = body_terms.len;
+
+        // Term text is packed behind the array so the whole stream is freed at once
+        char *term_strs = (char *) (data->terms + body_terms.len);
+
+        for (i64 term_idx = 0; term_idx < body_terms.len; term_idx++) {
+            const BodyTerm *body_term = &body_terms.data[term_idx];
+
+            memcpy(term_strs, body_term->text.data, body_term->text.len);
+            term_strs[body_term->text.len] = '\0';
+
+            data->terms[term_idx] = (ArticleTerm){
+                .text = term_strs,
+                .field = body_term->field,
+            };
+
+            term_strs += body_term->text.len + 1;
+        }
+    }
+
+    data->word_count = text_stats.word_count;
+    data->reading_minutes = (text_stats.word_count + kArticleWordsPerMinute - 1) / kArticleWordsPerMinute;
+
+    if (text_stats.excerpt_char_limit > 0) {
+        data->excerpt = calloc(text_stats.excerpt.len + 1, sizeof(char));
+        assert(data->excerpt);
+        memcpy(data->excerpt, text_stats.excerpt.data, text_stats.excerpt.len);
+    }
+
+    if (body_outputs.toc_html) {
+        data->toc_html = calloc(toc_html.len + 1, sizeof(char));
+        assert(data->toc_html);
+        memcpy(data->toc_html, toc_html.data, toc_html.len);
+    }
+
+    if (body_toc.len > 0) {
+        u64 toc_size = body_toc.len * sizeof(ArticleTocEntry);
+        ARRAY_FOR(body_toc_entry, &body_toc) {
+            toc_size += body_toc_entry->text.len + 1 + body_toc_entry->id.len + 1;
+        }
+
+        data->toc = malloc(toc_size);
+        assert(data->toc);
+        data->toc_count = body_toc.len;
+
+        char *toc_strs = (char *) (data->toc + body_toc.len);
+
+        for (i64 toc_idx = 0; toc_idx < body_toc.len; toc_idx++) {
+            const BodyTocEntry *body_toc_entry = &body_toc.data[toc_idx];
+
+            char *text = toc_strs;
+            memcpy(text, body_toc_entry->text.data, body_toc_entry->text.len);
+            text[body_toc_entry->text.len] = '\0';
+            toc_strs += body_toc_entry->text.len + 1;
+
+            char *id = toc_strs;
+            memcpy(id, body_toc_entry->id.data, body_toc_entry->id.len);
+            id[body_toc_entry->id.len] = '\0';
+            toc_strs += body_toc_entry->id.len + 1;
+
+            data->toc[toc_idx] = (ArticleTocEntry){
+                .level = body_toc_entry->level,
+                .text = text,
+                .id = id,
+            };
+        }
+    }
+
+    if (body_passages.len > 0) {
+        data->passages = calloc(body_passages.len, sizeof(ArticlePassage));
+        assert(data->passages);
+        data->passage_count = body_passages.len;
+
+        for (i64 passage_idx = 0; passage_idx < body_passages.len; passage_idx++) {
+            const BiblePassage *body_passage = &body_passages.data[passage_idx];
+
+            data->passages[passage_idx] = (ArticlePassage){
+                .book = body_passage->book,
+                .chapter = body_passage->ch_v.chapter,
+                .start_verse = body_passage->ch_v.start_verse,
+                .end_verse = body_passage->ch_v.end_verse,
+            };
+        }
+    }
+}
+
+// Emits the body and copies its outputs out of the document arena. False when
+// an AST is rejected. Data is left untouched then, and also when the arena
+// limit runs out
+static bool article_render_body(
+    Arena *tmp,
+    const ArticleBodySource *source,
+    const ArticleParseOptions *options,
+    BodyArenaLimit *arena_limit,
+    ArticleArenaStats *arena_stats,
+    ArticleData *data
+) {
+    ArticleBodyOutputs body = {};
+    article_body_outputs_begin(tmp, options, arena_limit, arena_stats, &body);
+
+    bool rendered = true;
+
+    if (source->ast) {
+        rendered = body_ast_to_html(tmp, source->ast, &body.body_html, &body.outputs);
+    } else {
+        body_to_html(
+            tmp,
+            source->metadata,
+            source->file_lines,
+            source->start_body_line_idx,
+            &body.body_html,
+            &body.outputs
+        );
+    }
+
+    article_body_outputs_end(&body, options, rendered && !arena_limit->exhausted, data);
+
+    return rendered;
+}
+
+// Splits the source into lines, false when the arena has no room for them
+static bool article_split_lines(
+    Arena *tmp,
+    const string *file_buffer,
+    BodyArenaLimit *arena_limit,
+    strings *out_lines
+) {
+    i64 line_count = 1;
+    for (const char *newline = memchr(file_buffer->data, '\n', file_buffer->len); newline;
+         newline = memchr(newline + 1, '\n', file_buffer->data + file_buffer->len - (newline + 1))) {
+        line_count++;
+    }
+
+    if (!body_arena_has_room(tmp, arena_limit, file_buffer->len + line_count * kArticleArenaBytesPerLine)) {
+        return false;
+    }
+
+    TRACE_BEGIN("str_split", nullptr, file_buffer->len);
+    *out_lines = str_split(tmp, file_buffer, "\n");
+    TRACE_END("str_split", -1);
+
+    return true;
+}
+
+static ArticleData article_parse_buffer(
+    Arena *tmp,
+    const char *filepath,
+    const string *file_buffer,
+    const ArticleParseOptions *options,
+    BodyArenaLimit *arena_limit
+) {
     ArticleData data = {};
-    if (!filepath) {
+
+    ArticleArenaStats *arena_stats = article_arena_stats_begin(tmp, arena_limit, options, &data);
+
+    i64 stage_start_offset = tmp->offset;
+
+    strings file_lines = {};
+    if (!article_split_lines(tmp, file_buffer, arena_limit, &file_lines)) {
         return data;
     }
 
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_LINES, tmp, stage_start_offset);
+
+    Metadata metadata = {};
+
+    stage_start_offset = tmp->offset;
+
+    TRACE_BEGIN("metadata_get", nullptr, -1);
+    i64 start_body_line_idx = metadata_get(tmp, &file_lines, &metadata);
+    TRACE_END("metadata_get", -1);
+
+    body_arena_charge(arena_stats, ARTICLE_ARENA_SITE_METADATA, tmp, stage_start_offset);
+
+    if (start_body_line_idx >= 0) {
+        ArticleBodySource source = {
+            .metadata = &metadata,
+            .file_lines = &file_lines,
+            .start_body_line_idx = start_body_line_idx,
+        };
+
+        article_render_body(tmp, &source, options, arena_limit, arena_stats, &data);
+    }
+
+    metadata_free(&metadata);
+
+    if (!arena_limit->exhausted) {
+        article_check_budget(filepath, options, arena_stats);
+    }
+
+    return data;
+}
+
+static bool article_read_file(Arena *tmp, const char *filepath, string *out_file_buffer) {
     FILE *fp = fopen(filepath, "rb");
     if (!fp) {
-        return data;
+        return false;
     }
 
-    Arena tmp = arena_make(kMallocInitialCapacity / 2);
-    string file_buffer = {&tmp};
-
     int err = 0;
     DEFER(err = fclose(fp), assert(!err), fp = nullptr) {
         err = fseek(fp, 0, SEEK_END);
@@ -58,35 +559,619 @@ ArticleData article_parse(const char *filepath) {
         long file_size = ftell(fp);
         rewind(fp);
 
-        file_buffer.len = file_size + 1;
-        ARRAY_MAKE(&file_buffer);
+        TRACE_BEGIN("file_read", filepath, file_size);
+
+        *out_file_buffer = (string){tmp, file_size + 1};
+        ARRAY_MAKE(out_file_buffer);
 
-        size_t read_size = fread(file_buffer.data, sizeof(char), file_size, fp);
+        size_t read_size = fread(out_file_buffer->data, sizeof(char), file_size, fp);
         assert(read_size == file_size);
 
-        file_buffer.data[file_size] = '\0';
+        out_file_buffer->data[file_size] = '\0';
+
+        TRACE_END("file_read", -1);
+    }
+
+    return true;
+}
+
+ArticleData article_parse_ex(const char *filepath, const ArticleParseOptions *options) {
+    ArticleData data = {};
+    if (!filepath) {
+        return data;
+    }
+
+    struct stat st = {};
+    if (stat(filepath, &st) != 0) {
+        return data;
     }
 
-    strings file_lines = str_split(&tmp, &file_buffer, "\n");
+    bible_require();
 
-    MetadataMap metadata_map = {HASHMAP_TYPE_STR_KEY};
-    string default_str = {};
-    HASHMAP_MAKE(&metadata_map, &default_str);
+    TRACE_BEGIN("article_parse", filepath, -1);
 
-    i64 start_body_line_idx = metadata_get(&tmp, &file_lines, &metadata_map);
-    if (start_body_line_idx >= 0) {
-        string body_html = str_make(&tmp, "");
+    i64 arena_capacity = article_arena_capacity(st.st_size);
+    BodyArenaLimit arena_limit = {};
+
+    // The file is read again into each larger arena, that is rare enough
+    do {
+        arena_limit = (BodyArenaLimit){arena_capacity};
+        data = (ArticleData){};
+
+        Arena tmp = article_arena_make(arena_capacity);
+        string file_buffer = {&tmp};
+
+        if (article_read_file(&tmp, filepath, &file_buffer)) {
+            data = article_parse_buffer(&tmp, filepath, &file_buffer, options, &arena_limit);
+        }
+
+        arena_free(&tmp);
+    } while (arena_limit.exhausted && article_arena_grow(filepath, &arena_capacity));
+
+    TRACE_END("article_parse", -1);
+
+    return data;
+}
+
+ArticleData article_parse_bytes(const char *bytes, size_t len, const ArticleParseOptions *options) {
+    ArticleData data = {};
+    if (!bytes) {
+        return data;
+    }
+
+    bible_require();
+
+    const char *source_path = options ? options->source_path : nullptr;
+
+    TRACE_BEGIN("article_parse", source_path, (i64) len);
+
+    i64 arena_capacity = article_arena_capacity((i64) len);
+    BodyArenaLimit arena_limit = {};
+
+    do {
+        arena_limit = (BodyArenaLimit){arena_capacity};
+
+        Arena tmp = article_arena_make(arena_capacity);
+        string file_buffer = {&tmp, (i64) len + 1};
+        ARRAY_MAKE(&file_buffer);
+
+        memcpy(file_buffer.data, bytes, len);
+        file_buffer.data[len] = '\0';
+
+        data = article_parse_buffer(&tmp, source_path, &file_buffer, options, &arena_limit);
+
+        arena_free(&tmp);
+    } while (arena_limit.exhausted && article_arena_grow(source_path, &arena_capacity));
+
+    TRACE_END("article_parse", -1);
+
+    return data;
+}
+
+struct ARTICLE_PARSER_T {
+    ArticleParseOptions options;
+    Arena tmp;
+    BodyArenaLimit arena_limit;
+    ArticleArenaStats *arena_stats;
+    ArticleData data;
+    // The line the last chunk ended inside of, until its newline arrives
+    char *partial_line;
+    size_t partial_len;
+    size_t partial_capacity;
+    // Without a size hint, the lines taken so far each followed by a newline,
+    // replayed into a larger arena when the arena runs out. Null otherwise
+    char *source;
+    size_t source_len;
+    size_t source_capacity;
+    // Body HTML handed to the sink so far, and how much of it a replay has
+    // still to render again before the sink sees new output
+    size_t sink_len;
+    size_t sink_skip_len;
+    Metadata metadata;
+    i32 meta_delim_count;
+    // Null until the header has been read
+    BodyStream *body_stream;
+    ArticleBodyOutputs body;
+    ArticleHtmlSink sink;
+    void *sink_ctx;
+};
+
+ArticleParser *article_parser_create(
+    const ArticleParseOptions *options,
+    size_t size_hint,
+    ArticleHtmlSink sink,
+    void *sink_ctx
+) {
+    bible_require();
+
+    ArticleParser *parser = calloc(1, sizeof(ArticleParser));
+    assert(parser);
+
+    parser->options = options ? *options : (ArticleParseOptions){};
+    parser->sink = sink;
+    parser->sink_ctx = sink_ctx;
+
+    // Without a hint the arena starts small and the source is kept, to be
+    // replayed into a larger one each time it runs out
+    if (size_hint == 0) {
+        parser->source_capacity = (size_t) kArticleArenaMinCapacity;
+        parser->source = malloc(parser->source_capacity);
+        assert(parser->source);
+    }
+
+    i64 arena_capacity = article_arena_capacity((i64) size_hint);
+
+    parser->arena_limit = (BodyArenaLimit){arena_capacity};
+    parser->tmp = article_arena_make(arena_capacity);
+    parser->arena_stats = article_arena_stats_begin(
+        &parser->tmp,
+        &parser->arena_limit,
+        &parser->options,
+        &parser->data
+    );
+
+    return parser;
+}
+
+// Hands the sink what a replay renders past the HTML it was handed before
+static void article_parser_sink(void *ctx, const char *html, size_t len) {
+    ArticleParser *parser = ctx;
+
+    size_t skip_len = parser->sink_skip_len < len ? parser->sink_skip_len : len;
+    parser->sink_skip_len -= skip_len;
+
+    if (len > skip_len) {
+        parser->sink_len += len - skip_len;
+        parser->sink(parser->sink_ctx, html + skip_len, len - skip_len);
+    }
+}
+
+// Copies a complete line into the arena and feeds it to the metadata, then to
+// the body once the header is read
+static void article_parser_take_line(ArticleParser *parser, const string_view *line_view) {
+    Arena *tmp = &parser->tmp;
+
+    if (!body_arena_has_room(tmp, &parser->arena_limit, line_view->len + kArticleArenaBytesPerLine)) {
+        return;
+    }
 
-        body_to_html(&tmp, &metadata_map, &file_lines, start_body_line_idx, &body_html);
+    i64 stage_start_offset = tmp->offset;
 
-        data.body_html = calloc(body_html.len + 1, sizeof(char));
-        assert(data.body_html);
-        memcpy(data.body_html, body_html.data, body_html.len);
+    // Kept until the parser is freed, the metadata values are views into it
+    string line = str_view_make(tmp, line_view);
+
+    body_arena_charge(parser->arena_stats, ARTICLE_ARENA_SITE_LINES, tmp, stage_start_offset);
+
+    if (!parser->body_stream) {
+        stage_start_offset = tmp->offset;
+        bool body_started = metadata_read_line(tmp, &line, &parser->meta_delim_count, &parser->metadata);
+        body_arena_charge(parser->arena_stats, ARTICLE_ARENA_SITE_METADATA, tmp, stage_start_offset);
+
+        if (!body_started) {
+            return;
+        }
+
+        article_body_outputs_begin(tmp, &parser->options, &parser->arena_limit, parser->arena_stats, &parser->body);
+        if (parser->sink) {
+            parser->body.outputs.sink = article_parser_sink;
+            parser->body.outputs.sink_ctx = parser;
+        }
+
+        parser->body_stream = body_stream_begin(tmp, &parser->metadata, &parser->body.body_html, &parser->body.outputs);
+    }
+
+    body_stream_line(parser->body_stream, &line);
+}
+
+// Drops what the parser made of the lines so far and starts again in an arena
+// grown the way article_parse_bytes grows it, false when the source wasn't kept
+// or the arena is at the limit
+static bool article_parser_restart(ArticleParser *parser) {
+    i64 arena_capacity = parser->arena_limit.capacity;
+    if (!parser->source || !article_arena_grow(parser->options.source_path, &arena_capacity)) {
+        return false;
+    }
+
+    if (parser->body_stream) {
+        body_stream_free(parser->body_stream);
+        parser->body_stream = nullptr;
+        article_body_outputs_end(&parser->body, &parser->options, false, &parser->data);
+    }
+    parser->body = (ArticleBodyOutputs){};
+
+    article_free(&parser->data);
+    parser->data = (ArticleData){};
+
+    metadata_free(&parser->metadata);
+    parser->metadata = (Metadata){};
+    parser->meta_delim_count = 0;
+
+    arena_free(&parser->tmp);
+    parser->arena_limit = (BodyArenaLimit){arena_capacity};
+    parser->tmp = article_arena_make(arena_capacity);
+    parser->arena_stats = article_arena_stats_begin(
+        &parser->tmp,
+        &parser->arena_limit,
+        &parser->options,
+        &parser->data
+    );
+
+    parser->sink_skip_len = parser->sink_len;
+
+    return true;
+}
+
+// Takes the kept lines again after a restart, stopping if the arena runs out
+static void article_parser_replay(ArticleParser *parser) {
+    const char *line_start = parser->source;
+    const char *source_end = parser->source + parser->source_len;
+
+    for (const char *newline = memchr(line_start, '\n', source_end - line_start); newline;
+         newline = memchr(line_start, '\n', source_end - line_start)) {
+        string_view line_view = {line_start, newline - line_start};
+
+        article_parser_take_line(parser, &line_view);
+        if (parser->arena_limit.exhausted) {
+            return;
+        }
+
+        line_start = newline + 1;
+    }
+}
+
+// Restarts in larger arenas until the kept lines fit, false when the parser
+// stays exhausted
+static bool article_parser_recover(ArticleParser *parser) {
+    while (parser->arena_limit.exhausted && article_parser_restart(parser)) {
+        article_parser_replay(parser);
+    }
+
+    return !parser->arena_limit.exhausted;
+}
+
+static void article_parser_keep_line(ArticleParser *parser, const string_view *line_view) {
+    size_t kept_len = parser->source_len + (size_t) line_view->len + 1;
+    if (kept_len > parser->source_capacity) {
+        parser->source_capacity = kept_len * 2;
+        parser->source = realloc(parser->source, parser->source_capacity);
+        assert(parser->source);
+    }
+
+    memcpy(parser->source + parser->source_len, line_view->data, line_view->len);
+    parser->source[kept_len - 1] = '\n';
+    parser->source_len = kept_len;
+}
+
+static void article_parser_push_line(ArticleParser *parser, const string_view *line_view) {
+    article_parser_take_line(parser, line_view);
+
+    while (parser->arena_limit.exhausted && article_parser_recover(parser)) {
+        article_parser_take_line(parser, line_view);
+    }
+
+    if (!parser->arena_limit.exhausted) {
+        if (parser->source) {
+            article_parser_keep_line(parser, line_view);
+        }
+    } else if (!parser->source) {
+        fprintf(
+            stderr,
+            "article_html: %s needs more than its %lld byte document arena, pass a larger size hint\n",
+            parser->options.source_path ? parser->options.source_path : "<bytes>",
+            (long long) parser->arena_limit.capacity
+        );
+    }
+}
+
+// Adds to the line the last chunk ended inside of. A line longer than the
+// arena could ever hold marks the parser exhausted instead
+static bool article_parser_partial_append(ArticleParser *parser, const char *bytes, size_t len) {
+    i64 line_limit = parser->source ? g_document_arena_limit : parser->arena_limit.capacity;
+
+    if (parser->partial_len + len > (size_t) line_limit) {
+        parser->arena_limit.exhausted = true;
+
+        fprintf(
+            stderr,
+            "article_html: %s has a line longer than the %lld byte document arena\n",
+            parser->options.source_path ? parser->options.source_path : "<bytes>",
+            (long long) line_limit
+        );
+        return false;
+    }
+
+    if (parser->partial_len + len > parser->partial_capacity) {
+        parser->partial_capacity = (parser->partial_len + len) * 2;
+        parser->partial_line = realloc(parser->partial_line, parser->partial_capacity);
+        assert(parser->partial_line);
+    }
+
+    memcpy(parser->partial_line + parser->partial_len, bytes, len);
+    parser->partial_len += len;
+
+    return true;
+}
+
+bool article_parser_feed(ArticleParser *parser, const char *bytes, size_t len) {
+    if (!parser || (!bytes && len > 0) || parser->arena_limit.exhausted) {
+        return false;
+    }
+
+    TRACE_BEGIN("parser_feed", parser->options.source_path, (i64) len);
+
+    const char *line_start = bytes;
+    const char *chunk_end = bytes + len;
+
+    for (const char *newline = memchr(line_start, '\n', chunk_end - line_start); newline;
+         newline = memchr(line_start, '\n', chunk_end - line_start)) {
+        string_view line_view = {line_start, newline - line_start};
+
+        if (parser->partial_len > 0) {
+            if (!article_parser_partial_append(parser, line_view.data, (size_t) line_view.len)) {
+                TRACE_END("parser_feed", -1);
+                return false;
+            }
+
+            line_view = (string_view){parser->partial_line, (i64) parser->partial_len};
+            parser->partial_len = 0;
+        }
+
+        article_parser_push_line(parser, &line_view);
+        line_start = newline + 1;
+
+        if (parser->arena_limit.exhausted) {
+            TRACE_END("parser_feed", -1);
+            return false;
+        }
+    }
+
+    // The rest waits for its newline, an unterminated metablock with it
+    size_t rest_len = chunk_end - line_start;
+    if (rest_len > 0 && !article_parser_partial_append(parser, line_start, rest_len)) {
+        TRACE_END("parser_feed", -1);
+        return false;
+    }
+
+    TRACE_END("parser_feed", (i64) parser->partial_len);
+
+    return true;
+}
+
+ArticleData article_parser_finish(ArticleParser *parser) {
+    ArticleData data = {};
+    if (!parser) {
+        return data;
+    }
+
+    TRACE_BEGIN("parser_finish", parser->options.source_path, (i64) parser->partial_len);
+
+    // Whatever follows the last newline is a line too, empty or not. The other
+    // parsers split the source with its terminator, which ends up in this line
+    if (!parser->arena_limit.exhausted && article_parser_partial_append(parser, "", 1)) {
+        string_view line_view = {parser->partial_line, (i64) parser->partial_len};
+        parser->partial_len = 0;
+
+        article_parser_push_line(parser, &line_view);
+    }
+
+    while (parser->body_stream) {
+        bool finished = body_stream_finish(parser->body_stream);
+        parser->body_stream = nullptr;
+
+        article_body_outputs_end(&parser->body, &parser->options, finished, &parser->data);
+
+        // Finishing can run out of room too, the replay then makes a new stream
+        if (parser->arena_limit.exhausted) {
+            article_parser_recover(parser);
+        }
+    }
+
+    if (!parser->arena_limit.exhausted) {
+        article_check_budget(parser->options.source_path, &parser->options, parser->arena_stats);
+    }
+
+    data = parser->data;
+    parser->data = (ArticleData){};
+
+    TRACE_END("parser_finish", -1);
+
+    article_parser_destroy(parser);
+
+    return data;
+}
+
+void article_parser_destroy(ArticleParser *parser) {
+    if (!parser) {
+        return;
+    }
+
+    if (parser->body_stream) {
+        body_stream_free(parser->body_stream);
+        article_body_outputs_end(&parser->body, &parser->options, false, &parser->data);
+    }
+
+    article_free(&parser->data);
+    metadata_free(&parser->metadata);
+    arena_free(&parser->tmp);
+    free(parser->partial_line);
+    free(parser->source);
+    free(parser);
+}
+
+void *article_ast_make(const char *filepath, size_t *out_size) {
+    if (!filepath || !out_size) {
+        return nullptr;
+    }
+
+    struct stat st = {};
+    if (stat(filepath, &st) != 0) {
+        return nullptr;
+    }
+
+    bible_require();
+
+    i64 arena_capacity = article_arena_capacity(st.st_size);
+    BodyArenaLimit arena_limit = {};
+
+    void *ast = nullptr;
+
+    do {
+        arena_limit = (BodyArenaLimit){arena_capacity};
+
+        Arena tmp = article_arena_make(arena_capacity);
+        string file_buffer = {&tmp};
+
+        strings file_lines = {};
+
+        if (article_read_file(&tmp, filepath, &file_buffer)
+            && article_split_lines(&tmp, &file_buffer, &arena_limit, &file_lines)) {
+            TRACE_BEGIN("article_ast_make", filepath, file_buffer.len);
+
+            Metadata metadata = {};
+            i64 start_body_line_idx = metadata_get(&tmp, &file_lines, &metadata);
+
+            // The terminator article_read_file adds isn't part of the source
+            u64 source_hash = hash_fnv1a(file_buffer.data, file_buffer.len - 1, HASH_FNV1A_SEED);
+
+            u64 ast_size = 0;
+            ast = body_to_ast(
+                &tmp,
+                &metadata,
+                &file_lines,
+                start_body_line_idx,
+                source_hash,
+                &arena_limit,
+                &ast_size
+            );
+            *out_size = ast_size;
+
+            metadata_free(&metadata);
+
+            TRACE_END("article_ast_make", (i64) ast_size);
+        }
+
+        arena_free(&tmp);
+    } while (arena_limit.exhausted && article_arena_grow(filepath, &arena_capacity));
+
+    return ast;
+}
+
+bool article_ast_write(const char *filepath, const char *ast_filepath) {
+    if (!ast_filepath) {
+        return false;
+    }
+
+    size_t ast_size = 0;
+    void *ast = article_ast_make(filepath, &ast_size);
+    if (!ast) {
+        return false;
+    }
+
+    size_t tmp_filepath_size = strlen(ast_filepath) + 32;
+    char *tmp_filepath = malloc(tmp_filepath_size);
+    assert(tmp_filepath);
+    snprintf(tmp_filepath, tmp_filepath_size, "%s.%d.tmp", ast_filepath, (int) getpid());
+
+    bool written = false;
+
+    FILE *fp = fopen(tmp_filepath, "wb");
+    if (fp) {
+        written = fwrite(ast, 1, ast_size, fp) == ast_size;
+        written = (fclose(fp) == 0) && written;
+
+        if (written) {
+            written = rename(tmp_filepath, ast_filepath) == 0;
+        } else {
+            remove(tmp_filepath);
+        }
+    }
+
+    free(tmp_filepath);
+    free(ast);
+
+    return written;
+}
+
+ArticleData article_parse_ast(const void *ast, size_t ast_size, const ArticleParseOptions *options) {
+    ArticleData data = {};
+
+    AstView ast_view = {};
+    if (!ast_open(&ast_view, ast, ast_size)) {
+        return data;
+    }
+
+    const char *source_path = options ? options->source_path : nullptr;
+
+    bible_require();
+
+    TRACE_BEGIN("article_parse_ast", source_path, (i64) ast_size);
+
+    i64 arena_capacity = article_arena_capacity((i64) ast_size);
+    BodyArenaLimit arena_limit = {};
+
+    do {
+        arena_limit = (BodyArenaLimit){arena_capacity};
+        data = (ArticleData){};
+
+        Arena tmp = article_arena_make(arena_capacity);
+
+        ArticleArenaStats *arena_stats = article_arena_stats_begin(&tmp, &arena_limit, options, &data);
+
+        if (ast_view.header->has_body) {
+            ArticleBodySource source = {
+                .ast = &ast_view,
+            };
+
+            if (!article_render_body(&tmp, &source, options, &arena_limit, arena_stats, &data)) {
+                fprintf(stderr, "article_html: %s has a malformed AST\n", source_path ? source_path : "<bytes>");
+                data = (ArticleData){};
+            }
+        }
+
+        if (!arena_limit.exhausted) {
+            article_check_budget(source_path, options, arena_stats);
+        }
+
+        arena_free(&tmp);
+    } while (arena_limit.exhausted && article_arena_grow(source_path, &arena_capacity));
+
+    TRACE_END("article_parse_ast", -1);
+
+    return data;
+}
+
+ArticleData article_parse_ast_file(const char *ast_filepath, const ArticleParseOptions *options) {
+    ArticleData data = {};
+    if (!ast_filepath) {
+        return data;
     }
 
-    HASHMAP_FREE(&metadata_map);
+    int fd = open(ast_filepath, O_RDONLY);
+    if (fd < 0) {
+        return data;
+    }
 
-    arena_free(&tmp);
+    struct stat st = {};
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return data;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mapping == MAP_FAILED) {
+        return data;
+    }
+
+    ArticleParseOptions ast_options = options ? *options : (ArticleParseOptions){};
+    if (!ast_options.source_path) {
+        ast_options.source_path = ast_filepath;
+    }
+
+    data = article_parse_ast(mapping, st.st_size, &ast_options);
+
+    munmap(mapping, st.st_size);
 
     return data;
 }
@@ -117,5 +1202,122 @@ void article_free(ArticleData *data) {
             free(data->body_html);
             data->body_html = nullptr;
         }
+        if (data->excerpt) {
+            free(data->excerpt);
+            data->excerpt = nullptr;
+        }
+        if (data->toc) {
+            free(data->toc);
+            data->toc = nullptr;
+            data->toc_count = 0;
+        }
+        if (data->toc_html) {
+            free(data->toc_html);
+            data->toc_html = nullptr;
+        }
+        if (data->body_compressed) {
+            free(data->body_compressed);
+            data->body_compressed = nullptr;
+            data->body_compressed_len = 0;
+        }
+        if (data->labels) {
+            for (size_t label_idx = 0; label_idx < data->label_count; label_idx++) {
+                free(data->labels[label_idx].name);
+                free(data->labels[label_idx].heading_text);
+            }
+            free(data->labels);
+            data->labels = nullptr;
+            data->label_count = 0;
+        }
+        if (data->terms) {
+            free(data->terms);
+            data->terms = nullptr;
+            data->term_count = 0;
+        }
+        if (data->passages) {
+            free(data->passages);
+            data->passages = nullptr;
+            data->passage_count = 0;
+        }
+    }
+}
+
+const char *article_arena_site_name(ArticleArenaSite site) {
+    if (site < 0 || site >= ARTICLE_ARENA_SITE_COUNT) {
+        return "unknown";
+    }
+
+    return kArticleArenaSiteStrs[site];
+}
+
+bool article_trace_start() {
+#ifdef ARTICLE_HTML_TRACE
+    trace_start();
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool article_trace_stop(const char *json_filepath) {
+#ifdef ARTICLE_HTML_TRACE
+    return trace_stop(json_filepath);
+#else
+    (void) json_filepath;
+    return false;
+#endif
+}
+
+bool article_load_label_index(const char *label_index_filepath) {
+    label_index_close(&g_label_index);
+
+    return label_index_open(&g_label_index, label_index_filepath);
+}
+
+bool article_load_bibliography(const char *bib_filepath, const char *cache_filepath) {
+    bibliography_close(&g_bibliography);
+
+    if (!bib_filepath) {
+        return false;
+    }
+
+    if (cache_filepath) {
+        return bibliography_load(&g_bibliography, bib_filepath, cache_filepath);
+    }
+
+    size_t default_cache_filepath_size = strlen(bib_filepath) + sizeof(".cache");
+    char *default_cache_filepath = malloc(default_cache_filepath_size);
+    assert(default_cache_filepath);
+    snprintf(default_cache_filepath, default_cache_filepath_size, "%s.cache", bib_filepath);
+
+    bool loaded = bibliography_load(&g_bibliography, bib_filepath, default_cache_filepath);
+
+    free(default_cache_filepath);
+
+    return loaded;
+}
+
+bool article_load_translation(const char *name, const char *csv_filepath) {
+    bible_require();
+
+    return bible_load_translation(name, csv_filepath) >= 0;
+}
+
+ArticleCompressor *article_compressor_create(ArticleCompression compression, int level) {
+    HtmlCompressor *compressor = calloc(1, sizeof(HtmlCompressor));
+    assert(compressor);
+
+    if (!html_compressor_init(compressor, compression, level)) {
+        free(compressor);
+        compressor = nullptr;
+    }
+
+    return compressor;
+}
+
+void article_compressor_destroy(ArticleCompressor *compressor) {
+    if (compressor) {
+        html_compressor_free(compressor);
+        free(compressor);
     }
 }
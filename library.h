@@ -1,6 +1,103 @@
 #ifndef ARTICLE_HTML_LIBRARY_H
 #define ARTICLE_HTML_LIBRARY_H
 
+#include <stddef.h>
+
+typedef enum ARTICLE_COMPRESSION_E {
+    ARTICLE_COMPRESSION_NONE,
+    ARTICLE_COMPRESSION_GZIP,
+    ARTICLE_COMPRESSION_ZSTD,
+} ArticleCompression;
+
+typedef struct HTML_COMPRESSOR_T ArticleCompressor;
+
+typedef struct ARTICLE_PARSER_T ArticleParser;
+
+// Receives the body HTML in order as it becomes final. Output after a forward
+// label reference is held back until the heading it links to is in
+typedef void (*ArticleHtmlSink)(void *ctx, const char *html, size_t len);
+
+typedef enum ARTICLE_TERM_FIELD_E {
+    ARTICLE_TERM_FIELD_TEXT,
+    ARTICLE_TERM_FIELD_HEADING,
+} ArticleTermField;
+
+typedef struct ARTICLE_TERM_T {
+    // Lower-cased, NUL-terminated
+    const char* text;
+    ArticleTermField field;
+} ArticleTerm;
+
+// Where a document's arena bytes go, in pipeline order
+typedef enum ARTICLE_ARENA_SITE_E {
+    ARTICLE_ARENA_SITE_SOURCE,
+    ARTICLE_ARENA_SITE_LINES,
+    ARTICLE_ARENA_SITE_METADATA,
+    ARTICLE_ARENA_SITE_TOKENS,
+    ARTICLE_ARENA_SITE_TEXT,
+    ARTICLE_ARENA_SITE_PASSAGES,
+    ARTICLE_ARENA_SITE_TERMS,
+    ARTICLE_ARENA_SITE_OUTPUT,
+    ARTICLE_ARENA_SITE_COUNT,
+} ArticleArenaSite;
+
+typedef struct ARTICLE_ARENA_SITE_STATS_T {
+    size_t bytes;
+    // Operations at the site that grew the arena
+    size_t allocation_count;
+} ArticleArenaSiteStats;
+
+typedef struct ARTICLE_ARENA_STATS_T {
+    ArticleArenaSiteStats sites[ARTICLE_ARENA_SITE_COUNT];
+    // High-watermark of the document arena
+    size_t peak_bytes;
+    size_t capacity_bytes;
+    bool over_budget;
+} ArticleArenaStats;
+
+typedef struct ARTICLE_PARSE_OPTIONS_T {
+    // Compresses body_html while it is emitted, reused across documents
+    ArticleCompressor* compressor;
+    // Only the compressed body is returned
+    bool compressed_only;
+    // Fills terms with the normalized words of the body, for search indexing
+    bool collect_terms;
+    // Fills passages with the bible passages the body quotes, for citation indexing
+    bool collect_passages;
+    // Fills arena_stats, the per-site breakdown of the document arena
+    bool collect_arena_stats;
+    // Warns on stderr when a document's arena peaks above this many bytes and
+    // collects arena_stats as well, 0 for no limit
+    size_t arena_budget;
+    // Names the article in warnings when it is parsed from bytes
+    const char* source_path;
+    // Fills excerpt with up to this many characters of the body text, 0 for none
+    size_t excerpt_chars;
+    // Fills toc and toc_html. Headings without a label get an id slugged from
+    // their text, numbered when it repeats or is taken by a label
+    bool collect_toc;
+} ArticleParseOptions;
+
+typedef struct ARTICLE_LABEL_T {
+    char* name;
+    char* heading_text;
+} ArticleLabel;
+
+// A Bible passage cited by the article, start_verse is 0 for a whole chapter
+typedef struct ARTICLE_PASSAGE_T {
+    int book;
+    int chapter;
+    int start_verse;
+    int end_verse;
+} ArticlePassage;
+
+typedef struct ARTICLE_TOC_ENTRY_T {
+    int level;
+    const char* text;
+    // Anchor of the heading in body_html
+    const char* id;
+} ArticleTocEntry;
+
 typedef struct ARTICLE_DATA_T {
     char* title;
     char* subtitle;
@@ -8,14 +105,146 @@ typedef struct ARTICLE_DATA_T {
     char* date_created;
     char* date_modified;
     char* body_html;
+    unsigned char* body_compressed;
+    size_t body_compressed_len;
+    ArticleLabel* labels;
+    size_t label_count;
+    // One allocation holding the terms followed by their text
+    ArticleTerm* terms;
+    size_t term_count;
+    ArticlePassage* passages;
+    size_t passage_count;
+    // Words of the body text, headings and bible blocks aside
+    size_t word_count;
+    // Rounded up, 0 only for an empty body
+    size_t reading_minutes;
+    // Plain text with whitespace collapsed, cut on a character boundary
+    char* excerpt;
+    // One allocation holding the entries followed by their text and ids
+    ArticleTocEntry* toc;
+    size_t toc_count;
+    // Nested <ul> lists linking every heading, outermost <ul class="toc">
+    char* toc_html;
+    ArticleArenaStats arena_stats;
 } ArticleData;
 
+typedef enum ARTICLE_CORPUS_LOADING_E {
+    // Loaded by article_init_ex
+    ARTICLE_CORPUS_LOADING_EAGER,
+    // Loaded by the first parse or translation that needs it
+    ARTICLE_CORPUS_LOADING_LAZY,
+} ArticleCorpusLoading;
+
+// Zero members take the defaults
+typedef struct ARTICLE_CONFIG_T {
+    // Bytes reserved for the allocator, 1 GB by default
+    size_t memory_budget;
+    // Most a document's arena may grow to, half the budget by default. Arenas
+    // start out sized to the document and grow when a body runs out of room
+    size_t document_arena_limit;
+    // The default translation, "./data/lsb.csv" by default
+    const char* corpus_filepath;
+    ArticleCorpusLoading corpus_loading;
+    // Maps the translations' text on 2 MB pages, MAP_HUGETLB when pages are
+    // reserved and madvise(MADV_HUGEPAGE) otherwise. Document arenas of 2 MB
+    // or more are advised onto them as well
+    bool huge_pages;
+} ArticleConfig;
+
+typedef struct ARTICLE_HUGE_PAGES_REPORT_T {
+    // Bytes mapped for the loaded translations
+    size_t corpus_bytes;
+    // Of those, bytes on 2 MB pages right now. The kernel may back advised
+    // mappings with 4 KB pages when it has no huge ones free
+    size_t corpus_huge_bytes;
+    int translation_count;
+    // Translations on reserved hugetlb pages rather than transparent ones
+    int hugetlb_count;
+} ArticleHugePagesReport;
+
+// Same as article_init_ex with every default
 void article_init();
 
+// Only the first call after article_uninit takes effect
+void article_init_ex(const ArticleConfig *config);
+
+// Bytes article_init_ex reserved for the allocator, 0 before it
+size_t article_memory_budget();
+
+// Zero before a lazily loaded corpus is first used
+ArticleHugePagesReport article_huge_pages_report();
+
 void article_uninit();
 
 ArticleData article_parse(const char *filepath);
 
+ArticleData article_parse_ex(const char *filepath, const ArticleParseOptions *options);
+
+// Parses an article already held in memory, e.g. an upload or a daemon request
+ArticleData article_parse_bytes(const char *bytes, size_t len, const ArticleParseOptions *options);
+
+// Parses an article pushed a chunk at a time, e.g. as an upload arrives. Each
+// block is rendered and handed to sink, which may be null, as soon as its last
+// line is in. size_hint sizes the document arena like the length passed to
+// article_parse_bytes. With 0 the arena starts small and the parser keeps the
+// lines, replaying them into a larger arena whenever it runs out
+ArticleParser *article_parser_create(
+    const ArticleParseOptions *options,
+    size_t size_hint,
+    ArticleHtmlSink sink,
+    void *sink_ctx
+);
+
+// Chunks may end anywhere, inside a line or a metablock. Returns false once the
+// arena has run out for good, the rest of the article is dropped then
+bool article_parser_feed(ArticleParser *parser, const char *bytes, size_t len);
+
+// Renders what is left and frees the parser. The data is what article_parse_bytes
+// makes of the same bytes, without the body when the arena ran out
+ArticleData article_parser_finish(ArticleParser *parser);
+
+// Frees a parser without finishing it, e.g. when the upload is aborted
+void article_parser_destroy(ArticleParser *parser);
+
+// Tokenizes an article once into a self-contained binary AST, malloc'd, the
+// caller frees it. Loading it later skips straight to emitting the HTML
+void *article_ast_make(const char *filepath, size_t *out_size);
+
+// Writes the AST of an article beside ast_filepath and renames it into place
+bool article_ast_write(const char *filepath, const char *ast_filepath);
+
+// Emits an article from its AST, ast must be 8-byte aligned. Translations are
+// matched by name against the ones loaded now. Returns empty data when the AST
+// is corrupt or from another version
+ArticleData article_parse_ast(const void *ast, size_t ast_size, const ArticleParseOptions *options);
+
+// Maps an AST file and emits it
+ArticleData article_parse_ast_file(const char *ast_filepath, const ArticleParseOptions *options);
+
 void article_free(ArticleData *data);
 
+const char *article_arena_site_name(ArticleArenaSite site);
+
+// Records spans until article_trace_stop writes them as Chrome trace-event
+// JSON, both return false when the build has no ARTICLE_HTML_TRACE
+bool article_trace_start();
+
+bool article_trace_stop(const char *json_filepath);
+
+bool article_load_label_index(const char *label_index_filepath);
+
+// Resolves "{{cite <key>, ...}}" against a .bib. It is parsed once into
+// cache_filepath, nullptr for "<bib_filepath>.cache", and only parsed again
+// after the .bib changes. Load before rendering, the threads share it read-only
+bool article_load_bibliography(const char *bib_filepath, const char *cache_filepath);
+
+// Makes a translation selectable with "translation = <name>" in the metadata
+// or "{{bible block <name> <refs>}}", after article_init
+bool article_load_translation(const char *name, const char *csv_filepath);
+
+// Returns nullptr when the compression isn't available in this build
+ArticleCompressor *article_compressor_create(ArticleCompression compression, int level);
+
+void article_compressor_destroy(ArticleCompressor *compressor);
+
 #endif // ARTICLE_HTML_LIBRARY_H
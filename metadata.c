@@ -4,45 +4,148 @@
 
 #include "metadata.h"
 
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 static const char *kMetadataDelimiter = "---";
-static const char *kMetadataFieldAssignDelimiter = "=";
+static const char kMetadataFieldAssignDelimiter = '=';
 
-i64 metadata_get(Arena *arena, const strings *file_lines, MetadataMap *out_map) {
-    i64 end_metadata_line_idx = -1;
+static const char *kMetadataKeyStrs[] = {
+#ifndef X
+#define X(key, str) \
+    str,
+#endif
+    X_METADATA_KEYS
+#undef X
+};
 
-    i32 meta_delim_count = 0;
+#define METADATA_KEY_SLOT_COUNT 16
 
-    ARRAY_FOR(line, file_lines) {
-        if (strncmp(line->data, kMetadataDelimiter, strlen(kMetadataDelimiter)) == 0) {
-            meta_delim_count++;
-        } else {
-            if (meta_delim_count == 1) {
-                u64 delim_len = strlen(kMetadataFieldAssignDelimiter);
-                const char* assign_delim = strstr(line->data, kMetadataFieldAssignDelimiter);
-                if (assign_delim) {
-                    string_view key = {
-                        line->data,
-                        assign_delim - line->data
-                    };
-                    string_view val = {
-                        assign_delim + delim_len,
-                        (line->data + line->len + 1) - (assign_delim + delim_len)
-                    };
-
-                    str_view_strip(&key);
-                    str_view_strip(&val);
+// (len + key[0]) & kMetadataKeySlotMask is distinct for every known key, so one
+// slot lookup and one memcmp settle it. The slots can't be checked at compile
+// time, C doesn't fold string literals, so metadata_init aborts when a key no
+// longer owns its slot
+static const u32 kMetadataKeySlotMask = METADATA_KEY_SLOT_COUNT - 1;
+
+static_assert(METADATA_KEY_COUNT <= METADATA_KEY_SLOT_COUNT, "every known key needs a slot of its own");
+
+static const MetadataKey kMetadataKeySlots[METADATA_KEY_SLOT_COUNT] = {
+    [0] = METADATA_KEY_DATE_CREATED, // 12 + 'd'
+    [1] = METADATA_KEY_DATE_MODIFIED, // 13 + 'd'
+    [2] = METADATA_KEY_COUNT,
+    [3] = METADATA_KEY_COUNT,
+    [4] = METADATA_KEY_COUNT,
+    [5] = METADATA_KEY_COUNT,
+    [6] = METADATA_KEY_COUNT,
+    [7] = METADATA_KEY_AUTHOR, // 6 + 'a'
+    [8] = METADATA_KEY_COUNT,
+    [9] = METADATA_KEY_TITLE, // 5 + 't'
+    [10] = METADATA_KEY_COUNT,
+    [11] = METADATA_KEY_SUBTITLE, // 8 + 's'
+    [12] = METADATA_KEY_COUNT,
+    [13] = METADATA_KEY_COUNT,
+    [14] = METADATA_KEY_COUNT,
+    [15] = METADATA_KEY_TRANSLATION, // 11 + 't'
+};
+
+MetadataKey metadata_key_find(const string_view *key) {
+    if (!key || key->len <= 0) {
+        return METADATA_KEY_COUNT;
+    }
+
+    u32 slot = ((u32) key->len + (u8) key->data[0]) & kMetadataKeySlotMask;
+    MetadataKey metadata_key = kMetadataKeySlots[slot];
+
+    if (metadata_key == METADATA_KEY_COUNT
+        || (i64) strlen(kMetadataKeyStrs[metadata_key]) != key->len
+        || memcmp(kMetadataKeyStrs[metadata_key], key->data, key->len) != 0) {
+        return METADATA_KEY_COUNT;
+    }
+
+    return metadata_key;
+}
+
+void metadata_init() {
+    // A key added to X_METADATA_KEYS whose slot is missing or taken would
+    // otherwise silently land in the unknown map, so this holds in release
+    // builds too
+    for (i32 key_idx = 0; key_idx < METADATA_KEY_COUNT; key_idx++) {
+        string_view key = {
+            kMetadataKeyStrs[key_idx],
+            (i64) strlen(kMetadataKeyStrs[key_idx]),
+        };
+
+        if (metadata_key_find(&key) != (MetadataKey) key_idx) {
+            fprintf(stderr, "article_html: metadata key \"%s\" doesn't own its slot\n", kMetadataKeyStrs[key_idx]);
+            abort();
+        }
+    }
+}
+
+bool metadata_read_line(Arena *arena, const string *line, i32 *inout_delim_count, Metadata *out_metadata) {
+    i64 delim_len = (i64) strlen(kMetadataDelimiter);
+
+    if (line->len >= delim_len && memcmp(line->data, kMetadataDelimiter, delim_len) == 0) {
+        (*inout_delim_count)++;
+    } else {
+        if (*inout_delim_count == 1) {
+            const char *assign_delim = memchr(line->data, kMetadataFieldAssignDelimiter, line->len);
+            if (assign_delim) {
+                string_view key = {
+                    line->data,
+                    assign_delim - line->data
+                };
+                string_view val = {
+                    assign_delim + 1,
+                    (line->data + line->len) - (assign_delim + 1)
+                };
+
+                str_view_strip(&key);
+                str_view_strip(&val);
+
+                MetadataKey metadata_key = metadata_key_find(&key);
+
+                if (metadata_key != METADATA_KEY_COUNT) {
+                    out_metadata->values[metadata_key] = val;
+                } else {
+                    if (!out_metadata->unknown_map_made) {
+                        out_metadata->unknown_map = (MetadataMap){HASHMAP_TYPE_STR_KEY};
+                        string default_str = {};
+                        HASHMAP_MAKE(&out_metadata->unknown_map, &default_str);
+                        out_metadata->unknown_map_made = true;
+                    }
 
                     string key_str = str_view_make(arena, &key);
                     string val_str = str_view_make(arena, &val);
 
-                    HASHMAP_PUT(out_map, &key_str.data, &val_str);
+                    HASHMAP_PUT(&out_metadata->unknown_map, &key_str.data, &val_str);
                 }
-            } else if (meta_delim_count >= 2) {
-                end_metadata_line_idx = line - file_lines->data;
-                break;
             }
+        } else if (*inout_delim_count >= 2) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+i64 metadata_get(Arena *arena, const strings *file_lines, Metadata *out_metadata) {
+    i32 meta_delim_count = 0;
+
+    ARRAY_FOR(line, file_lines) {
+        if (metadata_read_line(arena, line, &meta_delim_count, out_metadata)) {
+            return line - file_lines->data;
         }
     }
 
-    return end_metadata_line_idx;
+    return -1;
+}
+
+void metadata_free(Metadata *metadata) {
+    if (metadata && metadata->unknown_map_made) {
+        HASHMAP_FREE(&metadata->unknown_map);
+        metadata->unknown_map_made = false;
+    }
 }
@@ -8,10 +8,50 @@
 #include <altcore/hashmap.h>
 #include <altcore/strings.h>
 
+typedef enum METADATA_KEY_E : i32 {
+#ifndef X_METADATA_KEYS
+#define X_METADATA_KEYS \
+    X(TITLE, "title") \
+    X(SUBTITLE, "subtitle") \
+    X(AUTHOR, "author") \
+    X(DATE_CREATED, "date_created") \
+    X(DATE_MODIFIED, "date_modified") \
+    X(TRANSLATION, "translation")
+#endif
+#ifndef X
+#define X(key, str) \
+    METADATA_KEY_##key,
+#endif
+    X_METADATA_KEYS
+#undef X
+    METADATA_KEY_COUNT
+} MetadataKey;
+
 typedef struct METADATA_MAP_T {
     HASHMAP_FIELDS(const char*, string)
 } MetadataMap;
 
-i64 metadata_get(Arena *arena, const strings *file_lines, MetadataMap *out_map);
+typedef struct METADATA_T {
+    // Views into the file lines, data is nullptr when the key is absent
+    string_view values[METADATA_KEY_COUNT];
+    // Keys outside X_METADATA_KEYS, only made once the header has one
+    MetadataMap unknown_map;
+    bool unknown_map_made;
+} Metadata;
+
+// Known keys land in values without allocating, only unknown keys are copied
+i64 metadata_get(Arena *arena, const strings *file_lines, Metadata *out_metadata);
+
+// One line of metadata_get, for lines that arrive one at a time. True when the
+// line is the first of the body, the values are views into the earlier lines
+bool metadata_read_line(Arena *arena, const string *line, i32 *inout_delim_count, Metadata *out_metadata);
+
+void metadata_free(Metadata *metadata);
+
+// METADATA_KEY_COUNT when the key isn't a known one
+MetadataKey metadata_key_find(const string_view *key);
+
+// Checks the known keys' slots once at startup
+void metadata_init();
 
 #endif //ARTICLE_HTML_METADATA_H
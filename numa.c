@@ -0,0 +1,156 @@
+//
+// Created by wright on 10/19/26.
+//
+
+// sched_setaffinity and the CPU_* macros
+#define _GNU_SOURCE
+
+#include "numa.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+static const char *kNumaNodesDir = "/sys/devices/system/node";
+
+// Bits in the one-word node masks handed to the kernel, which reads maxnode - 1
+static const u64 kNumaMaskBits = 64;
+
+// "0-3,8-11" into the node's CPUs, keeping only the allowed ones
+static void numa_parse_cpulist(const char *cpulist, const cpu_set_t *allowed, NumaNode *node) {
+    const char *c = cpulist;
+
+    while (*c >= '0' && *c <= '9') {
+        char *end = nullptr;
+        long first_cpu = strtol(c, &end, 10);
+        long last_cpu = first_cpu;
+
+        if (*end == '-') {
+            last_cpu = strtol(end + 1, &end, 10);
+        }
+
+        for (long cpu = first_cpu; cpu <= last_cpu && node->cpu_count < NUMA_NODE_CPU_MAX; cpu++) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, allowed)) {
+                node->cpus[node->cpu_count++] = (i32) cpu;
+            }
+        }
+
+        c = *end == ',' ? end + 1 : end;
+    }
+}
+
+static int numa_node_cmp(const void *a, const void *b) {
+    return ((const NumaNode *) a)->id - ((const NumaNode *) b)->id;
+}
+
+void numa_topology_detect(NumaTopology *topology) {
+    *topology = (NumaTopology){};
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        for (i32 cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    DIR *nodes_dir = opendir(kNumaNodesDir);
+
+    if (nodes_dir) {
+        struct dirent *entry = nullptr;
+
+        while ((entry = readdir(nodes_dir)) && topology->node_count < NUMA_NODE_MAX) {
+            int node_id = -1;
+            char tail = '\0';
+
+            // "node<N>" only, not "node<N>x" or the has_* masks beside them
+            if (sscanf(entry->d_name, "node%d%c", &node_id, &tail) != 1 || node_id < 0) {
+                continue;
+            }
+
+            char cpulist_filepath[320];
+            snprintf(cpulist_filepath, sizeof(cpulist_filepath), "%s/%s/cpulist", kNumaNodesDir, entry->d_name);
+
+            FILE *fp = fopen(cpulist_filepath, "r");
+            if (!fp) {
+                continue;
+            }
+
+            char cpulist[4096] = {};
+            bool read = fgets(cpulist, sizeof(cpulist), fp) != nullptr;
+            fclose(fp);
+
+            NumaNode *node = &topology->nodes[topology->node_count];
+            *node = (NumaNode){.id = node_id};
+
+            if (read) {
+                numa_parse_cpulist(cpulist, &allowed, node);
+            }
+
+            // Memory-only nodes and ones the affinity mask rules out run no workers
+            if (node->cpu_count > 0) {
+                topology->node_count++;
+            }
+        }
+
+        closedir(nodes_dir);
+    }
+
+    if (topology->node_count == 0) {
+        NumaNode *node = &topology->nodes[0];
+        *node = (NumaNode){};
+
+        for (i32 cpu = 0; cpu < CPU_SETSIZE && node->cpu_count < NUMA_NODE_CPU_MAX; cpu++) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                node->cpus[node->cpu_count++] = cpu;
+            }
+        }
+
+        topology->node_count = 1;
+    }
+
+    qsort(topology->nodes, topology->node_count, sizeof(NumaNode), numa_node_cmp);
+}
+
+i32 numa_node_cpu(const NumaNode *node, i32 n) {
+    if (node->cpu_count <= 0) {
+        return -1;
+    }
+
+    return node->cpus[n % node->cpu_count];
+}
+
+bool numa_bind_thread(const NumaNode *node, i32 cpu) {
+    bool bound = true;
+
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+
+        bound = sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+    }
+
+    if (node->id >= 0 && (u64) node->id < kNumaMaskBits) {
+        unsigned long node_mask = 1UL << node->id;
+
+        bound = syscall(SYS_set_mempolicy, MPOL_PREFERRED, &node_mask, kNumaMaskBits + 1) == 0 && bound;
+    }
+
+    return bound;
+}
+
+bool numa_bind_memory(void *data, u64 size, const NumaNode *node) {
+    if (node->id < 0 || (u64) node->id >= kNumaMaskBits) {
+        return false;
+    }
+
+    unsigned long node_mask = 1UL << node->id;
+
+    return syscall(SYS_mbind, data, size, MPOL_BIND, &node_mask, kNumaMaskBits + 1, 0) == 0;
+}
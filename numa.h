@@ -0,0 +1,39 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_NUMA_H
+#define ARTICLE_HTML_NUMA_H
+
+#include <altcore/types.h>
+
+#define NUMA_NODE_MAX 8
+#define NUMA_NODE_CPU_MAX 256
+
+// A node and the CPUs of it this process may run on
+typedef struct NUMA_NODE_T {
+    i32 id;
+    i32 cpu_count;
+    i32 cpus[NUMA_NODE_CPU_MAX];
+} NumaNode;
+
+// Nodes without an allowed CPU are left out, a machine /sys shows no nodes
+// for is one node holding every allowed CPU
+typedef struct NUMA_TOPOLOGY_T {
+    i32 node_count;
+    NumaNode nodes[NUMA_NODE_MAX];
+} NumaTopology;
+
+void numa_topology_detect(NumaTopology *topology);
+
+// The n-th allowed CPU of the node, wrapping around
+i32 numa_node_cpu(const NumaNode *node, i32 n);
+
+// Pins the calling thread to one CPU and prefers its node for the pages it
+// touches from then on
+bool numa_bind_thread(const NumaNode *node, i32 cpu);
+
+// Binds a mapping nothing has touched yet to the node's memory
+bool numa_bind_memory(void *data, u64 size, const NumaNode *node);
+
+#endif //ARTICLE_HTML_NUMA_H
@@ -0,0 +1,559 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "search_index.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <altcore/arenas.h>
+#include <altcore/hashmap.h>
+
+#include "index_file.h"
+#include "altcore/defer.h"
+
+// A u32 takes at most five 7-bit groups
+static const i64 kSearchVarintMaxLen = 5;
+
+typedef struct SEARCH_DOC_TERMS_MAP_T {
+    HASHMAP_FIELDS(const char*, i64)
+} SearchDocTermsMap;
+
+typedef struct SEARCH_INDEX_DOCS_T {
+    ARRAY_FIELDS(SearchIndexDoc)
+} SearchIndexDocs;
+
+typedef struct SEARCH_INDEX_TERMS_T {
+    ARRAY_FIELDS(SearchIndexTerm)
+} SearchIndexTerms;
+
+// Two sorted runs merged into out on their own thread
+typedef struct SEARCH_MERGE_PAIR_T {
+    pthread_t thread;
+    const SearchIndexRecord *a;
+    i64 a_len;
+    const SearchIndexRecord *b;
+    i64 b_len;
+    SearchIndexRecord *out;
+} SearchMergePair;
+
+bool search_term_char(char c) {
+    // Bytes of multi-byte UTF-8 sequences stay part of the word
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || (u8) c >= 0x80;
+}
+
+static i32 search_index_record_cmp(const SearchIndexRecord *a, const SearchIndexRecord *b) {
+    i32 cmp = index_file_str_cmp(&a->term, &b->term);
+    if (cmp == 0) {
+        cmp = (a->posting.doc_idx > b->posting.doc_idx) - (a->posting.doc_idx < b->posting.doc_idx);
+    }
+
+    return cmp;
+}
+
+static int search_index_record_qsort_cmp(const void *a, const void *b) {
+    return search_index_record_cmp(a, b);
+}
+
+static void search_put_varint(string *bytes, u32 val) {
+    while (val >= 0x80) {
+        bytes->data[bytes->len++] = (char) ((val & 0x7F) | 0x80);
+        val >>= 7;
+    }
+
+    bytes->data[bytes->len++] = (char) val;
+}
+
+static bool search_get_varint(const u8 **cursor, const u8 *end, u32 *out_val) {
+    u32 val = 0;
+
+    for (i64 shift = 0; shift < 7 * kSearchVarintMaxLen && *cursor < end; shift += 7) {
+        u8 byte = *(*cursor)++;
+        val |= (u32) (byte & 0x7F) << shift;
+
+        if (!(byte & 0x80)) {
+            *out_val = val;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool search_index_open(SearchIndex *index, const char *filepath) {
+    if (!index || !filepath) {
+        return false;
+    }
+
+    *index = (SearchIndex){};
+
+    IndexFileMapping mapping = {};
+    if (!index_file_map(filepath, sizeof(SearchIndexHeader), &mapping)) {
+        return false;
+    }
+
+    const SearchIndexHeader *header = (const SearchIndexHeader *) mapping.data;
+
+    bool valid = header->magic == SEARCH_INDEX_MAGIC
+                 && header->version == SEARCH_INDEX_VERSION
+                 && index_file_section_fits(
+                     &mapping,
+                     header->docs_offset,
+                     header->doc_count,
+                     sizeof(SearchIndexDoc),
+                     alignof(SearchIndexDoc)
+                 )
+                 && index_file_section_fits(
+                     &mapping,
+                     header->terms_offset,
+                     header->term_count,
+                     sizeof(SearchIndexTerm),
+                     alignof(SearchIndexTerm)
+                 )
+                 && index_file_section_fits(&mapping, header->postings_offset, header->postings_size, 1, 1)
+                 && index_file_section_fits(&mapping, header->strs_offset, header->strs_size, 1, 1);
+
+    // Lookups trust the tables from here on, so every string has to lie in the
+    // pool and every term's postings in the postings section
+    const SearchIndexDoc *docs = (const SearchIndexDoc *) (mapping.data + header->docs_offset);
+    const SearchIndexTerm *terms = (const SearchIndexTerm *) (mapping.data + header->terms_offset);
+
+    for (u32 doc_idx = 0; valid && doc_idx < header->doc_count; doc_idx++) {
+        valid = index_file_str_fits(header->strs_size, docs[doc_idx].path_offset, docs[doc_idx].path_len);
+    }
+
+    for (u32 term_idx = 0; valid && term_idx < header->term_count; term_idx++) {
+        const SearchIndexTerm *term = &terms[term_idx];
+
+        valid = index_file_str_fits(header->strs_size, term->text_offset, term->text_len)
+                && term->postings_offset <= header->postings_size
+                && term->postings_len <= header->postings_size - term->postings_offset;
+    }
+
+    if (!valid) {
+        index_file_unmap(&mapping);
+        return false;
+    }
+
+    index->data = mapping.data;
+    index->size = mapping.size;
+    index->header = header;
+    index->docs = docs;
+    index->terms = terms;
+    index->postings = index->data + header->postings_offset;
+    index->strs = (const char *) (index->data + header->strs_offset);
+
+    return true;
+}
+
+void search_index_close(SearchIndex *index) {
+    if (index && index->data) {
+        IndexFileMapping mapping = {index->data, index->size};
+        index_file_unmap(&mapping);
+        *index = (SearchIndex){};
+    }
+}
+
+bool search_index_find(const SearchIndex *index, const string_view *term, SearchPostingsIter *out_iter) {
+    if (!index || !index->data || !term || term->len <= 0 || term->len > SEARCH_TERM_MAX_LEN) {
+        return false;
+    }
+
+    char normalized_term_data[SEARCH_TERM_MAX_LEN];
+    for (i64 c_idx = 0; c_idx < term->len; c_idx++) {
+        char c = term->data[c_idx];
+        normalized_term_data[c_idx] = c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+    }
+
+    string_view normalized_term = {
+        normalized_term_data,
+        term->len,
+    };
+
+    // The dictionary is sorted, so a binary search touches only log2(term_count) pages
+    i64 low_idx = 0;
+    i64 high_idx = (i64) index->header->term_count - 1;
+
+    while (low_idx <= high_idx) {
+        i64 mid_idx = low_idx + (high_idx - low_idx) / 2;
+        const SearchIndexTerm *entry = &index->terms[mid_idx];
+
+        string_view entry_text = {
+            index->strs + entry->text_offset,
+            entry->text_len,
+        };
+
+        i32 cmp = index_file_str_cmp(&entry_text, &normalized_term);
+
+        if (cmp < 0) {
+            low_idx = mid_idx + 1;
+        } else if (cmp > 0) {
+            high_idx = mid_idx - 1;
+        } else {
+            if (out_iter) {
+                *out_iter = (SearchPostingsIter){
+                    .cursor = index->postings + entry->postings_offset,
+                    .end = index->postings + entry->postings_offset + entry->postings_len,
+                    .doc_count = entry->doc_count,
+                };
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool search_postings_next(SearchPostingsIter *iter, SearchPosting *out_posting) {
+    if (!iter || iter->cursor >= iter->end) {
+        return false;
+    }
+
+    u32 doc_idx_delta = 0;
+    SearchPosting posting = {};
+
+    if (!search_get_varint(&iter->cursor, iter->end, &doc_idx_delta)
+        || !search_get_varint(&iter->cursor, iter->end, &posting.heading_count)
+        || !search_get_varint(&iter->cursor, iter->end, &posting.text_count)) {
+        iter->cursor = iter->end;
+        return false;
+    }
+
+    iter->doc_idx += doc_idx_delta;
+    posting.doc_idx = iter->doc_idx;
+
+    if (out_posting) {
+        *out_posting = posting;
+    }
+
+    return true;
+}
+
+string_view search_index_doc_path(const SearchIndex *index, u32 doc_idx) {
+    string_view path = {};
+
+    if (index && index->data && doc_idx < index->header->doc_count) {
+        path.data = index->strs + index->docs[doc_idx].path_offset;
+        path.len = index->docs[doc_idx].path_len;
+    }
+
+    return path;
+}
+
+void search_index_push_doc(
+    Arena *arena,
+    u32 doc_idx,
+    const ArticleTerm *terms,
+    i64 term_count,
+    SearchIndexRecords *out_records
+) {
+    SearchDocTermsMap doc_terms = {HASHMAP_TYPE_STR_KEY};
+    i64 default_record_idx = -1;
+    HASHMAP_MAKE(&doc_terms, &default_record_idx);
+
+    for (i64 term_idx = 0; term_idx < term_count; term_idx++) {
+        const ArticleTerm *term = &terms[term_idx];
+
+        i64 record_idx = HASHMAP_GET_VAL(&doc_terms, &term->text);
+
+        if (record_idx < 0) {
+            string term_text = str_make(arena, "%s", term->text);
+
+            SearchIndexRecord record = {
+                .term = {term_text.data, term_text.len},
+                .posting = {.doc_idx = doc_idx},
+            };
+
+            ARRAY_PUSH(out_records, &record);
+
+            record_idx = out_records->len - 1;
+            HASHMAP_PUT(&doc_terms, &term->text, &record_idx);
+        }
+
+        SearchPosting *posting = &out_records->data[record_idx].posting;
+        if (term->field == ARTICLE_TERM_FIELD_HEADING) {
+            posting->heading_count++;
+        } else {
+            posting->text_count++;
+        }
+    }
+
+    HASHMAP_FREE(&doc_terms);
+}
+
+i64 search_index_push_capacity(const SearchIndexRecords *records, const ArticleTerm *terms, i64 term_count) {
+    // Each new term is copied with str_make, whose buffer may round up to twice the text
+    i64 capacity = 0;
+    for (i64 term_idx = 0; term_idx < term_count; term_idx++) {
+        capacity += 2 * ((i64) strlen(terms[term_idx].text) + 1) + 16;
+    }
+
+    // Outgrowing the array reallocates it at twice the size, the doublings
+    // together take less than twice the final size
+    i64 records_cap = records->cap > 0 ? records->cap : 8;
+    while (records_cap < records->len + term_count) {
+        records_cap *= 2;
+    }
+    if (records_cap > records->cap) {
+        capacity += 2 * records_cap * (i64) sizeof(SearchIndexRecord);
+    }
+
+    return capacity + 1024;
+}
+
+void search_index_sort_records(SearchIndexRecords *records) {
+    qsort(records->data, records->len, sizeof(SearchIndexRecord), search_index_record_qsort_cmp);
+}
+
+static void *search_merge_pair_run(void *arg) {
+    SearchMergePair *pair = arg;
+
+    i64 a_idx = 0;
+    i64 b_idx = 0;
+    i64 out_idx = 0;
+
+    while (a_idx < pair->a_len && b_idx < pair->b_len) {
+        if (search_index_record_cmp(&pair->b[b_idx], &pair->a[a_idx]) < 0) {
+            pair->out[out_idx++] = pair->b[b_idx++];
+        } else {
+            pair->out[out_idx++] = pair->a[a_idx++];
+        }
+    }
+
+    memcpy(pair->out + out_idx, pair->a + a_idx, (pair->a_len - a_idx) * sizeof(SearchIndexRecord));
+    out_idx += pair->a_len - a_idx;
+    memcpy(pair->out + out_idx, pair->b + b_idx, (pair->b_len - b_idx) * sizeof(SearchIndexRecord));
+
+    return nullptr;
+}
+
+// Merges the runs pairwise, each pair of a round on its own thread, until one
+// is left. Returns the sorted records, malloc'd unless it is the only run
+static const SearchIndexRecord *search_index_merge_runs(
+    const SearchIndexRecords *runs,
+    i64 run_count,
+    i64 record_count,
+    SearchIndexRecord **out_buffers
+) {
+    out_buffers[0] = nullptr;
+    out_buffers[1] = nullptr;
+
+    if (run_count == 0) {
+        return nullptr;
+    }
+    if (run_count == 1) {
+        return runs[0].data;
+    }
+
+    const SearchIndexRecord **heads = calloc(run_count, sizeof(SearchIndexRecord *));
+    i64 *lens = calloc(run_count, sizeof(i64));
+    SearchMergePair *pairs = calloc(run_count / 2 + 1, sizeof(SearchMergePair));
+    assert(heads && lens && pairs);
+
+    for (i64 run_idx = 0; run_idx < run_count; run_idx++) {
+        heads[run_idx] = runs[run_idx].data;
+        lens[run_idx] = runs[run_idx].len;
+    }
+
+    // Rounds alternate between two buffers, a round only reads the one it isn't writing
+    for (i64 buffer_idx = 0; buffer_idx < 2; buffer_idx++) {
+        out_buffers[buffer_idx] = malloc((record_count > 0 ? record_count : 1) * sizeof(SearchIndexRecord));
+        assert(out_buffers[buffer_idx]);
+    }
+
+    i64 head_count = run_count;
+
+    for (i64 round_idx = 0; head_count > 1; round_idx++) {
+        SearchIndexRecord *out = out_buffers[round_idx % 2];
+        i64 pair_count = head_count / 2;
+        i64 out_offset = 0;
+
+        for (i64 pair_idx = 0; pair_idx < pair_count; pair_idx++) {
+            SearchMergePair *pair = &pairs[pair_idx];
+            *pair = (SearchMergePair){
+                .a = heads[2 * pair_idx],
+                .a_len = lens[2 * pair_idx],
+                .b = heads[2 * pair_idx + 1],
+                .b_len = lens[2 * pair_idx + 1],
+                .out = out + out_offset,
+            };
+            out_offset += pair->a_len + pair->b_len;
+
+            // The last pair is merged on this thread
+            if (pair_idx + 1 < pair_count) {
+                int err = pthread_create(&pair->thread, nullptr, search_merge_pair_run, pair);
+                assert(!err);
+            }
+        }
+
+        search_merge_pair_run(&pairs[pair_count - 1]);
+
+        for (i64 pair_idx = 0; pair_idx + 1 < pair_count; pair_idx++) {
+            int err = pthread_join(pairs[pair_idx].thread, nullptr);
+            assert(!err);
+        }
+
+        // An odd run out is carried over into this round's buffer
+        if (head_count % 2) {
+            memcpy(out + out_offset, heads[head_count - 1], lens[head_count - 1] * sizeof(SearchIndexRecord));
+        }
+
+        i64 next_head_count = 0;
+        out_offset = 0;
+
+        for (i64 head_idx = 0; head_idx < head_count; head_idx += 2) {
+            i64 len = lens[head_idx] + (head_idx + 1 < head_count ? lens[head_idx + 1] : 0);
+
+            heads[next_head_count] = out + out_offset;
+            lens[next_head_count] = len;
+            next_head_count++;
+            out_offset += len;
+        }
+
+        head_count = next_head_count;
+    }
+
+    const SearchIndexRecord *merged = heads[0];
+
+    free(pairs);
+    free(lens);
+    free(heads);
+
+    return merged;
+}
+
+bool search_index_write(
+    const char *filepath,
+    const string_view *doc_paths,
+    i64 doc_count,
+    const SearchIndexRecords *runs,
+    i64 run_count
+) {
+    if (!filepath || (doc_count > 0 && !doc_paths) || (run_count > 0 && !runs)) {
+        return false;
+    }
+
+    i64 record_count = 0;
+    u64 strs_size = 0;
+
+    for (i64 run_idx = 0; run_idx < run_count; run_idx++) {
+        record_count += runs[run_idx].len;
+
+        ARRAY_FOR(record, &runs[run_idx]) {
+            strs_size += record->term.len;
+        }
+    }
+
+    for (i64 doc_idx = 0; doc_idx < doc_count; doc_idx++) {
+        strs_size += doc_paths[doc_idx].len;
+    }
+
+    u64 postings_capacity = record_count * 3 * kSearchVarintMaxLen;
+
+    Arena arena = arena_make(
+        (i64) (strs_size + 1 + postings_capacity + 1
+               + record_count * sizeof(SearchIndexTerm)
+               + doc_count * sizeof(SearchIndexDoc))
+        + 1024
+    );
+
+    bool written = false;
+
+    DEFER(arena_free(&arena)) {
+        string strs = {&arena, (i64) strs_size + 1};
+        ARRAY_MAKE(&strs);
+        strs.len = 0;
+
+        string postings = {&arena, (i64) postings_capacity + 1};
+        ARRAY_MAKE(&postings);
+        postings.len = 0;
+
+        SearchIndexDocs docs = {&arena, doc_count > 0 ? doc_count : 1};
+        ARRAY_MAKE(&docs);
+        docs.len = 0;
+
+        SearchIndexTerms terms = {&arena, record_count > 0 ? record_count : 1};
+        ARRAY_MAKE(&terms);
+        terms.len = 0;
+
+        for (i64 doc_idx = 0; doc_idx < doc_count; doc_idx++) {
+            SearchIndexDoc doc = {
+                .path_offset = (u32) strs.len,
+                .path_len = (u32) doc_paths[doc_idx].len,
+            };
+
+            memcpy(strs.data + strs.len, doc_paths[doc_idx].data, doc_paths[doc_idx].len);
+            strs.len += doc_paths[doc_idx].len;
+
+            ARRAY_PUSH(&docs, &doc);
+        }
+
+        SearchIndexTerm *current_term = nullptr;
+        string_view current_term_text = {};
+        u32 prior_doc_idx = 0;
+
+        SearchIndexRecord *merge_buffers[2] = {};
+        const SearchIndexRecord *merged = search_index_merge_runs(runs, run_count, record_count, merge_buffers);
+
+        for (i64 record_idx = 0; record_idx < record_count; record_idx++) {
+            const SearchIndexRecord *record = &merged[record_idx];
+
+            if (!current_term || index_file_str_cmp(&current_term_text, &record->term) != 0) {
+                SearchIndexTerm term = {
+                    .text_offset = (u32) strs.len,
+                    .text_len = (u32) record->term.len,
+                    .postings_offset = postings.len,
+                };
+
+                memcpy(strs.data + strs.len, record->term.data, record->term.len);
+                strs.len += record->term.len;
+
+                ARRAY_PUSH(&terms, &term);
+
+                current_term = &terms.data[terms.len - 1];
+                current_term_text = record->term;
+                prior_doc_idx = 0;
+            }
+
+            search_put_varint(&postings, record->posting.doc_idx - prior_doc_idx);
+            search_put_varint(&postings, record->posting.heading_count);
+            search_put_varint(&postings, record->posting.text_count);
+
+            prior_doc_idx = record->posting.doc_idx;
+
+            current_term->doc_count++;
+            current_term->postings_len = (u32) (postings.len - current_term->postings_offset);
+        }
+
+        free(merge_buffers[0]);
+        free(merge_buffers[1]);
+
+        SearchIndexHeader header = {
+            .magic = SEARCH_INDEX_MAGIC,
+            .version = SEARCH_INDEX_VERSION,
+            .doc_count = (u32) docs.len,
+            .term_count = (u32) terms.len,
+        };
+
+        header.docs_offset = sizeof(SearchIndexHeader);
+        header.terms_offset = header.docs_offset + docs.len * sizeof(SearchIndexDoc);
+        header.postings_offset = header.terms_offset + terms.len * sizeof(SearchIndexTerm);
+        header.postings_size = postings.len;
+        header.strs_offset = header.postings_offset + postings.len;
+        header.strs_size = strs.len;
+
+        IndexFileSection sections[] = {
+            {&header, sizeof(header)},
+            {docs.data, docs.len * sizeof(SearchIndexDoc)},
+            {terms.data, terms.len * sizeof(SearchIndexTerm)},
+            {postings.data, postings.len},
+            {strs.data, strs.len},
+        };
+
+        written = index_file_write(filepath, sections, STATIC_ARRAY_LEN(sections));
+    }
+
+    return written;
+}
@@ -0,0 +1,120 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_SEARCH_INDEX_H
+#define ARTICLE_HTML_SEARCH_INDEX_H
+
+#include <altcore/types.h>
+#include <altcore/strings.h>
+
+#include "library.h"
+
+#define SEARCH_INDEX_MAGIC 0x58495341u // "ASIX"
+#define SEARCH_INDEX_VERSION 1u
+
+// Longer words are left out of the term stream
+#define SEARCH_TERM_MAX_LEN 64
+
+// On-disk layout: header, document table, term dictionary sorted by term
+// bytes, postings, then the string pool. Each term's postings are varints of
+// (doc_idx delta, heading_count, text_count) in ascending doc_idx order.
+typedef struct SEARCH_INDEX_HEADER_T {
+    u32 magic;
+    u32 version;
+    u32 doc_count;
+    u32 term_count;
+    u64 docs_offset;
+    u64 terms_offset;
+    u64 postings_offset;
+    u64 postings_size;
+    u64 strs_offset;
+    u64 strs_size;
+} SearchIndexHeader;
+
+typedef struct SEARCH_INDEX_DOC_T {
+    u32 path_offset, path_len;
+} SearchIndexDoc;
+
+typedef struct SEARCH_INDEX_TERM_T {
+    u32 text_offset, text_len;
+    u32 doc_count;
+    u32 postings_len;
+    u64 postings_offset;
+} SearchIndexTerm;
+
+typedef struct SEARCH_INDEX_T {
+    const u8 *data;
+    u64 size;
+    const SearchIndexHeader *header;
+    const SearchIndexDoc *docs;
+    const SearchIndexTerm *terms;
+    const u8 *postings;
+    const char *strs;
+} SearchIndex;
+
+typedef struct SEARCH_POSTING_T {
+    u32 doc_idx;
+    u32 heading_count;
+    u32 text_count;
+} SearchPosting;
+
+typedef struct SEARCH_POSTINGS_ITER_T {
+    const u8 *cursor;
+    const u8 *end;
+    u32 doc_idx;
+    u32 doc_count;
+} SearchPostingsIter;
+
+// One document's occurrence counts for a single term
+typedef struct SEARCH_INDEX_RECORD_T {
+    string_view term;
+    SearchPosting posting;
+} SearchIndexRecord;
+
+typedef struct SEARCH_INDEX_RECORDS_T {
+    ARRAY_FIELDS(SearchIndexRecord)
+} SearchIndexRecords;
+
+// Letters, digits and UTF-8 bytes make up a term, anything else separates terms
+bool search_term_char(char c);
+
+bool search_index_open(SearchIndex *index, const char *filepath);
+
+void search_index_close(SearchIndex *index);
+
+// The term is normalized the same way as the article terms before lookup
+bool search_index_find(const SearchIndex *index, const string_view *term, SearchPostingsIter *out_iter);
+
+bool search_postings_next(SearchPostingsIter *iter, SearchPosting *out_posting);
+
+string_view search_index_doc_path(const SearchIndex *index, u32 doc_idx);
+
+// Folds one article's term stream into a record per distinct term, the term
+// text is copied into the arena
+void search_index_push_doc(
+    Arena *arena,
+    u32 doc_idx,
+    const ArticleTerm *terms,
+    i64 term_count,
+    SearchIndexRecords *out_records
+);
+
+// Arena bytes search_index_push_doc may take to add this document to records,
+// so a caller can start a new run in a fresh arena before it runs out
+i64 search_index_push_capacity(const SearchIndexRecords *records, const ArticleTerm *terms, i64 term_count);
+
+// Sorts by (term, doc_idx), each worker sorts its own runs before the merge
+void search_index_sort_records(SearchIndexRecords *records);
+
+// Merges sorted runs into a single index, doc_paths is indexed by doc_idx.
+// Pairs of runs are merged on their own threads, halving the runs each round
+bool search_index_write(
+    const char *filepath,
+    const string_view *doc_paths,
+    i64 doc_count,
+    const SearchIndexRecords *runs,
+    i64 run_count
+);
+
+#endif //ARTICLE_HTML_SEARCH_INDEX_H
@@ -2,22 +2,952 @@
 // Created by wright on 2/21/26.
 //
 
+// nftw's FTW_DEPTH and FTW_PHYS
+#define _GNU_SOURCE
+
 #include "test.h"
 
+#include <ftw.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#ifdef ARTICLE_HTML_ZSTD
+#include <zstd.h>
+#endif
 
 #include "library.h"
+#include "ast.h"
+#include "batch.h"
+#include "bibliography.h"
+#include "citation_index.h"
+#include "escape.h"
+#include "label_index.h"
+#include "search_index.h"
 
-int main(int argc, char **argv) {
-    article_init();
+static int g_test_check_count = 0;
+static int g_test_failed_count = 0;
+
+// Every test writes below it, removed once the run ends
+static char g_test_dir[] = "/tmp/article_html_test.XXXXXX";
+
+static const char *kTestCorpusCsv =
+    "Book,Chapter,Verse,Text\n"
+    "Genesis,1,1,<div class=\"verse\"><sup>1</sup> In the beginning.</div>\n";
+
+bool test_check(bool passed, const char *expr, const char *file, int line) {
+    g_test_check_count++;
+
+    if (!passed) {
+        g_test_failed_count++;
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    }
+
+    return passed;
+}
+
+static char *test_path(const char *name) {
+    size_t len = strlen(g_test_dir) + 1 + strlen(name) + 1;
+    char *path = malloc(len);
+    if (path) {
+        snprintf(path, len, "%s/%s", g_test_dir, name);
+    }
+
+    return path;
+}
+
+static bool test_write_file(const char *filepath, const char *text) {
+    FILE *fp = fopen(filepath, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    bool written = fputs(text, fp) >= 0;
+
+    return fclose(fp) == 0 && written;
+}
+
+// Overwrites the u32 at offset, for checking that an open rejects the index
+static bool test_corrupt_u32(const char *filepath, u64 offset, u32 value) {
+    FILE *fp = fopen(filepath, "r+b");
+    if (!fp) {
+        return false;
+    }
+
+    bool written = fseek(fp, (long) offset, SEEK_SET) == 0 && fwrite(&value, sizeof(value), 1, fp) == 1;
+
+    return fclose(fp) == 0 && written;
+}
+
+static int test_remove_entry(const char *filepath, const struct stat *st, int type, struct FTW *ftw) {
+    return remove(filepath);
+}
+
+static bool test_str_view_eq(string_view view, const char *str) {
+    return view.len == (i64) strlen(str) && memcmp(view.data, str, view.len) == 0;
+}
+
+static LabelIndexRecord test_label_record(const char *article_path, const char *label, const char *heading_text) {
+    LabelIndexRecord record = {
+        {article_path, (i64) strlen(article_path)},
+        {label, (i64) strlen(label)},
+        {heading_text, (i64) strlen(heading_text)},
+    };
+
+    return record;
+}
+
+static void test_label_index() {
+    char *index_filepath = test_path("labels.idx");
+
+    Arena arena = arena_make(64 * 1024);
+
+    LabelIndexRecords records = {&arena};
+    ARRAY_MAKE(&records);
+
+    LabelIndexRecord record = test_label_record("site/a.xmd", "intro", "Introduction");
+    ARRAY_PUSH(&records, &record);
+    record = test_label_record("site/a.xmd", "end", "The End");
+    ARRAY_PUSH(&records, &record);
+    record = test_label_record("site/b.xmd", "intro", "Another Intro");
+    ARRAY_PUSH(&records, &record);
+
+    TEST_CHECK(label_index_write(index_filepath, &records));
+
+    LabelIndex index = {};
+    if (TEST_CHECK(label_index_open(&index, index_filepath))) {
+        string_view article_path = {"site/a.xmd", 10};
+        string_view label = {"end", 3};
+        LabelIndexRecord found = {};
+
+        TEST_CHECK(label_index_find(&index, &article_path, &label, &found));
+        TEST_CHECK(test_str_view_eq(found.heading_text, "The End"));
+
+        // Lookups are normalized the same way as the keys
+        string_view dotted_path = {"./site/b.xmd", 12};
+        label = (string_view){"intro", 5};
+        TEST_CHECK(label_index_find(&index, &dotted_path, &label, &found));
+        TEST_CHECK(test_str_view_eq(found.heading_text, "Another Intro"));
+
+        label = (string_view){"missing", 7};
+        TEST_CHECK(!label_index_find(&index, &article_path, &label, &found));
+
+        u64 heading_len_offset = index.header->entries_offset + offsetof(LabelIndexEntry, heading_len);
+        u32 strs_size = (u32) index.header->strs_size;
+        u64 slots_offset = index.header->slots_offset;
+        u32 entry_count = index.header->entry_count;
+
+        label_index_close(&index);
+
+        // A string running past the pool is rejected rather than read later
+        TEST_CHECK(test_corrupt_u32(index_filepath, heading_len_offset, strs_size + 1));
+        TEST_CHECK(!label_index_open(&index, index_filepath));
+
+        // So is a slot naming an entry past the last
+        TEST_CHECK(label_index_write(index_filepath, &records));
+        TEST_CHECK(test_corrupt_u32(index_filepath, slots_offset, entry_count + 1));
+        TEST_CHECK(!label_index_open(&index, index_filepath));
+    }
+
+    arena_free(&arena);
+    free(index_filepath);
+}
+
+static void test_search_index() {
+    char *index_filepath = test_path("search.idx");
+
+    Arena arena = arena_make(64 * 1024);
+
+    const ArticleTerm doc_terms[][3] = {
+        {{"grace", ARTICLE_TERM_FIELD_HEADING}, {"grace", ARTICLE_TERM_FIELD_TEXT}, {"peace", ARTICLE_TERM_FIELD_TEXT}},
+        {{"peace", ARTICLE_TERM_FIELD_TEXT}, {"light", ARTICLE_TERM_FIELD_TEXT}, {"peace", ARTICLE_TERM_FIELD_TEXT}},
+        {{"grace", ARTICLE_TERM_FIELD_TEXT}, {"truth", ARTICLE_TERM_FIELD_HEADING}, {"light", ARTICLE_TERM_FIELD_TEXT}},
+    };
+    const i64 doc_count = 3;
+
+    string_view doc_paths[] = {
+        {"a.xmd", 5},
+        {"b.xmd", 5},
+        {"c.xmd", 5},
+    };
+
+    // One run per document, an odd count so one is carried through a merge round
+    SearchIndexRecords runs[3] = {};
+    for (i64 doc_idx = 0; doc_idx < doc_count; doc_idx++) {
+        runs[doc_idx] = (SearchIndexRecords){&arena};
+        ARRAY_MAKE(&runs[doc_idx]);
+
+        search_index_push_doc(&arena, (u32) doc_idx, doc_terms[doc_idx], 3, &runs[doc_idx]);
+        search_index_sort_records(&runs[doc_idx]);
+    }
+
+    TEST_CHECK(search_index_write(index_filepath, doc_paths, doc_count, runs, doc_count));
+
+    SearchIndex index = {};
+    if (TEST_CHECK(search_index_open(&index, index_filepath))) {
+        TEST_CHECK(index.header->doc_count == 3);
+        TEST_CHECK(index.header->term_count == 4);
+
+        // Lookups are lower-cased like the terms
+        string_view term = {"Grace", 5};
+        SearchPostingsIter iter = {};
+        SearchPosting posting = {};
+
+        if (TEST_CHECK(search_index_find(&index, &term, &iter))) {
+            TEST_CHECK(iter.doc_count == 2);
+
+            TEST_CHECK(search_postings_next(&iter, &posting));
+            TEST_CHECK(posting.doc_idx == 0 && posting.heading_count == 1 && posting.text_count == 1);
+            TEST_CHECK(test_str_view_eq(search_index_doc_path(&index, posting.doc_idx), "a.xmd"));
+
+            TEST_CHECK(search_postings_next(&iter, &posting));
+            TEST_CHECK(posting.doc_idx == 2 && posting.heading_count == 0 && posting.text_count == 1);
+
+            TEST_CHECK(!search_postings_next(&iter, &posting));
+        }
+
+        term = (string_view){"peace", 5};
+        if (TEST_CHECK(search_index_find(&index, &term, &iter))) {
+            TEST_CHECK(search_postings_next(&iter, &posting) && posting.doc_idx == 0);
+            TEST_CHECK(search_postings_next(&iter, &posting) && posting.doc_idx == 1 && posting.text_count == 2);
+        }
+
+        term = (string_view){"mercy", 5};
+        TEST_CHECK(!search_index_find(&index, &term, &iter));
+
+        search_index_close(&index);
+    }
+
+    arena_free(&arena);
+    free(index_filepath);
+}
+
+static bool test_citation_find(
+    const CitationIndex *index,
+    BibleBook book,
+    i32 chapter,
+    i32 start_verse,
+    i32 end_verse,
+    const u32 *article_idxs,
+    i64 article_idx_count
+) {
+    Arena arena = arena_make(4096);
+
+    BiblePassage passage = {
+        book,
+        {chapter, start_verse, end_verse},
+    };
+
+    CitationIndexArticleIdxs found = citation_index_find(&arena, index, &passage);
+
+    bool equal = found.len == article_idx_count;
+    for (i64 idx = 0; equal && idx < article_idx_count; idx++) {
+        equal = found.data[idx] == article_idxs[idx];
+    }
+
+    arena_free(&arena);
+
+    return equal;
+}
+
+static void test_citation_index() {
+    char *index_filepath = test_path("citation.idx");
+
+    Arena arena = arena_make(64 * 1024);
+
+    const ArticlePassage article_passages[][2] = {
+        {{BIBLE_BOOK_JOHN, 3, 16, 16}, {BIBLE_BOOK_JOHN, 3, 16, 16}},
+        {{BIBLE_BOOK_JOHN, 3, 0, 0}, {BIBLE_BOOK_ROMANS, 8, 28, 39}},
+        {{BIBLE_BOOK_JOHN, 3, 16, 18}, {BIBLE_BOOK_ROMANS, 8, 1, 1}},
+    };
+    const i64 article_count = 3;
+
+    string_view article_paths[] = {
+        {"a.xmd", 5},
+        {"b.xmd", 5},
+        {"c.xmd", 5},
+    };
+
+    CitationIndexIntervals intervals = {&arena};
+    ARRAY_MAKE(&intervals);
+
+    for (i64 article_idx = 0; article_idx < article_count; article_idx++) {
+        citation_index_push_passages((u32) article_idx, article_passages[article_idx], 2, &intervals);
+    }
+
+    TEST_CHECK(citation_index_write(index_filepath, article_paths, article_count, &intervals));
+
+    CitationIndex index = {};
+    if (TEST_CHECK(citation_index_open(&index, index_filepath))) {
+        // The repeated John 3:16 of a.xmd is stored once
+        TEST_CHECK(index.header->article_count == 3 && index.header->interval_count == 5);
+
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_JOHN, 3, 16, 16, (u32[]) {0, 1, 2}, 3));
+        // A whole chapter citation covers each of its verses
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_JOHN, 3, 1, 1, (u32[]) {1}, 1));
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_JOHN, 3, 17, 17, (u32[]) {1, 2}, 2));
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_ROMANS, 8, 30, 31, (u32[]) {1}, 1));
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_ROMANS, 8, 0, 0, (u32[]) {1, 2}, 2));
+        TEST_CHECK(test_citation_find(&index, BIBLE_BOOK_GENESIS, 1, 1, 1, nullptr, 0));
+
+        TEST_CHECK(test_str_view_eq(citation_index_article_path(&index, 2), "c.xmd"));
+
+        u64 path_offset_offset = index.header->articles_offset + offsetof(CitationIndexArticle, path_offset);
+        u32 strs_size = (u32) index.header->strs_size;
+
+        citation_index_close(&index);
+
+        // A path pointing past the string pool fails the open instead of being read
+        TEST_CHECK(test_corrupt_u32(index_filepath, path_offset_offset, strs_size));
+        TEST_CHECK(!citation_index_open(&index, index_filepath));
+    }
+
+    arena_free(&arena);
+    free(index_filepath);
+}
+
+static void test_bibliography() {
+    char *cache_filepath = test_path("refs.bibcache");
+
+    // The title expands to more than the whole .bib, so the pools are regrown
+    const char *bib =
+        "@comment{ignored}\n"
+        "@string{ pub = \"Light Press\" }\n"
+        "@STRING{word = {Grace upon grace, } }\n"
+        "@string{words = word # word # word # word}\n"
+        "@book{smith2020,\n"
+        "  author = {John {Smith}},\n"
+        "  title = words # words # words # words # words # words # words # \"end\",\n"
+        "  publisher = pub,\n"
+        "  year = 2020 # \", \" # jan,\n"
+        "  note = {not kept}\n"
+        "}\n"
+        "@article{smith2020, title = {Duplicate}}\n";
+
+    TEST_CHECK(bibliography_compile(bib, strlen(bib), cache_filepath));
+
+    Bibliography loaded = {};
+    if (TEST_CHECK(bibliography_open(&loaded, cache_filepath))) {
+        TEST_CHECK(loaded.header->entry_count == 1);
+
+        string_view key = {"smith2020", 9};
+        BibliographyRecord record = {};
+
+        if (TEST_CHECK(bibliography_find(&loaded, &key, &record))) {
+            TEST_CHECK(test_str_view_eq(record.type, "book"));
+            TEST_CHECK(test_str_view_eq(record.fields[BIBLIOGRAPHY_FIELD_AUTHOR], "John Smith"));
+            TEST_CHECK(test_str_view_eq(record.fields[BIBLIOGRAPHY_FIELD_PUBLISHER], "Light Press"));
+            TEST_CHECK(test_str_view_eq(record.fields[BIBLIOGRAPHY_FIELD_YEAR], "2020, January"));
+
+            const string_view *title = &record.fields[BIBLIOGRAPHY_FIELD_TITLE];
+            TEST_CHECK(title->len == 28 * (i64) strlen("Grace upon grace, ") + 3);
+            TEST_CHECK(title->len > (i64) strlen(bib));
+        }
+
+        key = (string_view){"missing", 7};
+        TEST_CHECK(!bibliography_find(&loaded, &key, &record));
+
+        u64 key_offset_offset = loaded.header->entries_offset + offsetof(BibliographyEntry, key.offset);
+        u32 strs_size = (u32) loaded.header->strs_size;
+
+        bibliography_close(&loaded);
+
+        // A key running past the pool is rejected rather than read later
+        TEST_CHECK(test_corrupt_u32(cache_filepath, key_offset_offset, strs_size));
+        TEST_CHECK(!bibliography_open(&loaded, cache_filepath));
+    }
+
+    free(cache_filepath);
+}
+
+// Generated heading ids step around labels and around earlier suffixed slugs
+// What html_escape_append writes, one byte at a time
+static void test_escape_reference(string *out_html, const char *text, i64 text_len) {
+    for (i64 c_idx = 0; c_idx < text_len; c_idx++) {
+        const char *entity = nullptr;
+
+        switch (text[c_idx]) {
+            case '\0':
+                entity = "";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '&':
+                entity = "&amp;";
+                break;
+            case '"':
+                entity = "&quot;";
+                break;
+            case '\'':
+                entity = "&#39;";
+                break;
+            default:
+                break;
+        }
+
+        if (entity) {
+            str_append(out_html, "%s", entity);
+        } else {
+            str_append(out_html, "%c", text[c_idx]);
+        }
+    }
+}
+
+static bool test_escape_matches(Arena *arena, const char *text, i64 text_len) {
+    string escaped = str_make(arena, "");
+    html_escape_append(&escaped, text, text_len);
+
+    string expected = str_make(arena, "");
+    test_escape_reference(&expected, text, text_len);
+
+    return escaped.len == expected.len && memcmp(escaped.data, expected.data, expected.len) == 0;
+}
+
+// Each special byte at the edges of the 16- and 32-byte blocks and in the
+// tail the vector loops leave to the scalar one, plus empty, all-special and
+// longer-than-the-stage inputs
+static void test_html_escape() {
+    const char specials[] = {'&', '<', '>', '"', '\'', '\0'};
+    const i64 text_lens[] = {1, 15, 16, 17, 31, 32, 33, 47, 48, 63, 64, 65, 100};
+    const i64 offsets[] = {0, 15, 16, 31, 32, -1};
+    const i64 max_text_len = 5000;
+
+    Arena arena = arena_make(64 * 1024 * 1024);
+
+    char *text = malloc(max_text_len);
+    if (!TEST_CHECK(text != nullptr)) {
+        arena_free(&arena);
+        return;
+    }
+
+    TEST_CHECK(test_escape_matches(&arena, "", 0));
+
+    for (size_t special_idx = 0; special_idx < sizeof(specials); special_idx++) {
+        for (size_t len_idx = 0; len_idx < sizeof(text_lens) / sizeof(text_lens[0]); len_idx++) {
+            i64 text_len = text_lens[len_idx];
+
+            for (size_t offset_idx = 0; offset_idx < sizeof(offsets) / sizeof(offsets[0]); offset_idx++) {
+                // -1 is the last byte, past the last whole block
+                i64 offset = offsets[offset_idx] < 0 ? text_len - 1 : offsets[offset_idx];
+                if (offset >= text_len) {
+                    continue;
+                }
+
+                memset(text, 'g', text_len);
+                text[offset] = specials[special_idx];
+
+                TEST_CHECK(test_escape_matches(&arena, text, text_len));
+            }
+
+            memset(text, specials[special_idx], text_len);
+            TEST_CHECK(test_escape_matches(&arena, text, text_len));
+        }
+    }
 
-    ArticleData data = article_parse("data/draft_1.xmd");
-    if (data.body_html) {
-        printf("%s\n", data.body_html);
+    for (i64 c_idx = 0; c_idx < max_text_len; c_idx++) {
+        text[c_idx] = specials[c_idx % sizeof(specials)];
+    }
+    TEST_CHECK(test_escape_matches(&arena, text, max_text_len));
+
+    memset(text, '&', max_text_len);
+    TEST_CHECK(test_escape_matches(&arena, text, max_text_len));
+
+    free(text);
+    arena_free(&arena);
+}
+
+static void test_toc_ids() {
+    const char *article =
+        "---\n"
+        "title = Toc\n"
+        "---\n"
+        "\n"
+        "# Intro\n"
+        "\n"
+        "# Intro\n"
+        "\n"
+        "# Intro 2\n"
+        "\n"
+        "# {{label intro-3}} Labeled\n"
+        "\n"
+        "# Intro\n";
+    const char *expected_ids[] = {"intro", "intro-2", "intro-2-2", "intro-3", "intro-4"};
+    const size_t expected_count = sizeof(expected_ids) / sizeof(expected_ids[0]);
+
+    ArticleParseOptions options = {.collect_toc = true};
+    ArticleData data = article_parse_bytes(article, strlen(article), &options);
+
+    if (TEST_CHECK(data.toc_count == expected_count)) {
+        for (size_t entry_idx = 0; entry_idx < expected_count; entry_idx++) {
+            TEST_CHECK(strcmp(data.toc[entry_idx].id, expected_ids[entry_idx]) == 0);
+        }
+    }
+
+    article_free(&data);
+}
+
+// A line needs more headroom than the first arena gives, it is sized from the
+// whole source at 1 MB plus 48 bytes a byte, so the body is parsed again
+static void test_arena_retry() {
+    const char *header = "---\ntitle = Retry\n---\n\n";
+    const char *word = "grace ";
+    const i64 word_count = 64 * 1024;
+
+    i64 header_len = (i64) strlen(header);
+    i64 word_len = (i64) strlen(word);
+    i64 article_len = header_len + word_count * word_len;
+
+    char *article = malloc(article_len + 1);
+    if (!TEST_CHECK(article != nullptr)) {
+        return;
+    }
+
+    memcpy(article, header, header_len);
+    for (i64 word_idx = 0; word_idx < word_count; word_idx++) {
+        memcpy(article + header_len + word_idx * word_len, word, word_len);
+    }
+    article[article_len] = '\0';
+
+    ArticleParseOptions options = {.collect_arena_stats = true};
+    ArticleData data = article_parse_bytes(article, article_len, &options);
+
+    if (TEST_CHECK(data.body_html != nullptr)) {
+        i64 rendered_word_count = 0;
+        for (const char *match = strstr(data.body_html, "grace"); match; match = strstr(match + 1, "grace")) {
+            rendered_word_count++;
+        }
+
+        TEST_CHECK(rendered_word_count == word_count);
+        TEST_CHECK(data.arena_stats.capacity_bytes > 1024 * 1024 + 48 * (size_t) article_len);
     }
 
     article_free(&data);
+    free(article);
+}
+
+typedef struct TEST_PUSH_SINK_T {
+    char *html;
+    size_t len;
+    size_t capacity;
+} TestPushSink;
+
+static void test_push_sink(void *ctx, const char *html, size_t len) {
+    TestPushSink *sink = ctx;
+
+    if (sink->len + len > sink->capacity) {
+        sink->capacity = (sink->len + len) * 2;
+        sink->html = realloc(sink->html, sink->capacity);
+        if (!TEST_CHECK(sink->html != nullptr)) {
+            sink->len = sink->capacity = 0;
+            return;
+        }
+    }
+
+    memcpy(sink->html + sink->len, html, len);
+    sink->len += len;
+}
+
+// Pushed in chunks that end inside lines, with no size hint so the parser has
+// to replay into a larger arena, the data and the html the sink saw match a
+// parse of the whole buffer
+static void test_push_parse() {
+    const char *header = "---\ntitle = Push\n---\n\n";
+    const char *section = "# {{label part-%d}} Part\n\nSee {{ref part-0}}, grace upon grace upon grace.\n\n";
+    const int section_count = 4096;
+
+    size_t capacity = strlen(header) + (size_t) section_count * (strlen(section) + 16);
+    char *article = malloc(capacity);
+    if (!TEST_CHECK(article != nullptr)) {
+        return;
+    }
+
+    size_t len = (size_t) snprintf(article, capacity, "%s", header);
+    for (int section_idx = 0; section_idx < section_count; section_idx++) {
+        len += (size_t) snprintf(article + len, capacity - len, section, section_idx);
+    }
+
+    ArticleParseOptions options = {.collect_toc = true};
+    ArticleData parsed = article_parse_bytes(article, len, &options);
+
+    TestPushSink sink = {};
+    ArticleParser *parser = article_parser_create(&options, 0, test_push_sink, &sink);
+
+    const size_t chunk_len = 4093;
+    for (size_t offset = 0; offset < len; offset += chunk_len) {
+        size_t feed_len = len - offset < chunk_len ? len - offset : chunk_len;
+        TEST_CHECK(article_parser_feed(parser, article + offset, feed_len));
+    }
+
+    ArticleData pushed = article_parser_finish(parser);
+
+    if (TEST_CHECK(parsed.body_html != nullptr && pushed.body_html != nullptr)) {
+        size_t body_len = strlen(parsed.body_html);
+
+        TEST_CHECK(strcmp(pushed.body_html, parsed.body_html) == 0);
+        TEST_CHECK(sink.len == body_len && memcmp(sink.html, parsed.body_html, body_len) == 0);
+        TEST_CHECK(pushed.label_count == parsed.label_count);
+        TEST_CHECK(pushed.toc_count == parsed.toc_count);
+    }
+
+    article_free(&pushed);
+    article_free(&parsed);
+    free(sink.html);
+    free(article);
+}
+
+// A ref ahead of the heading it names is patched once the heading is emitted
+static void test_forward_ref() {
+    const char *article =
+        "---\n"
+        "title = Forward\n"
+        "---\n"
+        "\n"
+        "See {{ref setup}} below.\n"
+        "\n"
+        "# {{label setup}} Setup Steps\n";
+
+    ArticleData data = article_parse_bytes(article, strlen(article), nullptr);
+
+    if (TEST_CHECK(data.body_html != nullptr)) {
+        const char *link = strstr(data.body_html, "<a class=\"label-ref\" href=\"#setup\">Setup Steps</a>");
+        const char *heading = strstr(data.body_html, "id=\"setup\"");
+
+        TEST_CHECK(link != nullptr && heading != nullptr && link < heading);
+        TEST_CHECK(strstr(data.body_html, "label-ref-unresolved") == nullptr);
+    }
+
+    article_free(&data);
+}
+
+// A forward ref split across chunks holds back the sink's output from the ref
+// on, even past the flush threshold, until the heading it names is in
+static void test_push_forward_ref() {
+    const char *filler = "Filler grace upon grace upon grace upon grace.\n\n";
+    const int filler_count = 1024;
+
+    Arena arena = arena_make(1024 * 1024);
+
+    string before = str_make(&arena, "---\ntitle = Forward\n---\n\n");
+    for (int filler_idx = 0; filler_idx < filler_count; filler_idx++) {
+        str_append(&before, "%s", filler);
+    }
+    str_append(&before, "See {{ref se");
+
+    string after = str_make(&arena, "tup}} below.\n\n");
+    for (int filler_idx = 0; filler_idx < filler_count; filler_idx++) {
+        str_append(&after, "%s", filler);
+    }
+
+    const char *heading = "# {{label setup}} Setup Steps\n";
+
+    string article = str_make(&arena, "%s%s%s", before.data, after.data, heading);
+    ArticleData parsed = article_parse_bytes(article.data, article.len, nullptr);
+
+    TestPushSink sink = {};
+    ArticleParser *parser = article_parser_create(nullptr, article.len, test_push_sink, &sink);
+
+    TEST_CHECK(article_parser_feed(parser, before.data, before.len));
+    size_t before_sink_len = sink.len;
+    TEST_CHECK(article_parser_feed(parser, after.data, after.len));
+    size_t after_sink_len = sink.len;
+    TEST_CHECK(article_parser_feed(parser, heading, strlen(heading)));
+
+    ArticleData pushed = article_parser_finish(parser);
+
+    if (TEST_CHECK(parsed.body_html != nullptr && pushed.body_html != nullptr)) {
+        const char *link = strstr(parsed.body_html, "<a class=\"label-ref\" href=\"#setup\">Setup Steps</a>");
+
+        // The filler ahead of the ref was flushed, nothing from the ref on was
+        if (TEST_CHECK(link != nullptr)) {
+            TEST_CHECK(before_sink_len > 0);
+            TEST_CHECK(after_sink_len <= (size_t) (link - parsed.body_html));
+        }
+
+        size_t body_len = strlen(parsed.body_html);
+        TEST_CHECK(strcmp(pushed.body_html, parsed.body_html) == 0);
+        TEST_CHECK(sink.len == body_len && memcmp(sink.html, parsed.body_html, body_len) == 0);
+    }
+
+    article_free(&pushed);
+    article_free(&parsed);
+    free(sink.html);
+    arena_free(&arena);
+}
+
+// An article emitted from its AST, in memory and from a file, matches a parse of
+// the source, a heading deeper than <h6> included. A level past <h6> or a string
+// past the pool in the file is turned away by the open instead of being emitted
+static void test_ast_round_trip() {
+    const char *article =
+        "---\n"
+        "title = Tree\n"
+        "---\n"
+        "\n"
+        "# {{label intro}} Intro\n"
+        "\n"
+        "See {{ref intro}} and *grace* upon {{bible hover Genesis 1:1}}.\n"
+        "\n"
+        "####### Deeper than h6\n"
+        "\n"
+        "{{bible block Genesis 1:1}}\n";
+
+    char *filepath = test_path("tree.xmd");
+    char *ast_filepath = test_path("tree.ast");
+    TEST_CHECK(test_write_file(filepath, article));
+
+    ArticleParseOptions options = {.collect_toc = true};
+    ArticleData parsed = article_parse_ex(filepath, &options);
+
+    size_t ast_size = 0;
+    void *ast = article_ast_make(filepath, &ast_size);
+
+    if (TEST_CHECK(parsed.body_html != nullptr && ast != nullptr)) {
+        ArticleData from_ast = article_parse_ast(ast, ast_size, &options);
+        if (TEST_CHECK(from_ast.body_html != nullptr)) {
+            TEST_CHECK(strcmp(from_ast.body_html, parsed.body_html) == 0);
+            TEST_CHECK(from_ast.toc_count == parsed.toc_count);
+            TEST_CHECK(strstr(from_ast.body_html, "<h7") == nullptr);
+        }
+        article_free(&from_ast);
+
+        TEST_CHECK(article_ast_write(filepath, ast_filepath));
+        ArticleData from_file = article_parse_ast_file(ast_filepath, &options);
+        TEST_CHECK(from_file.body_html != nullptr && strcmp(from_file.body_html, parsed.body_html) == 0);
+        article_free(&from_file);
+
+        AstView view = {};
+        if (TEST_CHECK(ast_open(&view, ast, ast_size))) {
+            AstNode *nodes = (AstNode *) ((u8 *) ast + view.header->nodes_offset);
+            u32 node_count = view.header->node_count;
+            u64 strs_size = view.header->strs_size;
+
+            // Only heading opens carry a level
+            for (u32 node_idx = 0; node_idx < node_count; node_idx++) {
+                if (nodes[node_idx].level > 0) {
+                    i32 level = nodes[node_idx].level;
+
+                    nodes[node_idx].level = ARTICLE_AST_HEADING_LEVEL_MAX + 1;
+                    TEST_CHECK(!ast_open(&view, ast, ast_size));
+
+                    ArticleData corrupt = article_parse_ast(ast, ast_size, &options);
+                    TEST_CHECK(corrupt.body_html == nullptr);
+                    article_free(&corrupt);
+
+                    nodes[node_idx].level = level;
+                    break;
+                }
+            }
+
+            nodes[0].str_offset = (u32) strs_size;
+            TEST_CHECK(!ast_open(&view, ast, ast_size));
+        }
+    }
+
+    free(ast);
+    article_free(&parsed);
+    free(ast_filepath);
+    free(filepath);
+}
+
+// Inflates a gzip or zstd body into out, returns its length or -1
+static i64 test_decompress(ArticleCompression compression, const u8 *data, size_t len, char *out, size_t out_cap) {
+    switch (compression) {
+        case ARTICLE_COMPRESSION_GZIP: {
+            z_stream stream = {};
+            if (inflateInit2(&stream, 15 + 16) != Z_OK) {
+                return -1;
+            }
+
+            stream.next_in = (u8 *) data;
+            stream.avail_in = (uInt) len;
+            stream.next_out = (u8 *) out;
+            stream.avail_out = (uInt) out_cap;
+
+            int status = inflate(&stream, Z_FINISH);
+            i64 out_len = status == Z_STREAM_END ? (i64) stream.total_out : -1;
+            inflateEnd(&stream);
+
+            return out_len;
+        }
+        case ARTICLE_COMPRESSION_ZSTD: {
+#ifdef ARTICLE_HTML_ZSTD
+            size_t out_len = ZSTD_decompress(out, out_cap, data, len);
+            return ZSTD_isError(out_len) ? -1 : (i64) out_len;
+#else
+            return -1;
+#endif
+        }
+        default:
+            return -1;
+    }
+}
+
+// Two documents through one compressor each decompress to the body_html of a
+// plain parse. A codec this build doesn't have is skipped
+static void test_compressed_round_trip() {
+    const char *articles[] = {
+        "---\ntitle = First\n---\n\n# {{label one}} One\n\nGrace upon grace, see {{ref one}}.\n",
+        "---\ntitle = Second\n---\n\n# Two\n\n*Grace* & <peace> \"upon\" 'grace'.\n\n{{bible block Genesis 1:1}}\n",
+    };
+    const size_t article_count = sizeof(articles) / sizeof(articles[0]);
+    const ArticleCompression compressions[] = {ARTICLE_COMPRESSION_GZIP, ARTICLE_COMPRESSION_ZSTD};
+    const size_t compression_count = sizeof(compressions) / sizeof(compressions[0]);
+
+    for (size_t compression_idx = 0; compression_idx < compression_count; compression_idx++) {
+        ArticleCompression compression = compressions[compression_idx];
+
+        ArticleCompressor *compressor = article_compressor_create(compression, 0);
+        if (!compressor) {
+            TEST_CHECK(compression == ARTICLE_COMPRESSION_ZSTD);
+            continue;
+        }
+
+        for (size_t article_idx = 0; article_idx < article_count; article_idx++) {
+            const char *article = articles[article_idx];
+
+            ArticleData plain = article_parse_bytes(article, strlen(article), nullptr);
+
+            // The second document leaves only the compressed body behind
+            ArticleParseOptions options = {
+                .compressor = compressor,
+                .compressed_only = article_idx > 0,
+            };
+            ArticleData compressed = article_parse_bytes(article, strlen(article), &options);
+
+            if (TEST_CHECK(plain.body_html != nullptr && compressed.body_compressed != nullptr)) {
+                size_t body_len = strlen(plain.body_html);
+                char *body = malloc(body_len + 1);
+
+                i64 out_len = test_decompress(
+                    compression,
+                    compressed.body_compressed,
+                    compressed.body_compressed_len,
+                    body,
+                    body_len + 1
+                );
+
+                TEST_CHECK(out_len == (i64) body_len && memcmp(body, plain.body_html, body_len) == 0);
+                TEST_CHECK(options.compressed_only == (compressed.body_html == nullptr));
+
+                free(body);
+            }
+
+            article_free(&compressed);
+            article_free(&plain);
+        }
+
+        article_compressor_destroy(compressor);
+    }
+}
+
+// One article under src_root and one outside it, both given by absolute paths.
+// Refs name them by their path below src_root and by their whole path, and
+// link to the pages the batch rendered
+static void test_label_ref_hrefs() {
+    const char *target = "---\ntitle = Target\n---\n\n# {{label install}} Install\n";
+
+    char *src_root = test_path("src");
+    char *guide_dir = test_path("src/guide");
+    char *guide_filepath = test_path("src/guide/setup.xmd");
+    char *outside_filepath = test_path("outside.xmd");
+    char *out_dir = test_path("out");
+    char *index_filepath = test_path("hrefs.idx");
+
+    Arena arena = arena_make(64 * 1024);
+
+    TEST_CHECK(mkdir(src_root, 0755) == 0 && mkdir(guide_dir, 0755) == 0);
+    TEST_CHECK(test_write_file(guide_filepath, target));
+    TEST_CHECK(test_write_file(outside_filepath, target));
+
+    const char *filepaths[] = {guide_filepath, outside_filepath};
+    ArticleBatchOptions options = {
+        .out_dir = out_dir,
+        .src_root = src_root,
+        .label_index_filepath = index_filepath,
+        .worker_count = 1,
+    };
+    ArticleBatchResult result = article_batch_render(filepaths, 2, &options);
+    TEST_CHECK(result.rendered_count == 2 && result.failed_index_count == 0);
+
+    if (TEST_CHECK(article_load_label_index(index_filepath))) {
+        string article = str_make(
+            &arena,
+            "---\ntitle = Refs\n---\n\nSee {{ref guide/setup.xmd#install}} and {{ref %s#install}}.\n",
+            outside_filepath
+        );
+        ArticleData data = article_parse_bytes(article.data, article.len, nullptr);
+
+        // g_test_dir is absolute, the page of the article outside src_root keeps it below out_dir
+        string guide_page = str_make(&arena, "%s/guide/setup.html", out_dir);
+        string outside_page = str_make(&arena, "%s%s/outside.html", out_dir, g_test_dir);
+        string outside_href = str_make(&arena, "href=\"%s/outside.html#install\">Install</a>", g_test_dir);
+
+        TEST_CHECK(access(guide_page.data, F_OK) == 0);
+        TEST_CHECK(access(outside_page.data, F_OK) == 0);
+
+        if (TEST_CHECK(data.body_html != nullptr)) {
+            TEST_CHECK(strstr(data.body_html, "href=\"/guide/setup.html#install\">Install</a>") != nullptr);
+            TEST_CHECK(strstr(data.body_html, outside_href.data) != nullptr);
+            TEST_CHECK(strstr(data.body_html, "href=\"//") == nullptr);
+        }
+
+        article_free(&data);
+    }
+
+    arena_free(&arena);
+    free(index_filepath);
+    free(out_dir);
+    free(outside_filepath);
+    free(guide_filepath);
+    free(guide_dir);
+    free(src_root);
+}
+
+int main(int argc, char **argv) {
+    if (!mkdtemp(g_test_dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    test_label_index();
+    test_search_index();
+    test_citation_index();
+    test_bibliography();
+    test_html_escape();
+
+    // A corpus of its own, so the parse tests don't depend on the working directory
+    char *corpus_filepath = test_path("corpus.csv");
+    TEST_CHECK(test_write_file(corpus_filepath, kTestCorpusCsv));
+
+    ArticleConfig config = {
+        .corpus_filepath = corpus_filepath,
+        .corpus_loading = ARTICLE_CORPUS_LOADING_LAZY,
+    };
+    article_init_ex(&config);
+
+    test_toc_ids();
+    test_arena_retry();
+    test_push_parse();
+    test_forward_ref();
+    test_push_forward_ref();
+    test_label_ref_hrefs();
+    test_ast_round_trip();
+    test_compressed_round_trip();
 
     article_uninit();
+    free(corpus_filepath);
+
+    nftw(g_test_dir, test_remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+
+    printf("%d of %d checks failed\n", g_test_failed_count, g_test_check_count);
+
+    return g_test_failed_count > 0 ? 1 : 0;
 }
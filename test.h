@@ -5,4 +5,11 @@
 #ifndef ARTICLE_HTML_TEST_H
 #define ARTICLE_HTML_TEST_H
 
-#endif //ARTICLE_HTML_TEST_H
\ No newline at end of file
+#include <stdbool.h>
+
+// Reports a failed check with where it is, the run carries on to the next one
+#define TEST_CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+bool test_check(bool passed, const char *expr, const char *file, int line);
+
+#endif //ARTICLE_HTML_TEST_H
@@ -0,0 +1,211 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "trace.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct TRACE_EVENT_T {
+    const char *name;
+    u64 ts_ns;
+    // Negative when the span has no byte count
+    i64 bytes;
+    char phase;
+    char path[TRACE_PATH_CAPACITY];
+} TraceEvent;
+
+// Written only by its own thread, read by trace_stop once the thread is idle
+typedef struct TRACE_RING_T {
+    TraceEvent events[TRACE_RING_CAPACITY];
+    atomic_ullong head;
+    u32 tid;
+    atomic_bool retired;
+    struct TRACE_RING_T *next;
+} TraceRing;
+
+static atomic_bool g_trace_enabled = false;
+static u64 g_trace_start_ns = 0;
+
+// Only taken when a thread records its first span
+static pthread_mutex_t g_trace_rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *g_trace_rings = nullptr;
+static u32 g_trace_ring_count = 0;
+
+static pthread_once_t g_trace_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_trace_ring_key;
+
+static _Thread_local TraceRing *t_trace_ring = nullptr;
+
+static u64 trace_now_ns() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (u64) ts.tv_sec * 1000000000ULL + (u64) ts.tv_nsec;
+}
+
+// The ring outlives its thread so the spans can still be flushed, a new
+// thread picks it up again once it is empty
+static void trace_ring_retire(void *ring) {
+    atomic_store(&((TraceRing *) ring)->retired, true);
+}
+
+static void trace_make_key() {
+    int err = pthread_key_create(&g_trace_ring_key, trace_ring_retire);
+    assert(!err);
+}
+
+static TraceRing *trace_thread_ring() {
+    if (t_trace_ring) {
+        return t_trace_ring;
+    }
+
+    pthread_once(&g_trace_key_once, trace_make_key);
+
+    pthread_mutex_lock(&g_trace_rings_mutex);
+
+    TraceRing *ring = g_trace_rings;
+    while (ring && !(atomic_load(&ring->retired) && atomic_load(&ring->head) == 0)) {
+        ring = ring->next;
+    }
+
+    if (ring) {
+        atomic_store(&ring->retired, false);
+    } else {
+        ring = calloc(1, sizeof(TraceRing));
+        assert(ring);
+
+        ring->tid = ++g_trace_ring_count;
+        ring->next = g_trace_rings;
+        g_trace_rings = ring;
+    }
+
+    pthread_mutex_unlock(&g_trace_rings_mutex);
+
+    pthread_setspecific(g_trace_ring_key, ring);
+    t_trace_ring = ring;
+
+    return ring;
+}
+
+static void trace_record(char phase, const char *name, const char *path, i64 bytes) {
+    if (!atomic_load_explicit(&g_trace_enabled, memory_order_relaxed)) {
+        return;
+    }
+
+    TraceRing *ring = trace_thread_ring();
+
+    u64 head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent *event = &ring->events[head % TRACE_RING_CAPACITY];
+
+    event->name = name;
+    event->ts_ns = trace_now_ns();
+    event->bytes = bytes;
+    event->phase = phase;
+    event->path[0] = '\0';
+
+    if (path) {
+        strncpy(event->path, path, TRACE_PATH_CAPACITY - 1);
+        event->path[TRACE_PATH_CAPACITY - 1] = '\0';
+    }
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void trace_write_json_str(FILE *fp, const char *str) {
+    fputc('"', fp);
+
+    for (const char *c = str; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fputc('\\', fp);
+            fputc(*c, fp);
+        } else if ((unsigned char) *c < 0x20) {
+            fprintf(fp, "\\u%04x", (unsigned char) *c);
+        } else {
+            fputc(*c, fp);
+        }
+    }
+
+    fputc('"', fp);
+}
+
+void trace_start() {
+    g_trace_start_ns = trace_now_ns();
+    atomic_store(&g_trace_enabled, true);
+}
+
+bool trace_stop(const char *json_filepath) {
+    atomic_store(&g_trace_enabled, false);
+
+    if (!json_filepath) {
+        return false;
+    }
+
+    FILE *fp = fopen(json_filepath, "wb");
+    if (!fp) {
+        return false;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    int pid = (int) getpid();
+    bool first_event = true;
+
+    pthread_mutex_lock(&g_trace_rings_mutex);
+
+    for (TraceRing *ring = g_trace_rings; ring; ring = ring->next) {
+        u64 head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        u64 first_idx = head > TRACE_RING_CAPACITY ? head - TRACE_RING_CAPACITY : 0;
+
+        for (u64 event_idx = first_idx; event_idx < head; event_idx++) {
+            const TraceEvent *event = &ring->events[event_idx % TRACE_RING_CAPACITY];
+            u64 ts_ns = event->ts_ns > g_trace_start_ns ? event->ts_ns - g_trace_start_ns : 0;
+
+            fprintf(
+                fp,
+                "%s\n{\"name\":\"%s\",\"cat\":\"article_html\",\"ph\":\"%c\","
+                "\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{",
+                first_event ? "" : ",",
+                event->name,
+                event->phase,
+                (double) ts_ns / 1e3,
+                pid,
+                ring->tid
+            );
+
+            if (event->path[0]) {
+                fprintf(fp, "\"path\":");
+                trace_write_json_str(fp, event->path);
+            }
+            if (event->bytes >= 0) {
+                fprintf(fp, "%s\"bytes\":%lld", event->path[0] ? "," : "", (long long) event->bytes);
+            }
+
+            fprintf(fp, "}}");
+            first_event = false;
+        }
+
+        atomic_store(&ring->head, 0);
+    }
+
+    pthread_mutex_unlock(&g_trace_rings_mutex);
+
+    fprintf(fp, "\n]}\n");
+
+    return fclose(fp) == 0;
+}
+
+void trace_span_begin(const char *name, const char *path, i64 bytes) {
+    trace_record('B', name, path, bytes);
+}
+
+void trace_span_end(const char *name, i64 bytes) {
+    trace_record('E', name, nullptr, bytes);
+}
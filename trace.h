@@ -0,0 +1,40 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_TRACE_H
+#define ARTICLE_HTML_TRACE_H
+
+#include <altcore/types.h>
+
+// Span names are stored by pointer, only pass string literals
+#ifdef ARTICLE_HTML_TRACE
+
+#define TRACE_BEGIN(name, path, bytes) trace_span_begin(name, path, bytes)
+#define TRACE_END(name, bytes) trace_span_end(name, bytes)
+
+#else
+
+#define TRACE_BEGIN(name, path, bytes) ((void) 0)
+#define TRACE_END(name, bytes) ((void) 0)
+
+#endif
+
+// Events recorded by a thread before the ring wraps, older ones are overwritten
+#define TRACE_RING_CAPACITY (1 << 15)
+
+// Longer paths are truncated in the span arguments
+#define TRACE_PATH_CAPACITY 96
+
+// Spans are only recorded between start and stop
+void trace_start();
+
+// Writes every thread's ring as Chrome trace-event JSON and clears them, the
+// recording threads must be idle
+bool trace_stop(const char *json_filepath);
+
+void trace_span_begin(const char *name, const char *path, i64 bytes);
+
+void trace_span_end(const char *name, i64 bytes);
+
+#endif //ARTICLE_HTML_TRACE_H
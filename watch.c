@@ -0,0 +1,343 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#include "watch.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <altcore/types.h>
+#include <altcore/arenas.h>
+#include <altcore/strings.h>
+#include <altcore/hashmap.h>
+
+static const i64 kWatchDirsArenaCapacity = 16LL * 1024LL * 1024LL;
+static const i64 kWatchPendingArenaCapacity = 64LL * 1024LL * 1024LL;
+static const i32 kWatchDefaultDebounceMs = 30;
+static const i32 kWatchDefaultMaxLatencyMs = 1000;
+static const i32 kWatchStopPollMs = 200;
+static const char *kWatchDefaultExtension = ".xmd";
+static const u32 kWatchFileEvents = IN_CLOSE_WRITE | IN_MOVED_TO;
+static const u32 kWatchDirEvents = IN_CREATE | IN_MOVED_TO | IN_ONLYDIR;
+
+typedef struct WATCH_PENDING_SET_T {
+    HASHMAP_FIELDS(const char*, bool)
+} WatchPendingSet;
+
+typedef struct WATCH_STATE_T {
+    const ArticleWatchOptions *options;
+    i32 inotify_fd;
+    // Watched directory path per inotify watch descriptor
+    Arena dirs_arena;
+    strings dir_paths;
+    Arena pending_arena;
+    strings pending_paths;
+    WatchPendingSet pending_set;
+    // When the first of the pending changes came in
+    i64 pending_since_ms;
+    // Every debounced render runs on these threads
+    ArticleBatchPool *pool;
+} WatchState;
+
+static volatile sig_atomic_t g_watch_stopping = 0;
+
+static i64 watch_now_ms() {
+    struct timespec ts = {};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (i64) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool watch_has_extension(const char *filename, const char *extension) {
+    u64 filename_len = strlen(filename);
+    u64 extension_len = strlen(extension);
+
+    return filename_len > extension_len
+           && strcmp(filename + filename_len - extension_len, extension) == 0;
+}
+
+static void watch_push_pending(WatchState *state, const string *dir_path, const char *filename);
+
+static void watch_render_pending(WatchState *state);
+
+// With queue_files, the articles already in the tree are rendered too, as
+// after an overflow lost their events
+static void watch_add_dir(WatchState *state, const char *dir_path, bool queue_files) {
+    i32 wd = inotify_add_watch(state->inotify_fd, dir_path, kWatchFileEvents | kWatchDirEvents);
+    if (wd < 0) {
+        return;
+    }
+
+    while (state->dir_paths.len <= wd) {
+        string empty_path = {};
+        ARRAY_PUSH(&state->dir_paths, &empty_path);
+    }
+
+    // A directory met again keeps its watch descriptor and its copy of the path
+    string *watched_path = &state->dir_paths.data[wd];
+    if (!watched_path->data || strcmp(watched_path->data, dir_path) != 0) {
+        *watched_path = str_make(&state->dirs_arena, "%s", dir_path);
+    }
+
+    DIR *dir = opendir(dir_path);
+    if (!dir) {
+        return;
+    }
+
+    // Sub-directories are watched individually, inotify isn't recursive
+    struct dirent *entry = nullptr;
+    while ((entry = readdir(dir))) {
+        if (queue_files
+            && entry->d_type != DT_DIR
+            && watch_has_extension(entry->d_name, state->options->extension)) {
+            watch_push_pending(state, &state->dir_paths.data[wd], entry->d_name);
+            continue;
+        }
+
+        if (entry->d_type != DT_DIR
+            || strcmp(entry->d_name, ".") == 0
+            || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+
+        char sub_dir_path[4096];
+        i32 path_len = snprintf(sub_dir_path, sizeof(sub_dir_path), "%s/%s", dir_path, entry->d_name);
+        if (path_len > 0 && path_len < (i32) sizeof(sub_dir_path)) {
+            watch_add_dir(state, sub_dir_path, queue_files);
+        }
+    }
+
+    closedir(dir);
+}
+
+static void watch_reset_pending(WatchState *state) {
+    HASHMAP_FREE(&state->pending_set);
+
+    state->pending_arena.offset = 0;
+
+    state->pending_set = (WatchPendingSet){HASHMAP_TYPE_STR_KEY};
+    bool default_pending = false;
+    HASHMAP_MAKE(&state->pending_set, &default_pending);
+
+    state->pending_paths = (strings){&state->pending_arena};
+    ARRAY_MAKE(&state->pending_paths);
+}
+
+// The set only copies a path into the arena once it is new
+static void watch_push_pending(WatchState *state, const string *dir_path, const char *filename) {
+    char filepath_buffer[4096];
+    i32 path_len = snprintf(filepath_buffer, sizeof(filepath_buffer), "%s/%s", dir_path->data, filename);
+    if (path_len <= 0 || path_len >= (i32) sizeof(filepath_buffer)) {
+        return;
+    }
+
+    // Editors often write the same file several times per save
+    const char *lookup_path = filepath_buffer;
+    if (HASHMAP_GET_VAL(&state->pending_set, &lookup_path)) {
+        return;
+    }
+
+    // The path and the list moving to twice its size. A full arena renders
+    // what is pending and starts over
+    i64 push_bytes = 2 * (path_len + 1) + 2 * (state->pending_paths.len + 1) * (i64) sizeof(string);
+    if (state->pending_arena.offset + push_bytes > kWatchPendingArenaCapacity) {
+        watch_render_pending(state);
+    }
+
+    if (state->pending_paths.len == 0) {
+        state->pending_since_ms = watch_now_ms();
+    }
+
+    string filepath = str_make(&state->pending_arena, "%s", filepath_buffer);
+
+    bool pending = true;
+    HASHMAP_PUT(&state->pending_set, &filepath.data, &pending);
+    ARRAY_PUSH(&state->pending_paths, &filepath);
+}
+
+static void watch_read_events(WatchState *state) {
+    alignas(struct inotify_event) char events_buffer[16 * 1024];
+
+    for (;;) {
+        ssize_t read_len = read(state->inotify_fd, events_buffer, sizeof(events_buffer));
+        if (read_len <= 0) {
+            break;
+        }
+
+        for (char *cursor = events_buffer; cursor < events_buffer + read_len;) {
+            const struct inotify_event *event = (const struct inotify_event *) cursor;
+            cursor += sizeof(struct inotify_event) + event->len;
+
+            // Events were dropped, so whatever changed is unknown: the whole
+            // tree is rendered again and any new directories watched. The
+            // directory paths are made again, keeping only those still there
+            if (event->mask & IN_Q_OVERFLOW) {
+                fprintf(stderr, "watch: inotify queue overflowed, rescanning %s\n", state->options->src_dir);
+
+                state->dirs_arena.offset = 0;
+                state->dir_paths = (strings){&state->dirs_arena};
+                ARRAY_MAKE(&state->dir_paths);
+
+                watch_add_dir(state, state->options->src_dir, true);
+                continue;
+            }
+
+            if (event->len == 0 || event->wd < 0 || event->wd >= state->dir_paths.len) {
+                continue;
+            }
+
+            const string *dir_path = &state->dir_paths.data[event->wd];
+            if (!dir_path->data) {
+                continue;
+            }
+
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    char sub_dir_path[4096];
+                    i32 path_len = snprintf(
+                        sub_dir_path,
+                        sizeof(sub_dir_path),
+                        "%s/%s",
+                        dir_path->data,
+                        event->name
+                    );
+                    // Files may land in it before its watch exists
+                    if (path_len > 0 && path_len < (i32) sizeof(sub_dir_path)) {
+                        watch_add_dir(state, sub_dir_path, true);
+                    }
+                }
+                continue;
+            }
+
+            if ((event->mask & kWatchFileEvents)
+                && watch_has_extension(event->name, state->options->extension)) {
+                watch_push_pending(state, dir_path, event->name);
+            }
+        }
+    }
+}
+
+static void watch_render_pending(WatchState *state) {
+    if (state->pending_paths.len == 0) {
+        return;
+    }
+
+    const char **filepaths = (const char **) calloc(state->pending_paths.len, sizeof(char *));
+    assert(filepaths);
+
+    for (i64 path_idx = 0; path_idx < state->pending_paths.len; path_idx++) {
+        filepaths[path_idx] = state->pending_paths.data[path_idx].data;
+    }
+
+    ArticleBatchOptions batch_options = {
+        .out_dir = state->options->out_dir,
+        .src_root = state->options->src_dir,
+        .pool = state->pool,
+    };
+
+    ArticleBatchResult result = article_batch_render(filepaths, state->pending_paths.len, &batch_options);
+
+    if (result.failed_count > 0) {
+        fprintf(stderr, "watch: %zu of %lld articles failed to render\n",
+                result.failed_count, (long long) state->pending_paths.len);
+    }
+
+    free(filepaths);
+
+    watch_reset_pending(state);
+}
+
+int article_watch_run(const ArticleWatchOptions *options) {
+    if (!options || !options->src_dir || !options->out_dir) {
+        return -1;
+    }
+
+    ArticleWatchOptions resolved_options = *options;
+    if (!resolved_options.extension) {
+        resolved_options.extension = kWatchDefaultExtension;
+    }
+    if (resolved_options.debounce_ms <= 0) {
+        resolved_options.debounce_ms = kWatchDefaultDebounceMs;
+    }
+    if (resolved_options.max_latency_ms <= 0) {
+        resolved_options.max_latency_ms = kWatchDefaultMaxLatencyMs;
+    }
+
+    WatchState state = {
+        .options = &resolved_options,
+        .inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC),
+    };
+
+    if (state.inotify_fd < 0) {
+        return -1;
+    }
+
+    state.dirs_arena = arena_make(kWatchDirsArenaCapacity);
+    state.dir_paths = (strings){&state.dirs_arena};
+    ARRAY_MAKE(&state.dir_paths);
+
+    state.pending_arena = arena_make(kWatchPendingArenaCapacity);
+    state.pending_set = (WatchPendingSet){HASHMAP_TYPE_STR_KEY};
+    bool default_pending = false;
+    HASHMAP_MAKE(&state.pending_set, &default_pending);
+    state.pending_paths = (strings){&state.pending_arena};
+    ARRAY_MAKE(&state.pending_paths);
+
+    state.pool = article_batch_pool_create(resolved_options.worker_count);
+
+    watch_add_dir(&state, resolved_options.src_dir, false);
+
+    g_watch_stopping = 0;
+
+    while (!g_watch_stopping) {
+        struct pollfd inotify_poll = {
+            .fd = state.inotify_fd,
+            .events = POLLIN,
+        };
+
+        // While changes are pending, a quiet debounce window triggers the
+        // render, or the oldest change reaching the maximum latency
+        i32 timeout_ms = kWatchStopPollMs;
+        if (state.pending_paths.len > 0) {
+            i64 latency_left_ms = state.pending_since_ms + resolved_options.max_latency_ms - watch_now_ms();
+            if (latency_left_ms <= 0) {
+                watch_render_pending(&state);
+                continue;
+            }
+
+            timeout_ms = latency_left_ms < resolved_options.debounce_ms
+                             ? (i32) latency_left_ms
+                             : resolved_options.debounce_ms;
+        }
+
+        i32 ready = poll(&inotify_poll, 1, timeout_ms);
+        if (ready > 0) {
+            watch_read_events(&state);
+        } else if (ready == 0) {
+            watch_render_pending(&state);
+        }
+    }
+
+    watch_render_pending(&state);
+
+    article_batch_pool_destroy(state.pool);
+    close(state.inotify_fd);
+
+    HASHMAP_FREE(&state.pending_set);
+    arena_free(&state.pending_arena);
+    arena_free(&state.dirs_arena);
+
+    return 0;
+}
+
+void article_watch_stop() {
+    g_watch_stopping = 1;
+}
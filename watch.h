@@ -0,0 +1,30 @@
+//
+// Created by wright on 10/19/26.
+//
+
+#ifndef ARTICLE_HTML_WATCH_H
+#define ARTICLE_HTML_WATCH_H
+
+#include "batch.h"
+
+typedef struct ARTICLE_WATCH_OPTIONS_T {
+    const char* src_dir;
+    const char* out_dir;
+    // Only files ending in this are rendered, defaults to ".xmd"
+    const char* extension;
+    int debounce_ms;
+    // Pending changes are rendered after this long even while more keep
+    // arriving, defaults to 1000
+    int max_latency_ms;
+    int worker_count;
+} ArticleWatchOptions;
+
+// Watches src_dir recursively and re-renders articles as they are saved,
+// until article_watch_stop, each to its path relative to src_dir under
+// out_dir. The library must already be initialised
+int article_watch_run(const ArticleWatchOptions *options);
+
+// Async-signal-safe
+void article_watch_stop();
+
+#endif //ARTICLE_HTML_WATCH_H